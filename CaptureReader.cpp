@@ -0,0 +1,323 @@
+#include "CaptureReader.h"
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//
+// Function used to map a whole file read only.  Returns nullptr on failure.
+//
+static const uint8_t *MapFile(const std::string& sPath, size_t nMinSize,
+    size_t *pnSize)
+{
+    int fd = ::open(sPath.c_str(), O_RDONLY);
+    if(fd < 0) return nullptr;
+
+    struct stat st;
+    if(::fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < nMinSize) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    void    *p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if(p == MAP_FAILED) return nullptr;
+
+    *pnSize = st.st_size;
+    return static_cast<const uint8_t *>(p);
+}
+
+//
+// Constructor.  sPath is the data file, the index is expected next to it.
+//
+CaptureReader::CaptureReader(const std::string& sPath)
+    : m_pMap(nullptr)
+    , m_nMapSize(0)
+    , m_nSamples(0)
+    , m_dSamplePeriod(0.0)
+    , m_pIndexMap(nullptr)
+    , m_nIndexMapSize(0)
+    , m_pEntries(nullptr)
+    , m_nEntries(0)
+{
+    ::memset(&m_Header, 0, sizeof(m_Header));
+
+    size_t          nSize = 0;
+    const uint8_t   *p = MapFile(sPath, sizeof(RecordingFileHeader), &nSize);
+    if(!p) {
+        std::cerr << "Unable to open " << sPath << std::endl;
+        return;
+    }
+
+    ::memcpy(&m_Header, p, sizeof(m_Header));
+
+    if(::strncmp(m_Header.szMagic, RECORDING_MAGIC, sizeof(m_Header.szMagic))
+        || m_Header.nHeaderSize > nSize) {
+        std::cerr << sPath << " is not a recording" << std::endl;
+        ::munmap(const_cast<uint8_t *>(p), nSize);
+        return;
+    }
+    m_Header.szName[sizeof(m_Header.szName) - 1] = '\0';
+    m_Header.szDataType[sizeof(m_Header.szDataType) - 1] = '\0';
+
+    m_pMap = p;
+    m_nMapSize = nSize;
+
+    // A recording that was never closed has no count in its header
+    m_nSamples = std::min<uint64_t>(m_Header.nSamples ?
+        m_Header.nSamples : UINT64_MAX,
+        (m_nMapSize - m_Header.nHeaderSize) / sizeof(float));
+    m_dSamplePeriod = m_Header.dSamplePeriod * m_Header.nDecimationFactor;
+
+    std::string sIndexPath = sPath;
+    if(sIndexPath.size() > 4 &&
+        sIndexPath.substr(sIndexPath.size() - 4) == ".llr")
+        sIndexPath.resize(sIndexPath.size() - 4);
+    sIndexPath += ".lli";
+
+    if(!MapIndex(sIndexPath)) {
+        // Treat the whole recording as one segment
+        m_DefaultEntry.nSample = 0;
+        m_DefaultEntry.nFileOffset = m_Header.nHeaderSize;
+        m_DefaultEntry.dTimestamp = m_Header.dFirstSampleTimestamp != 0.0 ?
+            m_Header.dFirstSampleTimestamp : NAN;
+        m_DefaultEntry.nFlags = INDEX_FLAG_SEGMENT_START;
+        m_DefaultEntry.nSegment = 0;
+
+        m_pEntries = &m_DefaultEntry;
+        m_nEntries = 1;
+    }
+
+    BuildSegments();
+}
+
+//
+// Destructor
+//
+CaptureReader::~CaptureReader()
+{
+    if(m_pMap) ::munmap(const_cast<uint8_t *>(m_pMap), m_nMapSize);
+    if(m_pIndexMap)
+        ::munmap(const_cast<uint8_t *>(m_pIndexMap), m_nIndexMapSize);
+}
+
+//
+// Function used to map and check the index file
+//
+bool CaptureReader::MapIndex(const std::string& sPath)
+{
+    size_t          nSize = 0;
+    const uint8_t   *p = MapFile(sPath, sizeof(RecordingIndexHeader), &nSize);
+    if(!p) return false;
+
+    RecordingIndexHeader    h;
+    ::memcpy(&h, p, sizeof(h));
+
+    const RecordingIndexEntry   *pEntries =
+        reinterpret_cast<const RecordingIndexEntry *>(p + sizeof(h));
+    size_t  nEntries = (nSize - sizeof(h)) / sizeof(RecordingIndexEntry);
+
+    // The index can run ahead of the data in a recording that was never
+    // closed
+    while(nEntries && pEntries[nEntries - 1].nSample >= m_nSamples)
+        nEntries--;
+
+    if(::strncmp(h.szMagic, RECORDING_INDEX_MAGIC, sizeof(h.szMagic)) ||
+        h.nEntrySize != sizeof(RecordingIndexEntry) || !nEntries ||
+        pEntries[0].nSample != 0) {
+        ::munmap(const_cast<uint8_t *>(p), nSize);
+        return false;
+    }
+
+    m_pIndexMap = p;
+    m_nIndexMapSize = nSize;
+    m_pEntries = pEntries;
+    m_nEntries = nEntries;
+
+    return true;
+}
+
+//
+// Function used to split the index into segments.  Only segments with known
+// timestamps take part in time searches.
+//
+void CaptureReader::BuildSegments(void)
+{
+    for(size_t i = 0; i < m_nEntries; i++) {
+        const RecordingIndexEntry&  e = m_pEntries[i];
+
+        if(i == 0 || (e.nFlags & (INDEX_FLAG_SEGMENT_START | INDEX_FLAG_GAP))) {
+            if(!m_vSegments.empty()) {
+                CaptureSegment& s = m_vSegments.back();
+                s.nSamples = e.nSample - s.nFirstSample;
+            }
+
+            CaptureSegment  s;
+            s.nFirstSample = e.nSample;
+            s.nSamples = 0;
+            s.dStartTime = e.dTimestamp;
+            s.nFlags = e.nFlags;
+            s.nFirstEntry = i;
+            s.nEntries = 0;
+            m_vSegments.push_back(s);
+        }
+
+        m_vSegments.back().nEntries++;
+    }
+
+    if(!m_vSegments.empty()) {
+        CaptureSegment& s = m_vSegments.back();
+        s.nSamples = m_nSamples - s.nFirstSample;
+    }
+
+    for(size_t i = 0; i < m_vSegments.size(); i++)
+        if(!std::isnan(m_vSegments[i].dStartTime) && m_vSegments[i].nSamples)
+            m_vTimedSegments.push_back(i);
+}
+
+//
+// Function used to find the last index entry of a segment at or before a
+// time
+//
+const RecordingIndexEntry *CaptureReader::EntryAtTime(
+    const CaptureSegment& s, double dTime) const
+{
+    const RecordingIndexEntry   *pFirst = m_pEntries + s.nFirstEntry;
+    const RecordingIndexEntry   *pEnd = pFirst + s.nEntries;
+
+    auto    it = std::upper_bound(pFirst, pEnd, dTime,
+        [](double t, const RecordingIndexEntry& e) {
+            return t < e.dTimestamp;
+        });
+
+    return it == pFirst ? pFirst : it - 1;
+}
+
+//
+// Function used to find the last index entry of a segment at or before a
+// sample
+//
+const RecordingIndexEntry *CaptureReader::EntryAtSample(
+    const CaptureSegment& s, uint64_t nSample) const
+{
+    const RecordingIndexEntry   *pFirst = m_pEntries + s.nFirstEntry;
+    const RecordingIndexEntry   *pEnd = pFirst + s.nEntries;
+
+    auto    it = std::upper_bound(pFirst, pEnd, nSample,
+        [](uint64_t n, const RecordingIndexEntry& e) {
+            return n < e.nSample;
+        });
+
+    return it == pFirst ? pFirst : it - 1;
+}
+
+//
+// Function used to find the first sample with a timestamp at or after
+// dTime.  Returns false if there is none.
+//
+bool CaptureReader::SampleAtTime(double dTime, uint64_t *pnSample) const
+{
+    if(m_vTimedSegments.empty() || std::isnan(dTime)) return false;
+
+    auto    it = std::upper_bound(m_vTimedSegments.begin(),
+        m_vTimedSegments.end(), dTime,
+        [this](double t, size_t i) { return t < m_vSegments[i].dStartTime; });
+
+    if(it == m_vTimedSegments.begin()) {
+        // Before the capture started
+        *pnSample = m_vSegments[*it].nFirstSample;
+        return true;
+    }
+
+    const CaptureSegment&   s = m_vSegments[*(it - 1)];
+    const RecordingIndexEntry   *e = EntryAtTime(s, dTime);
+
+    // A timestamp is only good to a few units in its last place, about
+    // 2e-7 s for an epoch time and so a good part of a sample at high
+    // rates.  A time that rounds to just after a sample still finds it.
+    uint64_t    n = e->nSample;
+    if(m_dSamplePeriod > 0.0) {
+        double  dTolerance = std::max(CAPTURE_TIME_TOLERANCE,
+            4.0 * std::numeric_limits<double>::epsilon() * std::fabs(dTime) /
+            m_dSamplePeriod);
+        double  d = std::ceil((dTime - e->dTimestamp) / m_dSamplePeriod -
+            dTolerance);
+        if(d > 0.0) n += static_cast<uint64_t>(d);
+    }
+
+    if(n < s.nFirstSample + s.nSamples) {
+        *pnSample = n;
+        return true;
+    }
+
+    // Between this segment and the next one
+    if(it == m_vTimedSegments.end()) return false;
+
+    *pnSample = m_vSegments[*it].nFirstSample;
+    return true;
+}
+
+//
+// Function used to get the timestamp of a sample, NaN if it is not known
+//
+double CaptureReader::TimeOfSample(uint64_t nSample) const
+{
+    if(nSample >= m_nSamples || m_vSegments.empty()) return NAN;
+
+    auto    it = std::upper_bound(m_vSegments.begin(), m_vSegments.end(),
+        nSample, [](uint64_t n, const CaptureSegment& s) {
+            return n < s.nFirstSample;
+        });
+    if(it == m_vSegments.begin()) return NAN;
+
+    const RecordingIndexEntry   *e = EntryAtSample(*(it - 1), nSample);
+
+    return e->dTimestamp + static_cast<double>(nSample - e->nSample) *
+        m_dSamplePeriod;
+}
+
+//
+// Function used to get up to nMaxSamples from nSample on.  Returns the
+// number of samples available at *ppData.
+//
+size_t CaptureReader::Read(uint64_t nSample, size_t nMaxSamples,
+    const float **ppData) const
+{
+    if(!m_pMap || nSample >= m_nSamples) return 0;
+
+    *ppData = reinterpret_cast<const float *>(m_pMap +
+        m_Header.nHeaderSize) + nSample;
+
+    return static_cast<size_t>(std::min<uint64_t>(nMaxSamples,
+        m_nSamples - nSample));
+}
+
+//
+// Function used to get the samples with timestamps in [dStartTime,
+// dEndTime).  Returns the number of samples at *ppData, the first of which
+// is sample *pnFirstSample.  A range spanning a restart also holds the
+// samples of any untimed segment recorded in between.
+//
+size_t CaptureReader::ReadTimeRange(double dStartTime, double dEndTime,
+    const float **ppData, uint64_t *pnFirstSample) const
+{
+    uint64_t    nFirst, nEnd;
+
+    if(!SampleAtTime(dStartTime, &nFirst)) return 0;
+    if(!SampleAtTime(dEndTime, &nEnd)) nEnd = m_nSamples;
+    if(nEnd <= nFirst) return 0;
+
+    *pnFirstSample = nFirst;
+    return Read(nFirst, static_cast<size_t>(nEnd - nFirst), ppData);
+}
+
+#endif
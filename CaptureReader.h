@@ -0,0 +1,93 @@
+#ifndef __CAPTUREREADER_H__
+#define __CAPTUREREADER_H__
+
+#if defined(__linux__)
+
+#include    <string>
+#include    <vector>
+#include    "ChannelRecorder.h"
+
+//
+// Least fraction of a sample period a time can be past a sample's timestamp
+// and still be taken as that sample, more for timestamps too big to be
+// that precise
+//
+#define CAPTURE_TIME_TOLERANCE  1e-3
+
+//
+// Definition of a run of samples whose timestamps follow on from each other
+//
+typedef struct {
+    uint64_t    nFirstSample;           // First sample of the segment
+    uint64_t    nSamples;               // Samples in the segment
+    double      dStartTime;             // Timestamp of nFirstSample, NaN if
+                                        // not known
+    uint32_t    nFlags;                 // INDEX_FLAG_* it started with
+    size_t      nFirstEntry;            // Index entries of the segment
+    size_t      nEntries;
+} CaptureSegment;
+
+//
+// Definition of the capture reader.
+//
+// Memory maps one ChannelRecorder data file (.llr) and the index
+// written next to it (.lli), and answers "which sample is at time t"
+// with a binary search over the segments and then over the index entries of
+// the segment found, so a seek costs O(log n) however long the capture is.
+// Reads return pointers straight into the mapped file.
+//
+// A recording without an index (or with a damaged one) is read as a single
+// segment starting at the first sample timestamp in its header.
+//
+class CaptureReader {
+    public:
+        explicit CaptureReader(const std::string& sPath);
+        ~CaptureReader();
+
+        CaptureReader(const CaptureReader&) = delete;
+        CaptureReader& operator=(const CaptureReader&) = delete;
+
+        bool IsOpen(void) const { return m_pMap != nullptr; }
+
+        const RecordingFileHeader& Header(void) const { return m_Header; }
+        uint64_t Samples(void) const { return m_nSamples; }
+        double SamplePeriod(void) const { return m_dSamplePeriod; }
+        const std::vector<CaptureSegment>& Segments(void) const {
+            return m_vSegments;
+        }
+
+        bool SampleAtTime(double dTime, uint64_t *pnSample) const;
+        double TimeOfSample(uint64_t nSample) const;
+
+        size_t Read(uint64_t nSample, size_t nMaxSamples,
+            const float **ppData) const;
+        size_t ReadTimeRange(double dStartTime, double dEndTime,
+            const float **ppData, uint64_t *pnFirstSample) const;
+
+    private:
+        bool MapIndex(const std::string&);
+        void BuildSegments(void);
+        const RecordingIndexEntry *EntryAtTime(const CaptureSegment&,
+            double dTime) const;
+        const RecordingIndexEntry *EntryAtSample(const CaptureSegment&,
+            uint64_t nSample) const;
+
+        RecordingFileHeader         m_Header;
+        const uint8_t               *m_pMap;
+        size_t                      m_nMapSize;
+        uint64_t                    m_nSamples;
+        double                      m_dSamplePeriod;
+
+        const uint8_t               *m_pIndexMap;
+        size_t                      m_nIndexMapSize;
+        const RecordingIndexEntry   *m_pEntries;
+        size_t                      m_nEntries;
+        RecordingIndexEntry         m_DefaultEntry;
+
+        std::vector<CaptureSegment> m_vSegments;
+        std::vector<size_t>         m_vTimedSegments;
+};
+
+#endif
+
+#endif
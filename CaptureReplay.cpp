@@ -0,0 +1,363 @@
+#include "CaptureReplay.h"
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <dirent.h>
+#include <sys/stat.h>
+
+//
+// Constructor.  sPath is either a single recording file or a directory of
+// them.
+//
+CaptureReplay::CaptureReplay(const std::string& sPath, EventHandler fCb,
+    const CaptureReplayConfig& Config)
+    : m_fEventHandler(fCb)
+    , m_Config(Config)
+    , m_ReplayThread(nullptr)
+    , m_bStop(false)
+    , m_nBlocks(0)
+    , m_nSamples(0)
+    , m_dSeconds(0.0)
+{
+    if(m_Config.dSpeed < 0.0) m_Config.dSpeed = 0.0;
+    if(!m_Config.nBlockSamples) m_Config.nBlockSamples = 1024;
+
+    struct stat st;
+    if(::stat(sPath.c_str(), &st) < 0) {
+        std::cerr << "Unable to open " << sPath << std::endl;
+        return;
+    }
+
+    if(!S_ISDIR(st.st_mode)) {
+        Open(sPath);
+        return;
+    }
+
+    // Take the files in name order so ids are the same on every replay
+    std::vector<std::string>    vFiles;
+    DIR *d = ::opendir(sPath.c_str());
+    if(d) {
+        struct dirent   *de;
+        while((de = ::readdir(d)) != nullptr) {
+            std::string sName(de->d_name);
+            if(sName.size() > 4 && sName.substr(sName.size() - 4) == ".llr")
+                vFiles.push_back(sPath + "/" + sName);
+        }
+        ::closedir(d);
+    }
+    std::sort(vFiles.begin(), vFiles.end());
+
+    for(auto& e : vFiles) Open(e);
+}
+
+//
+// Destructor
+//
+CaptureReplay::~CaptureReplay()
+{
+    Stop();
+    Wait();
+}
+
+//
+// Function used to tell whether a segment is the timestamp of the
+// acquisition before it arriving late, rather than a new acquisition
+//
+static bool IsLate(const std::vector<CaptureSegment>& vSegments, size_t i)
+{
+    return i > 0 && !std::isnan(vSegments[i].dStartTime) &&
+        std::isnan(vSegments[i - 1].dStartTime);
+}
+
+//
+// Function used to open a recording, finding from its index where each
+// acquisition starts and when each segment is to be replayed
+//
+bool CaptureReplay::Open(const std::string& sPath)
+{
+    Channel ch;
+
+    ch.pReader = std::make_unique<CaptureReader>(sPath);
+    if(!ch.pReader->IsOpen()) return false;
+
+    const std::vector<CaptureSegment>&  vSegments = ch.pReader->Segments();
+
+    ch.hChannel = ChannelNames::Intern(ch.pReader->Header().szName);
+    ch.nId = static_cast<int>(m_vChannels.size());
+    ch.dPeriod = ch.pReader->SamplePeriod();
+    ch.nSegment = 0;
+    ch.nNext = 0;
+
+    for(size_t i = 0; i < vSegments.size(); i++) {
+        if(i == 0 || ((vSegments[i].nFlags & INDEX_FLAG_SEGMENT_START) &&
+            !IsLate(vSegments, i)))
+            ch.vRuns.push_back(i);
+    }
+
+    // An untimed segment goes just before the one whose timestamp came
+    // late, else straight after the one before
+    ch.vTimes.resize(vSegments.size());
+    for(size_t i = 0; i < vSegments.size(); i++) {
+        const CaptureSegment&   s = vSegments[i];
+
+        if(!std::isnan(s.dStartTime))
+            ch.vTimes[i] = s.dStartTime;
+        else if(i + 1 < vSegments.size() && IsLate(vSegments, i + 1))
+            ch.vTimes[i] = vSegments[i + 1].dStartTime -
+                static_cast<double>(s.nSamples) * ch.dPeriod;
+        else if(i > 0)
+            ch.vTimes[i] = ch.vTimes[i - 1] +
+                static_cast<double>(vSegments[i - 1].nSamples) * ch.dPeriod;
+        else
+            ch.vTimes[i] = 0.0;
+    }
+
+    m_vChannels.push_back(std::move(ch));
+    return true;
+}
+
+//
+// Function used to get the sample after a channel's next block, which
+// ends with its segment
+//
+uint64_t CaptureReplay::BlockEnd(const Channel& ch) const
+{
+    const CaptureSegment&   s = ch.pReader->Segments()[ch.nSegment];
+
+    return std::min<uint64_t>(ch.nNext + m_Config.nBlockSamples,
+        s.nFirstSample + s.nSamples);
+}
+
+//
+// Function used to get the timestamp of the last sample of a channel's next
+// block, which is when a live server would have sent it
+//
+double CaptureReplay::BlockTime(const Channel& ch) const
+{
+    const CaptureSegment&   s = ch.pReader->Segments()[ch.nSegment];
+
+    return ch.vTimes[ch.nSegment] +
+        static_cast<double>(BlockEnd(ch) - s.nFirstSample) * ch.dPeriod;
+}
+
+//
+// Function used to get the segment after the last of an acquisition of a
+// channel
+//
+size_t CaptureReplay::RunEnd(const Channel& ch, size_t nRun) const
+{
+    return nRun + 1 < ch.vRuns.size() ? ch.vRuns[nRun + 1] :
+        ch.pReader->Segments().size();
+}
+
+//
+// Function used to hand on a channel's first sample timestamp
+//
+void CaptureReplay::FirstSampleTimestamp(const Channel& ch, double dTime)
+{
+    ChannelTimestampInfo    ctsi;
+    ctsi.sName.assign(ch.pReader->Header().szName);
+    ctsi.hChannel = ch.hChannel;
+    ctsi.nId = ch.nId;
+    ctsi.dFirstSampleTimestamp = dTime;
+    m_fEventHandler(EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS, &ctsi, sizeof(ctsi));
+}
+
+//
+// Function used to play back the capture on the calling thread
+//
+void CaptureReplay::Run(void)
+{
+    auto    tStart = std::chrono::steady_clock::now();
+    size_t  nRuns = 0;
+
+    // Announce the channels exactly like a live connection does
+    for(auto& e : m_vChannels) {
+        const RecordingFileHeader&  h = e.pReader->Header();
+
+        ChannelInfo ci;
+        ci.sName.assign(h.szName);
+        ci.hChannel = e.hChannel;
+        ci.sDataType.assign(h.szDataType);
+        ci.dScale = h.dScale;
+        ci.dOffset = h.dOffset;
+        ci.dSamplePeriod = h.dSamplePeriod;
+        ci.nDecimationFactor = 1;
+        m_fEventHandler(EVENT_TYPE_AVAILABLE_CHANNEL, &ci, sizeof(ci));
+    }
+
+    for(auto& e : m_vChannels) {
+        ChannelSubscribedInfo   csi;
+        csi.sName.assign(e.pReader->Header().szName);
+        csi.hChannel = e.hChannel;
+        csi.nId = e.nId;
+        csi.nDecimationFactor = e.pReader->Header().nDecimationFactor;
+        m_fEventHandler(EVENT_TYPE_CHANNEL_SUBSCRIBED, &csi, sizeof(csi));
+
+        double  dStart = e.pReader->Segments()[0].dStartTime;
+        FirstSampleTimestamp(e, std::isnan(dStart) ? 0.0 : dStart);
+
+        nRuns = std::max(nRuns, e.vRuns.size());
+    }
+
+    bool    bState = true;
+    m_fEventHandler(EVENT_TYPE_ACQUIRE, &bState, sizeof(bState));
+
+    // Deliver the blocks of all channels in timestamp order, an acquisition
+    // at a time
+    typedef std::pair<double, size_t>   Next;
+    double  dFirstTime = NAN;
+
+    for(size_t nRun = 0; nRun < nRuns; nRun++) {
+        if(m_bStop.load(std::memory_order_relaxed)) break;
+
+        if(nRun) {
+            // Acquisition stopped and started again
+            for(auto& e : m_vChannels) FirstSampleTimestamp(e, 0.0);
+
+            bState = false;
+            m_fEventHandler(EVENT_TYPE_ACQUIRE, &bState, sizeof(bState));
+            bState = true;
+            m_fEventHandler(EVENT_TYPE_ACQUIRE, &bState, sizeof(bState));
+        }
+
+        std::priority_queue<Next, std::vector<Next>, std::greater<Next>>
+            qNext;
+
+        for(size_t i = 0; i < m_vChannels.size(); i++) {
+            Channel&    ch = m_vChannels[i];
+            if(nRun >= ch.vRuns.size()) continue;
+
+            const auto& vSegments = ch.pReader->Segments();
+            ch.nSegment = ch.vRuns[nRun];
+            ch.nNext = vSegments[ch.nSegment].nFirstSample;
+
+            if(nRun && !std::isnan(vSegments[ch.nSegment].dStartTime))
+                FirstSampleTimestamp(ch, vSegments[ch.nSegment].dStartTime);
+
+            while(ch.nSegment < RunEnd(ch, nRun) &&
+                !vSegments[ch.nSegment].nSamples) ch.nSegment++;
+            if(ch.nSegment < RunEnd(ch, nRun))
+                qNext.push({BlockTime(ch), i});
+        }
+
+        while(!qNext.empty() && !m_bStop.load(std::memory_order_relaxed)) {
+            auto [dTime, i] = qNext.top();
+            qNext.pop();
+
+            Channel&    ch = m_vChannels[i];
+            const auto& vSegments = ch.pReader->Segments();
+            const CaptureSegment&   s = vSegments[ch.nSegment];
+
+            if(std::isnan(dFirstTime)) dFirstTime = dTime;
+            if(m_Config.dSpeed > 0.0) {
+                auto    tDue = tStart + std::chrono::duration_cast<
+                    std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(
+                        (dTime - dFirstTime) / m_Config.dSpeed));
+                std::this_thread::sleep_until(tDue);
+            }
+
+            // The timestamp of the acquisition came after its first samples
+            if(ch.nNext == s.nFirstSample && IsLate(vSegments, ch.nSegment))
+                FirstSampleTimestamp(ch, s.dStartTime);
+
+            const float *pData;
+            ChannelDataInfo cdi;
+            cdi.hChannel = ch.hChannel;
+            cdi.nId = ch.nId;
+            cdi.nSamples = ch.pReader->Read(ch.nNext,
+                static_cast<size_t>(BlockEnd(ch) - ch.nNext), &pData);
+            cdi.pData = const_cast<float *>(pData);
+
+            m_fEventHandler(EVENT_TYPE_CHANNEL_DATA, &cdi, sizeof(cdi));
+
+            ch.nNext += cdi.nSamples;
+            m_nBlocks.fetch_add(1, std::memory_order_relaxed);
+            m_nSamples.fetch_add(cdi.nSamples, std::memory_order_relaxed);
+
+            // On to the next segment of the acquisition at the end of this
+            // one
+            if(ch.nNext >= s.nFirstSample + s.nSamples) {
+                do ch.nSegment++;
+                while(ch.nSegment < RunEnd(ch, nRun) &&
+                    !vSegments[ch.nSegment].nSamples);
+
+                if(ch.nSegment >= RunEnd(ch, nRun)) continue;
+                ch.nNext = vSegments[ch.nSegment].nFirstSample;
+            }
+            qNext.push({BlockTime(ch), i});
+        }
+    }
+
+    // Stop acquisition and unsubscribe the way the client reports it
+    for(auto& e : m_vChannels) FirstSampleTimestamp(e, 0.0);
+
+    bState = false;
+    m_fEventHandler(EVENT_TYPE_ACQUIRE, &bState, sizeof(bState));
+
+    for(auto& e : m_vChannels) {
+        ChannelUnsubscribedInfo cui;
+        cui.hChannel = e.hChannel;
+        cui.nId = e.nId;
+        m_fEventHandler(EVENT_TYPE_CHANNEL_UNSUBSCRIBED, &cui, sizeof(cui));
+    }
+
+    m_dSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - tStart).count();
+}
+
+//
+// Function used to play back the capture on a thread of its own
+//
+void CaptureReplay::Start(void)
+{
+    if(m_ReplayThread) return;
+
+    m_bStop = false;
+    m_ReplayThread = new std::thread([this]() { Run(); });
+}
+
+//
+// Function used to stop a replay early
+//
+void CaptureReplay::Stop(void)
+{
+    m_bStop = true;
+}
+
+//
+// Function used to wait for a replay started with Start() to finish
+//
+void CaptureReplay::Wait(void)
+{
+    if(!m_ReplayThread) return;
+
+    m_ReplayThread->join();
+    delete m_ReplayThread;
+    m_ReplayThread = nullptr;
+}
+
+//
+// Function used to get the replay counters.  dSeconds is only set once the
+// replay has finished.
+//
+CaptureReplayStats CaptureReplay::Stats(void) const
+{
+    CaptureReplayStats  s;
+
+    s.nBlocks = m_nBlocks.load(std::memory_order_relaxed);
+    s.nSamples = m_nSamples.load(std::memory_order_relaxed);
+    s.nBytes = s.nSamples * sizeof(float);
+    s.dSeconds = m_dSeconds;
+
+    return s;
+}
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef __CAPTUREREPLAY_H__
+#define __CAPTUREREPLAY_H__
+
+#if defined(__linux__)
+
+#include    <atomic>
+#include    <memory>
+#include    <string>
+#include    <thread>
+#include    <vector>
+#include    "CaptureReader.h"
+
+//
+// Definition of the replay settings
+//
+typedef struct {
+    double      dSpeed;                 // 1.0 = real time, N = N times real
+                                        // time, 0 = as fast as possible
+    size_t      nBlockSamples;          // Samples per EVENT_TYPE_CHANNEL_DATA
+} CaptureReplayConfig;
+
+//
+// Definition of replay counters
+//
+typedef struct {
+    uint64_t    nBlocks;                // Data events delivered
+    uint64_t    nSamples;               // Samples delivered
+    uint64_t    nBytes;                 // Sample bytes delivered
+    double      dSeconds;               // Wall clock time of the replay
+} CaptureReplayStats;
+
+//
+// Definition of the capture replay source.
+//
+// Reads the files a ChannelRecorder wrote with CaptureReaders and plays
+// them back through an EventHandler with the same EVENT_TYPE_* sequence a
+// live LowLatencyDataClient produces:  available, subscribed, first sample
+// timestamp and acquisition on for every channel, then the data blocks of
+// all channels interleaved in timestamp order, then acquisition off and
+// unsubscribed.  Data events point straight into the mapped files.
+//
+// The segments of each file's index say when that happened more than
+// once.  A segment started without a timestamp, or with one straight after
+// a timed segment, is a new acquisition:  every channel gets a first
+// sample timestamp of 0 and acquisition goes off and on again (once for
+// all channels, the n-th restart of each file being the same one), then
+// any timestamp the new segment has.  A timed segment after an untimed one
+// is the timestamp arriving late, and a segment after lost samples carries
+// on, neither of them stopping acquisition.  Block times come from the
+// segments, those of untimed ones from the timed segment after them in the
+// same acquisition or else the one before.
+//
+class CaptureReplay {
+    public:
+        CaptureReplay(const std::string& sPath, EventHandler,
+            const CaptureReplayConfig&);
+        ~CaptureReplay();
+
+        CaptureReplay(const CaptureReplay&) = delete;
+        CaptureReplay& operator=(const CaptureReplay&) = delete;
+
+        size_t Channels(void) const { return m_vChannels.size(); }
+
+        void Run(void);
+        void Start(void);
+        void Stop(void);
+        void Wait(void);
+
+        CaptureReplayStats Stats(void) const;
+
+    private:
+        typedef struct {
+            std::unique_ptr<CaptureReader>  pReader;
+            ChannelHandle       hChannel;   // Of the recording's name
+            int                 nId;
+            double              dPeriod;    // Between samples recorded
+            std::vector<size_t> vRuns;      // First segment of each
+                                            // acquisition
+            std::vector<double> vTimes;     // Of each segment's first
+                                            // sample, for the replay
+            size_t              nSegment;   // Of nNext
+            uint64_t            nNext;      // Next sample to deliver
+        } Channel;
+
+        bool Open(const std::string&);
+        double BlockTime(const Channel&) const;
+        uint64_t BlockEnd(const Channel&) const;
+        size_t RunEnd(const Channel&, size_t nRun) const;
+        void FirstSampleTimestamp(const Channel&, double);
+
+        EventHandler            m_fEventHandler;
+        CaptureReplayConfig     m_Config;
+        std::vector<Channel>    m_vChannels;
+
+        std::thread             *m_ReplayThread;
+        std::atomic<bool>       m_bStop;
+
+        std::atomic<uint64_t>   m_nBlocks;
+        std::atomic<uint64_t>   m_nSamples;
+        double                  m_dSeconds;
+};
+
+#endif
+
+#endif
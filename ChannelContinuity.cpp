@@ -0,0 +1,118 @@
+#include "ChannelContinuity.h"
+#include <algorithm>
+#include <cmath>
+
+//
+// Constructor
+//
+ChannelContinuity::ChannelContinuity()
+    : m_dTolerance(CONTINUITY_TOLERANCE)
+{
+}
+
+//
+// Function used to start checking a newly subscribed channel, it's first
+// judged once Restart() gives it a first sample timestamp
+//
+void ChannelContinuity::Subscribed(int nId, double dEffectiveSamplePeriod)
+{
+    if(nId < 0) return;
+
+    if(m_vChannels.size() <= static_cast<size_t>(nId)) {
+        Channel cNone = {};
+        cNone.bActive = false;
+        m_vChannels.resize(nId + 1, cNone);
+    }
+
+    Channel&    c = m_vChannels[nId];
+
+    c.bActive = false;
+    c.dPeriod = dEffectiveSamplePeriod;
+    c.Counts = ContinuityCounts();
+}
+
+//
+// Function used to start over from a channel's first sample, when it has
+// been subscribed or acquisition has started or stopped
+//
+void ChannelContinuity::Restart(int nId, double dFirstSampleTimestamp)
+{
+    if(nId < 0 || static_cast<size_t>(nId) >= m_vChannels.size()) return;
+
+    Channel&    c = m_vChannels[nId];
+
+    // Without a sample period there's no telling when samples are due
+    c.bActive = std::isfinite(c.dPeriod) && c.dPeriod > 0.0;
+    c.dOrigin = dFirstSampleTimestamp;
+    c.nSamples = 0;
+    c.bBaseline = false;
+    c.bWindowEmpty = true;
+}
+
+//
+// Function used to stop checking a channel
+//
+void ChannelContinuity::Unsubscribed(int nId)
+{
+    if(nId < 0 || static_cast<size_t>(nId) >= m_vChannels.size()) return;
+
+    m_vChannels[nId].bActive = false;
+}
+
+//
+// Function used to judge the window that has just ended, returns the
+// number of samples found missing (> 0) or repeated (< 0), else 0.  The
+// window carries on if the client is behind with reading.
+//
+int64_t ChannelContinuity::Judge(int nId, bool bCaughtUp)
+{
+    if(nId < 0 || static_cast<size_t>(nId) >= m_vChannels.size()) return 0;
+
+    Channel&    c = m_vChannels[nId];
+    if(!c.bActive || !bCaughtUp) return 0;
+
+    c.bWindowEmpty = true;
+
+    if(!c.bBaseline) {
+        c.dBaseline = c.dWindowMin;
+        c.bBaseline = true;
+        return 0;
+    }
+
+    double  dStep = c.dWindowMin - c.dBaseline;
+    double  dThreshold = std::max(Tolerance(), c.dPeriod / 2.0);
+
+    if(std::fabs(dStep) <= dThreshold) {
+        c.dBaseline = c.dWindowMin;
+        return 0;
+    }
+
+    int64_t nSamples = static_cast<int64_t>(std::llround(dStep / c.dPeriod));
+
+    // Correct the count so the lag is back where it was
+    c.nSamples += nSamples;
+    c.dBaseline = c.dWindowMin - nSamples * c.dPeriod;
+
+    if(nSamples > 0) {
+        c.Counts.nGaps++;
+        c.Counts.nMissingSamples += static_cast<uint64_t>(nSamples);
+    } else {
+        c.Counts.nOverlaps++;
+        c.Counts.nRepeatedSamples += static_cast<uint64_t>(-nSamples);
+    }
+
+    return nSamples;
+}
+
+//
+// Function used to get the time the next sample of a channel is due to
+// have been taken at
+//
+double ChannelContinuity::NextSampleTimestamp(int nId) const
+{
+    if(nId < 0 || static_cast<size_t>(nId) >= m_vChannels.size())
+        return NAN;
+
+    const Channel&  c = m_vChannels[nId];
+    return c.dOrigin + c.nSamples * c.dPeriod;
+}
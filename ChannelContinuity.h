@@ -0,0 +1,132 @@
+#ifndef __CHANNELCONTINUITY_H__
+#define __CHANNELCONTINUITY_H__
+
+#include    <atomic>
+#include    <chrono>
+#include    <cstddef>
+#include    <cstdint>
+#include    <vector>
+
+#define CONTINUITY_TOLERANCE        0.005   // Seconds of jitter tolerated
+                                            // by default
+#define CONTINUITY_WINDOW           0.5     // Seconds of packets whose
+                                            // smallest lag is judged
+#define CONTINUITY_QUEUE_BYTES      65536   // Received and not yet read
+                                            // beyond this the client is
+                                            // behind, not the server
+
+//
+// Definition of the cumulative continuity counts of a channel
+//
+typedef struct {
+    uint64_t    nGaps;                  // Times samples went missing
+    uint64_t    nMissingSamples;
+    uint64_t    nOverlaps;              // Times samples came twice
+    uint64_t    nRepeatedSamples;
+} ContinuityCounts;
+
+//
+// Definition of the sample continuity checker used by LowLatencyDataClient.
+//
+// Data packets carry no sequence numbers or timestamps, so the only way to
+// tell samples have gone missing is time.  Sample n of a channel was taken
+// at FSTS + n * period (period being the sample period times decimation),
+// and its packet can't arrive before then, so
+//
+//      lag = arrival time - (FSTS + samples received * period)
+//
+// is the transport and buffering delay plus any offset between the two
+// clocks.  That changes from packet to packet, but its smallest value over
+// a window of packets does not, until the server skips samples (the lag
+// steps up by the time they cover) or sends some twice (it steps down).
+//
+// The first window's smallest lag is the baseline, each later one is
+// compared against it; a step of more than the tolerance, and at least
+// half a sample period, is a gap or overlap of the nearest whole number of
+// samples, and the sample count is corrected so it is only reported once.
+// Smaller changes move the baseline along, which follows the slow drift
+// between the clocks.  While the client has fallen behind, its lag is up
+// because it hasn't read the samples yet rather than because they never
+// came, so a window is only judged once the socket has nearly been
+// drained.
+//
+// Knowing the FSTS is not needed, an unknown (0) one only adds a constant
+// to the lag.  A step of the client's clock looks like a gap or overlap.
+//
+// Every id subscribed so far has an entry, made when it is first
+// subscribed.  All but SetTolerance(), where a tolerance of 0 turns
+// checking off, are for the socket read thread only.
+//
+class ChannelContinuity {
+    public:
+        ChannelContinuity();
+
+        void SetTolerance(double dSeconds)
+        {
+            m_dTolerance.store(dSeconds, std::memory_order_relaxed);
+        }
+
+        double Tolerance(void) const
+        {
+            return m_dTolerance.load(std::memory_order_relaxed);
+        }
+
+        void Subscribed(int nId, double dEffectiveSamplePeriod);
+        void Restart(int nId, double dFirstSampleTimestamp);
+        void Unsubscribed(int nId);
+
+        //
+        // Function used to count a data packet's samples, returns true
+        // when a window has ended and Judge() should be called
+        //
+        bool Data(int nId, size_t nSamples)
+        {
+            if(nId < 0 || static_cast<size_t>(nId) >= m_vChannels.size())
+                return false;
+
+            Channel&    c = m_vChannels[nId];
+            if(!c.bActive || Tolerance() <= 0.0) return false;
+
+            double  dNow = std::chrono::duration<double>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+
+            c.nSamples += static_cast<int64_t>(nSamples);
+
+            double  dLag = dNow - (c.dOrigin + c.nSamples * c.dPeriod);
+            if(c.bWindowEmpty || dLag < c.dWindowMin) c.dWindowMin = dLag;
+            if(c.bWindowEmpty) {
+                c.dWindowStart = dNow;
+                c.bWindowEmpty = false;
+            }
+
+            return dNow - c.dWindowStart >= CONTINUITY_WINDOW;
+        }
+
+        int64_t Judge(int nId, bool bCaughtUp);
+
+        double NextSampleTimestamp(int nId) const;
+
+        const ContinuityCounts& Counts(int nId) const
+        {
+            return m_vChannels[nId].Counts;
+        }
+
+    private:
+        typedef struct {
+            bool                bActive;
+            double              dPeriod;        // Between samples received
+            double              dOrigin;        // FSTS
+            int64_t             nSamples;       // Since FSTS, corrected
+            bool                bBaseline;      // Set by a judged window
+            double              dBaseline;
+            bool                bWindowEmpty;
+            double              dWindowStart;
+            double              dWindowMin;
+            ContinuityCounts    Counts;         // Since subscribed
+        } Channel;
+
+        std::atomic<double>     m_dTolerance;
+        std::vector<Channel>    m_vChannels;    // By id
+};
+
+#endif
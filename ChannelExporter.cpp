@@ -0,0 +1,572 @@
+#include "ChannelExporter.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+//
+// Smallest output buffer accepted, most spare sample buffers kept and the
+// most characters a single time or value is allowed to take
+//
+static constexpr size_t nMinBufferBytes = 64 * 1024;
+static constexpr size_t nMaxSpareBuffers = 64;
+static constexpr size_t nMaxFieldBytes = 32;
+
+//
+// Powers of ten up to the most time decimals allowed
+//
+static constexpr int64_t aPow10[] = {
+    1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL,
+    100000000LL, 1000000000LL, 10000000000LL, 100000000000LL,
+    1000000000000LL
+};
+
+//
+// Functions used to format a value into at most nMaxFieldBytes.  A value
+// that does not fit (a time of 1e300 say) leaves the field empty.
+//
+static inline char *FormatFixed(char *p, double v, int nDecimals)
+{
+    auto    r = std::to_chars(p, p + nMaxFieldBytes, v,
+        std::chars_format::fixed, nDecimals);
+    return r.ec == std::errc() ? r.ptr : p;
+}
+
+//
+// Function used to format dBaseTime (whole seconds) + dTime.  Keeping the
+// two apart holds on to the digits a double loses at epoch times, and
+// writing two integers is several times quicker than fixed notation.
+//
+static inline char *FormatTime(char *p, double dBaseTime, double dTime,
+    int nDecimals)
+{
+    double  dSeconds = std::floor(dTime);
+    int64_t nFraction = std::llround((dTime - dSeconds) *
+        static_cast<double>(aPow10[nDecimals]));
+    if(nFraction >= aPow10[nDecimals]) {
+        nFraction -= aPow10[nDecimals];
+        dSeconds += 1.0;
+    }
+    dSeconds += dBaseTime;
+
+    if(dSeconds < 0.0 || dSeconds >= 9e15)
+        return FormatFixed(p, dBaseTime + dTime, nDecimals);
+
+    p = std::to_chars(p, p + nMaxFieldBytes,
+        static_cast<int64_t>(dSeconds)).ptr;
+    if(nDecimals) {
+        *p = '.';
+        for(int i = nDecimals; i > 0; i--) {
+            p[i] = static_cast<char>('0' + nFraction % 10);
+            nFraction /= 10;
+        }
+        p += nDecimals + 1;
+    }
+
+    return p;
+}
+
+static inline char *FormatGeneral(char *p, double v, int nDigits)
+{
+    auto    r = std::to_chars(p, p + nMaxFieldBytes, v,
+        std::chars_format::general, nDigits);
+    return r.ec == std::errc() ? r.ptr : p;
+}
+
+static inline char *FormatShortest(char *p, float v)
+{
+    // Whole numbers (raw ADC counts) are much quicker as integers
+    if(v == std::trunc(v) && std::fabs(v) < 2147483648.0f)
+        return std::to_chars(p, p + nMaxFieldBytes,
+            static_cast<int32_t>(v)).ptr;
+
+    auto    r = std::to_chars(p, p + nMaxFieldBytes, v);
+    return r.ec == std::errc() ? r.ptr : p;
+}
+
+//
+// Constructor
+//
+ChannelExporter::ChannelExporter(const ChannelExporterConfig& Config)
+    : m_Config(Config)
+    , m_pFile(nullptr)
+    , m_nQueuedSamples(0)
+    , m_bExit(false)
+    , m_bHeaderWritten(false)
+    , m_dBaseTime(NAN)
+    , m_dTolerance(0.0)
+    , m_dLastRowTime(-INFINITY)
+    , m_nPending(0)
+    , m_nFill(0)
+    , m_nMaxRowBytes(0)
+    , m_nRows(0)
+    , m_nSamples(0)
+    , m_nBytes(0)
+    , m_nDroppedSamples(0)
+    , m_nIgnoredSamples(0)
+    , m_nWriteErrors(0)
+{
+    if(!m_Config.cSeparator) m_Config.cSeparator = ',';
+    m_Config.nTimeDecimals = std::clamp(m_Config.nTimeDecimals, 0, 12);
+    m_Config.nValueDigits = std::clamp(m_Config.nValueDigits, 0, 17);
+    if(m_Config.nBufferBytes < nMinBufferBytes)
+        m_Config.nBufferBytes = 4 * 1024 * 1024;
+    if(!m_Config.nMaxQueuedSamples) m_Config.nMaxQueuedSamples = 16 << 20;
+    if(!m_Config.nMaxPendingSamples) m_Config.nMaxPendingSamples = 16 << 20;
+
+    if(m_Config.sPath == "-") {
+        m_pFile = stdout;
+    } else {
+        m_pFile = std::fopen(m_Config.sPath.c_str(), "wb");
+        if(!m_pFile) {
+            std::cerr << "Unable to create " << m_Config.sPath << std::endl;
+            return;
+        }
+    }
+
+    // Whole buffers are written at once, stdio buffering would only copy
+    std::setvbuf(m_pFile, nullptr, _IONBF, 0);
+
+    m_vBuffer.resize(m_Config.nBufferBytes);
+
+    m_ExportThread = std::thread([this]() { ExportThread(); });
+}
+
+//
+// Destructor
+//
+ChannelExporter::~ChannelExporter()
+{
+    Finish();
+}
+
+//
+// Function used to write out everything queued and close the output.
+// Later events are ignored.
+//
+void ChannelExporter::Finish(void)
+{
+    if(!m_pFile) return;
+
+    {
+        std::unique_lock<std::mutex>    lk(m_Lock);
+        m_bExit = true;
+    }
+    m_Signal.notify_one();
+    m_ExportThread.join();
+
+    if(m_pFile != stdout) std::fclose(m_pFile);
+    m_pFile = nullptr;
+}
+
+//
+// Function used to get the export counters
+//
+ChannelExporterStats ChannelExporter::Stats(void) const
+{
+    ChannelExporterStats    s;
+
+    s.nRows = m_nRows.load(std::memory_order_relaxed);
+    s.nSamples = m_nSamples.load(std::memory_order_relaxed);
+    s.nBytes = m_nBytes.load(std::memory_order_relaxed);
+    s.nDroppedSamples = m_nDroppedSamples.load(std::memory_order_relaxed);
+    s.nIgnoredSamples = m_nIgnoredSamples.load(std::memory_order_relaxed);
+    s.nWriteErrors = m_nWriteErrors.load(std::memory_order_relaxed);
+
+    return s;
+}
+
+//
+// Function used to queue a message for the export thread.  A data message
+// that does not fit waits or is dropped as configured.
+//
+void ChannelExporter::Post(Message&& m)
+{
+    size_t  n = m.vSamples.size();
+
+    {
+        std::unique_lock<std::mutex>    lk(m_Lock);
+
+        if(n && m_nQueuedSamples &&
+            m_nQueuedSamples + n > m_Config.nMaxQueuedSamples) {
+            if(!m_Config.bBlockWhenFull) {
+                m_nDroppedSamples.fetch_add(n, std::memory_order_relaxed);
+                m_vSpare.push_back(std::move(m.vSamples));
+                return;
+            }
+
+            m_Space.wait(lk, [this, n]() {
+                return !m_nQueuedSamples ||
+                    m_nQueuedSamples + n <= m_Config.nMaxQueuedSamples;
+            });
+        }
+
+        m_nQueuedSamples += n;
+        m_dMessages.push_back(std::move(m));
+    }
+    m_Signal.notify_one();
+}
+
+//
+// Function used to tell the export thread a channel is (again) acquiring
+//
+void ChannelExporter::PostStart(int nId, const TrackedChannel& tc)
+{
+    Message m;
+
+    m.nType = START;
+    m.nId = nId;
+    m.dTime = 0.0;
+    m.nIndex = 0;
+    m.sName = tc.ci.sName;
+    m.dScale = tc.ci.dScale;
+    m.dOffset = tc.ci.dOffset;
+    m.dSamplePeriod = tc.dEffectiveSamplePeriod;
+
+    Post(std::move(m));
+}
+
+//
+// Function used to tell the export thread a channel stopped acquiring
+//
+void ChannelExporter::PostStop(int nId)
+{
+    Message m;
+
+    m.nType = STOP;
+    m.nId = nId;
+    m.dTime = 0.0;
+    m.nIndex = 0;
+    m.dScale = 1.0;
+    m.dOffset = 0.0;
+    m.dSamplePeriod = 0.0;
+
+    Post(std::move(m));
+}
+
+//
+// Function used to process events from the LowLatencyDataClient or a
+// CaptureReplay
+//
+void ChannelExporter::HandleEvent(EventType nType, const void *p, size_t n)
+{
+    m_Tracker.HandleEvent(nType, p, n);
+
+    if(!m_pFile) return;
+
+    if(nType == EVENT_TYPE_CHANNEL_DATA) {
+        const ChannelDataInfo   *cdi =
+            reinterpret_cast<const ChannelDataInfo *>(p);
+
+        auto    it = m_mInputs.find(cdi->nId);
+        const TrackedChannel    *tc = m_Tracker.Find(cdi->nId);
+        if(it == m_mInputs.end() || !tc || !cdi->nSamples) return;
+
+        Input&  in = (*it).second;
+        if(!in.bStarted) {
+            PostStart(cdi->nId, *tc);
+            in.bStarted = true;
+        }
+
+        Message m;
+        m.nType = DATA;
+        m.nId = cdi->nId;
+        m.dTime = in.dSegmentStart;
+        m.nIndex = in.nSegmentSamples;
+        m.dScale = tc->ci.dScale;
+        m.dOffset = tc->ci.dOffset;
+        m.dSamplePeriod = tc->dEffectiveSamplePeriod;
+        in.nSegmentSamples += cdi->nSamples;
+
+        {
+            // Reuse the capacity of a buffer the export thread is done with
+            std::unique_lock<std::mutex>    lk(m_Lock);
+            if(!m_vSpare.empty()) {
+                m.vSamples = std::move(m_vSpare.back());
+                m_vSpare.pop_back();
+            }
+        }
+        m.vSamples.assign(cdi->pData, cdi->pData + cdi->nSamples);
+
+        Post(std::move(m));
+
+    } else if(nType == EVENT_TYPE_CHANNEL_SUBSCRIBED) {
+        const ChannelSubscribedInfo *csi =
+            reinterpret_cast<const ChannelSubscribedInfo *>(p);
+        m_mInputs[csi->nId] = Input{ 0.0, 0, false };
+
+    } else if(nType == EVENT_TYPE_CHANNEL_UNSUBSCRIBED) {
+        const ChannelUnsubscribedInfo   *cui =
+            reinterpret_cast<const ChannelUnsubscribedInfo *>(p);
+
+        auto    it = m_mInputs.find(cui->nId);
+        if(it == m_mInputs.end()) return;
+
+        if((*it).second.bStarted) PostStop(cui->nId);
+        m_mInputs.erase(it);
+
+    } else if(nType == EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS) {
+        const ChannelTimestampInfo  *ctsi =
+            reinterpret_cast<const ChannelTimestampInfo *>(p);
+
+        auto    it = m_mInputs.find(ctsi->nId);
+        const TrackedChannel    *tc = m_Tracker.Find(ctsi->nId);
+        if(it == m_mInputs.end() || !tc) return;
+
+        Input&  in = (*it).second;
+        if(ctsi->dFirstSampleTimestamp == 0.0) {
+            // Acquisition stopped, rows no longer wait for this channel
+            if(in.bStarted) PostStop(ctsi->nId);
+            in.bStarted = false;
+        } else if(!in.bStarted ||
+            ctsi->dFirstSampleTimestamp != in.dSegmentStart) {
+            in.dSegmentStart = ctsi->dFirstSampleTimestamp;
+            in.nSegmentSamples = 0;
+            PostStart(ctsi->nId, *tc);
+            in.bStarted = true;
+        }
+    }
+}
+
+//
+// Function used to get the timestamp of a column's next sample
+//
+double ChannelExporter::NextTime(const Column& c)
+{
+    const Block&    b = c.dBlocks.front();
+    return b.dTime + static_cast<double>(b.nIndex + b.nPos) * c.dSamplePeriod;
+}
+
+//
+// Function used to apply a message on the export thread
+//
+void ChannelExporter::Apply(Message& m)
+{
+    if(m.nType == START) {
+        auto    it = m_mColumns.find(m.nId);
+        if(it == m_mColumns.end())
+            it = m_mColumns.emplace(m.nId, Column{}).first;
+
+        Column& c = (*it).second;
+        c.sName = m.sName;
+        c.dScale = m.dScale;
+        c.dOffset = m.dOffset;
+        c.dSamplePeriod = m.dSamplePeriod;
+        c.bActive = true;
+        return;
+    }
+
+    auto    it = m_mColumns.find(m.nId);
+    if(it == m_mColumns.end()) return;
+    Column& c = (*it).second;
+
+    if(m.nType == STOP) {
+        c.bActive = false;
+        return;
+    }
+
+    if(m_bHeaderWritten && !c.bExported) {
+        m_nIgnoredSamples.fetch_add(m.vSamples.size(),
+            std::memory_order_relaxed);
+        return;
+    }
+
+    // Times are kept relative to the first whole second seen
+    if(std::isnan(m_dBaseTime)) m_dBaseTime = std::floor(m.dTime);
+    const double    dSegment = m.dTime - m_dBaseTime;
+    const double    dFirst = dSegment + static_cast<double>(m.nIndex) *
+        c.dSamplePeriod;
+
+    // Samples for rows already written cannot be placed any more
+    size_t  nSkip = 0;
+    if(m_bHeaderWritten && dFirst < m_dLastRowTime + m_dTolerance) {
+        nSkip = m.vSamples.size();
+        if(c.dSamplePeriod > 0.0) {
+            double  d = std::ceil((m_dLastRowTime + m_dTolerance - dFirst) /
+                c.dSamplePeriod);
+            nSkip = std::min(nSkip, static_cast<size_t>(d));
+        }
+        m_nIgnoredSamples.fetch_add(nSkip, std::memory_order_relaxed);
+    }
+    if(nSkip == m.vSamples.size()) return;
+
+    c.nPending += m.vSamples.size() - nSkip;
+    m_nPending += m.vSamples.size() - nSkip;
+    c.dBlocks.push_back(Block{ dSegment, m.nIndex, std::move(m.vSamples),
+        nSkip });
+}
+
+//
+// Function used to fix the columns and write the header line
+//
+void ChannelExporter::WriteHeader(void)
+{
+    std::string sLine("time");
+    double      dMinPeriod = INFINITY;
+
+    for(auto& e : m_mColumns) {
+        Column& c = e.second;
+
+        c.bExported = true;
+        m_vExported.push_back(&c);
+        if(c.dSamplePeriod > 0.0)
+            dMinPeriod = std::min(dMinPeriod, c.dSamplePeriod);
+
+        sLine.push_back(m_Config.cSeparator);
+        if(c.sName.find_first_of(std::string("\"\n") + m_Config.cSeparator) ==
+            std::string::npos) {
+            sLine += c.sName;
+        } else {
+            sLine.push_back('"');
+            for(char ch : c.sName) {
+                if(ch == '"') sLine.push_back('"');
+                sLine.push_back(ch);
+            }
+            sLine.push_back('"');
+        }
+    }
+    sLine.push_back('\n');
+
+    m_dTolerance = std::isinf(dMinPeriod) ? 0.0 : dMinPeriod / 2.0;
+    m_bHeaderWritten = true;
+
+    m_nMaxRowBytes = (m_vExported.size() + 1) * (nMaxFieldBytes + 1) + 1;
+    if(m_vBuffer.size() < 2 * std::max(m_nMaxRowBytes, sLine.size()))
+        m_vBuffer.resize(2 * std::max(m_nMaxRowBytes, sLine.size()));
+
+    ::memcpy(m_vBuffer.data() + m_nFill, sLine.data(), sLine.size());
+    m_nFill += sLine.size();
+}
+
+//
+// Function used to write all the rows that can be written.  On the final
+// call nothing is waited for.
+//
+void ChannelExporter::WriteRows(bool bFinal)
+{
+    if(!m_nPending) return;
+
+    if(!m_bHeaderWritten) {
+        // Give every acquiring channel the chance to get a column
+        bool    bWaiting = false;
+        for(auto& e : m_mColumns)
+            if(e.second.bActive && !e.second.nPending) bWaiting = true;
+        if(bWaiting && !bFinal && m_nPending <= m_Config.nMaxPendingSamples)
+            return;
+
+        WriteHeader();
+    }
+
+    uint64_t    nRows = 0;
+    uint64_t    nSamples = 0;
+    char        *pBuffer = m_vBuffer.data();
+
+    while(m_nPending) {
+        double  dTime = INFINITY;
+        bool    bBlocked = false;
+
+        for(Column *c : m_vExported) {
+            if(c->nPending)
+                dTime = std::min(dTime, NextTime(*c));
+            else if(c->bActive)
+                bBlocked = true;
+        }
+
+        // Wait for the slowest acquiring channel to catch up
+        if(bBlocked && !bFinal && m_nPending <= m_Config.nMaxPendingSamples)
+            break;
+
+        if(m_nFill + m_nMaxRowBytes > m_vBuffer.size()) Flush();
+
+        char    *p = pBuffer + m_nFill;
+        p = FormatTime(p, m_dBaseTime, dTime, m_Config.nTimeDecimals);
+
+        for(Column *c : m_vExported) {
+            *p++ = m_Config.cSeparator;
+            if(!c->nPending || NextTime(*c) > dTime + m_dTolerance) continue;
+
+            Block&  b = c->dBlocks.front();
+            double  v = static_cast<double>(b.vSamples[b.nPos]) * c->dScale +
+                c->dOffset;
+
+            if(m_Config.nValueDigits)
+                p = FormatGeneral(p, v, m_Config.nValueDigits);
+            else
+                p = FormatShortest(p, static_cast<float>(v));
+
+            if(++b.nPos == b.vSamples.size()) {
+                m_vUsed.push_back(std::move(b.vSamples));
+                c->dBlocks.pop_front();
+            }
+            c->nPending--;
+            m_nPending--;
+            nSamples++;
+        }
+
+        *p++ = '\n';
+        m_nFill = p - pBuffer;
+        m_dLastRowTime = dTime;
+        nRows++;
+    }
+
+    m_nRows.fetch_add(nRows, std::memory_order_relaxed);
+    m_nSamples.fetch_add(nSamples, std::memory_order_relaxed);
+}
+
+//
+// Function used to write out the buffer
+//
+void ChannelExporter::Flush(void)
+{
+    if(!m_nFill) return;
+
+    if(std::fwrite(m_vBuffer.data(), 1, m_nFill, m_pFile) != m_nFill)
+        m_nWriteErrors.fetch_add(1, std::memory_order_relaxed);
+
+    m_nBytes.fetch_add(m_nFill, std::memory_order_relaxed);
+    m_nFill = 0;
+}
+
+//
+// Function used as the export thread.  Takes everything queued at once,
+// then writes whatever rows are complete.
+//
+void ChannelExporter::ExportThread(void)
+{
+    std::deque<Message> dWork;
+
+    while(true) {
+        bool    bExit;
+
+        {
+            std::unique_lock<std::mutex>    lk(m_Lock);
+            m_Signal.wait(lk, [this]() {
+                return m_bExit || !m_dMessages.empty();
+            });
+
+            dWork.swap(m_dMessages);
+            m_nQueuedSamples = 0;
+            bExit = m_bExit;
+
+            for(auto& v : m_vUsed) {
+                if(m_vSpare.size() >= nMaxSpareBuffers) break;
+                m_vSpare.push_back(std::move(v));
+            }
+        }
+        m_Space.notify_all();
+        m_vUsed.clear();
+
+        for(auto& m : dWork) Apply(m);
+        dWork.clear();
+
+        WriteRows(false);
+
+        if(bExit) {
+            WriteRows(true);
+            Flush();
+            std::fflush(m_pFile);
+            break;
+        }
+    }
+}
@@ -0,0 +1,175 @@
+#ifndef __CHANNELEXPORTER_H__
+#define __CHANNELEXPORTER_H__
+
+#include    <atomic>
+#include    <condition_variable>
+#include    <cstdio>
+#include    <deque>
+#include    <map>
+#include    <mutex>
+#include    <string>
+#include    <thread>
+#include    <vector>
+#include    "ChannelTracker.h"
+
+//
+// Definition of the export settings
+//
+typedef struct {
+    std::string sPath;                  // Output file, "-" for stdout
+    char        cSeparator;             // ',' for CSV, '\t' for TSV
+    int         nTimeDecimals;          // Digits after the point in times
+    int         nValueDigits;           // Significant digits, 0 = shortest
+                                        // that reads back the same float
+    size_t      nBufferBytes;           // Size of the output buffer
+    size_t      nMaxQueuedSamples;      // Samples waiting for the thread
+    size_t      nMaxPendingSamples;     // Samples waiting for a slow channel
+    bool        bBlockWhenFull;         // Wait rather than drop when the
+                                        // queue is full (captures)
+} ChannelExporterConfig;
+
+//
+// Definition of export counters
+//
+typedef struct {
+    uint64_t    nRows;
+    uint64_t    nSamples;               // Values written
+    uint64_t    nBytes;
+    uint64_t    nDroppedSamples;        // Queue was full
+    uint64_t    nIgnoredSamples;        // Late or not in the columns
+    uint64_t    nWriteErrors;
+} ChannelExporterStats;
+
+//
+// Definition of the text export sink.
+//
+// Writes the scaled samples (raw * dScale + dOffset) of the subscribed
+// channels as CSV or TSV, one row per sample timestamp:
+//
+//      time,<channel>,<channel>,...
+//
+// Channels whose sample falls on a row's timestamp (within half the
+// shortest sample period) fill their column, the others leave it empty, so
+// channels with different rates or decimation line up by time.  The columns
+// are the channels known when the first row is written.
+//
+// HandleEvent() only copies each data block into a queue.  A background
+// thread merges the channels by timestamp, formats with std::to_chars into
+// a large buffer and writes the buffer out whole.  A row is only written
+// once every acquiring channel has data up to it, unless a slow channel
+// holds up more than nMaxPendingSamples.
+//
+// Live, the queue drops (and counts) data rather than stall the socket
+// thread; driven from a CaptureReplay set bBlockWhenFull so the replay
+// waits for the export instead.
+//
+class ChannelExporter {
+    public:
+        explicit ChannelExporter(const ChannelExporterConfig&);
+        ~ChannelExporter();
+
+        ChannelExporter(const ChannelExporter&) = delete;
+        ChannelExporter& operator=(const ChannelExporter&) = delete;
+
+        bool IsOpen(void) const { return m_pFile != nullptr; }
+
+        void HandleEvent(EventType, const void *, size_t);
+        void Finish(void);
+
+        ChannelExporterStats Stats(void) const;
+
+    private:
+        typedef enum {
+            START,
+            DATA,
+            STOP,
+        } MessageType;
+
+        typedef struct {
+            MessageType         nType;
+            int                 nId;
+            double              dTime;          // DATA: segment start
+            uint64_t            nIndex;         // DATA: index of the first
+                                                // sample in the segment
+            std::vector<float>  vSamples;       // DATA only
+            std::string         sName;          // START only
+            double              dScale;
+            double              dOffset;
+            double              dSamplePeriod;
+        } Message;
+
+        typedef struct {
+            double              dTime;          // Segment start relative
+                                                // to m_dBaseTime
+            uint64_t            nIndex;         // Index of vSamples[0]
+            std::vector<float>  vSamples;
+            size_t              nPos;           // Next sample to write
+        } Block;
+
+        typedef struct {
+            std::string         sName;
+            double              dScale;
+            double              dOffset;
+            double              dSamplePeriod;
+            bool                bActive;        // Still acquiring
+            bool                bExported;      // Has a column
+            std::deque<Block>   dBlocks;
+            size_t              nPending;
+        } Column;
+
+        // Caller thread side of a subscribed channel
+        typedef struct {
+            double              dSegmentStart;
+            uint64_t            nSegmentSamples;
+            bool                bStarted;
+        } Input;
+
+        void Post(Message&&);
+        void PostStart(int nId, const TrackedChannel&);
+        void PostStop(int nId);
+
+        void ExportThread(void);
+        void Apply(Message&);
+        void WriteHeader(void);
+        void WriteRows(bool bFinal);
+        void Flush(void);
+
+        static double NextTime(const Column&);
+
+        ChannelExporterConfig       m_Config;
+        ChannelTracker              m_Tracker;
+        std::map<int, Input>        m_mInputs;      // Caller thread only
+
+        std::FILE                   *m_pFile;
+        std::deque<Message>         m_dMessages;
+        std::vector<std::vector<float>> m_vSpare;   // Recycled sample buffers
+        size_t                      m_nQueuedSamples;
+        std::mutex                  m_Lock;
+        std::condition_variable     m_Signal;
+        std::condition_variable     m_Space;
+        bool                        m_bExit;
+        std::thread                 m_ExportThread;
+
+        // Export thread only
+        std::map<int, Column>       m_mColumns;
+        std::vector<Column *>       m_vExported;
+        std::vector<std::vector<float>> m_vUsed;    // For m_vSpare
+        bool                        m_bHeaderWritten;
+        double                      m_dBaseTime;    // Whole seconds, row
+                                                    // times are relative
+        double                      m_dTolerance;
+        double                      m_dLastRowTime;
+        size_t                      m_nPending;
+        std::vector<char>           m_vBuffer;
+        size_t                      m_nFill;
+        size_t                      m_nMaxRowBytes;
+
+        std::atomic<uint64_t>       m_nRows;
+        std::atomic<uint64_t>       m_nSamples;
+        std::atomic<uint64_t>       m_nBytes;
+        std::atomic<uint64_t>       m_nDroppedSamples;
+        std::atomic<uint64_t>       m_nIgnoredSamples;
+        std::atomic<uint64_t>       m_nWriteErrors;
+};
+
+#endif
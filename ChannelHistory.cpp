@@ -0,0 +1,451 @@
+#include "ChannelHistory.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+//
+// Definition of the history ring for a single channel id.  The metadata and
+// the buffer pointer are only changed by the writer inside the sequence
+// lock.  A buffer that is replaced is retired rather than freed, and the
+// writer only frees retired buffers when it sees no reader copying, as a
+// reader may have been handed the old pointer.
+//
+struct ChannelHistory::Ring {
+    std::atomic<uint32_t>                   nSeq{0};
+    ChannelHistoryInfo                      Meta{};
+    float                                   *pBuffer = nullptr;
+    uint64_t                                nMask = 0;
+    bool                                    bRestartPending = false;
+
+    std::atomic<uint64_t>                   nHead{0};       // Published
+    std::atomic<uint64_t>                   nReserve{0};    // Being written
+
+    std::atomic<uint32_t>                   nReaders{0};    // In Read()
+
+    std::unique_ptr<float[]>                pOwned;         // pBuffer
+    std::vector<std::unique_ptr<float[]>>   vRetired;
+};
+
+//
+// Number of times a reader retries before giving up on a busy channel
+//
+static constexpr int nMaxReadRetries = 64;
+
+//
+// Smallest ring that will be allocated
+//
+static constexpr size_t nMinCapacity = 1024;
+
+//
+// Constructor
+//
+ChannelHistory::ChannelHistory(const ChannelHistoryConfig& Config)
+    : m_Config(Config)
+{
+    if(m_Config.nMaxChannelId < 0) m_Config.nMaxChannelId = 0;
+
+    m_aRings.reset(new std::atomic<Ring *>[m_Config.nMaxChannelId + 1]);
+    for(int i = 0; i <= m_Config.nMaxChannelId; i++) m_aRings[i] = nullptr;
+}
+
+//
+// Destructor
+//
+ChannelHistory::~ChannelHistory()
+{
+}
+
+//
+// Function used to get the ring for a channel id, if there is one
+//
+ChannelHistory::Ring *ChannelHistory::FindRing(int nId) const
+{
+    if(nId < 0 || nId > m_Config.nMaxChannelId) return nullptr;
+    return m_aRings[nId].load(std::memory_order_acquire);
+}
+
+//
+// Function used to work out how many samples to keep for a channel.  The
+// result is always a power of two so ring positions are a simple mask.
+//
+size_t ChannelHistory::Capacity(const TrackedChannel& tc) const
+{
+    size_t  nWanted = 0;
+
+    if(m_Config.dSeconds > 0.0 && tc.dEffectiveSamplePeriod > 0.0)
+        nWanted = static_cast<size_t>(
+            std::ceil(m_Config.dSeconds / tc.dEffectiveSamplePeriod));
+
+    size_t  nLimit = m_Config.nMaxBytes / sizeof(float);
+    if(nWanted == 0) nWanted = nLimit;
+
+    size_t  nCapacity = nMinCapacity;
+    while(nCapacity < nWanted) nCapacity <<= 1;
+
+    // Never go over the memory limit, round down instead
+    while(nLimit && nCapacity > nLimit && nCapacity > nMinCapacity)
+        nCapacity >>= 1;
+
+    return nCapacity;
+}
+
+//
+// Function used to (re)start a channel's history.  Any samples held are
+// discarded and sample indices restart at 0.
+//
+void ChannelHistory::Reset(Ring *r, const TrackedChannel *tc,
+    bool bSubscribed)
+{
+    float       *pBuffer = r->pBuffer;
+    uint64_t    nMask = r->nMask;
+
+    if(tc) {
+        size_t  nCapacity = Capacity(*tc);
+
+        // Allocate outside of the sequence lock so readers are not held off
+        if(nCapacity != nMask + 1 || !pBuffer) {
+            if(r->pOwned) r->vRetired.push_back(std::move(r->pOwned));
+            r->pOwned.reset(new float[nCapacity]);
+            pBuffer = r->pOwned.get();
+            nMask = nCapacity - 1;
+        }
+    }
+
+    uint32_t    nSeq = r->nSeq.load(std::memory_order_relaxed);
+    r->nSeq.store(nSeq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if(tc) {
+        ::memset(r->Meta.szName, 0, sizeof(r->Meta.szName));
+        ::strncpy(r->Meta.szName, tc->ci.sName.c_str(),
+            sizeof(r->Meta.szName) - 1);
+        r->Meta.nId = tc->nId;
+        r->Meta.dScale = tc->ci.dScale;
+        r->Meta.dOffset = tc->ci.dOffset;
+        r->Meta.dSamplePeriod = tc->dEffectiveSamplePeriod;
+        r->Meta.nDecimationFactor = tc->ci.nDecimationFactor;
+        r->Meta.dFirstSampleTimestamp = tc->dFirstSampleTimestamp;
+        r->Meta.nEpoch++;
+
+        r->pBuffer = pBuffer;
+        r->nMask = nMask;
+        r->nHead.store(0, std::memory_order_relaxed);
+        r->nReserve.store(0, std::memory_order_relaxed);
+    }
+    r->Meta.bSubscribed = bSubscribed;
+
+    r->nSeq.store(nSeq + 2, std::memory_order_release);
+
+    // A reader that comes along from now on gets the new buffer, so with
+    // none in Read() nothing can be using the retired ones
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(!r->vRetired.empty() &&
+        r->nReaders.load(std::memory_order_relaxed) == 0)
+        r->vRetired.clear();
+}
+
+//
+// Function used to add a block of samples to a channel's history
+//
+void ChannelHistory::Append(Ring *r, const float *pData, size_t nSamples)
+{
+    uint64_t    nHead = r->nHead.load(std::memory_order_relaxed);
+    uint64_t    nCapacity = r->nMask + 1;
+
+    // Let readers know these positions are about to be overwritten
+    r->nReserve.store(nHead + nSamples, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // Only the newest nCapacity samples of a huge block can be kept
+    uint64_t    nIndex = nHead;
+    if(nSamples > nCapacity) {
+        nIndex += nSamples - nCapacity;
+        pData += nSamples - nCapacity;
+        nSamples = nCapacity;
+    }
+
+    size_t  nPos = nIndex & r->nMask;
+    size_t  nFirst = std::min<size_t>(nSamples, nCapacity - nPos);
+
+    ::memcpy(r->pBuffer + nPos, pData, nFirst * sizeof(float));
+    if(nFirst < nSamples)
+        ::memcpy(r->pBuffer, pData + nFirst,
+            (nSamples - nFirst) * sizeof(float));
+
+    r->nHead.store(r->nReserve.load(std::memory_order_relaxed),
+        std::memory_order_release);
+}
+
+//
+// Function used to process events from the LowLatencyDataClient
+//
+void ChannelHistory::HandleEvent(EventType nType, const void *p, size_t nSize)
+{
+    // Data is the hot path, keep it first and short
+    if(nType == EVENT_TYPE_CHANNEL_DATA) {
+        const ChannelDataInfo *cdi =
+            reinterpret_cast<const ChannelDataInfo *>(p);
+
+        Ring    *r = FindRing(cdi->nId);
+        if(!r || !r->Meta.bSubscribed || !cdi->nSamples) return;
+
+        if(r->bRestartPending) {
+            r->bRestartPending = false;
+            Reset(r, m_Tracker.Find(cdi->nId), true);
+        }
+        Append(r, cdi->pData, cdi->nSamples);
+        return;
+    }
+
+    // Keep the ring readable after unsubscribe, just mark it as such
+    if(nType == EVENT_TYPE_CHANNEL_UNSUBSCRIBED) {
+        const ChannelUnsubscribedInfo *cui =
+            reinterpret_cast<const ChannelUnsubscribedInfo *>(p);
+        Ring    *r = FindRing(cui->nId);
+        if(r) Reset(r, nullptr, false);
+    }
+
+    m_Tracker.HandleEvent(nType, p, nSize);
+
+    if(nType == EVENT_TYPE_CHANNEL_SUBSCRIBED) {
+        const ChannelSubscribedInfo *csi =
+            reinterpret_cast<const ChannelSubscribedInfo *>(p);
+        const TrackedChannel *tc = m_Tracker.Find(csi->nId);
+
+        if(!tc || csi->nId < 0 || csi->nId > m_Config.nMaxChannelId) return;
+
+        Ring    *r = FindRing(csi->nId);
+        if(!r) {
+            m_vRings.emplace_back(new Ring);
+            r = m_vRings.back().get();
+            Reset(r, tc, true);
+            m_aRings[csi->nId].store(r, std::memory_order_release);
+        } else Reset(r, tc, true);
+
+    } else if(nType == EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS) {
+        const ChannelTimestampInfo *ctsi =
+            reinterpret_cast<const ChannelTimestampInfo *>(p);
+        const TrackedChannel *tc = m_Tracker.Find(ctsi->nId);
+        Ring    *r = FindRing(ctsi->nId);
+
+        if(!tc || !r) return;
+
+        // A first sample timestamp of 0 means acquisition stopped.  Keep
+        // what is held readable until data for the next acquisition shows
+        // up.  Any other new first sample timestamp means sample indices
+        // start over.
+        if(tc->dFirstSampleTimestamp == 0.0)
+            r->bRestartPending = true;
+        else if(!(r->Meta.dFirstSampleTimestamp == tc->dFirstSampleTimestamp &&
+            r->nHead.load(std::memory_order_relaxed) == 0)) {
+            r->bRestartPending = false;
+            Reset(r, tc, true);
+        }
+    }
+}
+
+//
+// Function used to get a consistent copy of a channel's metadata
+//
+bool ChannelHistory::Info(int nId, ChannelHistoryInfo& Info) const
+{
+    Ring    *r = FindRing(nId);
+    if(!r) return false;
+
+    for(int nTry = 0; nTry < nMaxReadRetries; nTry++) {
+        uint32_t    nSeq = r->nSeq.load(std::memory_order_acquire);
+        if(nSeq & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        Info = r->Meta;
+        uint64_t    nCapacity = r->nMask + 1;
+        uint64_t    nHead = r->nHead.load(std::memory_order_acquire);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(r->nSeq.load(std::memory_order_relaxed) != nSeq) continue;
+
+        Info.nCapacity = nCapacity;
+        Info.nNextIndex = nHead;
+        Info.nFirstIndex = nHead > nCapacity ? nHead - nCapacity : 0;
+        return true;
+    }
+
+    return false;
+}
+
+//
+// Function used to find the id a channel's history is held under.  This
+// scans all ids so look it up once rather than on every read.
+//
+int ChannelHistory::FindChannel(const std::string& sName) const
+{
+    ChannelHistoryInfo  Info;
+    int                 nFound = -1;
+
+    for(int nId = 0; nId <= m_Config.nMaxChannelId; nId++) {
+        if(!ChannelHistory::Info(nId, Info)) continue;
+        if(sName != Info.szName) continue;
+
+        // Prefer the id that is currently subscribed
+        nFound = nId;
+        if(Info.bSubscribed) break;
+    }
+
+    return nFound;
+}
+
+//
+// Function used to read up to nCount samples starting at sample index nIndex.
+// If nIndex is older than what is held the read starts at the oldest sample
+// held.  The index of the first sample returned is stored in *pnFirstIndex.
+// Returns the number of samples copied.
+//
+size_t ChannelHistory::Read(int nId, uint64_t nIndex, float *pSamples,
+    size_t nCount, uint64_t *pnFirstIndex) const
+{
+    Ring    *r = FindRing(nId);
+    if(!r) return 0;
+
+    // Keeps the writer from freeing a buffer this might have been handed
+    struct ReaderGuard {
+        std::atomic<uint32_t>&  n;
+        explicit ReaderGuard(std::atomic<uint32_t>& nReaders) : n(nReaders)
+        {
+            n.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+        ~ReaderGuard() { n.fetch_sub(1, std::memory_order_release); }
+    } Guard(r->nReaders);
+
+    for(int nTry = 0; nTry < nMaxReadRetries; nTry++) {
+        uint32_t    nSeq = r->nSeq.load(std::memory_order_acquire);
+        if(nSeq & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        const float *pBuffer = r->pBuffer;
+        uint64_t    nMask = r->nMask;
+        uint64_t    nCapacity = nMask + 1;
+        uint64_t    nHead = r->nHead.load(std::memory_order_acquire);
+        uint64_t    nOldest = nHead > nCapacity ? nHead - nCapacity : 0;
+        uint64_t    nFirst = std::max(nIndex, nOldest);
+        size_t      nRead = 0;
+
+        if(pBuffer && nFirst < nHead) {
+            nRead = static_cast<size_t>(
+                std::min<uint64_t>(nCount, nHead - nFirst));
+
+            size_t  nPos = nFirst & nMask;
+            size_t  nPart = std::min<size_t>(nRead, nCapacity - nPos);
+            ::memcpy(pSamples, pBuffer + nPos, nPart * sizeof(float));
+            if(nPart < nRead)
+                ::memcpy(pSamples + nPart, pBuffer,
+                    (nRead - nPart) * sizeof(float));
+        }
+
+        // Make sure the copy was not torn by the writer
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t    nReserve = r->nReserve.load(std::memory_order_relaxed);
+        if(r->nSeq.load(std::memory_order_relaxed) != nSeq) continue;
+
+        if(nRead && nReserve > nCapacity && nFirst < nReserve - nCapacity) {
+            // Overtaken while copying, start again at what is still valid
+            nIndex = nReserve - nCapacity;
+            continue;
+        }
+
+        if(pnFirstIndex) *pnFirstIndex = nFirst;
+        return nRead;
+    }
+
+    return 0;
+}
+
+//
+// Function used to read a single sample by index
+//
+bool ChannelHistory::Sample(int nId, uint64_t nIndex, float& fSample) const
+{
+    uint64_t    nFirst;
+    return Read(nId, nIndex, &fSample, 1, &nFirst) == 1 && nFirst == nIndex;
+}
+
+//
+// Function used to get the (fractional) sample index of a time, snapped to
+// the nearest whole index when it is only off by the rounding of the
+// timestamps.  They are seconds since 1970, which a double only holds to a
+// few hundred ns, a good part of the period of a fast channel.
+//
+static double SnappedIndex(const ChannelHistoryInfo& Info, double dTime)
+{
+    double  dIndex = (dTime - Info.dFirstSampleTimestamp) / Info.dSamplePeriod;
+    double  dSlack = std::min(0.25, 1e-9 + 4.0 * DBL_EPSILON *
+        (std::fabs(dTime) + std::fabs(Info.dFirstSampleTimestamp)) /
+        Info.dSamplePeriod);
+    double  dNearest = std::round(dIndex);
+
+    return std::fabs(dIndex - dNearest) <= dSlack ? dNearest : dIndex;
+}
+
+//
+// Function used to read the samples with timestamps in [dStart, dEnd]
+//
+size_t ChannelHistory::ReadTimeRange(int nId, double dStart, double dEnd,
+    float *pSamples, size_t nCount, uint64_t *pnFirstIndex) const
+{
+    ChannelHistoryInfo  Info;
+    if(!ChannelHistory::Info(nId, Info)) return 0;
+
+    // No timing, or nothing in range, to go on
+    if(!std::isfinite(Info.dSamplePeriod) || !(Info.dSamplePeriod > 0.0) ||
+        !std::isfinite(Info.dFirstSampleTimestamp) ||
+        std::isnan(dStart) || std::isnan(dEnd)) return 0;
+
+    double  dLast = std::floor(SnappedIndex(Info, dEnd));
+    if(!(dLast >= 0.0)) return 0;
+
+    int64_t nFirst = IndexAtTime(Info, dStart);
+    int64_t nLast = static_cast<int64_t>(std::min(dLast,
+        static_cast<double>(Info.nNextIndex)));
+
+    if(nFirst < 0) nFirst = 0;
+    if(nLast < nFirst) return 0;
+
+    nCount = static_cast<size_t>(
+        std::min<int64_t>(static_cast<int64_t>(nCount), nLast - nFirst + 1));
+
+    return Read(nId, static_cast<uint64_t>(nFirst), pSamples, nCount,
+        pnFirstIndex);
+}
+
+//
+// Function used to get the index of the first sample at or after a time
+//
+int64_t ChannelHistory::IndexAtTime(const ChannelHistoryInfo& Info,
+    double dTime)
+{
+    if(!std::isfinite(Info.dSamplePeriod) || !(Info.dSamplePeriod > 0.0))
+        return -1;
+
+    // Out of int64_t range (or NaN) is before or after everything held
+    double  dIndex = std::ceil(SnappedIndex(Info, dTime));
+    if(!(dIndex > -9e18)) return -1;
+    if(dIndex > 9e18) return INT64_MAX;
+
+    return static_cast<int64_t>(dIndex);
+}
+
+//
+// Function used to get the timestamp of a sample index
+//
+double ChannelHistory::TimeAtIndex(const ChannelHistoryInfo& Info,
+    uint64_t nIndex)
+{
+    return Info.dFirstSampleTimestamp +
+        static_cast<double>(nIndex) * Info.dSamplePeriod;
+}
@@ -0,0 +1,97 @@
+#ifndef __CHANNELHISTORY_H__
+#define __CHANNELHISTORY_H__
+
+#include    <atomic>
+#include    <memory>
+#include    <string>
+#include    <vector>
+#include    "ChannelTracker.h"
+
+//
+// Definition of how much history is kept for each subscribed channel.  A
+// channel holds enough samples for dSeconds at its (decimated) rate, but
+// never more than nMaxBytes.  Either may be zero to leave it unlimited, but
+// not both.
+//
+typedef struct {
+    double      dSeconds;               // Seconds of data to keep
+    size_t      nMaxBytes;              // Max memory per channel
+    int         nMaxChannelId;          // Highest channel id to keep
+} ChannelHistoryConfig;
+
+//
+// Definition of a consistent snapshot of a channel's history metadata
+//
+typedef struct {
+    char        szName[64];             // Name of the channel
+    int         nId;                    // Subscribed ID of the channel
+    bool        bSubscribed;            // false once unsubscribed
+    double      dScale;                 // From server "available"
+    double      dOffset;                // From server "available"
+    double      dSamplePeriod;          // Period of the received samples
+    uint32_t    nDecimationFactor;      // Decimation factor subscribed with
+    double      dFirstSampleTimestamp;  // Timestamp of sample index 0
+    uint64_t    nEpoch;                 // Bumped whenever indices restart
+    uint64_t    nFirstIndex;            // Oldest sample index still held
+    uint64_t    nNextIndex;             // Index the next sample will get
+    size_t      nCapacity;              // Samples held when full
+} ChannelHistoryInfo;
+
+//
+// Definition of the in-memory per channel history store.
+//
+// HandleEvent() is the only writer and is meant to be called straight from
+// the LowLatencyDataClient event handler on the socket read thread.  All of
+// the reader functions can be called from any thread at any time and never
+// take a lock:  metadata is read under a sequence lock and sample reads are
+// validated against the write position after the copy, so a reader that got
+// overtaken by the writer simply retries.
+//
+// Sample index 0 is the first sample received after the channel's first
+// sample timestamp was (re)established, so the timestamp of index i is
+// dFirstSampleTimestamp + i * dSamplePeriod.
+//
+class ChannelHistory {
+    public:
+        explicit ChannelHistory(const ChannelHistoryConfig&);
+        ~ChannelHistory();
+
+        ChannelHistory(const ChannelHistory&) = delete;
+        ChannelHistory& operator=(const ChannelHistory&) = delete;
+
+        // Writer side
+        void HandleEvent(EventType, const void *, size_t);
+
+        // Reader side
+        int FindChannel(const std::string&) const;
+
+        bool Info(int nId, ChannelHistoryInfo&) const;
+
+        size_t Read(int nId, uint64_t nIndex, float *pSamples, size_t nCount,
+            uint64_t *pnFirstIndex = nullptr) const;
+
+        bool Sample(int nId, uint64_t nIndex, float& fSample) const;
+
+        size_t ReadTimeRange(int nId, double dStart, double dEnd,
+            float *pSamples, size_t nCount,
+            uint64_t *pnFirstIndex = nullptr) const;
+
+        static int64_t IndexAtTime(const ChannelHistoryInfo&, double dTime);
+        static double TimeAtIndex(const ChannelHistoryInfo&, uint64_t nIndex);
+
+    private:
+        struct Ring;
+
+        Ring *FindRing(int nId) const;
+        size_t Capacity(const TrackedChannel&) const;
+        void Reset(Ring *, const TrackedChannel *, bool bSubscribed);
+        void Append(Ring *, const float *, size_t);
+
+        ChannelHistoryConfig                    m_Config;
+        ChannelTracker                          m_Tracker;
+
+        std::unique_ptr<std::atomic<Ring *>[]>  m_aRings;
+        std::vector<std::unique_ptr<Ring>>      m_vRings;
+};
+
+#endif
@@ -0,0 +1,383 @@
+#include "ChannelLodPyramid.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+//
+// Definition of the summary kept for each bucket
+//
+struct ChannelLodPyramid::Summary {
+    float       fMin;
+    float       fMax;
+    double      dSum;
+    uint64_t    nCount;
+
+    void Clear(void) {
+        fMin = std::numeric_limits<float>::infinity();
+        fMax = -std::numeric_limits<float>::infinity();
+        dSum = 0.0;
+        nCount = 0;
+    }
+
+    void Merge(const Summary& s) {
+        if(!s.nCount) return;
+        fMin = std::min(fMin, s.fMin);
+        fMax = std::max(fMax, s.fMax);
+        dSum += s.dSum;
+        nCount += s.nCount;
+    }
+};
+
+//
+// Definition of the pyramid for a single channel id.  Bucket j of level k
+// summarizes samples [j * Bk, (j + 1) * Bk) where Bk is the level's bucket
+// size, and lives in slot (j % nBucketsPerLevel) of that level.
+//
+struct ChannelLodPyramid::Channel {
+    mutable std::mutex      Lock;
+
+    bool                    bSubscribed = false;
+    bool                    bRestartPending = false;
+    double                  dFirstSampleTimestamp = NAN;
+    double                  dSamplePeriod = NAN;
+    double                  dScale = 1.0;
+    double                  dOffset = 0.0;
+
+    uint64_t                nSamples = 0;       // Samples folded in so far
+    std::vector<Summary>    vBuckets;           // nLevels * nBucketsPerLevel
+    std::vector<uint64_t>   vCompleted;         // Completed buckets per level
+    std::vector<Summary>    vPartial;           // In progress bucket per level
+};
+
+//
+// Function used to round up to a power of 2
+//
+static uint32_t RoundUpPow2(uint32_t n)
+{
+    uint32_t    r = 1;
+    while(r < n) r <<= 1;
+    return r;
+}
+
+//
+// Constructor
+//
+ChannelLodPyramid::ChannelLodPyramid(const ChannelLodConfig& Config)
+    : m_Config(Config)
+{
+    m_Config.nBaseBucketSamples = RoundUpPow2(
+        std::max<uint32_t>(m_Config.nBaseBucketSamples, 1));
+    m_Config.nBucketsPerLevel = RoundUpPow2(
+        std::max<uint32_t>(m_Config.nBucketsPerLevel, 2));
+    m_Config.nLevels = std::min<uint32_t>(
+        std::max<uint32_t>(m_Config.nLevels, 1), 40);
+    if(m_Config.nMaxChannelId < 0) m_Config.nMaxChannelId = 0;
+
+    m_aChannels.reset(new std::atomic<Channel *>[m_Config.nMaxChannelId + 1]);
+    for(int i = 0; i <= m_Config.nMaxChannelId; i++) m_aChannels[i] = nullptr;
+}
+
+//
+// Destructor
+//
+ChannelLodPyramid::~ChannelLodPyramid()
+{
+}
+
+//
+// Function used to get the memory used for each subscribed channel
+//
+size_t ChannelLodPyramid::MemoryPerChannel(void) const
+{
+    return sizeof(Channel) + m_Config.nLevels *
+        ((m_Config.nBucketsPerLevel + 1) * sizeof(Summary) + sizeof(uint64_t));
+}
+
+//
+// Function used to get the pyramid for a channel id, if there is one
+//
+ChannelLodPyramid::Channel *ChannelLodPyramid::FindChannel(int nId) const
+{
+    if(nId < 0 || nId > m_Config.nMaxChannelId) return nullptr;
+    return m_aChannels[nId].load(std::memory_order_acquire);
+}
+
+//
+// Function used to empty a channel's pyramid and take on new metadata
+//
+void ChannelLodPyramid::Reset(Channel *ch, const TrackedChannel *tc)
+{
+    std::unique_lock<std::mutex>    lk(ch->Lock);
+
+    if(tc) {
+        ch->dFirstSampleTimestamp = tc->dFirstSampleTimestamp;
+        ch->dSamplePeriod = tc->dEffectiveSamplePeriod;
+        ch->dScale = tc->ci.dScale;
+        ch->dOffset = tc->ci.dOffset;
+    }
+
+    ch->nSamples = 0;
+    ch->vBuckets.resize(
+        static_cast<size_t>(m_Config.nLevels) * m_Config.nBucketsPerLevel);
+    ch->vCompleted.assign(m_Config.nLevels, 0);
+    ch->vPartial.resize(m_Config.nLevels);
+    for(auto& e : ch->vPartial) e.Clear();
+}
+
+//
+// Function used to store a level's finished bucket and carry it upwards
+//
+void ChannelLodPyramid::Complete(Channel *ch, uint32_t nLevel)
+{
+    while(true) {
+        Summary&    s = ch->vPartial[nLevel];
+        uint64_t    nSlot =
+            ch->vCompleted[nLevel] & (m_Config.nBucketsPerLevel - 1);
+
+        ch->vBuckets[nLevel * m_Config.nBucketsPerLevel + nSlot] = s;
+        ch->vCompleted[nLevel]++;
+
+        if(nLevel + 1 >= m_Config.nLevels) {
+            s.Clear();
+            return;
+        }
+
+        ch->vPartial[nLevel + 1].Merge(s);
+        s.Clear();
+
+        // Two buckets make one bucket on the next level up
+        if(ch->vCompleted[nLevel] & 1) return;
+        nLevel++;
+    }
+}
+
+//
+// Function used to fold a block of samples into a channel's pyramid
+//
+void ChannelLodPyramid::Update(Channel *ch, const float *pData,
+    size_t nSamples)
+{
+    std::unique_lock<std::mutex>    lk(ch->Lock);
+    const uint64_t  nBase = m_Config.nBaseBucketSamples;
+
+    while(nSamples) {
+        size_t  nRoom =
+            static_cast<size_t>(nBase - (ch->nSamples & (nBase - 1)));
+        size_t  n = std::min(nRoom, nSamples);
+
+        Summary&    s = ch->vPartial[0];
+        float       fMin = s.fMin;
+        float       fMax = s.fMax;
+        double      dSum = 0.0;
+
+        for(size_t i = 0; i < n; i++) {
+            fMin = std::min(fMin, pData[i]);
+            fMax = std::max(fMax, pData[i]);
+            dSum += pData[i];
+        }
+
+        s.fMin = fMin;
+        s.fMax = fMax;
+        s.dSum += dSum;
+        s.nCount += n;
+
+        ch->nSamples += n;
+        pData += n;
+        nSamples -= n;
+
+        if(n == nRoom) Complete(ch, 0);
+    }
+}
+
+//
+// Function used to get the index of the oldest sample a level still holds
+//
+uint64_t ChannelLodPyramid::OldestSample(const Channel *ch,
+    uint32_t nLevel) const
+{
+    uint64_t    nDone = ch->vCompleted[nLevel];
+    uint64_t    nOldest = nDone > m_Config.nBucketsPerLevel ?
+        nDone - m_Config.nBucketsPerLevel : 0;
+
+    return nOldest * (static_cast<uint64_t>(m_Config.nBaseBucketSamples) <<
+        nLevel);
+}
+
+//
+// Function used to summarize buckets [nFirst, nLast) of a level.  Buckets the
+// level has not finished yet are taken from the levels below, so the newest
+// data is always included.  Returns false if nothing was found.
+//
+bool ChannelLodPyramid::Gather(const Channel *ch, uint32_t nLevel,
+    uint64_t nFirst, uint64_t nLast, Summary& Result) const
+{
+    uint64_t    nDone = ch->vCompleted[nLevel];
+    uint64_t    nOldest = nDone > m_Config.nBucketsPerLevel ?
+        nDone - m_Config.nBucketsPerLevel : 0;
+    uint64_t    nCount = Result.nCount;
+
+    const Summary   *pLevel =
+        &ch->vBuckets[nLevel * m_Config.nBucketsPerLevel];
+
+    uint64_t    nEnd = std::min(nLast, nDone);
+    for(uint64_t j = std::max(nFirst, nOldest); j < nEnd; j++)
+        Result.Merge(pLevel[j & (m_Config.nBucketsPerLevel - 1)]);
+
+    if(nLast > nDone) {
+        uint64_t    nFrom = std::max(nFirst, nDone);
+
+        if(nLevel == 0) {
+            if(nFrom == nDone) Result.Merge(ch->vPartial[0]);
+        } else
+            Gather(ch, nLevel - 1, nFrom * 2, std::min(nLast, nDone + 1) * 2,
+                Result);
+    }
+
+    return Result.nCount != nCount;
+}
+
+//
+// Function used to get nBuckets display buckets covering [dStart, dEnd).
+// Returns the number of buckets filled in, buckets with no data held have
+// nSamples set to 0.
+//
+size_t ChannelLodPyramid::Query(int nId, double dStart, double dEnd,
+    LodBucket *pBuckets, size_t nBuckets) const
+{
+    Channel *ch = FindChannel(nId);
+    if(!ch || !nBuckets || !(dEnd > dStart)) return 0;
+
+    std::unique_lock<std::mutex>    lk(ch->Lock);
+
+    if(!(ch->dSamplePeriod > 0.0) || ch->vCompleted.empty()) return 0;
+
+    double  dFirst = (dStart - ch->dFirstSampleTimestamp) / ch->dSamplePeriod;
+    double  dPerBucket = (dEnd - dStart) / ch->dSamplePeriod /
+        static_cast<double>(nBuckets);
+
+    // Pick the coarsest level whose buckets still fit in a display bucket
+    uint32_t    nLevel = 0;
+    while(nLevel + 1 < m_Config.nLevels &&
+        static_cast<double>(static_cast<uint64_t>(
+            m_Config.nBaseBucketSamples) << (nLevel + 1)) <= dPerBucket)
+        nLevel++;
+
+    // A long span at a fine zoom can start before the oldest bucket that
+    // level still holds; use the finest level above it that holds the start
+    double  dFrom = std::max(0.0, dFirst);
+    while(nLevel + 1 < m_Config.nLevels &&
+        static_cast<double>(OldestSample(ch, nLevel)) > dFrom)
+        nLevel++;
+
+    double  dLevelBucket = static_cast<double>(
+        static_cast<uint64_t>(m_Config.nBaseBucketSamples) << nLevel);
+
+    for(size_t i = 0; i < nBuckets; i++) {
+        double      d0 = dFirst + static_cast<double>(i) * dPerBucket;
+        double      d1 = d0 + dPerBucket;
+        LodBucket&  b = pBuckets[i];
+
+        b.dStart = ch->dFirstSampleTimestamp + d0 * ch->dSamplePeriod;
+        b.nSamples = 0;
+        b.fMin = b.fMax = b.fMean = NAN;
+
+        if(d1 <= 0.0) continue;
+
+        // A bucket goes to the display bucket its first sample falls in.
+        // When display buckets are smaller than level buckets use the level
+        // bucket that covers the display bucket.
+        uint64_t    nFirst = static_cast<uint64_t>(
+            std::max(0.0, std::ceil(d0 / dLevelBucket)));
+        uint64_t    nLast = static_cast<uint64_t>(
+            std::ceil(d1 / dLevelBucket));
+        if(nLast <= nFirst) {
+            nFirst = static_cast<uint64_t>(
+                std::max(0.0, std::floor(d0 / dLevelBucket)));
+            nLast = nFirst + 1;
+        }
+
+        Summary s;
+        s.Clear();
+        if(!Gather(ch, nLevel, nFirst, nLast, s)) continue;
+
+        double  dLo = s.fMin * ch->dScale + ch->dOffset;
+        double  dHi = s.fMax * ch->dScale + ch->dOffset;
+        if(dLo > dHi) std::swap(dLo, dHi);
+
+        b.fMin = static_cast<float>(dLo);
+        b.fMax = static_cast<float>(dHi);
+        b.fMean = static_cast<float>(
+            (s.dSum / static_cast<double>(s.nCount)) * ch->dScale +
+            ch->dOffset);
+        b.nSamples = s.nCount;
+    }
+
+    return nBuckets;
+}
+
+//
+// Function used to process events from the LowLatencyDataClient
+//
+void ChannelLodPyramid::HandleEvent(EventType nType, const void *p,
+    size_t nSize)
+{
+    if(nType == EVENT_TYPE_CHANNEL_DATA) {
+        const ChannelDataInfo *cdi =
+            reinterpret_cast<const ChannelDataInfo *>(p);
+
+        Channel *ch = FindChannel(cdi->nId);
+        if(!ch || !ch->bSubscribed || !cdi->nSamples) return;
+
+        if(ch->bRestartPending) {
+            ch->bRestartPending = false;
+            Reset(ch, m_Tracker.Find(cdi->nId));
+        }
+        Update(ch, cdi->pData, cdi->nSamples);
+        return;
+    }
+
+    m_Tracker.HandleEvent(nType, p, nSize);
+
+    if(nType == EVENT_TYPE_CHANNEL_SUBSCRIBED) {
+        const ChannelSubscribedInfo *csi =
+            reinterpret_cast<const ChannelSubscribedInfo *>(p);
+        const TrackedChannel *tc = m_Tracker.Find(csi->nId);
+
+        if(!tc || csi->nId < 0 || csi->nId > m_Config.nMaxChannelId) return;
+
+        Channel *ch = FindChannel(csi->nId);
+        if(!ch) {
+            m_vChannels.emplace_back(new Channel);
+            ch = m_vChannels.back().get();
+            Reset(ch, tc);
+            m_aChannels[csi->nId].store(ch, std::memory_order_release);
+        } else Reset(ch, tc);
+
+        ch->bSubscribed = true;
+        ch->bRestartPending = false;
+
+    } else if(nType == EVENT_TYPE_CHANNEL_UNSUBSCRIBED) {
+        const ChannelUnsubscribedInfo *cui =
+            reinterpret_cast<const ChannelUnsubscribedInfo *>(p);
+        Channel *ch = FindChannel(cui->nId);
+        if(ch) ch->bSubscribed = false;
+
+    } else if(nType == EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS) {
+        const ChannelTimestampInfo *ctsi =
+            reinterpret_cast<const ChannelTimestampInfo *>(p);
+        const TrackedChannel *tc = m_Tracker.Find(ctsi->nId);
+        Channel *ch = FindChannel(ctsi->nId);
+
+        if(!tc || !ch) return;
+
+        // Same rules as ChannelHistory:  0 means acquisition stopped, keep
+        // what is there until new data arrives.
+        if(tc->dFirstSampleTimestamp == 0.0)
+            ch->bRestartPending = true;
+        else if(!(ch->dFirstSampleTimestamp == tc->dFirstSampleTimestamp &&
+            ch->nSamples == 0)) {
+            ch->bRestartPending = false;
+            Reset(ch, tc);
+        }
+    }
+}
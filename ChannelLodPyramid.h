@@ -0,0 +1,85 @@
+#ifndef __CHANNELLODPYRAMID_H__
+#define __CHANNELLODPYRAMID_H__
+
+#include    <atomic>
+#include    <memory>
+#include    <mutex>
+#include    <vector>
+#include    "ChannelTracker.h"
+
+//
+// Definition of the shape of the level of detail pyramid kept per channel.
+// Level 0 buckets summarize nBaseBucketSamples samples and every level above
+// summarizes twice as many as the one below.  Each level holds the newest
+// nBucketsPerLevel buckets, so memory per channel is fixed at
+//     nLevels * nBucketsPerLevel * sizeof(bucket)
+// and the time covered doubles with each level.
+//
+typedef struct {
+    uint32_t    nBaseBucketSamples;     // Samples per level 0 bucket (2^n)
+    uint32_t    nLevels;                // Number of levels
+    uint32_t    nBucketsPerLevel;       // Buckets held per level (2^n)
+    int         nMaxChannelId;          // Highest channel id to keep
+} ChannelLodConfig;
+
+//
+// Definition of one display bucket returned from a query.  Values have the
+// channel's scale and offset applied.
+//
+typedef struct {
+    double      dStart;                 // Timestamp at start of the bucket
+    float       fMin;                   // Minimum value in the bucket
+    float       fMax;                   // Maximum value in the bucket
+    float       fMean;                  // Mean value in the bucket
+    uint64_t    nSamples;               // Samples summarized, 0 = no data
+} LodBucket;
+
+//
+// Definition of the incrementally maintained min/max/mean pyramid.
+//
+// HandleEvent() is driven from the LowLatencyDataClient event handler and
+// folds each data block into the pyramid as it arrives.  Query() answers
+// "nBuckets display buckets between dStart and dEnd" by picking the level
+// whose buckets are just smaller than a display bucket, so the cost is
+// proportional to nBuckets no matter how many samples the span holds.  If
+// that level no longer holds the start of the span the finest coarser level
+// that does is used instead.
+//
+// Each channel has its own lock which is only held while a block is folded
+// in or a query is answered.
+//
+class ChannelLodPyramid {
+    public:
+        explicit ChannelLodPyramid(const ChannelLodConfig&);
+        ~ChannelLodPyramid();
+
+        ChannelLodPyramid(const ChannelLodPyramid&) = delete;
+        ChannelLodPyramid& operator=(const ChannelLodPyramid&) = delete;
+
+        void HandleEvent(EventType, const void *, size_t);
+
+        size_t Query(int nId, double dStart, double dEnd, LodBucket *pBuckets,
+            size_t nBuckets) const;
+
+        size_t MemoryPerChannel(void) const;
+
+    private:
+        struct Channel;
+        struct Summary;
+
+        Channel *FindChannel(int nId) const;
+        uint64_t OldestSample(const Channel *, uint32_t nLevel) const;
+        void Reset(Channel *, const TrackedChannel *);
+        void Update(Channel *, const float *, size_t);
+        void Complete(Channel *, uint32_t nLevel);
+        bool Gather(const Channel *, uint32_t nLevel, uint64_t nFirst,
+            uint64_t nLast, Summary&) const;
+
+        ChannelLodConfig                            m_Config;
+        ChannelTracker                              m_Tracker;
+
+        std::unique_ptr<std::atomic<Channel *>[]>   m_aChannels;
+        std::vector<std::unique_ptr<Channel>>       m_vChannels;
+};
+
+#endif
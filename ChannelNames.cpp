@@ -0,0 +1,149 @@
+#include "ChannelNames.h"
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+//
+// Definition of the names, the deque keeping each where it is as more are
+// added
+//
+typedef struct {
+    std::mutex                                      Lock;
+    std::unordered_map<std::string, ChannelHandle>  mHandles;
+    std::deque<std::string>                         dNames;     // By handle
+} Names;
+
+//
+// Function used to get the names, made on first use
+//
+static Names& TheNames(void)
+{
+    static Names    names;
+    return names;
+}
+
+//
+// Function used to get the handle of a name, giving it one if it's new
+//
+ChannelHandle ChannelNames::Intern(const std::string& sName)
+{
+    Names&                          n = TheNames();
+    std::unique_lock<std::mutex>    lk(n.Lock);
+
+    auto    r = n.mHandles.emplace(sName,
+        static_cast<ChannelHandle>(n.dNames.size()));
+    if(r.second) n.dNames.push_back(sName);
+
+    return (*r.first).second;
+}
+
+//
+// Function used to get the handle of a name, NO_CHANNEL_HANDLE if it has
+// never been seen
+//
+ChannelHandle ChannelNames::Find(const std::string& sName)
+{
+    Names&                          n = TheNames();
+    std::unique_lock<std::mutex>    lk(n.Lock);
+
+    auto    it = n.mHandles.find(sName);
+    return it == n.mHandles.end() ? NO_CHANNEL_HANDLE : (*it).second;
+}
+
+//
+// Function used to get the handles of a list of names, giving those that
+// are new one, in the order given
+//
+std::vector<ChannelHandle> ChannelNames::InternAll(
+    const std::vector<std::string>& vNames)
+{
+    Names&                          n = TheNames();
+    std::vector<ChannelHandle>      vHandles;
+    vHandles.reserve(vNames.size());
+
+    std::unique_lock<std::mutex>    lk(n.Lock);
+    for(auto& sName : vNames) {
+        auto    r = n.mHandles.emplace(sName,
+            static_cast<ChannelHandle>(n.dNames.size()));
+        if(r.second) n.dNames.push_back(sName);
+
+        vHandles.push_back((*r.first).second);
+    }
+
+    return vHandles;
+}
+
+//
+// Function used to get the handles of a list of names, in the order given,
+// NO_CHANNEL_HANDLE for those never seen
+//
+std::vector<ChannelHandle> ChannelNames::FindAll(
+    const std::vector<std::string>& vNames)
+{
+    Names&                          n = TheNames();
+    std::vector<ChannelHandle>      vHandles;
+    vHandles.reserve(vNames.size());
+
+    std::unique_lock<std::mutex>    lk(n.Lock);
+    for(auto& sName : vNames) {
+        auto    it = n.mHandles.find(sName);
+        vHandles.push_back(it == n.mHandles.end() ? NO_CHANNEL_HANDLE :
+            (*it).second);
+    }
+
+    return vHandles;
+}
+
+//
+// Function used to get the name of a handle, empty if it isn't one
+//
+const std::string& ChannelNames::Name(ChannelHandle h)
+{
+    static const std::string    sNone;
+
+    Names&                          n = TheNames();
+    std::unique_lock<std::mutex>    lk(n.Lock);
+
+    return h < n.dNames.size() ? n.dNames[h] : sNone;
+}
+
+//
+// Function used to get how many names there are, handles are below this
+//
+size_t ChannelNames::Count(void)
+{
+    Names&                          n = TheNames();
+    std::unique_lock<std::mutex>    lk(n.Lock);
+
+    return n.dNames.size();
+}
+
+//
+// Function used to tell whether a name matches a pattern with * (any run
+// of characters) and ? (any one character) wildcards
+//
+bool ChannelNames::Matches(const std::string& sPattern,
+    const std::string& sName)
+{
+    size_t  p = 0, n = 0;
+    size_t  nStar = std::string::npos, nStarName = 0;
+
+    while(n < sName.size()) {
+        if(p < sPattern.size() && (sPattern[p] == '?' ||
+            sPattern[p] == sName[n])) {
+            p++;
+            n++;
+        } else if(p < sPattern.size() && sPattern[p] == '*') {
+            nStar = p++;
+            nStarName = n;
+        } else if(nStar != std::string::npos) {
+            // Let the last * take one more character
+            p = nStar + 1;
+            n = ++nStarName;
+        } else
+            return false;
+    }
+
+    while(p < sPattern.size() && sPattern[p] == '*') p++;
+    return p == sPattern.size();
+}
@@ -0,0 +1,45 @@
+#ifndef __CHANNELNAMES_H__
+#define __CHANNELNAMES_H__
+
+#include    <cstddef>
+#include    <cstdint>
+#include    <string>
+#include    <vector>
+
+//
+// Handle of a channel name, dense from 0
+//
+typedef uint32_t    ChannelHandle;
+
+#define NO_CHANNEL_HANDLE   UINT32_MAX
+
+//
+// Definition of the channel names known to the process.
+//
+// Each name is given a handle the first time it is seen, and keeps it for
+// as long as the process runs, whatever is subscribed or unsubscribed and
+// however many times the client connects.  Per channel state can then be
+// kept in arrays indexed by handle, with the name looked up only to show
+// it.  Names are never forgotten, there are only ever so many channels.
+//
+// Thread safe.  Intern() and Find() lock, so resolve a name once and keep
+// its handle; the reference Name() gives stays valid.  InternAll() and
+// FindAll() do a whole list of names, such as those of a server message,
+// under one lock.
+//
+class ChannelNames {
+    public:
+        static ChannelHandle Intern(const std::string& sName);
+        static ChannelHandle Find(const std::string& sName);
+        static std::vector<ChannelHandle> InternAll(
+            const std::vector<std::string>& vNames);
+        static std::vector<ChannelHandle> FindAll(
+            const std::vector<std::string>& vNames);
+        static const std::string& Name(ChannelHandle);
+        static size_t Count(void);
+
+        static bool Matches(const std::string& sPattern,
+            const std::string& sName);
+};
+
+#endif
@@ -0,0 +1,634 @@
+#include "ChannelRecorder.h"
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+//
+// Alignment required for O_DIRECT buffers, offsets and sizes
+//
+static constexpr size_t nIoAlignment = 4096;
+
+//
+// Definition of an open recording.  Header, pChunk, nFill and the index
+// state belong to the socket thread, the rest to the writer thread.
+//
+struct ChannelRecorder::File {
+    RecordingFileHeader Header;
+    uint8_t             *pChunk = nullptr;
+    size_t              nFill = 0;
+    std::chrono::steady_clock::time_point   tChunk;     // When pChunk taken
+
+    // Index state, also socket thread only
+    double              dSamplePeriod = NAN;
+    uint32_t            nSegment = 0;
+    bool                bAnySegment = false;
+    double              dSegmentTimestamp = NAN;
+    uint64_t            nSegmentSamples = 0;    // Lost samples included
+    bool                bSegmentPending = true;
+    double              dPendingTimestamp = NAN;
+    bool                bGapPending = false;
+    uint64_t            nNextIndexSample = 0;
+
+    int                 fd = -1;
+    int                 fdIndex = -1;
+    bool                bDirect = false;
+    uint64_t            nOffset = RECORDING_HEADER_SIZE;
+    uint64_t            nReserved = 0;
+};
+
+//
+// Function used to round up to the O_DIRECT alignment
+//
+static size_t AlignUp(size_t n)
+{
+    return (n + nIoAlignment - 1) & ~(nIoAlignment - 1);
+}
+
+//
+// Constructor
+//
+ChannelRecorder::ChannelRecorder(const ChannelRecorderConfig& Config)
+    : m_Config(Config)
+    , m_bWriting(false)
+    , m_bExit(false)
+    , m_nChunksWritten(0)
+    , m_nBytesWritten(0)
+    , m_nDroppedSamples(0)
+    , m_nWriteErrors(0)
+{
+    if(m_Config.sDirectory.empty()) m_Config.sDirectory.assign(".");
+    if(m_Config.nChunkBytes < nIoAlignment)
+        m_Config.nChunkBytes = 1024 * 1024;
+    m_Config.nChunkBytes = AlignUp(m_Config.nChunkBytes);
+    if(m_Config.nChunks < 2) m_Config.nChunks = 2;
+    if(!m_Config.nFlushMillis) m_Config.nFlushMillis = 1000;
+    if(!m_Config.nIndexInterval) m_Config.nIndexInterval = 65536;
+
+    ::mkdir(m_Config.sDirectory.c_str(), 0755);
+
+    for(size_t i = 0; i < m_Config.nChunks; i++) {
+        uint8_t *p = static_cast<uint8_t *>(
+            ::aligned_alloc(nIoAlignment, m_Config.nChunkBytes));
+        m_vChunks.push_back(p);
+        m_vFreeChunks.push_back(p);
+    }
+
+    m_WriterThread = std::thread([this]() { WriterThread(); });
+}
+
+//
+// Destructor
+//
+ChannelRecorder::~ChannelRecorder()
+{
+    // Flush and close everything still being recorded
+    while(!m_mFiles.empty()) Close((*m_mFiles.begin()).first);
+
+    {
+        std::unique_lock<std::mutex>    lk(m_Lock);
+        m_bExit = true;
+    }
+    m_Signal.notify_one();
+    m_WriterThread.join();
+
+    for(auto p : m_vChunks) ::free(p);
+}
+
+//
+// Function used to close everything being recorded and wait for it all to
+// be written, so Stats() has the final counts.  Called from the socket
+// read thread, or once the client is gone.
+//
+void ChannelRecorder::Flush(void)
+{
+    while(!m_mFiles.empty()) Close((*m_mFiles.begin()).first);
+
+    std::unique_lock<std::mutex>    lk(m_Lock);
+    m_Idle.wait(lk, [this]() { return m_dRequests.empty() && !m_bWriting; });
+}
+
+//
+// Function used to turn a channel name into a file name
+//
+std::string ChannelRecorder::FileName(const std::string& sName,
+    const char *pszSuffix)
+{
+    std::string sFile;
+
+    for(char c : sName) {
+        if(::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '.' ||
+            c == '_')
+            sFile.push_back(c);
+        else
+            sFile.push_back('_');
+    }
+
+    return sFile + pszSuffix;
+}
+
+//
+// Function used to get the recorder counters
+//
+ChannelRecorderStats ChannelRecorder::Stats(void) const
+{
+    ChannelRecorderStats    s;
+
+    s.nChunksWritten = m_nChunksWritten.load(std::memory_order_relaxed);
+    s.nBytesWritten = m_nBytesWritten.load(std::memory_order_relaxed);
+    s.nDroppedSamples = m_nDroppedSamples.load(std::memory_order_relaxed);
+    s.nWriteErrors = m_nWriteErrors.load(std::memory_order_relaxed);
+
+    return s;
+}
+
+//
+// Function used to get a free chunk, nullptr if the writer is behind.  The
+// pool grows to one chunk per channel being recorded on top of the ones
+// configured, so channels never starve each other of chunks to fill.
+//
+uint8_t *ChannelRecorder::GetChunk(void)
+{
+    size_t  nLimit = m_Config.nChunks + m_mFiles.size();
+
+    std::unique_lock<std::mutex>    lk(m_Lock);
+
+    if(m_vFreeChunks.empty()) {
+        if(m_vChunks.size() >= nLimit) return nullptr;
+
+        uint8_t *p = static_cast<uint8_t *>(
+            ::aligned_alloc(nIoAlignment, m_Config.nChunkBytes));
+        if(p) m_vChunks.push_back(p);
+        return p;
+    }
+
+    uint8_t *p = m_vFreeChunks.back();
+    m_vFreeChunks.pop_back();
+    return p;
+}
+
+//
+// Function used to hand off a channel's part filled chunk so a slow channel
+// does not keep its samples from the disk.  O_DIRECT only writes whole
+// blocks, so the rest moves on to a new chunk.
+//
+void ChannelRecorder::FlushChunk(File *f)
+{
+    size_t  nWhole = m_Config.bDirectIo ?
+        f->nFill & ~(nIoAlignment - 1) : f->nFill;
+    if(!nWhole) return;
+
+    uint8_t *pNext = nullptr;
+    if(nWhole != f->nFill) {
+        pNext = GetChunk();
+        if(!pNext) return;
+        ::memcpy(pNext, f->pChunk + nWhole, f->nFill - nWhole);
+    }
+
+    Post(WRITE_CHUNK, f, f->pChunk, nWhole);
+    f->pChunk = pNext;
+    f->nFill -= nWhole;
+    f->tChunk = std::chrono::steady_clock::now();
+}
+
+//
+// Function used to hand a request to the writer thread
+//
+void ChannelRecorder::Post(RequestType nType, File *pFile, uint8_t *pChunk,
+    size_t nBytes, const RecordingIndexEntry *pEntry)
+{
+    Request r;
+
+    r.nType = nType;
+    r.pFile = pFile;
+    r.pChunk = pChunk;
+    r.nBytes = nBytes;
+    if(nType != WRITE_CHUNK && nType != WRITE_INDEX) r.Header = pFile->Header;
+    if(pEntry) r.Entry = *pEntry;
+
+    {
+        std::unique_lock<std::mutex>    lk(m_Lock);
+        m_dRequests.push_back(r);
+    }
+    m_Signal.notify_one();
+}
+
+//
+// Function used to stop recording a channel
+//
+void ChannelRecorder::Close(int nId)
+{
+    auto it = m_mFiles.find(nId);
+    if(it == m_mFiles.end()) return;
+
+    File    *f = (*it).second;
+    m_mFiles.erase(it);
+
+    // Anything in the current chunk goes along with the close
+    Post(CLOSE_FILE, f, f->pChunk, f->nFill);
+}
+
+//
+// Function used to account for samples that could not be recorded
+//
+void ChannelRecorder::Drop(File *f, size_t nSamples)
+{
+    f->Header.nDroppedSamples += nSamples;
+    m_nDroppedSamples.fetch_add(nSamples, std::memory_order_relaxed);
+
+    // The next sample recorded does not follow on from the last one
+    f->nSegmentSamples += nSamples;
+    f->bGapPending = true;
+}
+
+//
+// Function used to note that the next sample recorded starts a new segment
+//
+void ChannelRecorder::StartSegment(File *f, double dFirstSampleTimestamp)
+{
+    f->bSegmentPending = true;
+    f->dPendingTimestamp = dFirstSampleTimestamp;
+}
+
+//
+// Function used to add an index entry for the next sample to be recorded
+//
+void ChannelRecorder::AddIndexEntry(File *f, uint32_t nFlags)
+{
+    if(nFlags) {
+        if(nFlags & INDEX_FLAG_SEGMENT_START)
+            f->dSegmentTimestamp = f->dPendingTimestamp;
+        else
+            f->dSegmentTimestamp += static_cast<double>(f->nSegmentSamples) *
+                f->dSamplePeriod;
+
+        f->nSegment += f->bAnySegment ? 1 : 0;
+        f->bAnySegment = true;
+        f->nSegmentSamples = 0;
+        f->bSegmentPending = false;
+        f->bGapPending = false;
+    }
+
+    RecordingIndexEntry e;
+    e.nSample = f->Header.nSamples;
+    e.nFileOffset = RECORDING_HEADER_SIZE + e.nSample * sizeof(float);
+    e.dTimestamp = f->dSegmentTimestamp +
+        static_cast<double>(f->nSegmentSamples) * f->dSamplePeriod;
+    e.nFlags = nFlags;
+    e.nSegment = f->nSegment;
+
+    f->nNextIndexSample = e.nSample + m_Config.nIndexInterval;
+
+    Post(WRITE_INDEX, f, nullptr, 0, &e);
+}
+
+//
+// Function used to process events from the LowLatencyDataClient
+//
+void ChannelRecorder::HandleEvent(EventType nType, const void *p, size_t nSize)
+{
+    if(nType == EVENT_TYPE_CHANNEL_DATA) {
+        const ChannelDataInfo *cdi =
+            reinterpret_cast<const ChannelDataInfo *>(p);
+
+        auto it = m_mFiles.find(cdi->nId);
+        if(it == m_mFiles.end()) return;
+
+        File            *f = (*it).second;
+        const uint8_t   *pData =
+            reinterpret_cast<const uint8_t *>(cdi->pData);
+        size_t          nBytes = cdi->nSamples * sizeof(float);
+        bool            bIndexChecked = false;
+
+        if(f->nFill && std::chrono::steady_clock::now() - f->tChunk >=
+            std::chrono::milliseconds(m_Config.nFlushMillis))
+            FlushChunk(f);
+
+        while(nBytes) {
+            if(!f->pChunk) {
+                f->pChunk = GetChunk();
+                f->nFill = 0;
+                f->tChunk = std::chrono::steady_clock::now();
+
+                if(!f->pChunk) {
+                    // Writer is behind, drop rather than wait for the disk
+                    Drop(f, nBytes / sizeof(float));
+                    return;
+                }
+            }
+
+            if(!bIndexChecked) {
+                bIndexChecked = true;
+
+                if(f->bSegmentPending)
+                    AddIndexEntry(f, INDEX_FLAG_SEGMENT_START);
+                else if(f->bGapPending)
+                    AddIndexEntry(f, INDEX_FLAG_GAP);
+                else if(f->Header.nSamples >= f->nNextIndexSample)
+                    AddIndexEntry(f, 0);
+            }
+
+            size_t  n = std::min(nBytes, m_Config.nChunkBytes - f->nFill);
+            ::memcpy(f->pChunk + f->nFill, pData, n);
+            f->nFill += n;
+            f->Header.nSamples += n / sizeof(float);
+            f->nSegmentSamples += n / sizeof(float);
+            pData += n;
+            nBytes -= n;
+
+            if(f->nFill == m_Config.nChunkBytes) {
+                Post(WRITE_CHUNK, f, f->pChunk, f->nFill);
+                f->pChunk = nullptr;
+            }
+        }
+        return;
+    }
+
+    if(nType == EVENT_TYPE_CHANNEL_UNSUBSCRIBED) {
+        Close(reinterpret_cast<const ChannelUnsubscribedInfo *>(p)->nId);
+    }
+
+    m_Tracker.HandleEvent(nType, p, nSize);
+
+    if(nType == EVENT_TYPE_CHANNEL_SUBSCRIBED) {
+        const ChannelSubscribedInfo *csi =
+            reinterpret_cast<const ChannelSubscribedInfo *>(p);
+        const TrackedChannel *tc = m_Tracker.Find(csi->nId);
+        if(!tc) return;
+
+        // A re-subscribe under the same id starts a new file
+        Close(csi->nId);
+
+        File    *f = new File;
+        RecordingFileHeader& h = f->Header;
+
+        ::memset(&h, 0, sizeof(h));
+        ::strncpy(h.szMagic, RECORDING_MAGIC, sizeof(h.szMagic));
+        h.nVersion = RECORDING_VERSION;
+        h.nHeaderSize = RECORDING_HEADER_SIZE;
+        ::strncpy(h.szName, tc->ci.sName.c_str(), sizeof(h.szName) - 1);
+        ::strncpy(h.szDataType, tc->ci.sDataType.c_str(),
+            sizeof(h.szDataType) - 1);
+        h.dScale = tc->ci.dScale;
+        h.dOffset = tc->ci.dOffset;
+        h.dSamplePeriod = tc->ci.dSamplePeriod;
+        h.nDecimationFactor = tc->ci.nDecimationFactor;
+        h.nChannelId = tc->nId;
+        h.dFirstSampleTimestamp = 0.0;
+        f->dSamplePeriod = tc->dEffectiveSamplePeriod;
+
+        m_mFiles[csi->nId] = f;
+        Post(OPEN_FILE, f, nullptr, 0);
+
+    } else if(nType == EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS) {
+        const ChannelTimestampInfo *ctsi =
+            reinterpret_cast<const ChannelTimestampInfo *>(p);
+
+        auto it = m_mFiles.find(ctsi->nId);
+        if(it == m_mFiles.end()) return;
+
+        // The header keeps the first sample timestamp of the recording, a
+        // 0 only means acquisition stopped
+        File    *f = (*it).second;
+        if(f->Header.dFirstSampleTimestamp == 0.0 &&
+            ctsi->dFirstSampleTimestamp != 0.0) {
+            f->Header.dFirstSampleTimestamp = ctsi->dFirstSampleTimestamp;
+            Post(UPDATE_HEADER, f, nullptr, 0);
+        }
+
+        // Either way the samples that follow start a new segment
+        if(ctsi->dFirstSampleTimestamp == 0.0)
+            StartSegment(f, NAN);
+        else if(f->bSegmentPending ||
+            ctsi->dFirstSampleTimestamp != f->dSegmentTimestamp)
+            StartSegment(f, ctsi->dFirstSampleTimestamp);
+
+    } else if(nType == EVENT_TYPE_ACQUIRE) {
+        const bool  bState = *reinterpret_cast<const bool *>(p);
+
+        // Acquisition on/off are segment boundaries.  Keep a first sample
+        // timestamp that already arrived for the new segment.
+        for(auto& e : m_mFiles) {
+            File    *f = e.second;
+            if(!bState || !f->bSegmentPending) StartSegment(f, NAN);
+        }
+    }
+}
+
+//
+// Function used to write a header into the start of a file
+//
+void ChannelRecorder::WriteHeader(File *f, const RecordingFileHeader& h)
+{
+    if(f->fd < 0) return;
+
+    alignas(nIoAlignment) uint8_t   aHeader[RECORDING_HEADER_SIZE];
+
+    ::memset(aHeader, 0, sizeof(aHeader));
+    ::memcpy(aHeader, &h, sizeof(h));
+
+    if(::pwrite(f->fd, aHeader, sizeof(aHeader), 0) !=
+        static_cast<ssize_t>(sizeof(aHeader)))
+        m_nWriteErrors.fetch_add(1, std::memory_order_relaxed);
+}
+
+//
+// Function used to create a channel's file
+//
+void ChannelRecorder::Open(File *f, const RecordingFileHeader& h)
+{
+    std::string sBase = m_Config.sDirectory + "/" + FileName(h.szName, "-") +
+        std::to_string(h.nChannelId) + "-";
+    std::string sPath;
+    int         nFlags = O_WRONLY | O_CREAT | O_EXCL;
+
+    // Take the first <name>-<id>-<n>.llr that does not exist yet, earlier
+    // recordings of the channel are never overwritten
+    for(unsigned n = 0; ; n++) {
+        sPath = sBase + std::to_string(n) + ".llr";
+
+        f->bDirect = m_Config.bDirectIo;
+        f->fd = ::open(sPath.c_str(), nFlags | (f->bDirect ? O_DIRECT : 0),
+            0644);
+
+        // Not every file system does O_DIRECT
+        if(f->fd < 0 && f->bDirect && errno == EINVAL) {
+            f->bDirect = false;
+            f->fd = ::open(sPath.c_str(), nFlags, 0644);
+        }
+
+        if(f->fd >= 0 || errno != EEXIST) break;
+    }
+
+    if(f->fd < 0) {
+        std::cerr << "Unable to create " << sPath << ": " <<
+            ::strerror(errno) << std::endl;
+        m_nWriteErrors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    WriteHeader(f, h);
+
+    // The index is small and written a little at a time, so no O_DIRECT
+    std::string sIndexPath = sPath.substr(0, sPath.size() - 4) + ".lli";
+
+    f->fdIndex = ::open(sIndexPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+        0644);
+    if(f->fdIndex < 0) {
+        std::cerr << "Unable to create " << sIndexPath << ": " <<
+            ::strerror(errno) << std::endl;
+        m_nWriteErrors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    RecordingIndexHeader    ih;
+    ::memset(&ih, 0, sizeof(ih));
+    ::strncpy(ih.szMagic, RECORDING_INDEX_MAGIC, sizeof(ih.szMagic));
+    ih.nVersion = RECORDING_INDEX_VERSION;
+    ih.nEntrySize = sizeof(RecordingIndexEntry);
+    ih.nInterval = m_Config.nIndexInterval;
+    ih.dSamplePeriod = h.dSamplePeriod * h.nDecimationFactor;
+
+    if(::write(f->fdIndex, &ih, sizeof(ih)) != sizeof(ih))
+        m_nWriteErrors.fetch_add(1, std::memory_order_relaxed);
+}
+
+//
+// Function used to add an entry to the end of a channel's index file
+//
+void ChannelRecorder::WriteIndex(File *f, const RecordingIndexEntry& e)
+{
+    if(f->fdIndex < 0) return;
+
+    if(::write(f->fdIndex, &e, sizeof(e)) != sizeof(e))
+        m_nWriteErrors.fetch_add(1, std::memory_order_relaxed);
+}
+
+//
+// Function used to write a chunk at the end of a channel's file
+//
+void ChannelRecorder::Write(File *f, uint8_t *pChunk, size_t nBytes)
+{
+    if(f->fd < 0 || !nBytes) return;
+
+    // Keep space reserved ahead of the writes so the file system does not
+    // have to allocate on every write
+    if(m_Config.nPreallocateBytes && f->nOffset + nBytes > f->nReserved) {
+        f->nReserved = f->nOffset + std::max(nBytes,
+            AlignUp(m_Config.nPreallocateBytes));
+        ::fallocate(f->fd, FALLOC_FL_KEEP_SIZE, f->nOffset,
+            f->nReserved - f->nOffset);
+    }
+
+    // O_DIRECT needs whole blocks, a short last chunk gets padded and the
+    // file truncated to size when it is closed
+    size_t  nWrite = nBytes;
+    if(f->bDirect && (nWrite & (nIoAlignment - 1))) {
+        nWrite = AlignUp(nBytes);
+        ::memset(pChunk + nBytes, 0, nWrite - nBytes);
+    }
+
+    ssize_t nWritten = ::pwrite(f->fd, pChunk, nWrite, f->nOffset);
+
+    if(nWritten < 0 && f->bDirect && errno == EINVAL) {
+        // File system refused O_DIRECT after all, carry on buffered
+        f->bDirect = false;
+        ::fcntl(f->fd, F_SETFL, ::fcntl(f->fd, F_GETFL) & ~O_DIRECT);
+        nWritten = ::pwrite(f->fd, pChunk, nBytes, f->nOffset);
+    }
+
+    if(nWritten < static_cast<ssize_t>(nBytes)) {
+        m_nWriteErrors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    f->nOffset += nBytes;
+    m_nChunksWritten.fetch_add(1, std::memory_order_relaxed);
+    m_nBytesWritten.fetch_add(nBytes, std::memory_order_relaxed);
+}
+
+//
+// Function used to finish off a channel's file
+//
+void ChannelRecorder::Finish(File *f, const RecordingFileHeader& h)
+{
+    if(f->fd < 0) return;
+
+    WriteHeader(f, h);
+
+    // Drop any padding and unused preallocated space
+    if(::ftruncate(f->fd, f->nOffset) < 0)
+        m_nWriteErrors.fetch_add(1, std::memory_order_relaxed);
+
+    ::close(f->fd);
+    f->fd = -1;
+
+    if(f->fdIndex >= 0) {
+        ::close(f->fdIndex);
+        f->fdIndex = -1;
+    }
+}
+
+//
+// Thread used to do all of the file writes
+//
+void ChannelRecorder::WriterThread(void)
+{
+    while(true) {
+        Request r;
+
+        {
+            std::unique_lock<std::mutex>    lk(m_Lock);
+            m_Signal.wait(lk, [this]() {
+                return m_bExit || !m_dRequests.empty();
+            });
+
+            if(m_dRequests.empty()) break;
+
+            r = m_dRequests.front();
+            m_dRequests.pop_front();
+            m_bWriting = true;
+        }
+
+        switch(r.nType) {
+            case OPEN_FILE:
+                Open(r.pFile, r.Header);
+                break;
+
+            case WRITE_CHUNK:
+                Write(r.pFile, r.pChunk, r.nBytes);
+                break;
+
+            case WRITE_INDEX:
+                WriteIndex(r.pFile, r.Entry);
+                break;
+
+            case UPDATE_HEADER:
+                WriteHeader(r.pFile, r.Header);
+                break;
+
+            case CLOSE_FILE:
+                if(r.pChunk) Write(r.pFile, r.pChunk, r.nBytes);
+                Finish(r.pFile, r.Header);
+                delete r.pFile;
+                break;
+        }
+
+        // Give the chunk back for the socket thread to fill again
+        {
+            std::unique_lock<std::mutex>    lk(m_Lock);
+            if(r.pChunk) m_vFreeChunks.push_back(r.pChunk);
+            m_bWriting = false;
+        }
+        m_Idle.notify_all();
+    }
+}
+
+#endif
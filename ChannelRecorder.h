@@ -0,0 +1,193 @@
+#ifndef __CHANNELRECORDER_H__
+#define __CHANNELRECORDER_H__
+
+#if defined(__linux__)
+
+#include    <atomic>
+#include    <condition_variable>
+#include    <deque>
+#include    <map>
+#include    <mutex>
+#include    <string>
+#include    <thread>
+#include    <vector>
+#include    "ChannelTracker.h"
+
+#define RECORDING_MAGIC         "LLREC01"
+#define RECORDING_VERSION       1
+#define RECORDING_HEADER_SIZE   4096
+
+#define RECORDING_INDEX_MAGIC   "LLIDX01"
+#define RECORDING_INDEX_VERSION 1
+
+#define INDEX_FLAG_SEGMENT_START    0x1     // Acquisition (re)started here
+#define INDEX_FLAG_GAP              0x2     // Samples before this were lost
+
+//
+// Definition of the header at the start of every per channel recording
+// file.  The header is padded out to RECORDING_HEADER_SIZE and is followed by
+// the channel's raw float samples exactly as received from the server.
+//
+// NOTE:  All fields are in host byte order
+//
+typedef struct {
+    char        szMagic[8];             // RECORDING_MAGIC
+    uint32_t    nVersion;               // RECORDING_VERSION
+    uint32_t    nHeaderSize;            // Offset of the first sample
+    char        szName[256];            // From server "available"
+    char        szDataType[32];         // From server "available"
+    double      dScale;                 // From server "available"
+    double      dOffset;                // From server "available"
+    double      dSamplePeriod;          // From server "available"
+    uint32_t    nDecimationFactor;      // From subscribe
+    int32_t     nChannelId;             // Subscribed ID when recorded
+    double      dFirstSampleTimestamp;  // From server "subscribed"
+    uint64_t    nSamples;               // Samples in the file
+    uint64_t    nDroppedSamples;        // Samples lost to a full pool
+} RecordingFileHeader;
+
+//
+// Definition of the header at the start of every per channel index file
+// (.lli).  It is followed by RecordingIndexEntry's in sample order.
+//
+typedef struct {
+    char        szMagic[8];             // RECORDING_INDEX_MAGIC
+    uint32_t    nVersion;               // RECORDING_INDEX_VERSION
+    uint32_t    nEntrySize;             // sizeof(RecordingIndexEntry)
+    uint64_t    nInterval;              // Samples between periodic entries
+    double      dSamplePeriod;          // Period of the recorded samples
+    uint8_t     aReserved[32];
+} RecordingIndexHeader;
+
+//
+// Definition of an index entry.  Entries are written every nInterval samples
+// and at every segment boundary.  A segment starts whenever acquisition
+// (re)starts or samples were lost, i.e. whenever the timestamps of the
+// samples stop following on from the ones before.  Within a segment the
+// timestamp of sample n is dTimestamp + (n - nSample) * dSamplePeriod.
+//
+typedef struct {
+    uint64_t    nSample;                // Sample number in the data file
+    uint64_t    nFileOffset;            // Offset of the sample in the file
+    double      dTimestamp;             // Timestamp of the sample, NaN if
+                                        // no first sample timestamp known
+    uint32_t    nFlags;                 // INDEX_FLAG_*
+    uint32_t    nSegment;               // Segment number
+} RecordingIndexEntry;
+
+//
+// Definition of the recorder settings
+//
+typedef struct {
+    std::string sDirectory;             // Where the files are created
+    size_t      nChunkBytes;            // Size of each hand off buffer
+    size_t      nChunks;                // Hand off buffers shared by all
+    unsigned    nFlushMillis;           // Hand off part filled after (1000)
+    size_t      nPreallocateBytes;      // File space reserved at a time
+    bool        bDirectIo;              // Use O_DIRECT when possible
+    uint64_t    nIndexInterval;         // Samples between index entries
+} ChannelRecorderConfig;
+
+//
+// Definition of recorder counters
+//
+typedef struct {
+    uint64_t    nChunksWritten;
+    uint64_t    nBytesWritten;
+    uint64_t    nDroppedSamples;
+    uint64_t    nWriteErrors;
+} ChannelRecorderStats;
+
+//
+// Definition of the recorder sink.
+//
+// HandleEvent() runs on the socket read thread.  It only copies each data
+// block into the channel's current chunk; full chunks, and chunks part
+// filled for nFlushMillis, are handed off to a dedicated writer thread which
+// does large aligned writes into one append only file per channel.  The
+// pool grows to nChunks plus one chunk per channel being recorded so every
+// channel can always be filling one.  If the writer falls so far behind
+// that no free chunk is left the data is dropped and counted rather than
+// making the socket thread wait on the disk.
+//
+// Each subscription is recorded to <name>-<id>-<n>.llr, n being the first
+// number not already taken in the directory, so nothing is overwritten.
+// Next to each data file a sparse time index (.lli) is written so a
+// CaptureReader can find any timestamp with a binary search.
+//
+class ChannelRecorder {
+    public:
+        explicit ChannelRecorder(const ChannelRecorderConfig&);
+        ~ChannelRecorder();
+
+        ChannelRecorder(const ChannelRecorder&) = delete;
+        ChannelRecorder& operator=(const ChannelRecorder&) = delete;
+
+        void HandleEvent(EventType, const void *, size_t);
+        void Flush(void);
+
+        ChannelRecorderStats Stats(void) const;
+
+        static std::string FileName(const std::string& sName,
+            const char *pszSuffix = ".llr");
+
+    private:
+        struct File;
+
+        typedef enum {
+            OPEN_FILE,
+            WRITE_CHUNK,
+            WRITE_INDEX,
+            UPDATE_HEADER,
+            CLOSE_FILE,
+        } RequestType;
+
+        typedef struct {
+            RequestType         nType;
+            File                *pFile;
+            uint8_t             *pChunk;
+            size_t              nBytes;
+            RecordingFileHeader Header;     // OPEN, UPDATE and CLOSE only
+            RecordingIndexEntry Entry;      // WRITE_INDEX only
+        } Request;
+
+        uint8_t *GetChunk(void);
+        void FlushChunk(File *);
+        void Post(RequestType, File *, uint8_t *, size_t,
+            const RecordingIndexEntry *pEntry = nullptr);
+        void Close(int nId);
+        void Drop(File *, size_t nSamples);
+        void AddIndexEntry(File *, uint32_t nFlags);
+        void StartSegment(File *, double dFirstSampleTimestamp);
+
+        void WriterThread(void);
+        void Open(File *, const RecordingFileHeader&);
+        void WriteHeader(File *, const RecordingFileHeader&);
+        void WriteIndex(File *, const RecordingIndexEntry&);
+        void Write(File *, uint8_t *, size_t);
+        void Finish(File *, const RecordingFileHeader&);
+
+        ChannelRecorderConfig       m_Config;
+        ChannelTracker              m_Tracker;
+
+        std::map<int, File *>       m_mFiles;       // Socket thread only
+
+        std::vector<uint8_t *>      m_vChunks;      // All chunks
+        std::vector<uint8_t *>      m_vFreeChunks;
+        std::deque<Request>         m_dRequests;
+        std::mutex                  m_Lock;
+        std::condition_variable     m_Signal;
+        std::condition_variable     m_Idle;         // Nothing left to write
+        bool                        m_bWriting;     // A request taken
+        bool                        m_bExit;
+        std::thread                 m_WriterThread;
+
+        std::atomic<uint64_t>       m_nChunksWritten;
+        std::atomic<uint64_t>       m_nBytesWritten;
+        std::atomic<uint64_t>       m_nDroppedSamples;
+        std::atomic<uint64_t>       m_nWriteErrors;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,236 @@
+#include "ChannelTracker.h"
+#include <cmath>
+#include <vector>
+
+//
+// Function used to update the tracked channel information from an event
+//
+void ChannelTracker::HandleEvent(EventType nType, const void *p, size_t nSize)
+{
+    switch(nType) {
+        case EVENT_TYPE_AVAILABLE_CHANNEL: {
+            const ChannelInfo *ci = reinterpret_cast<const ChannelInfo *>(p);
+            m_mAvailableChannels[ci->sName] = *ci;
+            break;
+        }
+
+        case EVENT_TYPE_UNAVAILABLE_CHANNEL: {
+            const ChannelUnavailableInfo *cuai =
+                reinterpret_cast<const ChannelUnavailableInfo *>(p);
+            m_mAvailableChannels.erase(cuai->sName);
+            break;
+        }
+
+        case EVENT_TYPE_CHANNEL_SUBSCRIBED: {
+            const ChannelSubscribedInfo *csi =
+                reinterpret_cast<const ChannelSubscribedInfo *>(p);
+
+            TrackedChannel  tc;
+            auto it = m_mAvailableChannels.find(csi->sName);
+            if(it != m_mAvailableChannels.end()) tc.ci = (*it).second;
+            else {
+                tc.ci.sName = csi->sName;
+                tc.ci.hChannel = csi->hChannel;
+                tc.ci.dScale = 1.0;
+                tc.ci.dOffset = 0.0;
+                tc.ci.dSamplePeriod = NAN;
+            }
+            tc.ci.nDecimationFactor =
+                csi->nDecimationFactor ? csi->nDecimationFactor : 1;
+            tc.nId = csi->nId;
+            tc.dFirstSampleTimestamp = NAN;
+            tc.dEffectiveSamplePeriod =
+                tc.ci.dSamplePeriod * tc.ci.nDecimationFactor;
+
+            m_mSubscribedChannels[csi->nId] = tc;
+            break;
+        }
+
+        case EVENT_TYPE_CHANNEL_UNSUBSCRIBED: {
+            const ChannelUnsubscribedInfo *cui =
+                reinterpret_cast<const ChannelUnsubscribedInfo *>(p);
+            m_mSubscribedChannels.erase(cui->nId);
+            break;
+        }
+
+        case EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS: {
+            const ChannelTimestampInfo *ctsi =
+                reinterpret_cast<const ChannelTimestampInfo *>(p);
+            auto it = m_mSubscribedChannels.find(ctsi->nId);
+            if(it != m_mSubscribedChannels.end())
+                (*it).second.dFirstSampleTimestamp =
+                    ctsi->dFirstSampleTimestamp;
+            break;
+        }
+
+        case EVENT_TYPE_ACQUIRE:
+            m_bAcquisitionState = *reinterpret_cast<const bool *>(p);
+            break;
+
+        default:
+            break;
+    }
+}
+
+//
+// Function used to find a subscribed channel by id
+//
+const TrackedChannel *ChannelTracker::Find(int nId) const
+{
+    auto it = m_mSubscribedChannels.find(nId);
+    return it == m_mSubscribedChannels.end() ? nullptr : &(*it).second;
+}
+
+//
+// Function used to find an available channel by name
+//
+const ChannelInfo *ChannelTracker::FindAvailable(const std::string& sName) const
+{
+    auto it = m_mAvailableChannels.find(sName);
+    return it == m_mAvailableChannels.end() ? nullptr : &(*it).second;
+}
+
+//
+// Function used to describe everything tracked as JSON, so a consumer that
+// starts late can be brought up to date with ApplySnapshot()
+//
+json ChannelTracker::Snapshot(void) const
+{
+    json    j;
+
+    j["available"] = json::array();
+    for(auto& e : m_mAvailableChannels) {
+        json    jc;
+        jc["name"] = e.second.sName;
+        jc["data_type"] = e.second.sDataType;
+        jc["scale"] = e.second.dScale;
+        jc["offset"] = e.second.dOffset;
+        jc["sample_period"] = e.second.dSamplePeriod;
+        j["available"].push_back(jc);
+    }
+
+    j["subscribed"] = json::array();
+    for(auto& e : m_mSubscribedChannels) {
+        json    jc;
+        jc["name"] = e.second.ci.sName;
+        jc["id"] = e.first;
+        jc["decimation"] = e.second.ci.nDecimationFactor;
+        if(!std::isnan(e.second.dFirstSampleTimestamp))
+            jc["first_sample_timestamp"] = e.second.dFirstSampleTimestamp;
+        j["subscribed"].push_back(jc);
+    }
+
+    j["acquiring"] = m_bAcquisitionState;
+
+    return j;
+}
+
+//
+// Function used to take a Snapshot() apart.  Throws if it is malformed.
+//
+TrackerSnapshot ChannelTracker::ParseSnapshot(const json& j)
+{
+    TrackerSnapshot ts;
+
+    for(auto& e : j.at("available")) {
+        ChannelInfo ci;
+        ci.sName = e.at("name");
+        ci.hChannel = ChannelNames::Intern(ci.sName);
+        ci.sDataType = e.at("data_type");
+        ci.dScale = e.at("scale");
+        ci.dOffset = e.at("offset");
+        ci.dSamplePeriod = e.at("sample_period");
+        ci.nDecimationFactor = 1;
+        ts.mAvailable[ci.sName] = ci;
+    }
+
+    for(auto& e : j.at("subscribed")) {
+        TrackedChannel  tc;
+        tc.ci.sName = e.at("name");
+        tc.ci.hChannel = ChannelNames::Intern(tc.ci.sName);
+        tc.ci.nDecimationFactor = e.at("decimation");
+        tc.nId = e.at("id");
+        tc.dFirstSampleTimestamp = e.contains("first_sample_timestamp") ?
+            e.at("first_sample_timestamp").get<double>() : NAN;
+        tc.dEffectiveSamplePeriod = NAN;
+        ts.mSubscribed[tc.nId] = tc;
+    }
+
+    ts.bAcquiring = j.at("acquiring");
+
+    return ts;
+}
+
+//
+// Function used to bring the tracked state in line with a parsed
+// Snapshot(), passing each event that takes on to fCb as well
+//
+void ChannelTracker::ApplySnapshot(const TrackerSnapshot& ts,
+    const EventHandler& fCb)
+{
+    auto    Deliver = [this, &fCb](EventType nType, const void *p, size_t n) {
+        HandleEvent(nType, p, n);
+        fCb(nType, p, n);
+    };
+
+    // Channels that went away while we were not looking
+    std::vector<int>    vGone;
+    for(auto& e : m_mSubscribedChannels) {
+        auto    it = ts.mSubscribed.find(e.first);
+        if(it == ts.mSubscribed.end() ||
+            (*it).second.ci.sName != e.second.ci.sName)
+            vGone.push_back(e.first);
+    }
+    for(int nId : vGone) {
+        ChannelUnsubscribedInfo cui;
+        cui.hChannel = m_mSubscribedChannels[nId].ci.hChannel;
+        cui.nId = nId;
+        Deliver(EVENT_TYPE_CHANNEL_UNSUBSCRIBED, &cui, sizeof(cui));
+    }
+
+    std::vector<ChannelUnavailableInfo> vUnavailable;
+    for(auto& e : m_mAvailableChannels) {
+        if(ts.mAvailable.find(e.first) != ts.mAvailable.end()) continue;
+
+        ChannelUnavailableInfo  cuai;
+        cuai.sName = e.first;
+        cuai.hChannel = e.second.hChannel;
+        vUnavailable.push_back(cuai);
+    }
+    for(auto& cuai : vUnavailable)
+        Deliver(EVENT_TYPE_UNAVAILABLE_CHANNEL, &cuai, sizeof(cuai));
+
+    // Channels we have not heard of
+    for(auto& e : ts.mAvailable)
+        if(!FindAvailable(e.first))
+            Deliver(EVENT_TYPE_AVAILABLE_CHANNEL, &e.second, sizeof(e.second));
+
+    for(auto& e : ts.mSubscribed) {
+        const TrackedChannel    *tc = Find(e.first);
+
+        if(!tc) {
+            ChannelSubscribedInfo   csi;
+            csi.sName = e.second.ci.sName;
+            csi.hChannel = e.second.ci.hChannel;
+            csi.nId = e.first;
+            csi.nDecimationFactor = e.second.ci.nDecimationFactor;
+            Deliver(EVENT_TYPE_CHANNEL_SUBSCRIBED, &csi, sizeof(csi));
+            tc = Find(e.first);
+        }
+
+        double  dFsts = e.second.dFirstSampleTimestamp;
+        if(std::isnan(dFsts)) continue;
+        if(tc && tc->dFirstSampleTimestamp == dFsts) continue;
+
+        ChannelTimestampInfo    ctsi;
+        ctsi.sName = e.second.ci.sName;
+        ctsi.hChannel = e.second.ci.hChannel;
+        ctsi.nId = e.first;
+        ctsi.dFirstSampleTimestamp = dFsts;
+        Deliver(EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS, &ctsi, sizeof(ctsi));
+    }
+
+    bool    bState = ts.bAcquiring;
+    if(bState != m_bAcquisitionState)
+        Deliver(EVENT_TYPE_ACQUIRE, &bState, sizeof(bState));
+}
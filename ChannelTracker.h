@@ -0,0 +1,64 @@
+#ifndef __CHANNELTRACKER_H__
+#define __CHANNELTRACKER_H__
+
+#include    <map>
+#include    <string>
+#include    "LowLatencyDataClient.h"
+
+//
+// Definition of what is known about a subscribed channel, built up from the
+// events a LowLatencyDataClient delivers
+//
+typedef struct {
+    ChannelInfo     ci;                     // Available info + decimation
+    int             nId;                    // Subscribed ID of the channel
+    double          dFirstSampleTimestamp;  // Timestamp of first sample (s)
+    double          dEffectiveSamplePeriod; // dSamplePeriod * decimation
+} TrackedChannel;
+
+//
+// Definition of a Snapshot() taken apart, ready to be applied.  Subscribed
+// channels with no first sample timestamp have NaN.
+//
+typedef struct {
+    std::map<std::string, ChannelInfo>  mAvailable;
+    std::map<int, TrackedChannel>       mSubscribed;
+    bool                                bAcquiring;
+} TrackerSnapshot;
+
+//
+// Definition of a class that follows the EVENT_TYPE_* sequence and keeps the
+// per channel metadata that data consumers (history, recorders, ...) need but
+// which is not carried in a ChannelDataInfo.
+//
+// NOTE:  Like the event handler itself, this is only meant to be driven from
+//        the thread delivering the events.
+//
+class ChannelTracker {
+    public:
+        void HandleEvent(EventType, const void *, size_t);
+
+        const TrackedChannel *Find(int nId) const;
+        const ChannelInfo *FindAvailable(const std::string&) const;
+
+        const std::map<int, TrackedChannel>& Subscribed(void) const {
+            return m_mSubscribedChannels;
+        }
+
+        const std::map<std::string, ChannelInfo>& Available(void) const {
+            return m_mAvailableChannels;
+        }
+
+        bool AcquisitionState(void) const { return m_bAcquisitionState; }
+
+        json Snapshot(void) const;
+        static TrackerSnapshot ParseSnapshot(const json&);
+        void ApplySnapshot(const TrackerSnapshot&, const EventHandler&);
+
+    private:
+        std::map<std::string, ChannelInfo>  m_mAvailableChannels;
+        std::map<int, TrackedChannel>       m_mSubscribedChannels;
+        bool                                m_bAcquisitionState = false;
+};
+
+#endif
@@ -0,0 +1,278 @@
+#include "ClientMetrics.h"
+
+//
+// Function used to clear a counter
+//
+static inline void Zero(std::atomic<uint64_t>& n)
+{
+    n.store(0, std::memory_order_relaxed);
+}
+
+//
+// Constructor
+//
+ClientMetrics::ClientMetrics()
+    : m_tStart(std::chrono::steady_clock::now())
+{
+    Zero(m_Reader.nBytes);
+    Zero(m_Reader.nPackets);
+    Zero(m_Reader.nDataPackets);
+    Zero(m_Reader.nIgnoredPackets);
+    Zero(m_Reader.nFramingErrors);
+    Zero(m_Reader.nGaps);
+    Zero(m_Reader.nMissingSamples);
+    Zero(m_Reader.nOverlaps);
+    Zero(m_Reader.nRepeatedSamples);
+    Zero(m_Reader.nCallbacks);
+    Zero(m_Reader.nTimedCallbacks);
+    Zero(m_Reader.nCallbackNs);
+    for(auto& n : m_Reader.nMetadata) Zero(n);
+
+    Zero(m_Sender.nSendFailures);
+}
+
+//
+// Function used to clear the counters of a channel
+//
+void ClientMetrics::ZeroChannel(ChannelCounters& c)
+{
+    Zero(c.nPackets);
+    Zero(c.nSamples);
+    Zero(c.nGaps);
+    Zero(c.nMissingSamples);
+    Zero(c.nOverlaps);
+    Zero(c.nRepeatedSamples);
+}
+
+//
+// Function used to start counting a newly subscribed channel, making
+// counters for its id if it is the highest yet.  Called from the socket
+// read thread.
+//
+void ClientMetrics::Subscribed(int nId, const std::string& sName)
+{
+    if(nId < 0) return;
+
+    std::unique_lock<std::mutex>    lk(m_Lock);
+
+    while(m_vChannels.size() <= static_cast<size_t>(nId)) {
+        m_vChannels.push_back(std::make_unique<ChannelCounters>());
+        ZeroChannel(*m_vChannels.back());
+    }
+    if(m_vNames.size() < m_vChannels.size())
+        m_vNames.resize(m_vChannels.size());
+
+    ZeroChannel(*m_vChannels[nId]);
+    m_vNames[nId] = sName;
+}
+
+//
+// Function used to stop reporting an unsubscribed channel
+//
+void ClientMetrics::Unsubscribed(int nId)
+{
+    std::unique_lock<std::mutex>    lk(m_Lock);
+
+    if(nId < 0 || static_cast<size_t>(nId) >= m_vNames.size()) return;
+    m_vNames[nId].clear();
+}
+
+//
+// Function used to take the counters
+//
+ClientMetricsSnapshot ClientMetrics::Snapshot(void) const
+{
+    ClientMetricsSnapshot   s;
+    const auto              r = std::memory_order_relaxed;
+
+    s.nTimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - m_tStart).count();
+    s.nBytes = m_Reader.nBytes.load(r);
+    s.nPackets = m_Reader.nPackets.load(r);
+    s.nDataPackets = m_Reader.nDataPackets.load(r);
+    s.nIgnoredPackets = m_Reader.nIgnoredPackets.load(r);
+    s.nFramingErrors = m_Reader.nFramingErrors.load(r);
+    s.nGaps = m_Reader.nGaps.load(r);
+    s.nMissingSamples = m_Reader.nMissingSamples.load(r);
+    s.nOverlaps = m_Reader.nOverlaps.load(r);
+    s.nRepeatedSamples = m_Reader.nRepeatedSamples.load(r);
+    s.nCallbacks = m_Reader.nCallbacks.load(r);
+    s.nTimedCallbacks = m_Reader.nTimedCallbacks.load(r);
+    s.nCallbackNs = m_Reader.nCallbackNs.load(r);
+    for(int i = 0; i < METADATA_TYPES; i++)
+        s.nMetadata[i] = m_Reader.nMetadata[i].load(r);
+    s.nSendFailures = m_Sender.nSendFailures.load(r);
+    s.nReceiveQueueBytes = 0;
+    s.nReceiveBufferBytes = 0;
+
+    std::unique_lock<std::mutex>    lk(m_Lock);
+
+    for(size_t nId = 0; nId < m_vNames.size(); nId++) {
+        if(m_vNames[nId].empty()) continue;
+
+        const ChannelCounters&  cc = *m_vChannels[nId];
+        ChannelMetrics          c;
+        c.nId = static_cast<int>(nId);
+        c.sName = m_vNames[nId];
+        c.nPackets = cc.nPackets.load(r);
+        c.nSamples = cc.nSamples.load(r);
+        c.nGaps = cc.nGaps.load(r);
+        c.nMissingSamples = cc.nMissingSamples.load(r);
+        c.nOverlaps = cc.nOverlaps.load(r);
+        c.nRepeatedSamples = cc.nRepeatedSamples.load(r);
+        s.vChannels.push_back(c);
+    }
+
+    return s;
+}
+
+//
+// Function used to get the label value of a metadata type
+//
+const char *ClientMetrics::MetadataTypeName(MetadataType n)
+{
+    switch(n) {
+        case METADATA_TYPE_AVAILABLE:           return "available";
+        case METADATA_TYPE_UNAVAILABLE:         return "unavailable";
+        case METADATA_TYPE_SUBSCRIBED:          return "subscribed";
+        case METADATA_TYPE_UNSUBSCRIBED:        return "unsubscribed";
+        case METADATA_TYPE_ACQUISITION_STATE:   return "acquisition_state";
+        case METADATA_TYPE_STATUS:              return "status";
+        case METADATA_TYPE_UNKNOWN:             return "unknown";
+        case METADATA_TYPE_PARSE_ERROR:         return "parse_error";
+        default:                                return "other";
+    }
+}
+
+//
+// Function used to quote a label value
+//
+static std::string Label(const std::string& s)
+{
+    std::string str("\"");
+
+    for(char c : s) {
+        if(c == '\\' || c == '"') str.push_back('\\');
+        if(c == '\n') str.append("\\n");
+        else str.push_back(c);
+    }
+    str.push_back('"');
+
+    return str;
+}
+
+//
+// Function used to add the help and type lines of a metric
+//
+static void Describe(std::string& str, const char *pszName,
+    const char *pszType, const char *pszHelp)
+{
+    str.append("# HELP ").append(pszName).append(" ").append(pszHelp);
+    str.append("\n# TYPE ").append(pszName).append(" ").append(pszType);
+    str.append("\n");
+}
+
+//
+// Functions used to add a metric with a single value
+//
+static void Metric(std::string& str, const char *pszName,
+    const char *pszType, const char *pszHelp, uint64_t nValue)
+{
+    Describe(str, pszName, pszType, pszHelp);
+    str.append(pszName).append(" ").append(std::to_string(nValue));
+    str.append("\n");
+}
+
+static void Metric(std::string& str, const char *pszName,
+    const char *pszType, const char *pszHelp, double dValue)
+{
+    Describe(str, pszName, pszType, pszHelp);
+    str.append(pszName).append(" ").append(std::to_string(dValue));
+    str.append("\n");
+}
+
+//
+// Function used to add a counter with a value for each subscribed channel
+//
+static void ChannelMetric(std::string& str, const char *pszName,
+    const char *pszHelp, const std::vector<ChannelMetrics>& vChannels,
+    uint64_t ChannelMetrics::*pnValue)
+{
+    Describe(str, pszName, "counter", pszHelp);
+    for(auto& c : vChannels) {
+        str.append(pszName).append("{id=\"");
+        str.append(std::to_string(c.nId)).append("\",channel=");
+        str.append(Label(c.sName)).append("} ");
+        str.append(std::to_string(c.*pnValue)).append("\n");
+    }
+}
+
+//
+// Function used to write a snapshot in the Prometheus text exposition
+// format
+//
+void ClientMetrics::Prometheus(const ClientMetricsSnapshot& s,
+    std::string& str)
+{
+    Metric(str, "ll_client_uptime_seconds", "gauge",
+        "Seconds since the client started", s.nTimeNs / 1e9);
+    Metric(str, "ll_client_received_bytes_total", "counter",
+        "Bytes read from the server", s.nBytes);
+    Metric(str, "ll_client_received_packets_total", "counter",
+        "Packets read from the server", s.nPackets);
+    Metric(str, "ll_client_data_packets_total", "counter",
+        "Data packets delivered to the event handler", s.nDataPackets);
+    Metric(str, "ll_client_ignored_packets_total", "counter",
+        "Data packets for channels not subscribed", s.nIgnoredPackets);
+
+    Describe(str, "ll_client_metadata_messages_total", "counter",
+        "Metadata messages read, by type");
+    for(int i = 0; i < METADATA_TYPES; i++) {
+        str.append("ll_client_metadata_messages_total{type=\"");
+        str.append(MetadataTypeName(static_cast<MetadataType>(i)));
+        str.append("\"} ").append(std::to_string(s.nMetadata[i]));
+        str.append("\n");
+    }
+
+    Metric(str, "ll_client_framing_errors_total", "counter",
+        "Packets with a bad id or length", s.nFramingErrors);
+    Metric(str, "ll_client_gaps_total", "counter",
+        "Times samples went missing, all channels", s.nGaps);
+    Metric(str, "ll_client_missing_samples_total", "counter",
+        "Samples that went missing, all channels", s.nMissingSamples);
+    Metric(str, "ll_client_overlaps_total", "counter",
+        "Times samples came twice, all channels", s.nOverlaps);
+    Metric(str, "ll_client_repeated_samples_total", "counter",
+        "Samples that came twice, all channels", s.nRepeatedSamples);
+    Metric(str, "ll_client_send_failures_total", "counter",
+        "Commands that could not be sent", s.nSendFailures);
+    Metric(str, "ll_client_callbacks_total", "counter",
+        "Event handler calls", s.nCallbacks);
+    Metric(str, "ll_client_timed_callbacks_total", "counter",
+        "Event handler calls timed, a sample of them", s.nTimedCallbacks);
+    Metric(str, "ll_client_timed_callback_seconds_total", "counter",
+        "Time spent in the event handler calls timed", s.nCallbackNs / 1e9);
+    Metric(str, "ll_client_receive_queue_bytes", "gauge",
+        "Bytes received by the kernel not yet read", s.nReceiveQueueBytes);
+    Metric(str, "ll_client_receive_buffer_bytes", "gauge",
+        "Size of the buffer packets are read into", s.nReceiveBufferBytes);
+
+    ChannelMetric(str, "ll_client_channel_packets_total",
+        "Data packets of a subscribed channel", s.vChannels,
+        &ChannelMetrics::nPackets);
+    ChannelMetric(str, "ll_client_channel_samples_total",
+        "Samples of a subscribed channel", s.vChannels,
+        &ChannelMetrics::nSamples);
+    ChannelMetric(str, "ll_client_channel_gaps_total",
+        "Times samples of a subscribed channel went missing", s.vChannels,
+        &ChannelMetrics::nGaps);
+    ChannelMetric(str, "ll_client_channel_missing_samples_total",
+        "Samples of a subscribed channel that went missing", s.vChannels,
+        &ChannelMetrics::nMissingSamples);
+    ChannelMetric(str, "ll_client_channel_overlaps_total",
+        "Times samples of a subscribed channel came twice", s.vChannels,
+        &ChannelMetrics::nOverlaps);
+    ChannelMetric(str, "ll_client_channel_repeated_samples_total",
+        "Samples of a subscribed channel that came twice", s.vChannels,
+        &ChannelMetrics::nRepeatedSamples);
+}
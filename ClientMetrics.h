@@ -0,0 +1,210 @@
+#ifndef __CLIENTMETRICS_H__
+#define __CLIENTMETRICS_H__
+
+#include    <atomic>
+#include    <chrono>
+#include    <cstdint>
+#include    <memory>
+#include    <mutex>
+#include    <string>
+#include    <vector>
+
+#define CACHE_LINE_BYTES    64
+#define CALLBACK_TIMING_INTERVAL    32  // Event handler calls per one timed,
+                                        // reading the clock costs more than
+                                        // the rest of a packet's handling
+
+//
+// Kinds of metadata message counted
+//
+typedef enum {
+    METADATA_TYPE_AVAILABLE,
+    METADATA_TYPE_UNAVAILABLE,
+    METADATA_TYPE_SUBSCRIBED,
+    METADATA_TYPE_UNSUBSCRIBED,
+    METADATA_TYPE_ACQUISITION_STATE,
+    METADATA_TYPE_STATUS,
+    METADATA_TYPE_UNKNOWN,              // Valid JSON, nothing we know
+    METADATA_TYPE_PARSE_ERROR,          // Not JSON, or not as expected
+    METADATA_TYPES,
+} MetadataType;
+
+//
+// Definition of the counters of one subscribed channel
+//
+typedef struct {
+    int         nId;
+    std::string sName;
+    uint64_t    nPackets;               // Since it was subscribed
+    uint64_t    nSamples;
+    uint64_t    nGaps;                  // See ChannelContinuity
+    uint64_t    nMissingSamples;
+    uint64_t    nOverlaps;
+    uint64_t    nRepeatedSamples;
+} ChannelMetrics;
+
+//
+// Definition of a snapshot of the client counters.  Counters only go up
+// (apart from a channel's, which start again when its id is reused), so
+// rates come from the difference between two snapshots over nTimeNs.
+//
+typedef struct {
+    uint64_t                    nTimeNs;        // Since the client started
+    uint64_t                    nBytes;         // Read from the socket
+    uint64_t                    nPackets;       // Whole packets read
+    uint64_t                    nDataPackets;   // Delivered to the handler
+    uint64_t                    nIgnoredPackets;    // Data for ids not
+                                                    // subscribed
+    uint64_t                    nMetadata[METADATA_TYPES];
+    uint64_t                    nFramingErrors; // Bad ids and lengths
+    uint64_t                    nGaps;          // Samples gone missing, of
+    uint64_t                    nMissingSamples;    // all channels ever
+    uint64_t                    nOverlaps;      // Samples come twice
+    uint64_t                    nRepeatedSamples;
+    uint64_t                    nSendFailures;  // Commands not sent
+    uint64_t                    nCallbacks;     // Event handler calls
+    uint64_t                    nTimedCallbacks;    // The ones timed
+    uint64_t                    nCallbackNs;    // Time spent in those
+    uint64_t                    nReceiveQueueBytes; // Waiting in the socket
+    uint64_t                    nReceiveBufferBytes;    // Read into
+    std::vector<ChannelMetrics> vChannels;      // Subscribed ones
+} ClientMetricsSnapshot;
+
+//
+// Definition of the counters kept by LowLatencyDataClient.
+//
+// Nearly all counting is done by the socket read thread, so its counters
+// are updated with relaxed loads and stores rather than atomic read-modify-
+// writes and kept on cache lines of their own; the few counted by other
+// threads are on another line so nothing bounces between cores.  Snapshot()
+// can be called from any thread.
+//
+// There are counters for every id subscribed so far, made as the ids are
+// subscribed.  Only the socket read thread adds them, with m_Lock held, so
+// it finds them without; other threads hold it.  They never move once made.
+//
+class ClientMetrics {
+    public:
+        ClientMetrics();
+
+        ClientMetrics(const ClientMetrics&) = delete;
+        ClientMetrics& operator=(const ClientMetrics&) = delete;
+
+        // Socket read thread
+        void Received(size_t nBytes) { Add(m_Reader.nBytes, nBytes); }
+        void Packet(void) { Add(m_Reader.nPackets, 1); }
+        void FramingError(void) { Add(m_Reader.nFramingErrors, 1); }
+        void Metadata(MetadataType n) { Add(m_Reader.nMetadata[n], 1); }
+        void Ignored(void) { Add(m_Reader.nIgnoredPackets, 1); }
+
+        void Data(int nId, size_t nSamples)
+        {
+            Add(m_Reader.nDataPackets, 1);
+            if(nId < 0 || static_cast<size_t>(nId) >= m_vChannels.size())
+                return;
+
+            ChannelCounters&    c = *m_vChannels[nId];
+            Add(c.nPackets, 1);
+            Add(c.nSamples, nSamples);
+        }
+
+        void Gap(int nId, int64_t nSamples)
+        {
+            if(nSamples > 0) {
+                Add(m_Reader.nGaps, 1);
+                Add(m_Reader.nMissingSamples, nSamples);
+            } else {
+                Add(m_Reader.nOverlaps, 1);
+                Add(m_Reader.nRepeatedSamples, -nSamples);
+            }
+
+            if(nId < 0 || static_cast<size_t>(nId) >= m_vChannels.size())
+                return;
+
+            ChannelCounters&    c = *m_vChannels[nId];
+            if(nSamples > 0) {
+                Add(c.nGaps, 1);
+                Add(c.nMissingSamples, nSamples);
+            } else {
+                Add(c.nOverlaps, 1);
+                Add(c.nRepeatedSamples, -nSamples);
+            }
+        }
+
+        bool Callback(void)
+        {
+            uint64_t    n = m_Reader.nCallbacks.load(std::memory_order_relaxed);
+            m_Reader.nCallbacks.store(n + 1, std::memory_order_relaxed);
+            return n % CALLBACK_TIMING_INTERVAL == 0;
+        }
+
+        void TimedCallback(uint64_t nNs)
+        {
+            Add(m_Reader.nTimedCallbacks, 1);
+            Add(m_Reader.nCallbackNs, nNs);
+        }
+
+        void Subscribed(int nId, const std::string& sName);
+        void Unsubscribed(int nId);
+
+        // Any thread
+        void SendFailure(void)
+        {
+            m_Sender.nSendFailures.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        ClientMetricsSnapshot Snapshot(void) const;
+
+        static void Prometheus(const ClientMetricsSnapshot&, std::string&);
+        static const char *MetadataTypeName(MetadataType);
+
+    private:
+        typedef struct alignas(CACHE_LINE_BYTES) {
+            std::atomic<uint64_t>   nPackets;
+            std::atomic<uint64_t>   nSamples;
+            std::atomic<uint64_t>   nGaps;
+            std::atomic<uint64_t>   nMissingSamples;
+            std::atomic<uint64_t>   nOverlaps;
+            std::atomic<uint64_t>   nRepeatedSamples;
+        } ChannelCounters;
+
+        static void ZeroChannel(ChannelCounters&);
+
+        static void Add(std::atomic<uint64_t>& n, uint64_t nAdd)
+        {
+            n.store(n.load(std::memory_order_relaxed) + nAdd,
+                std::memory_order_relaxed);
+        }
+
+        typedef struct alignas(CACHE_LINE_BYTES) {
+            std::atomic<uint64_t>   nBytes;
+            std::atomic<uint64_t>   nPackets;
+            std::atomic<uint64_t>   nDataPackets;
+            std::atomic<uint64_t>   nIgnoredPackets;
+            std::atomic<uint64_t>   nFramingErrors;
+            std::atomic<uint64_t>   nGaps;
+            std::atomic<uint64_t>   nMissingSamples;
+            std::atomic<uint64_t>   nOverlaps;
+            std::atomic<uint64_t>   nRepeatedSamples;
+            std::atomic<uint64_t>   nCallbacks;
+            std::atomic<uint64_t>   nTimedCallbacks;
+            std::atomic<uint64_t>   nCallbackNs;
+            std::atomic<uint64_t>   nMetadata[METADATA_TYPES];
+        } ReaderCounters;
+
+        typedef struct alignas(CACHE_LINE_BYTES) {
+            std::atomic<uint64_t>   nSendFailures;
+        } SenderCounters;
+
+        ReaderCounters                          m_Reader;
+        SenderCounters                          m_Sender;
+
+        // By id, a name for those subscribed now
+        mutable std::mutex                      m_Lock;
+        std::vector<std::unique_ptr<ChannelCounters>>   m_vChannels;
+        std::vector<std::string>                m_vNames;
+
+        std::chrono::steady_clock::time_point   m_tStart;
+};
+
+#endif
@@ -0,0 +1,256 @@
+#include "FloatCodec.h"
+#include <cstring>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//
+// Function used to count leading zeros of a non zero 32 bit value
+//
+static inline uint32_t LeadingZeros(uint32_t x)
+{
+#if defined(_MSC_VER)
+    unsigned long   n;
+    _BitScanReverse(&n, x);
+    return 31 - n;
+#else
+    return __builtin_clz(x);
+#endif
+}
+
+//
+// Function used to count trailing zeros of a non zero 32 bit value
+//
+static inline uint32_t TrailingZeros(uint32_t x)
+{
+#if defined(_MSC_VER)
+    unsigned long   n;
+    _BitScanForward(&n, x);
+    return n;
+#else
+    return __builtin_ctz(x);
+#endif
+}
+
+namespace {
+
+//
+// Definition of the bit writer.  Bits are packed least significant first
+// into 32 bit words.
+//
+class BitWriter {
+    public:
+        BitWriter(uint8_t *p, size_t nSize)
+            : m_p(p), m_pEnd(p + nSize), m_nAcc(0), m_nFill(0) {}
+
+        inline void Put(uint64_t nValue, uint32_t nBits) {
+            m_nAcc |= nValue << m_nFill;
+            m_nFill += nBits;
+            if(m_nFill >= 32) {
+                uint32_t    w = static_cast<uint32_t>(m_nAcc);
+                if(m_p + sizeof(w) <= m_pEnd) ::memcpy(m_p, &w, sizeof(w));
+                m_p += sizeof(w);
+                m_nAcc >>= 32;
+                m_nFill -= 32;
+            }
+        }
+
+        // Returns the number of bytes used, 0 if it did not fit
+        size_t Finish(uint8_t *pStart) {
+            if(m_nFill) Put(0, 32 - m_nFill);
+            return m_p <= m_pEnd ? static_cast<size_t>(m_p - pStart) : 0;
+        }
+
+    private:
+        uint8_t     *m_p;
+        uint8_t     *m_pEnd;
+        uint64_t    m_nAcc;
+        uint32_t    m_nFill;
+};
+
+//
+// Definition of the bit reader matching BitWriter
+//
+class BitReader {
+    public:
+        BitReader(const uint8_t *p, size_t nSize)
+            : m_p(p), m_pEnd(p + nSize), m_nAcc(0), m_nFill(0) {}
+
+        inline uint32_t Get(uint32_t nBits) {
+            if(m_nFill < nBits) {
+                uint32_t    w = 0;
+                if(m_p + sizeof(w) <= m_pEnd) ::memcpy(&w, m_p, sizeof(w));
+                m_p += sizeof(w);
+                m_nAcc |= static_cast<uint64_t>(w) << m_nFill;
+                m_nFill += 32;
+            }
+            uint32_t    v = static_cast<uint32_t>(
+                m_nAcc & ((1ULL << nBits) - 1));
+            m_nAcc >>= nBits;
+            m_nFill -= nBits;
+            return v;
+        }
+
+        bool Overrun(void) const { return m_p > m_pEnd; }
+
+    private:
+        const uint8_t   *m_p;
+        const uint8_t   *m_pEnd;
+        uint64_t        m_nAcc;
+        uint32_t        m_nFill;
+};
+
+}
+
+//
+// Function used to get the most space a block of nSamples can need
+//
+size_t FloatCodec::MaxEncodedSize(size_t nSamples)
+{
+    // Worst case is a full 12 bit control word and 32 bits per sample
+    size_t  nBits = 32 + (nSamples ? nSamples - 1 : 0) * 44;
+    return sizeof(FloatCodecBlockHeader) + ((nBits + 31) / 32) * 4;
+}
+
+//
+// Function used to encode a block into a caller supplied buffer.  Returns
+// the number of bytes used (header included) or 0 if pOut is too small.
+//
+size_t FloatCodec::EncodeBlock(const float *pSamples, size_t nSamples,
+    uint8_t *pOut, size_t nOutSize)
+{
+    if(nOutSize < sizeof(FloatCodecBlockHeader)) return 0;
+
+    uint8_t     *pData = pOut + sizeof(FloatCodecBlockHeader);
+    BitWriter   bw(pData, nOutSize - sizeof(FloatCodecBlockHeader));
+
+    uint32_t    nPrev = 0;
+    uint32_t    nPrevLead = 0xff;
+    uint32_t    nPrevTrail = 0;
+
+    for(size_t i = 0; i < nSamples; i++) {
+        uint32_t    nBits;
+        ::memcpy(&nBits, &pSamples[i], sizeof(nBits));
+
+        if(i == 0) {
+            bw.Put(nBits, 32);
+            nPrev = nBits;
+            continue;
+        }
+
+        uint32_t    x = nBits ^ nPrev;
+        nPrev = nBits;
+
+        if(!x) {
+            // Same as the previous sample
+            bw.Put(0, 1);
+            continue;
+        }
+
+        uint32_t    nLead = LeadingZeros(x);
+        uint32_t    nTrail = TrailingZeros(x);
+
+        if(nPrevLead != 0xff && nLead >= nPrevLead && nTrail >= nPrevTrail) {
+            // Fits in the previous window:  '1' '0' <window bits>
+            uint32_t    nLen = 32 - nPrevLead - nPrevTrail;
+            bw.Put(0x1, 2);
+            bw.Put(x >> nPrevTrail, nLen);
+        } else {
+            // New window:  '1' '1' <5 bit lead> <5 bit length - 1> <bits>
+            uint32_t    nLen = 32 - nLead - nTrail;
+            bw.Put(0x3 | (nLead << 2) | ((nLen - 1) << 7), 12);
+            bw.Put(x >> nTrail, nLen);
+            nPrevLead = nLead;
+            nPrevTrail = nTrail;
+        }
+    }
+
+    size_t  nBytes = bw.Finish(pData);
+    if(nSamples && !nBytes) return 0;
+
+    FloatCodecBlockHeader   h;
+    h.nSamples = static_cast<uint32_t>(nSamples);
+    h.nBytes = static_cast<uint32_t>(nBytes);
+    ::memcpy(pOut, &h, sizeof(h));
+
+    return sizeof(h) + nBytes;
+}
+
+//
+// Function used to encode a block onto the end of a vector.  Returns the
+// number of bytes added.
+//
+size_t FloatCodec::EncodeBlock(const float *pSamples, size_t nSamples,
+    std::vector<uint8_t>& vOut)
+{
+    size_t  nStart = vOut.size();
+
+    vOut.resize(nStart + MaxEncodedSize(nSamples));
+    size_t  n = EncodeBlock(pSamples, nSamples, vOut.data() + nStart,
+        vOut.size() - nStart);
+    vOut.resize(nStart + n);
+
+    return n;
+}
+
+//
+// Function used to get the number of samples in an encoded block
+//
+size_t FloatCodec::BlockSamples(const uint8_t *pIn, size_t nInSize)
+{
+    FloatCodecBlockHeader   h;
+
+    if(nInSize < sizeof(h)) return 0;
+    ::memcpy(&h, pIn, sizeof(h));
+    return h.nSamples;
+}
+
+//
+// Function used to decode one block.  Returns the number of samples decoded,
+// 0 if the block is damaged or does not fit in pSamples.  The size of the
+// block is stored in *pnConsumed.
+//
+size_t FloatCodec::DecodeBlock(const uint8_t *pIn, size_t nInSize,
+    float *pSamples, size_t nMaxSamples, size_t *pnConsumed)
+{
+    FloatCodecBlockHeader   h;
+
+    if(nInSize < sizeof(h)) return 0;
+    ::memcpy(&h, pIn, sizeof(h));
+
+    if(h.nSamples > nMaxSamples ||
+        h.nBytes > nInSize - sizeof(h)) return 0;
+
+    BitReader   br(pIn + sizeof(h), h.nBytes);
+
+    uint32_t    nPrev = 0;
+    uint32_t    nLead = 0;
+    uint32_t    nTrail = 0;
+
+    for(uint32_t i = 0; i < h.nSamples; i++) {
+        if(i == 0) {
+            nPrev = br.Get(32);
+        } else if(br.Get(1)) {
+            uint32_t    x;
+
+            if(br.Get(1)) {
+                nLead = br.Get(5);
+                uint32_t    nLen = br.Get(5) + 1;
+                if(nLead + nLen > 32) return 0;
+                nTrail = 32 - nLead - nLen;
+                x = br.Get(nLen) << nTrail;
+            } else {
+                x = br.Get(32 - nLead - nTrail) << nTrail;
+            }
+
+            nPrev ^= x;
+        }
+
+        ::memcpy(&pSamples[i], &nPrev, sizeof(nPrev));
+    }
+
+    if(br.Overrun()) return 0;
+
+    if(pnConsumed) *pnConsumed = sizeof(h) + h.nBytes;
+    return h.nSamples;
+}
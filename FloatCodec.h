@@ -0,0 +1,55 @@
+#ifndef __FLOATCODEC_H__
+#define __FLOATCODEC_H__
+
+#include    <cstddef>
+#include    <cstdint>
+#include    <vector>
+
+//
+// Definition of the header in front of every encoded block
+//
+// NOTE:  All fields are in host byte order
+//
+typedef struct {
+    uint32_t    nSamples;               // Samples in the block
+    uint32_t    nBytes;                 // Encoded bytes following the header
+} FloatCodecBlockHeader;
+
+//
+// Definition of the lossless float codec.
+//
+// Samples are XORed with the previous sample and only the bits that differ
+// are stored, with the leading/trailing zero window reused from one sample
+// to the next while it still fits (the Gorilla scheme, sized for 32 bit
+// floats).  Slowly varying sensor data, and in particular raw ADC counts
+// stored as floats, changes only a few mantissa bits per sample and packs
+// into a small fraction of its raw size; a repeated value costs one bit.
+//
+// Data is encoded in independent blocks so a block can be decoded without
+// anything that came before it, which is what on-disk captures need for
+// seeking and what a compressed in-memory history needs to drop its oldest
+// data.
+//
+// NOTE:  ChannelRecorder and ChannelHistory still keep raw floats, so that
+//        CaptureReader, CaptureReplay and history reads can hand out
+//        pointers straight into the file or ring.  Only codec-bench uses
+//        the codec so far.
+//
+class FloatCodec {
+    public:
+        static size_t MaxEncodedSize(size_t nSamples);
+
+        static size_t EncodeBlock(const float *pSamples, size_t nSamples,
+            std::vector<uint8_t>& vOut);
+
+        static size_t EncodeBlock(const float *pSamples, size_t nSamples,
+            uint8_t *pOut, size_t nOutSize);
+
+        static size_t DecodeBlock(const uint8_t *pIn, size_t nInSize,
+            float *pSamples, size_t nMaxSamples,
+            size_t *pnConsumed = nullptr);
+
+        static size_t BlockSamples(const uint8_t *pIn, size_t nInSize);
+};
+
+#endif
@@ -1,8 +1,12 @@
 #include "LowLatencyDataClient.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
 #if defined(__linux__)
 #include <arpa/inet.h>
+#include <sys/socket.h>
 #endif
 
 #include <boost/range.hpp>
@@ -13,11 +17,26 @@ extern int nDebug;
 // Constructor
 //
 LowLatencyDataClient::LowLatencyDataClient(boost::asio::io_context& io_context,
-    std::string& host, std::string& service, EventHandler fCb)
-    : m_fEventHandler(fCb)
-    , m_Data(nullptr)
+    std::string& host, std::string& service, EventHandler fCb,
+    std::shared_ptr<ReceiveMemoryPool> pReceiveMemory)
+    : m_pAvailableChannels(std::make_shared<const AvailableChannels>())
+    , m_pSubscribedChannels(std::make_shared<const SubscribedChannels>())
+    , m_pIdByHandle(std::make_shared<const IdsByHandle>())
+    , m_fEventHandler(fCb)
+    , m_pReceiveMemory(pReceiveMemory)
+    , m_Data()
+    , m_nDataBytes(0)
+    , m_nMaxSubscribedId(-1)
 {
-    m_Data = new uint8_t[recvBufSize];
+    // Without a pool to share, one of its own with the defaults
+    if(!m_pReceiveMemory)
+        m_pReceiveMemory = std::make_shared<ReceiveMemoryPool>(
+            ReceiveMemoryConfig());
+
+    m_Data = m_pReceiveMemory->Get(m_pReceiveMemory->Config().nInitialBytes);
+    if(!m_Data.p) throw std::bad_alloc();
+    m_nDataBytes = m_Data.nBytes;
+
     Connect(io_context, host, service);
 }
 
@@ -26,16 +45,38 @@ LowLatencyDataClient::LowLatencyDataClient(boost::asio::io_context& io_context,
 //
 LowLatencyDataClient::~LowLatencyDataClient()
 {
+    boost::system::error_code   ec;
+
     m_bSocketReadThreadExit = true;
 
-    // This causes the read in the thread to return error
-    m_Socket->shutdown(tcp::socket::shutdown_both);
-    m_Socket->close();
+    // This causes the read in the thread to return error, if the thread
+    // hasn't already given up on the connection
+    m_Socket->shutdown(tcp::socket::shutdown_both, ec);
 
     m_SocketReadThread->join();
     delete m_SocketReadThread;
 
-    delete [] m_Data;
+    m_Socket->close(ec);
+
+    m_pReceiveMemory->Put(m_Data);
+}
+
+//
+// Function used to swap the receive buffer for one of at least nBytes,
+// keeping what has been read so far.  Socket read thread only.
+//
+bool LowLatencyDataClient::GrowData(size_t nBytes, size_t nKeepBytes)
+{
+    ReceiveBlock    b = m_pReceiveMemory->Get(nBytes);
+    if(!b.p) return false;
+
+    std::memcpy(b.p, m_Data.p, nKeepBytes);
+    m_pReceiveMemory->Put(m_Data);
+
+    m_Data = b;
+    m_nDataBytes = b.nBytes;
+
+    return true;
 }
 
 //
@@ -45,7 +86,7 @@ void LowLatencyDataClient::SocketReadThread(void)
 {
     // Set pointer to header
     LowLatencyStreamPacketHeader  *pHeader =
-        reinterpret_cast<LowLatencyStreamPacketHeader *>(m_Data);
+        reinterpret_cast<LowLatencyStreamPacketHeader *>(m_Data.p);
 
     // Start with getting a stream packet header
     size_t  nBufferOffset = 0;
@@ -55,21 +96,41 @@ void LowLatencyDataClient::SocketReadThread(void)
     while(!m_bSocketReadThreadExit) {
 
         int nAmountRead = 0;
-        if(nAmount2Read + nBufferOffset > recvBufSize) {
-            std::cerr << "Invalid amount to read " << nAmount2Read << std::endl;
-            std::cerr << "Read " << nAmount2Read << " to " << nBufferOffset <<
-                std::endl;
-            std::cerr << "Last pHeader->length " << ::ntohl(pHeader->length) <<
-                std::endl;
-            std::cerr << "Last pHeader->id " << ::ntohl(pHeader->id) <<
-                std::endl;
-            break;
+        if(nAmount2Read + nBufferOffset > m_Data.nBytes) {
+            // Take a bigger buffer, unless the packet is too big
+            if(!GrowData(nAmount2Read + nBufferOffset, nBufferOffset)) {
+                std::cerr << "Invalid amount to read " << nAmount2Read <<
+                    std::endl;
+                std::cerr << "Read " << nAmount2Read << " to " <<
+                    nBufferOffset << std::endl;
+                std::cerr << "Last pHeader->length " <<
+                    ::ntohl(pHeader->length) << std::endl;
+                std::cerr << "Last pHeader->id " << ::ntohl(pHeader->id) <<
+                    std::endl;
+                m_Metrics.FramingError();
+                break;
+            }
+            pHeader = reinterpret_cast<LowLatencyStreamPacketHeader *>(
+                m_Data.p);
         }
 
         try {
+#if defined(WITH_PACKET_TIMING)
+            // Receive some data, noting when the kernel got the start of a
+            // packet
+            uint64_t    nKernelNs;
+            nAmountRead = ReceiveTimestamped(m_Data.p + nBufferOffset,
+                nAmount2Read, &nKernelNs);
+            if(nBufferOffset == 0) m_nPacketKernelNs = nKernelNs;
+            if(nBufferOffset < sizeof(LowLatencyStreamPacketHeader) &&
+                nBufferOffset + nAmountRead >=
+                sizeof(LowLatencyStreamPacketHeader))
+                m_nPacketHeaderNs = PacketTiming::Now();
+#else
             // Receive some data on from the socket
             nAmountRead = m_Socket->receive(boost::asio::buffer(
-                m_Data + nBufferOffset, nAmount2Read));
+                m_Data.p + nBufferOffset, nAmount2Read));
+#endif
         }
         catch(...) {
             if(m_bSocketReadThreadExit) break;
@@ -80,6 +141,8 @@ void LowLatencyDataClient::SocketReadThread(void)
         }
 
         if(nAmountRead > 0) {
+            m_Metrics.Received(nAmountRead);
+
             // Adjust the buffer offset by the amount of data received
             nBufferOffset += nAmountRead;
 
@@ -88,11 +151,14 @@ void LowLatencyDataClient::SocketReadThread(void)
                 continue;
 
             } else if(nBufferOffset < ::ntohl(pHeader->length)) {
-                if(::ntohl(pHeader->id) > 7 &&
-                    ::ntohl(pHeader->id) != METADATA_ID) {
+                // No data comes for an id the server has yet to assign
+                if(::ntohl(pHeader->id) != METADATA_ID &&
+                    static_cast<int64_t>(::ntohl(pHeader->id)) >
+                    m_nMaxSubscribedId) {
 
                     std::cerr << "Bad id " << std::hex <<
                         ::ntohl(pHeader->id) << std::endl;
+                    m_Metrics.FramingError();
                     break;
                 }
                 nAmount2Read = ::ntohl(pHeader->length) - nBufferOffset;
@@ -100,9 +166,13 @@ void LowLatencyDataClient::SocketReadThread(void)
                 continue;
 
             } else {
+#if defined(WITH_PACKET_TIMING)
+                m_nPacketCompleteNs = PacketTiming::Now();
+#endif
                 // Process the packet and reset for the next packet
                 pHeader->id = ::ntohl(pHeader->id);
                 pHeader->length = ::ntohl(pHeader->length);
+                m_Metrics.Packet();
                 ProcessPacket(pHeader);
                 nAmount2Read = sizeof(LowLatencyStreamPacketHeader);
                 nBufferOffset = 0;
@@ -113,14 +183,81 @@ void LowLatencyDataClient::SocketReadThread(void)
         }
     }
 
-    // If we didn't get here because we are exiting, shutdown and close the
-    // socket
+    // If we didn't get here because we are exiting, the connection is lost.
+    // Shut the socket down, the destructor closes it.
     if(!m_bSocketReadThreadExit) {
-        m_Socket->shutdown(tcp::socket::shutdown_both);
-        m_Socket->close();
+        boost::system::error_code   ec;
+
+        m_Socket->shutdown(tcp::socket::shutdown_both, ec);
+        m_bConnected = false;
+    }
+}
+
+//
+// Function used to tell whether the connection to the server is still up
+//
+bool LowLatencyDataClient::Connected(void) const
+{
+    return m_bConnected;
+}
+
+#if defined(WITH_PACKET_TIMING)
+//
+// Function used to receive from the socket along with when the kernel
+// received it, 0 if it does not say
+//
+size_t LowLatencyDataClient::ReceiveTimestamped(uint8_t *p, size_t nBytes,
+    uint64_t *pnKernelNs)
+{
+    *pnKernelNs = 0;
+
+#if defined(__linux__)
+    struct iovec    iov = { p, nBytes };
+    char            Control[CMSG_SPACE(sizeof(struct timespec))];
+    struct msghdr   msg = {};
+
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = Control;
+    msg.msg_controllen = sizeof(Control);
+
+    ssize_t nRead;
+    do {
+        nRead = ::recvmsg(m_Socket->native_handle(), &msg, 0);
+    } while(nRead < 0 && errno == EINTR);
+
+    // Fail the way the socket's receive() does
+    if(nRead < 0) throw boost::system::system_error(errno,
+        boost::system::system_category());
+    if(nRead == 0) throw boost::system::system_error(boost::asio::error::eof);
+
+    for(struct cmsghdr *pCmsg = CMSG_FIRSTHDR(&msg); pCmsg;
+        pCmsg = CMSG_NXTHDR(&msg, pCmsg)) {
+        if(pCmsg->cmsg_level == SOL_SOCKET &&
+            pCmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec ts;
+            ::memcpy(&ts, CMSG_DATA(pCmsg), sizeof(ts));
+            *pnKernelNs = static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL +
+                static_cast<uint64_t>(ts.tv_nsec);
+        }
     }
+
+    return static_cast<size_t>(nRead);
+#else
+    return m_Socket->receive(boost::asio::buffer(p, nBytes));
+#endif
 }
 
+//
+// Function used to get the packet path latency histograms of each channel
+//
+std::vector<ChannelTimingSnapshot> LowLatencyDataClient::TimingSnapshot(
+    bool bReset)
+{
+    return m_Timing.Snapshot(bReset);
+}
+#endif
+
 //
 // Function used to connect to the server
 //
@@ -136,10 +273,42 @@ void LowLatencyDataClient::Connect(boost::asio::io_context& io_context,
     // Connect to the specified port on the specified server
     boost::asio::connect(*m_Socket, resolver.resolve(host, service));
 
+#if defined(WITH_PACKET_TIMING)
+    m_nPacketKernelNs = m_nPacketHeaderNs = m_nPacketCompleteNs = 0;
+#if defined(__linux__)
+    // Have the kernel stamp when each segment arrived
+    int nOn = 1;
+    if(::setsockopt(m_Socket->native_handle(), SOL_SOCKET, SO_TIMESTAMPNS,
+        &nOn, sizeof(nOn)) < 0)
+        std::cerr << "Unable to enable receive timestamps" << std::endl;
+#endif
+#endif
+
     m_bSocketReadThreadExit = false;
+    m_bConnected = true;
     m_SocketReadThread = new std::thread([this]() { SocketReadThread(); });
 }
 
+//
+// Function used to call the user event handler, timing some of the calls
+//
+void LowLatencyDataClient::CallEventHandler(EventType nType, const void *p,
+    size_t nSize)
+{
+    if(!m_Metrics.Callback()) {
+        m_fEventHandler(nType, p, nSize);
+        return;
+    }
+
+    auto    t0 = std::chrono::steady_clock::now();
+
+    m_fEventHandler(nType, p, nSize);
+
+    m_Metrics.TimedCallback(std::chrono::duration_cast<
+        std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+        t0).count());
+}
+
 //
 // Function used to process incoming packets
 //
@@ -147,8 +316,11 @@ void LowLatencyDataClient::ProcessPacket(LowLatencyStreamPacketHeader *pHeader)
 {
     if(pHeader->id & METADATA_ID) {
         if(pHeader->id == METADATA_ID) ProcessMetadataPacket(pHeader);
-        else std::cerr << "Corrupt metadata id " << std::hex <<
-            pHeader->id << std::endl;
+        else {
+            std::cerr << "Corrupt metadata id " << std::hex <<
+                pHeader->id << std::endl;
+            m_Metrics.FramingError();
+        }
     }
     else ProcessDataPacket(pHeader);
 }
@@ -159,16 +331,120 @@ void LowLatencyDataClient::ProcessPacket(LowLatencyStreamPacketHeader *pHeader)
 void LowLatencyDataClient::ProcessDataPacket(
     LowLatencyStreamPacketHeader *pHeader)
 {
-    if(m_mSubscribedChannelsList.find(pHeader->id) !=
-        m_mSubscribedChannelsList.end()) {
+    const SubscribedChannels&   mSubscribed = *m_pSubscribedChannels;
+    auto                        it = mSubscribed.find(pHeader->id);
+
+    if(it != mSubscribed.end()) {
 
         ChannelDataInfo cdi;
+        cdi.hChannel = (*it).second.hChannel;
         cdi.nId = static_cast<int>(pHeader->id);
         cdi.pData = reinterpret_cast<float *>(pHeader + 1);
         cdi.nSamples = (pHeader->length - sizeof(*pHeader)) / sizeof(float);
+        m_Metrics.Data(cdi.nId, cdi.nSamples);
+
+#if defined(WITH_PACKET_TIMING)
+        uint64_t    nEntryNs = PacketTiming::Now();
+#endif
+        CallEventHandler(EVENT_TYPE_CHANNEL_DATA, &cdi, sizeof(cdi));
+
+#if defined(WITH_PACKET_TIMING)
+        uint64_t    nExitNs = PacketTiming::Now();
+
+        m_Timing.Record(cdi.nId, PACKET_STAGE_KERNEL_TO_HEADER,
+            m_nPacketKernelNs, m_nPacketHeaderNs);
+        m_Timing.Record(cdi.nId, PACKET_STAGE_HEADER_TO_COMPLETE,
+            m_nPacketHeaderNs, m_nPacketCompleteNs);
+        m_Timing.Record(cdi.nId, PACKET_STAGE_COMPLETE_TO_HANDLER,
+            m_nPacketCompleteNs, nEntryNs);
+        m_Timing.Record(cdi.nId, PACKET_STAGE_HANDLER, nEntryNs, nExitNs);
+#endif
 
-        m_fEventHandler(EVENT_TYPE_CHANNEL_DATA, &cdi, sizeof(cdi));
+        if(m_Continuity.Data(cdi.nId, cdi.nSamples))
+            CheckContinuity(cdi.nId, (*it).second);
     }
+    else m_Metrics.Ignored();
+}
+
+//
+// Function used to judge a channel's sample continuity at the end of a
+// window, letting the user know of any gap
+//
+void LowLatencyDataClient::CheckContinuity(int nId, const ChannelInfo& ci)
+{
+    // Only judge once caught up with what the server has sent
+    boost::system::error_code   ec;
+    size_t                      nQueued = m_Socket->available(ec);
+
+    int64_t nSamples = m_Continuity.Judge(nId,
+        !ec && nQueued <= CONTINUITY_QUEUE_BYTES);
+    if(!nSamples) return;
+
+    m_Metrics.Gap(nId, nSamples);
+
+    const ContinuityCounts& counts = m_Continuity.Counts(nId);
+    ChannelGapInfo          cgi;
+
+    cgi.sName = ci.sName;
+    cgi.hChannel = ci.hChannel;
+    cgi.nId = nId;
+    cgi.nSamples = nSamples;
+    cgi.dNextSampleTimestamp = m_Continuity.NextSampleTimestamp(nId);
+    cgi.nGaps = counts.nGaps;
+    cgi.nMissingSamples = counts.nMissingSamples;
+    cgi.nOverlaps = counts.nOverlaps;
+    cgi.nRepeatedSamples = counts.nRepeatedSamples;
+
+    CallEventHandler(EVENT_TYPE_CHANNEL_GAP, &cgi, sizeof(cgi));
+}
+
+//
+// Function used to set how far the arrival of samples can move before it
+// is taken as some having gone missing or come twice, 0 to stop checking
+//
+void LowLatencyDataClient::SetContinuityTolerance(double dSeconds)
+{
+    m_Continuity.SetTolerance(dSeconds);
+}
+
+//
+// Functions used to take the current channel tables, from any thread.  The
+// table stays as it is for as long as the snapshot is held.
+//
+std::shared_ptr<const LowLatencyDataClient::AvailableChannels>
+    LowLatencyDataClient::AvailableChannelsSnapshot(void) const
+{
+    return std::atomic_load(&m_pAvailableChannels);
+}
+
+std::shared_ptr<const LowLatencyDataClient::SubscribedChannels>
+    LowLatencyDataClient::SubscribedChannelsSnapshot(void) const
+{
+    return std::atomic_load(&m_pSubscribedChannels);
+}
+
+//
+// Functions used to replace a channel table with an edited copy, from the
+// socket read thread only
+//
+void LowLatencyDataClient::PublishAvailableChannels(
+    std::shared_ptr<AvailableChannels> p)
+{
+    std::atomic_store(&m_pAvailableChannels,
+        std::shared_ptr<const AvailableChannels>(std::move(p)));
+}
+
+void LowLatencyDataClient::PublishSubscribedChannels(
+    std::shared_ptr<SubscribedChannels> p)
+{
+    std::atomic_store(&m_pSubscribedChannels,
+        std::shared_ptr<const SubscribedChannels>(std::move(p)));
+}
+
+void LowLatencyDataClient::PublishIdsByHandle(std::shared_ptr<IdsByHandle> p)
+{
+    std::atomic_store(&m_pIdByHandle,
+        std::shared_ptr<const IdsByHandle>(std::move(p)));
 }
 
 //
@@ -176,23 +452,40 @@ void LowLatencyDataClient::ProcessDataPacket(
 //
 void LowLatencyDataClient::ProcessUnsubscribeResponsePacket(json& j)
 {
-    for(auto& it : j["unsubscribed"]) {
-        std::string sName(it);
+    auto                                    pSubscribed =
+        std::make_shared<SubscribedChannels>(*m_pSubscribedChannels);
+    std::vector<ChannelUnsubscribedInfo>    vRemoved;
+    std::vector<ChannelHandle>              vHandles = ChannelNames::FindAll(
+        j["unsubscribed"].get<std::vector<std::string>>());
+
+    {
+        std::unique_lock<std::mutex>    lk(m_SubscriptionsLock);
+        auto                            pIds =
+            std::make_shared<IdsByHandle>(*m_pIdByHandle);
+
+        for(ChannelHandle h : vHandles) {
+            if(IdOf(*pIds, h) < 0) continue;
+
+            ChannelUnsubscribedInfo cui;
+            cui.hChannel = h;
+            cui.nId = IdOf(*pIds, h);
+            SetSubscribedId(*pIds, h, -1);
+            pSubscribed->erase(cui.nId);
+            vRemoved.push_back(cui);
+        }
 
-        for(auto sit = m_mSubscribedChannelsList.begin();
-            sit != m_mSubscribedChannelsList.end(); sit++) {
+        if(!vRemoved.empty()) PublishIdsByHandle(std::move(pIds));
+    }
+    if(vRemoved.empty()) return;
 
-            if((*sit).second.sName == sName) {
-                ChannelUnsubscribedInfo cui;
-                cui.nId = (*sit).first;
+    // One new table for them all
+    PublishSubscribedChannels(std::move(pSubscribed));
 
-                m_fEventHandler(EVENT_TYPE_CHANNEL_UNSUBSCRIBED, &cui,
-                    sizeof(cui));
+    for(auto& cui : vRemoved) {
+        m_Metrics.Unsubscribed(cui.nId);
+        m_Continuity.Unsubscribed(cui.nId);
 
-                m_mSubscribedChannelsList.erase(sit);
-                break;
-            }
-        }
+        CallEventHandler(EVENT_TYPE_CHANNEL_UNSUBSCRIBED, &cui, sizeof(cui));
     }
 }
 
@@ -201,58 +494,98 @@ void LowLatencyDataClient::ProcessUnsubscribeResponsePacket(json& j)
 //
 void LowLatencyDataClient::ProcessSubscribeResponsePacket(json& j)
 {
+    const AvailableChannels&            vAvailable = *m_pAvailableChannels;
+    auto                                pSubscribed =
+        std::make_shared<SubscribedChannels>(*m_pSubscribedChannels);
+    std::vector<ChannelSubscribedInfo>  vAdded;
+    std::vector<std::string>            vNames;
+
+    for(auto& it : j["subscribed"]) vNames.push_back(it["name"]);
+    std::vector<ChannelHandle>  vHandles = ChannelNames::FindAll(vNames);
+
     // Process all of the channels given
-    for(auto& it : j["subscribed"]) {
-        std::string sName(it["name"]);
-        int         nId = it["id"];
-        uint64_t    fsts_ns = it["first_sample_timestamp_ns"];
-
-        // Find the channel in the pending subscribe channels list
-        for(auto iit = m_vPendingSubscribeChannelsList.begin();
-            iit != m_vPendingSubscribeChannelsList.end(); iit++) {
-            if((*iit).sName == sName) {
-
-                // Channel found, get a copy of the channel info from the
-                // available channels list
-                if(m_mAvailableChannelsList.find(sName) ==
-                    m_mAvailableChannelsList.end()) {
-                    std::cerr << "Channel " << sName <<
-                        "is no longer available for subcribe" << std::endl;
-                    continue;
-                }
-                ChannelInfo& ci = m_mAvailableChannelsList[sName];
+    {
+        std::unique_lock<std::mutex>    lk(m_SubscriptionsLock);
+        auto                            pIds =
+            std::make_shared<IdsByHandle>(*m_pIdByHandle);
+        size_t                          n = 0;
+
+        for(auto& it : j["subscribed"]) {
+            const std::string&  sName = vNames[n];
+            ChannelHandle       h = vHandles[n++];
+            int                 nId = it["id"];
+            uint64_t            fsts_ns = it["first_sample_timestamp_ns"];
+
+            // Its data is valid from now on, whatever becomes of it here
+            m_nMaxSubscribedId = std::max<int64_t>(m_nMaxSubscribedId, nId);
+
+            // Find the channel in the pending subscribes, and remove it
+            // from there
+            auto    pit = m_mPendingSubscribe.find(h);
+            if(pit == m_mPendingSubscribe.end()) continue;
+
+            uint32_t    nDecimationFactor = (*pit).second;
+            m_mPendingSubscribe.erase(pit);
+
+            // Channel found, get a copy of the channel info from the
+            // available channels keeping the decimation factor that was
+            // asked for
+            if(!IsAvailable(vAvailable, h)) {
+                std::cerr << "Channel " << sName <<
+                    " is no longer available for subcribe" << std::endl;
+                continue;
+            }
+            ChannelInfo ci = vAvailable[h];
+            ci.nDecimationFactor = nDecimationFactor;
 
-                // Add the channel info to the list of subscribed channels
-                m_mSubscribedChannelsList[nId] = ci;
+            // Add the channel info to the subscribed channels
+            (*pSubscribed)[nId] = ci;
+            SetSubscribedId(*pIds, h, nId);
 
-                // Remove the channel from the pending subscribe list
-                m_vPendingSubscribeChannelsList.erase(iit);
+            // Save the first sample time stamp for the channel
+            m_vFSTS[h] = static_cast<double>(fsts_ns) / 1000000000.0;
 
-                ChannelSubscribedInfo   csi;
+            ChannelSubscribedInfo   csi;
 
-                csi.sName = sName;
-                csi.nId = nId;
+            csi.sName = sName;
+            csi.hChannel = h;
+            csi.nId = nId;
+            csi.nDecimationFactor = nDecimationFactor;
+            vAdded.push_back(csi);
+        }
 
-                // Let the user know the channel was subscribed
-                m_fEventHandler(EVENT_TYPE_CHANNEL_SUBSCRIBED, &csi,
-                    sizeof(csi));
+        if(!vAdded.empty()) PublishIdsByHandle(std::move(pIds));
+    }
+    if(vAdded.empty()) return;
 
-                // Save the first sample time stamp for the channel
-                m_mFSTS[sName] = static_cast<double>(fsts_ns) / 1000000000.0;
+    // One new table for them all, published before the user hears of any
+    PublishSubscribedChannels(std::move(pSubscribed));
 
-                // Let the user know what the first sample timestamp for the
-                // channel is
-                ChannelTimestampInfo   ctsi;
-                ctsi.sName = sName;
-                ctsi.nId = nId;
-                ctsi.dFirstSampleTimestamp = m_mFSTS[sName];
+    for(auto& csi : vAdded) {
+        double  dSamplePeriod = vAvailable[csi.hChannel].dSamplePeriod;
 
-                m_fEventHandler(EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS, &ctsi,
-                    sizeof(ctsi));
+        m_Metrics.Subscribed(csi.nId, csi.sName);
+        m_Continuity.Subscribed(csi.nId, dSamplePeriod *
+            std::max(csi.nDecimationFactor, 1U));
+#if defined(WITH_PACKET_TIMING)
+        m_Timing.Subscribed(csi.nId);
+#endif
 
-                break;
-            }
-        }
+        // Let the user know the channel was subscribed
+        CallEventHandler(EVENT_TYPE_CHANNEL_SUBSCRIBED, &csi, sizeof(csi));
+
+        m_Continuity.Restart(csi.nId, m_vFSTS[csi.hChannel]);
+
+        // Let the user know what the first sample timestamp for the
+        // channel is
+        ChannelTimestampInfo   ctsi;
+        ctsi.sName = csi.sName;
+        ctsi.hChannel = csi.hChannel;
+        ctsi.nId = csi.nId;
+        ctsi.dFirstSampleTimestamp = m_vFSTS[csi.hChannel];
+
+        CallEventHandler(EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS, &ctsi,
+            sizeof(ctsi));
     }
 }
 
@@ -261,10 +594,19 @@ void LowLatencyDataClient::ProcessSubscribeResponsePacket(json& j)
 //
 void LowLatencyDataClient::ProcessAvailableChannelsPacket(json& j)
 {
+    auto                        pAvailable =
+        std::make_shared<AvailableChannels>(*m_pAvailableChannels);
+    std::vector<ChannelInfo>    vAdded;
+    std::vector<std::string>    vNames;
+
+    for(auto it : j["available"].items()) vNames.push_back(it.key());
+    std::vector<ChannelHandle>  vHandles = ChannelNames::InternAll(vNames);
+    size_t                      n = 0;
+
     // Process all of the available channel information given
     for(auto it : j["available"].items()) {
-        std::string sName(it.key());
-        json        jInfo(it.value());
+        const std::string&  sName = vNames[n];
+        json                jInfo(it.value());
 
         // Get/create the channel info entry for this channel
         ChannelInfo ci;
@@ -272,22 +614,62 @@ void LowLatencyDataClient::ProcessAvailableChannelsPacket(json& j)
         // Extract channel specific informaton from the JSON and store it
         // int eh channel information structure
         ci.sName.assign(sName);
+        ci.hChannel = vHandles[n++];
         ci.dSamplePeriod = jInfo["sample_period"];
         ci.sDataType.assign(jInfo["data_type"]);
         ci.dScale = jInfo["scale"];
         ci.dOffset = jInfo["offset"];
         ci.nDecimationFactor = 1;
 
-        if(m_mAvailableChannelsList.find(sName) !=
-            m_mAvailableChannelsList.end()) {
+        if(IsAvailable(*pAvailable, ci.hChannel)) {
             std::cerr << "Channel '" << sName << "' is already available" <<
                 std::endl;
             continue;
         }
-        m_mAvailableChannelsList[sName] = ci;
+        if(pAvailable->size() <= ci.hChannel) {
+            ChannelInfo ciNone;
+            ciNone.hChannel = NO_CHANNEL_HANDLE;
+            pAvailable->resize(ci.hChannel + 1, ciNone);
+        }
+        (*pAvailable)[ci.hChannel] = ci;
+        vAdded.push_back(ci);
+    }
 
-        // Let the user know about the available channel
-        m_fEventHandler(EVENT_TYPE_AVAILABLE_CHANNEL, &ci, sizeof(ci));
+    // Publish them all before the user hears of any, so they can be
+    // subscribed to straight away
+    if(vAdded.empty()) return;
+    if(m_vFSTS.size() < pAvailable->size())
+        m_vFSTS.resize(pAvailable->size(), 0.0);
+    PublishAvailableChannels(std::move(pAvailable));
+
+    // Let the user know about the available channels
+    for(auto& ci : vAdded)
+        CallEventHandler(EVENT_TYPE_AVAILABLE_CHANNEL, &ci, sizeof(ci));
+
+    // Subscribe to those the user asked for by pattern, with the decimation
+    // of the first pattern each matches
+    std::vector<ChannelInfo>    vMatching;
+    {
+        std::unique_lock<std::mutex>    lk(m_SubscribePatternsLock);
+        if(m_vSubscribePatterns.empty()) return;
+
+        for(auto& ci : vAdded) {
+            for(auto& sp : m_vSubscribePatterns) {
+                if(!PatternMatches(sp, ci.sName)) continue;
+
+                vMatching.push_back(ci);
+                vMatching.back().nDecimationFactor = sp.nDecimationFactor;
+                break;
+            }
+        }
+    }
+
+    try {
+        SubscribeNewChannels(vMatching);
+    }
+    catch(...) {
+        std::cerr << "Failed to subscribe to channels matching a pattern" <<
+            std::endl;
     }
 }
 
@@ -296,33 +678,91 @@ void LowLatencyDataClient::ProcessAvailableChannelsPacket(json& j)
 //
 void LowLatencyDataClient::ProcessUnavailableChannelsPacket(json& j)
 {
+    auto                        pAvailable =
+        std::make_shared<AvailableChannels>(*m_pAvailableChannels);
+    auto                        pSubscribed =
+        std::make_shared<SubscribedChannels>(*m_pSubscribedChannels);
+    std::vector<ChannelUnavailableInfo> vRemoved;
+    std::vector<int>            vIds;
+    std::vector<std::string>    vNames =
+        j["unavailable"].get<std::vector<std::string>>();
+    std::vector<ChannelHandle>  vHandles = ChannelNames::FindAll(vNames);
+
     // Process all of the channels listed
-    for(auto& it : j["unavailable"]) {
-        std::string sName(it);
+    {
+        std::unique_lock<std::mutex>    lk(m_SubscriptionsLock);
+        auto                            pIds =
+            std::make_shared<IdsByHandle>(*m_pIdByHandle);
+
+        for(size_t n = 0; n < vNames.size(); n++) {
+            const std::string&  sName = vNames[n];
+            ChannelHandle       h = vHandles[n];
+
+            // If the channel is in the available channels list, remove it
+            if(IsAvailable(*pAvailable, h))
+                (*pAvailable)[h].hChannel = NO_CHANNEL_HANDLE;
+
+            // The channel is in the subscribed channels list, remove it
+            // from that as well.
+            if(IdOf(*pIds, h) >= 0) {
+                int nId = IdOf(*pIds, h);
+                m_Metrics.Unsubscribed(nId);
+                m_Continuity.Unsubscribed(nId);
+                pSubscribed->erase(nId);
+                SetSubscribedId(*pIds, h, -1);
+                vIds.push_back(nId);
+            }
 
-        // If the channel is in the available channels list, remove it
-        if(m_mAvailableChannelsList.find(sName) !=
-            m_mAvailableChannelsList.end()) {
-            m_mAvailableChannelsList.erase(sName);
+            // A subscribe sent for it won't be answered now
+            m_mPendingSubscribe.erase(h);
+
+            // Forget the first sample timestamp for this channel
+            if(h < m_vFSTS.size()) m_vFSTS[h] = 0.0;
+
+            ChannelUnavailableInfo  cuai;
+            cuai.sName = sName;
+            cuai.hChannel = h;
+            vRemoved.push_back(cuai);
         }
 
-        // The channel is in the subscribed channels list, remove it from
-        // that as well.
-        for(auto& e: m_mSubscribedChannelsList) {
-            if(e.second.sName == sName) {
-                UnsubscribeChannel(e.first);
-                m_mSubscribedChannelsList.erase(e.first);
-                break;
-            }
+        if(!vIds.empty()) PublishIdsByHandle(std::move(pIds));
+    }
+
+    // While they're still in the published table.  A failed send must not
+    // keep the new tables from being published.
+    if(!vIds.empty()) {
+        try {
+            UnsubscribeChannels(vIds);
         }
+        catch(...) {
+            std::cerr << "Failed to unsubscribe from unavailable channels" <<
+                std::endl;
+        }
+    }
+
+    PublishAvailableChannels(std::move(pAvailable));
+    PublishSubscribedChannels(std::move(pSubscribed));
+
+    // Let the user know the channels are no longer available
+    for(auto& cuai : vRemoved)
+        CallEventHandler(EVENT_TYPE_UNAVAILABLE_CHANNEL, &cuai, sizeof(cuai));
+}
 
-        // Remove the first sample timestamp for this channel
-        if(m_mFSTS.find(sName) != m_mFSTS.end()) m_mFSTS.erase(sName);
+//
+// Function used to get the client counters
+//
+ClientMetricsSnapshot LowLatencyDataClient::Metrics(void)
+{
+    ClientMetricsSnapshot       s = m_Metrics.Snapshot();
+    boost::system::error_code   ec;
 
-        // Let the user know the channel is no longer available
-        m_fEventHandler(EVENT_TYPE_UNAVAILABLE_CHANNEL,
-            sName.c_str(), sName.size());
+    if(m_Socket) {
+        size_t  n = m_Socket->available(ec);
+        if(!ec) s.nReceiveQueueBytes = n;
     }
+    s.nReceiveBufferBytes = m_nDataBytes;
+
+    return s;
 }
 
 //
@@ -345,16 +785,19 @@ void LowLatencyDataClient::ProcessAcquisitionStatePacket(json& j)
         // If acquisition state is "off" reset the first sample timestamps for
         // all of the subscribed channels.
 
-        for(auto& e: m_mSubscribedChannelsList) {
+        for(auto& e: *m_pSubscribedChannels) {
+
+            ChannelHandle   h = e.second.hChannel;
+            m_vFSTS[h] = 0.0;
+            m_Continuity.Restart(e.first, 0.0);
 
-            std::string sName = e.second.sName;
-            m_mFSTS[sName] = 0.0;
             ChannelTimestampInfo   ctsi;
-            ctsi.sName = sName;
+            ctsi.sName = e.second.sName;
+            ctsi.hChannel = h;
             ctsi.nId = e.first;
-            ctsi.dFirstSampleTimestamp = m_mFSTS[sName];
+            ctsi.dFirstSampleTimestamp = m_vFSTS[h];
 
-            m_fEventHandler(EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS, &ctsi,
+            CallEventHandler(EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS, &ctsi,
                 sizeof(ctsi));
         }
 
@@ -363,13 +806,17 @@ void LowLatencyDataClient::ProcessAcquisitionStatePacket(json& j)
     } else if(j["acquisition_state"] == "on") {
         m_bAcquisitionState = true;
 
+        // Samples count from the start of acquisition
+        for(auto& e: *m_pSubscribedChannels)
+            m_Continuity.Restart(e.first, m_vFSTS[e.second.hChannel]);
+
         if(j.contains("precise_acquisition_start_time")) {
             m_sPreciseAcquisitionStartTime.assign(
                 j["precise_acquisition_start_time"]);
         }
     }
 
-    m_fEventHandler(EVENT_TYPE_ACQUIRE, &m_bAcquisitionState,
+    CallEventHandler(EVENT_TYPE_ACQUIRE, &m_bAcquisitionState,
         sizeof(m_bAcquisitionState));
 }
 
@@ -389,28 +836,36 @@ void LowLatencyDataClient::ProcessMetadataPacket(
     try {
         json    j = json::parse(str);
 
-        if(j.contains("unsubscribed"))
+        if(j.contains("unsubscribed")) {
+            m_Metrics.Metadata(METADATA_TYPE_UNSUBSCRIBED);
             ProcessUnsubscribeResponsePacket(j);
 
-        else if(j.contains("subscribed"))
+        } else if(j.contains("subscribed")) {
+            m_Metrics.Metadata(METADATA_TYPE_SUBSCRIBED);
             ProcessSubscribeResponsePacket(j);
 
-        else if(j.contains("available"))
+        } else if(j.contains("available")) {
+            m_Metrics.Metadata(METADATA_TYPE_AVAILABLE);
             ProcessAvailableChannelsPacket(j);
 
-        else if(j.contains("unavailable"))
+        } else if(j.contains("unavailable")) {
+            m_Metrics.Metadata(METADATA_TYPE_UNAVAILABLE);
             ProcessUnavailableChannelsPacket(j);
 
-        else if(j.contains("acquisition_state"))
+        } else if(j.contains("acquisition_state")) {
+            m_Metrics.Metadata(METADATA_TYPE_ACQUISITION_STATE);
             ProcessAcquisitionStatePacket(j);
 
-        else if(j.contains("status"))
-            ;
+        } else if(j.contains("status")) {
+            m_Metrics.Metadata(METADATA_TYPE_STATUS);
 
-        else
+        } else {
+            m_Metrics.Metadata(METADATA_TYPE_UNKNOWN);
             std::cerr << "Unknown JSON" << std::endl << j.dump() << std::endl;
+        }
     }
     catch(...) {
+        m_Metrics.Metadata(METADATA_TYPE_PARSE_ERROR);
         std::cerr << std::endl << "Failed to parse incoming JSON" << std::endl;
         std::cerr << "Length: " << pHeader->length << std::endl;
         std::cerr << "ID: " << std::hex << pHeader->id << std::endl;
@@ -424,24 +879,55 @@ void LowLatencyDataClient::ProcessMetadataPacket(
 }
 
 //
-// Function used to send subscribe channels
+// Function used to send a packet to the server, counting failures
 //
-void LowLatencyDataClient::SendSubscribeChannels(
-    const std::vector<ChannelInfo>& vChannelsList)
+void LowLatencyDataClient::SendPacket(
+    const std::vector<boost::asio::const_buffer>& vSendList)
 {
-    json    j;
+    std::unique_lock<std::mutex>    lk(m_SendLock);
 
-    bool    bHaveChannels = false;
-    for(auto& e : vChannelsList) {
-        // If the channel is NOT available, skip it
-        if(m_mAvailableChannelsList.find(e.sName) ==
-            m_mAvailableChannelsList.end()) continue;
+    try {
+        m_Socket->send(boost::make_iterator_range(vSendList.begin(),
+            vSendList.end()));
+    }
+    catch(...) {
+        m_Metrics.SendFailure();
+        throw;
+    }
+}
 
-        bHaveChannels = true;
-        j["subscribe"][e.sName] = e.nDecimationFactor;
+//
+// Function used to send subscribe channels, noting those sent as pending.
+// With bNewOnly those subscribed or pending already are left out.
+//
+void LowLatencyDataClient::SendSubscribeChannels(
+    const std::vector<ChannelInfo>& vChannelsList, bool bNewOnly)
+{
+    json                        j;
+    auto                        pAvailable = AvailableChannelsSnapshot();
+    std::vector<ChannelHandle>  vSent;
+
+    {
+        std::unique_lock<std::mutex>    lk(m_SubscriptionsLock);
+        auto                            pIds = std::atomic_load(&m_pIdByHandle);
+
+        for(auto& e : vChannelsList) {
+            // If the channel is NOT available, skip it
+            if(!IsAvailable(*pAvailable, e.hChannel)) continue;
+
+            if(!bNewOnly)
+                m_mPendingSubscribe[e.hChannel] = e.nDecimationFactor;
+            else if(IdOf(*pIds, e.hChannel) >= 0 ||
+                !m_mPendingSubscribe.emplace(e.hChannel,
+                e.nDecimationFactor).second)
+                continue;
+
+            vSent.push_back(e.hChannel);
+            j["subscribe"][e.sName] = e.nDecimationFactor;
+        }
     }
 
-    if(!bHaveChannels) return;
+    if(vSent.empty()) return;
 
     std::string str(j.dump());
     std::vector<boost::asio::const_buffer>  vSendList;
@@ -454,8 +940,15 @@ void LowLatencyDataClient::SendSubscribeChannels(
     vSendList.push_back(boost::asio::buffer(&Header, sizeof(Header)));
     vSendList.push_back(boost::asio::buffer(str.data(), str.length()));
 
-    m_Socket->send(boost::make_iterator_range(vSendList.begin(),
-        vSendList.end()));
+    // Not sent after all, they won't be answered
+    try {
+        SendPacket(vSendList);
+    }
+    catch(...) {
+        std::unique_lock<std::mutex>    lk(m_SubscriptionsLock);
+        for(ChannelHandle h : vSent) m_mPendingSubscribe.erase(h);
+        throw;
+    }
 }
 
 //
@@ -463,10 +956,28 @@ void LowLatencyDataClient::SendSubscribeChannels(
 //
 int LowLatencyDataClient::SubscribedChannelId(std::string& sName)
 {
-    for(auto& e : m_mSubscribedChannelsList)
-        if(e.second.sName == sName) return e.first;
+    ChannelHandle   h = ChannelNames::Find(sName);
+    return h == NO_CHANNEL_HANDLE ? -1 : SubscribedChannelId(h);
+}
 
-    return -1;
+//
+// Function used to get the id for a subscribed channel by handle, without
+// taking a lock
+//
+int LowLatencyDataClient::SubscribedChannelId(ChannelHandle h)
+{
+    return IdOf(*std::atomic_load(&m_pIdByHandle), h);
+}
+
+//
+// Function used to note the id of a subscribed channel, -1 for none, in a
+// copy of the ids about to be published
+//
+void LowLatencyDataClient::SetSubscribedId(IdsByHandle& v, ChannelHandle h,
+    int nId)
+{
+    if(h >= v.size()) v.resize(h + 1, -1);
+    v[h] = nId;
 }
 
 //
@@ -475,13 +986,17 @@ int LowLatencyDataClient::SubscribedChannelId(std::string& sName)
 void LowLatencyDataClient::SubscribeChannels(
     const std::vector<ChannelInfo>& vChannelsList)
 {
-    // Add the channels to the pending channel subscribe list
-    m_vPendingSubscribeChannelsList.insert(
-        m_vPendingSubscribeChannelsList.end(),
-        vChannelsList.begin(), vChannelsList.end());
+    // Go by handle from here on, whatever the caller left in hChannel
+    std::vector<ChannelInfo>    vChannels(vChannelsList);
+    std::vector<std::string>    vNames;
+
+    for(auto& ci : vChannels) vNames.push_back(ci.sName);
+    std::vector<ChannelHandle>  vHandles = ChannelNames::InternAll(vNames);
+    for(size_t n = 0; n < vChannels.size(); n++)
+        vChannels[n].hChannel = vHandles[n];
 
     // Send the subscribe request
-    SendSubscribeChannels(vChannelsList);
+    SendSubscribeChannels(vChannels, false);
 }
 
 //
@@ -500,6 +1015,119 @@ void LowLatencyDataClient::SubscribeChannel(std::string& sName,
     SubscribeChannels(vChannelsList);
 }
 
+//
+// Function used to subscribe to a single channel by handle
+//
+void LowLatencyDataClient::SubscribeChannel(ChannelHandle h,
+    int nDecimationFactor)
+{
+    std::string sName(ChannelNames::Name(h));
+    SubscribeChannel(sName, nDecimationFactor);
+}
+
+//
+// Function used to subscribe to the channels not already subscribed to or
+// being subscribed to
+//
+void LowLatencyDataClient::SubscribeNewChannels(
+    const std::vector<ChannelInfo>& vChannelsList)
+{
+    SendSubscribeChannels(vChannelsList, true);
+}
+
+//
+// Function used to tell whether a channel name matches a pattern
+//
+bool LowLatencyDataClient::PatternMatches(const SubscribePattern& sp,
+    const std::string& sName)
+{
+    if(sp.bRegex) return std::regex_match(sName, sp.Regex);
+    return ChannelNames::Matches(sp.sPattern, sName);
+}
+
+//
+// Function used to add a pattern and subscribe to the available channels
+// that match it
+//
+void LowLatencyDataClient::AddSubscribePattern(const SubscribePattern& sp)
+{
+    // Added before looking at what's available, so a channel that becomes
+    // available meanwhile is seen here, by the socket read thread or both
+    {
+        std::unique_lock<std::mutex>    lk(m_SubscribePatternsLock);
+        m_vSubscribePatterns.push_back(sp);
+    }
+
+    std::vector<ChannelInfo>    vMatching;
+    for(auto& ci : *AvailableChannelsSnapshot()) {
+        if(ci.hChannel == NO_CHANNEL_HANDLE) continue;
+        if(!PatternMatches(sp, ci.sName)) continue;
+
+        vMatching.push_back(ci);
+        vMatching.back().nDecimationFactor = sp.nDecimationFactor;
+    }
+
+    SubscribeNewChannels(vMatching);
+}
+
+//
+// Function used to subscribe to the channels whose names match a pattern
+// with * and ? wildcards, now and whenever they become available
+//
+void LowLatencyDataClient::SubscribeMatching(const std::string& sPattern,
+    int nDecimationFactor)
+{
+    SubscribePattern    sp;
+
+    sp.sPattern = sPattern;
+    sp.bRegex = false;
+    sp.nDecimationFactor = nDecimationFactor;
+
+    AddSubscribePattern(sp);
+}
+
+//
+// Function used to subscribe to the channels whose whole names match a
+// regular expression, now and whenever they become available.  Returns
+// false if the expression is bad.
+//
+bool LowLatencyDataClient::SubscribeMatchingRegex(const std::string& sRegex,
+    int nDecimationFactor)
+{
+    SubscribePattern    sp;
+
+    sp.sPattern = sRegex;
+    sp.bRegex = true;
+    sp.nDecimationFactor = nDecimationFactor;
+
+    try {
+        sp.Regex.assign(sRegex, std::regex::ECMAScript | std::regex::optimize);
+    }
+    catch(std::regex_error& e) {
+        std::cerr << "Bad channel pattern '" << sRegex << "': " << e.what() <<
+            std::endl;
+        return false;
+    }
+
+    AddSubscribePattern(sp);
+    return true;
+}
+
+//
+// Function used to stop subscribing to channels as they become available
+// for a pattern, those subscribed stay subscribed
+//
+void LowLatencyDataClient::StopMatching(const std::string& sPattern)
+{
+    std::unique_lock<std::mutex>    lk(m_SubscribePatternsLock);
+
+    auto&   v = m_vSubscribePatterns;
+    v.erase(std::remove_if(v.begin(), v.end(),
+        [&sPattern](const SubscribePattern& sp) {
+            return sp.sPattern == sPattern;
+        }), v.end());
+}
+
 //
 // Function used to send unsubscribe packet
 //
@@ -512,10 +1140,11 @@ void LowLatencyDataClient::SendUnsubscribeChannels(
         std::cerr << std::endl << std::endl << __FUNCTION__ << std::endl;
     }
 
+    auto    pSubscribed = SubscribedChannelsSnapshot();
+
     bool    bHaveChannels = false;
     for(auto& nChId : vChannelIdsList) {
-        if(m_mSubscribedChannelsList.find(nChId) ==
-            m_mSubscribedChannelsList.end()) continue;
+        if(pSubscribed->find(nChId) == pSubscribed->end()) continue;
 
         bHaveChannels = true;
         j["unsubscribe"].push_back(nChId);
@@ -534,8 +1163,7 @@ void LowLatencyDataClient::SendUnsubscribeChannels(
     vSendList.push_back(boost::asio::buffer(&Header, sizeof(Header)));
     vSendList.push_back(boost::asio::buffer(str.data(), str.length()));
 
-    m_Socket->send(boost::make_iterator_range(vSendList.begin(),
-        vSendList.end()));
+    SendPacket(vSendList);
 }
 
 //
@@ -576,6 +1204,5 @@ void LowLatencyDataClient::Acquire(void)
     vSendList.push_back(boost::asio::buffer(&Header, sizeof(Header)));
     vSendList.push_back(boost::asio::buffer(str.data(), str.length()));
 
-    m_Socket->send(boost::make_iterator_range(vSendList.begin(),
-        vSendList.end()));
+    SendPacket(vSendList);
 }
@@ -5,9 +5,23 @@
 #include    <vector>
 #include    <mutex>
 #include    <memory>
+#include    <regex>
 #include    <thread>
+#include    <unordered_map>
 #include    <boost/asio.hpp>
 #include    <nlohmann/json.hpp>
+#include    "ChannelContinuity.h"
+#include    "ChannelNames.h"
+#include    "ClientMetrics.h"
+#include    "ReceiveMemory.h"
+
+// Time each stage of the data packet path, see PacketTiming.h
+
+//#define WITH_PACKET_TIMING
+
+#if defined(WITH_PACKET_TIMING)
+#include    "PacketTiming.h"
+#endif
 
 using json = nlohmann::json;
 using boost::asio::ip::tcp;
@@ -19,6 +33,7 @@ using boost::asio::ip::tcp;
 //
 typedef struct {
     std::string         sName;                  // From server "available"
+    ChannelHandle       hChannel;               // Of sName
     std::string         sDataType;              // From server "available"
     double              dScale;                 // From server "available"
     double              dOffset;                // From server "available"
@@ -51,32 +66,67 @@ typedef enum {
     EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS, // "first_sample_ts" JSON received
     EVENT_TYPE_CHANNEL_DATA,            // Channel data received
     EVENT_TYPE_ACQUIRE,                 // "acquisitio_state" JSON received
+    EVENT_TYPE_CHANNEL_GAP,             // Samples found missing or repeated
 } EventType;
 
 //
-// Event type specific data provided with each event type
+// Event type specific data provided with each event type:
 //
+//      EVENT_TYPE_AVAILABLE_CHANNEL        ChannelInfo
+//      EVENT_TYPE_UNAVAILABLE_CHANNEL      ChannelUnavailableInfo
+//      EVENT_TYPE_CHANNEL_SUBSCRIBED       ChannelSubscribedInfo
+//      EVENT_TYPE_CHANNEL_UNSUBSCRIBED     ChannelUnsubscribedInfo
+//      EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS  ChannelTimestampInfo
+//      EVENT_TYPE_CHANNEL_DATA             ChannelDataInfo
+//      EVENT_TYPE_ACQUIRE                  bool, true when acquiring
+//      EVENT_TYPE_CHANNEL_GAP              ChannelGapInfo
+//
+typedef struct {
+    std::string     sName;                  // Name of the channel
+    ChannelHandle   hChannel;               // Of sName, NO_CHANNEL_HANDLE
+                                            // if never available
+} ChannelUnavailableInfo;
+
 typedef struct {
-    std::string sName;                      // Name of the channel
-    int         nId;                        // Subcribed ID of the channel
-    double      dFirstSampleTimestamp;      // Timestamp of first sample
+    std::string     sName;                  // Name of the channel
+    ChannelHandle   hChannel;               // Of sName
+    int             nId;                    // Subcribed ID of the channel
+    double          dFirstSampleTimestamp;  // Timestamp of first sample
 } ChannelTimestampInfo;
 
 typedef struct {
-    std::string sName;                      // Name of the channel
-    int         nId;                        // Assigned Id
+    std::string     sName;                  // Name of the channel
+    ChannelHandle   hChannel;               // Of sName
+    int             nId;                    // Assigned Id
+    uint32_t        nDecimationFactor;      // Decimation factor requested
 } ChannelSubscribedInfo;
 
 typedef struct {
-    int         nId;                        // Id of channel unsubscribed
+    ChannelHandle   hChannel;               // Of the channel unsubscribed
+    int             nId;                    // Id of channel unsubscribed
 } ChannelUnsubscribedInfo;
 
 typedef struct {
-    int         nId;                        // Id of the channel this data is 4
-    float       *pData;                     // Pointer to the data
-    size_t      nSamples;                   // Number of data samples
+    ChannelHandle   hChannel;               // Of the channel this data is for
+    int             nId;                    // Id of the channel this data is 4
+    float           *pData;                 // Pointer to the data
+    size_t          nSamples;               // Number of data samples
 } ChannelDataInfo;
 
+typedef struct {
+    std::string     sName;                  // Name of the channel
+    ChannelHandle   hChannel;               // Of sName
+    int             nId;                    // Subscribed ID of the channel
+    int64_t         nSamples;               // > 0 missing, < 0 repeated,
+                                            // some time in the last
+                                            // CONTINUITY_WINDOW or so
+    double          dNextSampleTimestamp;   // Of the next data, corrected
+    uint64_t        nGaps;                  // Since subscribed, this one
+    uint64_t        nMissingSamples;        // included
+    uint64_t        nOverlaps;
+    uint64_t        nRepeatedSamples;
+} ChannelGapInfo;
+
 //
 // Type for user event handler function
 //
@@ -93,22 +143,79 @@ class LowLatencyDataClient {
         ~LowLatencyDataClient();
 
         LowLatencyDataClient(boost::asio::io_context& io_context,
-            std::string&, std::string&, EventHandler);
+            std::string&, std::string&, EventHandler,
+            std::shared_ptr<ReceiveMemoryPool> pReceiveMemory = nullptr);
 
         void SubscribeChannel(std::string&, int nDecimationFactor = 1);
+        void SubscribeChannel(ChannelHandle, int nDecimationFactor = 1);
 
         void SubscribeChannels(const std::vector<ChannelInfo>&);
 
+        void SubscribeMatching(const std::string& sPattern,
+            int nDecimationFactor = 1);
+        bool SubscribeMatchingRegex(const std::string& sRegex,
+            int nDecimationFactor = 1);
+        void StopMatching(const std::string& sPattern);
+
         int SubscribedChannelId(std::string&);
+        int SubscribedChannelId(ChannelHandle);
 
         void UnsubscribeChannels(const std::vector<int>&);
         void UnsubscribeChannel(int);
 
         void Acquire(void);
 
+        bool Connected(void) const;
+
         const std::string& PreciseAcquisitionStartTime(void);
 
+        ClientMetricsSnapshot Metrics(void);
+
+        void SetContinuityTolerance(double dSeconds);
+
+#if defined(WITH_PACKET_TIMING)
+        std::vector<ChannelTimingSnapshot> TimingSnapshot(bool bReset = false);
+#endif
+
     private:
+        // Lets ll-bench time the packet processing without a server
+        friend class LowLatencyDataClientBench;
+
+        // By handle, hChannel is NO_CHANNEL_HANDLE for those not available
+        typedef std::vector<ChannelInfo>            AvailableChannels;
+        typedef std::map<int, ChannelInfo>          SubscribedChannels;
+        typedef std::vector<int>                    IdsByHandle;    // -1 =
+                                                                    // none
+
+        static bool IsAvailable(const AvailableChannels& v, ChannelHandle h)
+        {
+            return h < v.size() && v[h].hChannel == h;
+        }
+
+        // Channels to subscribe to whenever they become available
+        typedef struct {
+            std::string     sPattern;
+            bool            bRegex;             // Else * and ? wildcards
+            std::regex      Regex;
+            uint32_t        nDecimationFactor;
+        } SubscribePattern;
+
+        static bool PatternMatches(const SubscribePattern&,
+            const std::string& sName);
+        void AddSubscribePattern(const SubscribePattern&);
+        void SubscribeNewChannels(const std::vector<ChannelInfo>&);
+
+        std::shared_ptr<const AvailableChannels> AvailableChannelsSnapshot(
+            void) const;
+        std::shared_ptr<const SubscribedChannels> SubscribedChannelsSnapshot(
+            void) const;
+        void PublishAvailableChannels(std::shared_ptr<AvailableChannels>);
+        void PublishSubscribedChannels(std::shared_ptr<SubscribedChannels>);
+        void PublishIdsByHandle(std::shared_ptr<IdsByHandle>);
+        static int IdOf(const IdsByHandle& v, ChannelHandle h)
+        {
+            return h < v.size() ? v[h] : -1;
+        }
 
         void Connect(boost::asio::io_context& io_context,
             std::string&, std::string&);
@@ -116,6 +223,7 @@ class LowLatencyDataClient {
         void ProcessPacket(LowLatencyStreamPacketHeader *);
 
         void ProcessDataPacket(LowLatencyStreamPacketHeader *);
+        void CheckContinuity(int nId, const ChannelInfo&);
 
         void ProcessUnsubscribeResponsePacket(json&);
         void ProcessSubscribeResponsePacket(json&);
@@ -124,35 +232,80 @@ class LowLatencyDataClient {
         void ProcessAcquisitionStatePacket(json&);
         void ProcessMetadataPacket(LowLatencyStreamPacketHeader *);
 
-        void SendSubscribeChannels(const std::vector<ChannelInfo>&);
+        void CallEventHandler(EventType, const void *, size_t);
+
+        void SendPacket(const std::vector<boost::asio::const_buffer>&);
+        static void SetSubscribedId(IdsByHandle&, ChannelHandle, int nId);
+        void SendSubscribeChannels(const std::vector<ChannelInfo>&,
+            bool bNewOnly);
         void SendUnsubscribeChannels(const std::vector<int>&);
 
         void SocketReadThread(void);
+        bool GrowData(size_t nBytes, size_t nKeepBytes);
+
+#if defined(WITH_PACKET_TIMING)
+        size_t ReceiveTimestamped(uint8_t *, size_t, uint64_t *pnKernelNs);
+#endif
 
         std::thread                         *m_SocketReadThread;
         volatile bool                       m_bSocketReadThreadExit;
-
-        std::mutex                          m_AvailableChannelsListLock;
-        std::mutex                          m_SubscribedChannelsListLock;
-
-        std::map<std::string, ChannelInfo>  m_mAvailableChannelsList;
-        std::map<int, ChannelInfo>          m_mSubscribedChannelsList;
-
-        std::vector<ChannelInfo>            m_vPendingSubscribeChannelsList;
+        std::atomic<bool>                   m_bConnected;
+
+        // Channel tables, never changed once published.  The socket read
+        // thread is the only one to replace them, with an edited copy, so
+        // it reads them as they are; other threads take a snapshot.
+        std::shared_ptr<const AvailableChannels>    m_pAvailableChannels;
+        std::shared_ptr<const SubscribedChannels>   m_pSubscribedChannels;
+
+        // Subscriptions sent but not yet answered (decimation, by handle),
+        // and the id of each subscribed channel by handle, so responses for
+        // thousands of channels are no more than a lookup per channel.
+        // The ids are published like the channel tables, by the socket
+        // read thread with the lock held, so any thread can look one up
+        // without it and those holding it see them agree with the pending
+        // subscribes.
+        std::mutex                              m_SubscriptionsLock;
+        std::unordered_map<ChannelHandle, uint32_t> m_mPendingSubscribe;
+        std::shared_ptr<const IdsByHandle>      m_pIdByHandle;
+
+        std::mutex                          m_SubscribePatternsLock;
+        std::vector<SubscribePattern>       m_vSubscribePatterns;
+
+        // The socket read thread sends subscribes for patterns as well as
+        // the user's thread
+        std::mutex                          m_SendLock;
 
         EventHandler                        m_fEventHandler;
 
-        enum { recvBufSize = (1024 * 1024 * 16) };
-
-        uint8_t                             *m_Data;
+        // Memory packets are read into, a block of a pool that may be
+        // shared with other clients, swapped for a bigger one as needed
+        std::shared_ptr<ReceiveMemoryPool>  m_pReceiveMemory;
+        ReceiveBlock                        m_Data;
+        std::atomic<size_t>                 m_nDataBytes;   // For Metrics()
 
         bool                                m_bAcquisitionState;
 
         std::unique_ptr<tcp::socket>        m_Socket;
 
-        std::map<std::string, double>       m_mFSTS;    // first sample ts's
+        // Highest id the server has assigned, data for any above is a
+        // framing error.  Socket read thread only.
+        int64_t                             m_nMaxSubscribedId;
+
+        std::vector<double>                 m_vFSTS;    // first sample ts's,
+                                                        // by handle
 
         std::string                         m_sPreciseAcquisitionStartTime;
+
+        ClientMetrics                       m_Metrics;
+
+        ChannelContinuity                   m_Continuity;
+
+#if defined(WITH_PACKET_TIMING)
+        PacketTiming                        m_Timing;
+        uint64_t                            m_nPacketKernelNs;
+        uint64_t                            m_nPacketHeaderNs;
+        uint64_t                            m_nPacketCompleteNs;
+#endif
 };
 
 #endif
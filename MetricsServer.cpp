@@ -0,0 +1,173 @@
+#include "MetricsServer.h"
+#include <iostream>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/time.h>
+#endif
+
+namespace http = boost::beast::http;
+using boost::asio::ip::tcp;
+
+#define REQUEST_TIMEOUT_MS  2000        // For a scraper to send its request
+
+//
+// Constructor
+//
+MetricsServer::MetricsServer(const MetricsServerConfig& config,
+    std::function<std::string(void)> fRender)
+    : m_Config(config)
+    , m_fRender(fRender)
+    , m_bStop(false)
+    , m_nRequests(0)
+{
+    if(m_Config.sAddress.empty()) m_Config.sAddress.assign("127.0.0.1");
+}
+
+//
+// Destructor
+//
+MetricsServer::~MetricsServer()
+{
+    Stop();
+}
+
+//
+// Function used to start listening for scrapes
+//
+bool MetricsServer::Start(void)
+{
+    try {
+        tcp::resolver   resolver(m_IoContext);
+        tcp::endpoint   ep = *resolver.resolve(m_Config.sAddress,
+            m_Config.sPort).begin();
+
+        m_Acceptor = std::make_unique<tcp::acceptor>(m_IoContext);
+        m_Acceptor->open(ep.protocol());
+        m_Acceptor->set_option(tcp::acceptor::reuse_address(true));
+        m_Acceptor->bind(ep);
+        m_Acceptor->listen();
+    }
+    catch(std::exception& e) {
+        std::cerr << "Unable to serve metrics on port " << m_Config.sPort <<
+            ": " << e.what() << std::endl;
+        m_Acceptor.reset();
+        return false;
+    }
+
+    m_bStop = false;
+    m_AcceptThread = std::thread([this]() { AcceptThread(); });
+
+    return true;
+}
+
+//
+// Function used to stop serving
+//
+void MetricsServer::Stop(void)
+{
+    if(!m_AcceptThread.joinable()) return;
+
+    m_bStop = true;
+
+    // Wake the blocking accept with a connection of our own
+    try {
+        tcp::endpoint   ep = m_Acceptor->local_endpoint();
+        if(ep.address().is_unspecified())
+            ep.address(boost::asio::ip::address_v4::loopback());
+
+        tcp::socket s(m_IoContext);
+        s.connect(ep);
+    }
+    catch(...) {
+    }
+
+    m_AcceptThread.join();
+    m_Acceptor.reset();
+}
+
+//
+// Function used to get the port being listened on, 0 if not started
+//
+uint16_t MetricsServer::Port(void) const
+{
+    boost::system::error_code   ec;
+
+    if(!m_Acceptor) return 0;
+
+    tcp::endpoint   ep = m_Acceptor->local_endpoint(ec);
+    return ec ? 0 : ep.port();
+}
+
+//
+// Thread used to accept and answer scrapes one at a time
+//
+void MetricsServer::AcceptThread(void)
+{
+    while(!m_bStop) {
+        tcp::socket                 s(m_IoContext);
+        boost::system::error_code   ec;
+
+        m_Acceptor->accept(s, ec);
+        if(m_bStop) break;
+
+        if(ec) {
+            std::cerr << "Metrics accept failed: " << ec.message() <<
+                std::endl;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+
+        Serve(s);
+    }
+}
+
+//
+// Function used to answer one request
+//
+void MetricsServer::Serve(tcp::socket& s)
+{
+    // Don't let a connection that never asks hold up the rest
+#if defined(__linux__)
+    struct timeval  tv = { REQUEST_TIMEOUT_MS / 1000,
+        (REQUEST_TIMEOUT_MS % 1000) * 1000 };
+    ::setsockopt(s.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+#else
+    DWORD   nTimeout = REQUEST_TIMEOUT_MS;
+    ::setsockopt(s.native_handle(), SOL_SOCKET, SO_RCVTIMEO,
+        reinterpret_cast<const char *>(&nTimeout), sizeof(nTimeout));
+#endif
+
+    boost::beast::flat_buffer           buffer;
+    http::request<http::string_body>    req;
+    boost::system::error_code           ec;
+
+    http::read(s, buffer, req, ec);
+    if(ec) return;
+
+    http::response<http::string_body>   res;
+    res.version(req.version());
+    res.keep_alive(false);
+    res.set(http::field::server, "ll-client");
+
+    if(req.method() != http::verb::get) {
+        res.result(http::status::method_not_allowed);
+        res.set(http::field::allow, "GET");
+        res.set(http::field::content_type, "text/plain");
+        res.body() = "Only GET is supported\n";
+    } else if(req.target() != "/metrics") {
+        res.result(http::status::not_found);
+        res.set(http::field::content_type, "text/plain");
+        res.body() = "Metrics are at /metrics\n";
+    } else {
+        res.result(http::status::ok);
+        res.set(http::field::content_type, "text/plain; version=0.0.4");
+        res.body() = m_fRender();
+        m_nRequests++;
+    }
+    res.prepare_payload();
+
+    http::write(s, res, ec);
+    s.shutdown(tcp::socket::shutdown_send, ec);
+}
@@ -0,0 +1,58 @@
+#ifndef __METRICSSERVER_H__
+#define __METRICSSERVER_H__
+
+#include    <atomic>
+#include    <functional>
+#include    <memory>
+#include    <string>
+#include    <thread>
+#include    <boost/asio.hpp>
+
+//
+// Definition of the metrics server settings
+//
+typedef struct {
+    std::string sAddress;               // "" = 127.0.0.1, localhost only
+    std::string sPort;                  // "0" = any free port
+} MetricsServerConfig;
+
+//
+// Definition of the metrics HTTP endpoint.
+//
+// Answers GET /metrics with whatever fRender produces, meant to be the
+// Prometheus text of ClientMetrics::Prometheus().  Scrapes are rare and
+// small, so one thread accepts and answers them in turn, each connection
+// closed after its response and given a couple of seconds to ask.
+//
+class MetricsServer {
+    public:
+        MetricsServer(const MetricsServerConfig&,
+            std::function<std::string(void)> fRender);
+        ~MetricsServer();
+
+        MetricsServer(const MetricsServer&) = delete;
+        MetricsServer& operator=(const MetricsServer&) = delete;
+
+        bool Start(void);
+        void Stop(void);
+
+        uint16_t Port(void) const;
+
+        uint64_t Requests(void) const { return m_nRequests; }
+
+    private:
+        void AcceptThread(void);
+        void Serve(boost::asio::ip::tcp::socket&);
+
+        MetricsServerConfig                             m_Config;
+        std::function<std::string(void)>                m_fRender;
+
+        boost::asio::io_context                         m_IoContext;
+        std::unique_ptr<boost::asio::ip::tcp::acceptor> m_Acceptor;
+        std::thread                                     m_AcceptThread;
+        std::atomic<bool>                               m_bStop;
+
+        std::atomic<uint64_t>                           m_nRequests;
+};
+
+#endif
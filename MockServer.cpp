@@ -0,0 +1,791 @@
+#include "MockServer.h"
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <arpa/inet.h>
+
+#define MAX_COMMAND_LENGTH  (1024 * 1024)   // Largest JSON taken from a client
+#define MAX_IDLE_WAIT_MS    50              // Longest a stream thread sleeps
+#define MAX_CATCH_UP_BLOCKS 64              // Per channel per pass
+#define TWO_PI              6.283185307179586
+
+//
+// Function used to spread the bits of a sample number, for noise that is
+// the same whoever asks for it
+//
+static inline uint64_t Mix(uint64_t n)
+{
+    n += 0x9e3779b97f4a7c15ULL;
+    n = (n ^ (n >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    n = (n ^ (n >> 27)) * 0x94d049bb133111ebULL;
+    return n ^ (n >> 31);
+}
+
+//
+// Definition of one client connection.  The read thread handles the
+// client's commands; the stream thread sends its subscribed channels' data.
+//
+class MockServer::Session {
+    public:
+        Session(MockServer *pServer, tcp::socket&& s, unsigned nSeed)
+            : m_pServer(pServer)
+            , m_Socket(std::move(s))
+            , m_Random(nSeed)
+            , m_bClosed(false)
+            , m_bFinished(false)
+        {
+        }
+
+        ~Session() { Close(); Join(); }
+
+        void Start(void)
+        {
+            m_ReadThread = std::thread([this]() { ReadThread(); });
+            m_StreamThread = std::thread([this]() { StreamThread(); });
+        }
+
+        void Close(void)
+        {
+            {
+                std::unique_lock<std::mutex>    lk(m_SubscribedLock);
+                if(m_bClosed) return;
+                m_bClosed = true;
+                m_Wake.notify_one();
+            }
+
+            boost::system::error_code   ec;
+            m_Socket.shutdown(tcp::socket::shutdown_both, ec);
+        }
+
+        void Join(void)
+        {
+            if(m_ReadThread.joinable()) m_ReadThread.join();
+            if(m_StreamThread.joinable()) m_StreamThread.join();
+        }
+
+        bool IsFinished(void) const { return m_bFinished; }
+
+        //
+        // Function used to let the stream thread know acquisition changed
+        //
+        void Wake(void)
+        {
+            std::unique_lock<std::mutex>    lk(m_SubscribedLock);
+            m_Wake.notify_one();
+        }
+
+        //
+        // Function used to drop every subscription to a channel that has
+        // become unavailable
+        //
+        void Drop(size_t nChannel)
+        {
+            std::unique_lock<std::mutex>    lk(m_SubscribedLock);
+
+            for(auto it = m_mSubscribed.begin(); it != m_mSubscribed.end(); ) {
+                if(it->second.nChannel == nChannel)
+                    it = m_mSubscribed.erase(it);
+                else it++;
+            }
+        }
+
+        bool SendMetadata(const json&);
+
+    private:
+        typedef struct {
+            size_t      nChannel;
+            uint32_t    nDecimationFactor;
+            uint64_t    nNext;              // Next decimated sample to send
+            uint64_t    nGeneration;        // Acquisition it belongs to
+        } Subscription;
+
+        void ReadThread(void);
+        void StreamThread(void);
+        void Subscribe(const json&);
+        void Unsubscribe(const json&);
+        bool Write(const uint8_t *, size_t, bool bData);
+
+        MockServer                      *m_pServer;
+        tcp::socket                     m_Socket;
+        std::mutex                      m_WriteLock;
+        std::mt19937                    m_Random;       // Faults, write lock
+
+        std::mutex                      m_SubscribedLock;
+        std::condition_variable         m_Wake;
+        std::map<int, Subscription>     m_mSubscribed;  // By id
+        bool                            m_bClosed;
+
+        std::thread                     m_ReadThread;
+        std::thread                     m_StreamThread;
+        std::atomic<bool>               m_bFinished;
+};
+
+//
+// Function used to write a packet, applying whatever faults are configured.
+// Returns false once the connection has failed.
+//
+bool MockServer::Session::Write(const uint8_t *p, size_t nBytes, bool bData)
+{
+    const MockFaults&   f = m_pServer->m_Config.Faults;
+    std::unique_lock<std::mutex>    lk(m_WriteLock);
+    std::uniform_real_distribution<double>  uniform(0.0, 1.0);
+
+    if(bData && f.dDropRate > 0.0 && uniform(m_Random) < f.dDropRate) {
+        m_pServer->m_nDropped++;
+        return true;
+    }
+
+    std::vector<uint8_t>    vCorrupt;
+    if(bData && f.dCorruptRate > 0.0 && uniform(m_Random) < f.dCorruptRate) {
+        vCorrupt.assign(p, p + nBytes);
+        LowLatencyStreamPacketHeader    *h =
+            reinterpret_cast<LowLatencyStreamPacketHeader *>(vCorrupt.data());
+
+        // An id the client has never seen or a length it cannot take
+        if(m_Random() & 1) h->id = ::htonl(0x40000000 | (m_Random() & 0xffff));
+        else h->length = ::htonl(0x7ffffff0);
+
+        p = vCorrupt.data();
+        m_pServer->m_nCorrupted++;
+    }
+
+    boost::system::error_code   ec;
+
+    if(!f.nFragmentBytes) {
+        if(f.nSlowWriteUs)
+            std::this_thread::sleep_for(std::chrono::microseconds(
+                f.nSlowWriteUs));
+        boost::asio::write(m_Socket, boost::asio::buffer(p, nBytes), ec);
+        return !ec;
+    }
+
+    // Pieces of random size, each its own send
+    std::uniform_int_distribution<size_t>   piece(1, f.nFragmentBytes);
+    for(size_t nOffset = 0; nOffset < nBytes && !ec; ) {
+        size_t  n = std::min(piece(m_Random), nBytes - nOffset);
+        boost::asio::write(m_Socket, boost::asio::buffer(p + nOffset, n), ec);
+        nOffset += n;
+
+        if(f.nSlowWriteUs && nOffset < nBytes)
+            std::this_thread::sleep_for(std::chrono::microseconds(
+                f.nSlowWriteUs));
+    }
+
+    return !ec;
+}
+
+//
+// Function used to send a metadata packet
+//
+bool MockServer::Session::SendMetadata(const json& j)
+{
+    std::string             str(j.dump());
+    std::vector<uint8_t>    v(sizeof(LowLatencyStreamPacketHeader) +
+        str.size());
+
+    LowLatencyStreamPacketHeader    *h =
+        reinterpret_cast<LowLatencyStreamPacketHeader *>(v.data());
+    h->id = ::htonl(METADATA_ID);
+    h->length = ::htonl(static_cast<uint32_t>(v.size()));
+    ::memcpy(h + 1, str.data(), str.size());
+
+    return Write(v.data(), v.size(), false);
+}
+
+//
+// Function used to handle a subscribe command.  Channels start with the
+// next sample on their decimated grid, or the first one of the next
+// acquisition.
+//
+void MockServer::Session::Subscribe(const json& j)
+{
+    // Availability and the acquisition cannot change under us
+    std::unique_lock<std::mutex>    lkServer(m_pServer->m_Lock);
+
+    const bool      bAcquiring = m_pServer->m_bAcquiring;
+    const uint64_t  nGeneration = m_pServer->m_nAcquisitionGeneration;
+    const uint64_t  nStartNs = m_pServer->m_nStartNs;
+    double  dElapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - m_pServer->m_tStart).count();
+
+    json    jReply;
+    std::unique_lock<std::mutex>    lk(m_SubscribedLock);
+
+    for(auto& e : j.items()) {
+        auto    it = std::find_if(m_pServer->m_vChannels.begin(),
+            m_pServer->m_vChannels.end(), [&e](const Channel& c) {
+                return c.Config.sName == e.key();
+            });
+        if(it == m_pServer->m_vChannels.end() || !it->bAvailable) continue;
+
+        size_t  nChannel = it - m_pServer->m_vChannels.begin();
+        bool    bSubscribed = false;
+        for(auto& s : m_mSubscribed)
+            if(s.second.nChannel == nChannel) bSubscribed = true;
+        if(bSubscribed) continue;
+
+        // Lowest id not in use
+        int nId = 0;
+        while(m_mSubscribed.find(nId) != m_mSubscribed.end()) nId++;
+
+        Subscription    s;
+        s.nChannel = nChannel;
+        s.nDecimationFactor = std::max(1, e.value().get<int>());
+        s.nGeneration = nGeneration;
+        s.nNext = 0;
+
+        uint64_t    nFstsNs = 0;
+        if(bAcquiring) {
+            const double    dRate = it->Config.dSampleRate;
+            uint64_t        nRaw = static_cast<uint64_t>(dElapsed * dRate);
+
+            s.nNext = (nRaw + s.nDecimationFactor - 1) / s.nDecimationFactor;
+            nFstsNs = nStartNs + static_cast<uint64_t>(std::llround(
+                static_cast<double>(s.nNext * s.nDecimationFactor) / dRate *
+                1e9));
+        }
+        m_mSubscribed[nId] = s;
+
+        jReply["subscribed"].push_back({
+            { "name", it->Config.sName },
+            { "id", nId },
+            { "first_sample_timestamp_ns", nFstsNs },
+        });
+    }
+
+    // Answer before any of the data goes out
+    if(!jReply.empty()) SendMetadata(jReply);
+    m_Wake.notify_one();
+}
+
+//
+// Function used to handle an unsubscribe command
+//
+void MockServer::Session::Unsubscribe(const json& j)
+{
+    json    jReply;
+
+    std::unique_lock<std::mutex>    lk(m_SubscribedLock);
+
+    for(auto& e : j) {
+        auto    it = m_mSubscribed.find(e.get<int>());
+        if(it == m_mSubscribed.end()) continue;
+
+        jReply["unsubscribed"].push_back(
+            m_pServer->m_vChannels[it->second.nChannel].Config.sName);
+        m_mSubscribed.erase(it);
+    }
+
+    if(!jReply.empty()) SendMetadata(jReply);
+}
+
+//
+// Thread used to read commands from the client
+//
+void MockServer::Session::ReadThread(void)
+{
+    std::vector<char>   vCommand;
+
+    while(true) {
+        LowLatencyStreamPacketHeader    Header;
+        boost::system::error_code       ec;
+
+        boost::asio::read(m_Socket, boost::asio::buffer(&Header,
+            sizeof(Header)), ec);
+        if(ec) break;
+
+        uint32_t    nId = ::ntohl(Header.id);
+        uint32_t    nLength = ::ntohl(Header.length);
+
+        if(nId != METADATA_ID || nLength < sizeof(Header) ||
+            nLength > MAX_COMMAND_LENGTH) {
+            std::cerr << "Bad packet from client, id " << std::hex << nId <<
+                std::dec << " length " << nLength << std::endl;
+            break;
+        }
+
+        vCommand.resize(nLength - sizeof(Header));
+        boost::asio::read(m_Socket, boost::asio::buffer(vCommand), ec);
+        if(ec) break;
+
+        try {
+            json    j = json::parse(vCommand.begin(), vCommand.end());
+
+            if(j.contains("subscribe")) Subscribe(j["subscribe"]);
+            else if(j.contains("unsubscribe")) Unsubscribe(j["unsubscribe"]);
+            else if(j.contains("acquire"))
+                m_pServer->SetAcquire(j["acquire"].get<bool>());
+            else
+                std::cerr << "Unknown command " << j.dump() << std::endl;
+        }
+        catch(...) {
+            std::cerr << "Bad command from client: " <<
+                std::string(vCommand.begin(), vCommand.end()) << std::endl;
+        }
+    }
+
+    Close();
+    if(m_StreamThread.joinable()) m_StreamThread.join();
+    m_bFinished = true;
+}
+
+//
+// Thread used to send the data of the subscribed channels as it comes due
+//
+void MockServer::Session::StreamThread(void)
+{
+    std::vector<std::vector<uint8_t>>   vPackets;
+    const size_t    nBlock = m_pServer->m_Config.nBlockSamples;
+
+    while(true) {
+        bool                                    bAcquiring;
+        uint64_t                                nGeneration;
+        std::chrono::steady_clock::time_point   tStart;
+        {
+            std::unique_lock<std::mutex>    lk(m_pServer->m_Lock);
+            bAcquiring = m_pServer->m_bAcquiring;
+            nGeneration = m_pServer->m_nAcquisitionGeneration;
+            tStart = m_pServer->m_tStart;
+        }
+
+        auto    tNow = std::chrono::steady_clock::now();
+        auto    tWake = tNow + std::chrono::milliseconds(MAX_IDLE_WAIT_MS);
+        double  dElapsed = std::chrono::duration<double>(tNow - tStart).count();
+
+        {
+            std::unique_lock<std::mutex>    lk(m_SubscribedLock);
+            if(m_bClosed) break;
+
+            for(auto& e : m_mSubscribed) {
+                Subscription&   s = e.second;
+                if(!bAcquiring) continue;
+
+                // A new acquisition starts every channel from its beginning
+                if(s.nGeneration != nGeneration) {
+                    s.nGeneration = nGeneration;
+                    s.nNext = 0;
+                }
+
+                const double    dRate =
+                    m_pServer->m_vChannels[s.nChannel].Config.dSampleRate;
+                const uint64_t  D = s.nDecimationFactor;
+                uint64_t        nRaw = static_cast<uint64_t>(dElapsed * dRate);
+                uint64_t        nAvailable = (nRaw + D - 1) / D;
+
+                for(int n = 0; n < MAX_CATCH_UP_BLOCKS &&
+                    s.nNext + nBlock <= nAvailable; n++) {
+                    std::vector<uint8_t>    v(
+                        sizeof(LowLatencyStreamPacketHeader) +
+                        nBlock * sizeof(float));
+                    LowLatencyStreamPacketHeader    *h =
+                        reinterpret_cast<LowLatencyStreamPacketHeader *>(
+                        v.data());
+                    h->id = ::htonl(static_cast<uint32_t>(e.first));
+                    h->length = ::htonl(static_cast<uint32_t>(v.size()));
+
+                    float   *pData = reinterpret_cast<float *>(h + 1);
+                    for(size_t i = 0; i < nBlock; i++)
+                        pData[i] = m_pServer->Sample(s.nChannel,
+                            (s.nNext + i) * D);
+
+                    s.nNext += nBlock;
+                    vPackets.push_back(std::move(v));
+                }
+
+                // When the next block is due
+                auto    tDue = tStart + std::chrono::duration_cast<
+                    std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(
+                    static_cast<double>((s.nNext + nBlock) * D) / dRate));
+                tWake = std::min(tWake, tDue);
+            }
+        }
+
+        for(auto& v : vPackets) {
+            if(!Write(v.data(), v.size(), true)) {
+                Close();
+                break;
+            }
+            m_pServer->m_nPackets++;
+            m_pServer->m_nSamples += nBlock;
+            m_pServer->m_nBytes += v.size();
+        }
+
+        if(!vPackets.empty()) {
+            vPackets.clear();
+            continue;
+        }
+
+        std::unique_lock<std::mutex>    lk(m_SubscribedLock);
+        if(m_bClosed) break;
+        m_Wake.wait_until(lk, tWake);
+    }
+}
+
+//
+// Constructor
+//
+MockServer::MockServer(const MockServerConfig& config)
+    : m_Config(config)
+    , m_bAcquiring(false)
+    , m_nAcquisitionGeneration(0)
+    , m_nStartNs(0)
+    , m_bStop(false)
+    , m_nConnects(0)
+    , m_nPackets(0)
+    , m_nSamples(0)
+    , m_nBytes(0)
+    , m_nCorrupted(0)
+    , m_nDropped(0)
+{
+    if(m_Config.sPort.empty()) m_Config.sPort.assign("10006");
+    if(m_Config.nBlockSamples == 0) m_Config.nBlockSamples = 1;
+
+    for(auto& c : m_Config.vChannels) {
+        Channel ch;
+        ch.Config = c;
+        if(!(ch.Config.dSampleRate > 0.0)) ch.Config.dSampleRate = 1000.0;
+        if(ch.Config.dScale == 0.0) ch.Config.dScale = 1.0;
+        ch.bAvailable = true;
+        m_vChannels.push_back(ch);
+    }
+
+    if(m_Config.bAcquire) SetAcquire(true);
+}
+
+//
+// Destructor
+//
+MockServer::~MockServer()
+{
+    Stop();
+}
+
+//
+// Function used to turn a signal name into a MockSignal
+//
+bool MockServer::ParseSignal(const std::string& s, MockSignal *pSignal)
+{
+    static const std::map<std::string, MockSignal>  mSignals = {
+        { "sine", MOCK_SIGNAL_SINE },
+        { "square", MOCK_SIGNAL_SQUARE },
+        { "ramp", MOCK_SIGNAL_RAMP },
+        { "noise", MOCK_SIGNAL_NOISE },
+        { "counter", MOCK_SIGNAL_COUNTER },
+    };
+
+    auto    it = mSignals.find(s);
+    if(it == mSignals.end()) return false;
+
+    *pSignal = it->second;
+    return true;
+}
+
+//
+// Function used to generate the value sent for raw sample nRaw of a
+// channel
+//
+float MockServer::Sample(size_t nChannel, uint64_t nRaw) const
+{
+    const MockChannelConfig&    c = m_vChannels[nChannel].Config;
+
+    if(c.nSignal == MOCK_SIGNAL_COUNTER)
+        return static_cast<float>(nRaw & 0xffffff);
+
+    const double    t = static_cast<double>(nRaw) / c.dSampleRate;
+    const double    dPhase = t * c.dFrequency - std::floor(t * c.dFrequency);
+    double          v = 0.0;
+
+    switch(c.nSignal) {
+        case MOCK_SIGNAL_SINE:
+            v = c.dAmplitude * std::sin(TWO_PI * dPhase);
+            break;
+
+        case MOCK_SIGNAL_SQUARE:
+            v = dPhase < 0.5 ? c.dAmplitude : -c.dAmplitude;
+            break;
+
+        case MOCK_SIGNAL_RAMP:
+            v = c.dAmplitude * (2.0 * dPhase - 1.0);
+            break;
+
+        case MOCK_SIGNAL_NOISE: {
+            uint64_t    n = Mix(nRaw ^ (static_cast<uint64_t>(nChannel) << 48) ^
+                m_Config.nSeed);
+            v = c.dAmplitude * (static_cast<double>(n >> 11) /
+                9007199254740992.0 * 2.0 - 1.0);
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    // What the chassis would send to give that value
+    double  dRaw = (v - c.dOffset) / c.dScale;
+
+    if(c.sDataType == "int16")
+        dRaw = std::max(-32768.0, std::min(32767.0, std::round(dRaw)));
+    else if(c.sDataType == "int32")
+        dRaw = std::max(-2147483648.0, std::min(2147483647.0,
+            std::round(dRaw)));
+
+    return static_cast<float>(dRaw);
+}
+
+//
+// Function used to describe channels the way "available" does
+//
+json MockServer::AvailableJson(const std::vector<size_t>& vChannels) const
+{
+    json    j;
+
+    for(size_t n : vChannels) {
+        const MockChannelConfig&    c = m_vChannels[n].Config;
+        j["available"][c.sName] = {
+            { "sample_period", 1.0 / c.dSampleRate },
+            { "data_type", c.sDataType.empty() ? "float" : c.sDataType },
+            { "scale", c.dScale },
+            { "offset", c.dOffset },
+        };
+    }
+
+    return j;
+}
+
+//
+// Function used to describe the acquisition state.  Called with the lock
+// held.
+//
+json MockServer::AcquisitionStateJson(void) const
+{
+    json    j = { { "acquisition_state", m_bAcquiring ? "on" : "off" } };
+
+    if(m_bAcquiring) {
+        std::time_t nSeconds = static_cast<std::time_t>(
+            m_nStartNs / 1000000000ULL);
+        std::tm     tm;
+#if defined(__linux__)
+        ::gmtime_r(&nSeconds, &tm);
+#else
+        ::gmtime_s(&tm, &nSeconds);
+#endif
+        char    szTime[64];
+        size_t  n = std::strftime(szTime, sizeof(szTime), "%Y-%m-%dT%H:%M:%S",
+            &tm);
+        std::snprintf(szTime + n, sizeof(szTime) - n, ".%09lluZ",
+            static_cast<unsigned long long>(m_nStartNs % 1000000000ULL));
+
+        j["precise_acquisition_start_time"] = szTime;
+    }
+
+    return j;
+}
+
+//
+// Function used to send metadata to every client.  Called with the lock
+// held.
+//
+void MockServer::Broadcast(const json& j)
+{
+    for(auto& s : m_vSessions)
+        if(!s->IsFinished()) s->SendMetadata(j);
+}
+
+//
+// Function used to start or stop acquisition for everyone
+//
+void MockServer::SetAcquire(bool bAcquire)
+{
+    std::unique_lock<std::mutex>    lk(m_Lock);
+
+    if(bAcquire && !m_bAcquiring) {
+        m_tStart = std::chrono::steady_clock::now();
+        m_nStartNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        m_nAcquisitionGeneration++;
+    }
+    m_bAcquiring = bAcquire;
+
+    Broadcast(AcquisitionStateJson());
+    for(auto& s : m_vSessions) s->Wake();
+}
+
+//
+// Function used to make a channel come and go
+//
+void MockServer::SetAvailable(const std::string& sName, bool bAvailable)
+{
+    std::unique_lock<std::mutex>    lk(m_Lock);
+
+    for(size_t n = 0; n < m_vChannels.size(); n++) {
+        Channel&    ch = m_vChannels[n];
+        if(ch.Config.sName != sName || ch.bAvailable == bAvailable) continue;
+
+        ch.bAvailable = bAvailable;
+
+        if(bAvailable) {
+            Broadcast(AvailableJson({ n }));
+        } else {
+            for(auto& s : m_vSessions) s->Drop(n);
+
+            json    j;
+            j["unavailable"].push_back(sName);
+            Broadcast(j);
+        }
+    }
+}
+
+//
+// Function used to start listening for clients
+//
+bool MockServer::Start(void)
+{
+    try {
+        tcp::resolver   resolver(m_IoContext);
+        tcp::endpoint   ep = *resolver.resolve(m_Config.sAddress.empty() ?
+            "0.0.0.0" : m_Config.sAddress, m_Config.sPort).begin();
+
+        m_Acceptor = std::make_unique<tcp::acceptor>(m_IoContext);
+        m_Acceptor->open(ep.protocol());
+        m_Acceptor->set_option(tcp::acceptor::reuse_address(true));
+        m_Acceptor->bind(ep);
+        m_Acceptor->listen();
+    }
+    catch(std::exception& e) {
+        std::cerr << "Unable to listen on port " << m_Config.sPort << ": " <<
+            e.what() << std::endl;
+        m_Acceptor.reset();
+        return false;
+    }
+
+    m_bStop = false;
+    m_AcceptThread = std::thread([this]() { AcceptThread(); });
+
+    return true;
+}
+
+//
+// Function used to get the port being listened on, 0 if not started
+//
+uint16_t MockServer::Port(void) const
+{
+    boost::system::error_code   ec;
+
+    if(!m_Acceptor) return 0;
+
+    tcp::endpoint   ep = m_Acceptor->local_endpoint(ec);
+    return ec ? 0 : ep.port();
+}
+
+//
+// Function used to disconnect every client and stop listening
+//
+void MockServer::Stop(void)
+{
+    if(m_AcceptThread.joinable()) {
+        m_bStop = true;
+
+        // Wake the blocking accept with a connection of our own
+        try {
+            tcp::endpoint   ep = m_Acceptor->local_endpoint();
+            if(ep.address().is_unspecified())
+                ep.address(boost::asio::ip::address_v4::loopback());
+
+            tcp::socket s(m_IoContext);
+            s.connect(ep);
+        }
+        catch(...) {
+        }
+
+        m_AcceptThread.join();
+        m_Acceptor.reset();
+    }
+
+    std::vector<std::unique_ptr<Session>>   vSessions;
+    {
+        std::unique_lock<std::mutex>    lk(m_Lock);
+        vSessions.swap(m_vSessions);
+    }
+
+    for(auto& s : vSessions) s->Close();
+    vSessions.clear();
+}
+
+//
+// Function used to free sessions whose client has gone.  Called with the
+// lock held.
+//
+void MockServer::Reap(void)
+{
+    for(auto it = m_vSessions.begin(); it != m_vSessions.end(); ) {
+        if((*it)->IsFinished()) it = m_vSessions.erase(it);
+        else it++;
+    }
+}
+
+//
+// Thread used to accept clients
+//
+void MockServer::AcceptThread(void)
+{
+    unsigned    nSession = 0;
+
+    while(!m_bStop) {
+        tcp::socket                 s(m_IoContext);
+        boost::system::error_code   ec;
+
+        m_Acceptor->accept(s, ec);
+        if(m_bStop) break;
+
+        if(ec) {
+            std::cerr << "Accept failed: " << ec.message() << std::endl;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+        s.set_option(tcp::no_delay(true), ec);
+
+        std::unique_lock<std::mutex>    lk(m_Lock);
+
+        Reap();
+
+        auto    p = std::make_unique<Session>(this, std::move(s),
+            m_Config.nSeed + ++nSession);
+
+        std::vector<size_t> vAvailable;
+        for(size_t n = 0; n < m_vChannels.size(); n++)
+            if(m_vChannels[n].bAvailable) vAvailable.push_back(n);
+
+        if(!vAvailable.empty()) p->SendMetadata(AvailableJson(vAvailable));
+        p->SendMetadata(AcquisitionStateJson());
+
+        p->Start();
+        m_vSessions.push_back(std::move(p));
+        m_nConnects++;
+    }
+}
+
+//
+// Function used to get the server counters
+//
+MockServerStats MockServer::Stats(void) const
+{
+    MockServerStats s;
+
+    std::unique_lock<std::mutex>    lk(m_Lock);
+
+    s.nClients = 0;
+    for(auto& p : m_vSessions) if(!p->IsFinished()) s.nClients++;
+
+    s.nConnects = m_nConnects;
+    s.nPackets = m_nPackets;
+    s.nSamples = m_nSamples;
+    s.nBytes = m_nBytes;
+    s.nCorrupted = m_nCorrupted;
+    s.nDropped = m_nDropped;
+
+    return s;
+}
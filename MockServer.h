@@ -0,0 +1,161 @@
+#ifndef __MOCKSERVER_H__
+#define __MOCKSERVER_H__
+
+#include    <atomic>
+#include    <chrono>
+#include    <map>
+#include    <memory>
+#include    <mutex>
+#include    <random>
+#include    <string>
+#include    <thread>
+#include    <vector>
+#include    "LowLatencyDataClient.h"
+
+//
+// Signals the simulated channels can carry
+//
+typedef enum {
+    MOCK_SIGNAL_SINE,
+    MOCK_SIGNAL_SQUARE,
+    MOCK_SIGNAL_RAMP,
+    MOCK_SIGNAL_NOISE,
+    MOCK_SIGNAL_COUNTER,                // Raw sample number mod 2^24, exact
+                                        // in a float, for checking delivery
+} MockSignal;
+
+//
+// Definition of one simulated channel
+//
+typedef struct {
+    std::string sName;
+    std::string sDataType;              // "float", "int16" or "int32";
+                                        // integer types send whole raw
+                                        // counts
+    double      dSampleRate;            // Hz, before decimation
+    double      dScale;                 // Engineering = raw * dScale +
+    double      dOffset;                //      dOffset
+    MockSignal  nSignal;
+    double      dAmplitude;             // Engineering units
+    double      dFrequency;             // Hz
+} MockChannelConfig;
+
+//
+// Definition of the faults the server can inject into data packets
+//
+typedef struct {
+    size_t      nFragmentBytes;         // Write packets in random pieces of
+                                        // at most this, 0 = whole
+    unsigned    nSlowWriteUs;           // Pause between the pieces
+    double      dCorruptRate;           // Chance a header is corrupted
+    double      dDropRate;              // Chance a packet is never sent
+} MockFaults;
+
+//
+// Definition of the server settings
+//
+typedef struct {
+    std::string                     sAddress;   // "" = all interfaces
+    std::string                     sPort;      // "0" = any free port
+    std::vector<MockChannelConfig>  vChannels;
+    size_t                          nBlockSamples;  // Per data packet,
+                                                    // after decimation
+    bool                            bAcquire;   // Acquiring from the start
+    MockFaults                      Faults;
+    unsigned                        nSeed;      // For noise and faults
+} MockServerConfig;
+
+//
+// Definition of server counters
+//
+typedef struct {
+    uint64_t    nClients;               // Connected now
+    uint64_t    nConnects;
+    uint64_t    nPackets;               // Data packets, dropped included
+    uint64_t    nSamples;
+    uint64_t    nBytes;
+    uint64_t    nCorrupted;
+    uint64_t    nDropped;
+} MockServerStats;
+
+//
+// Definition of the mock DAQ server.
+//
+// Speaks the server side of the low latency protocol so the client and
+// everything built on it can be run and load tested without a chassis:
+//
+//      -> available, acquisition_state          on connect
+//      <- subscribe {name: decimation}          -> subscribed (with
+//                                                  first_sample_timestamp_ns)
+//      <- unsubscribe [id, ...]                 -> unsubscribed
+//      <- acquire true|false                    -> acquisition_state to all
+//      -> unavailable / available               from SetAvailable()
+//
+// Acquisition is shared by all clients, as on a chassis.  While it is on,
+// every subscribed channel gets its samples in real time, nBlockSamples at
+// a time, generated from the acquisition start so all clients see the same
+// signal.  Each client has a thread streaming its data and one reading its
+// commands.
+//
+class MockServer {
+    public:
+        explicit MockServer(const MockServerConfig&);
+        ~MockServer();
+
+        MockServer(const MockServer&) = delete;
+        MockServer& operator=(const MockServer&) = delete;
+
+        bool Start(void);
+        void Stop(void);
+
+        uint16_t Port(void) const;
+
+        void SetAcquire(bool);
+        void SetAvailable(const std::string& sName, bool);
+
+        MockServerStats Stats(void) const;
+
+        static bool ParseSignal(const std::string&, MockSignal *);
+
+    private:
+        class Session;
+
+        typedef struct {
+            MockChannelConfig   Config;
+            bool                bAvailable;
+        } Channel;
+
+        void AcceptThread(void);
+        void Reap(void);
+
+        json AvailableJson(const std::vector<size_t>&) const;
+        json AcquisitionStateJson(void) const;
+        void Broadcast(const json&);
+
+        float Sample(size_t nChannel, uint64_t nRaw) const;
+
+        MockServerConfig                        m_Config;
+        std::vector<Channel>                    m_vChannels;
+
+        mutable std::mutex                      m_Lock;
+        bool                                    m_bAcquiring;
+        uint64_t                                m_nAcquisitionGeneration;
+        std::chrono::steady_clock::time_point   m_tStart;   // Acquisition
+        uint64_t                                m_nStartNs; // Same, as time
+                                                            // since the epoch
+        std::vector<std::unique_ptr<Session>>   m_vSessions;
+
+        boost::asio::io_context                 m_IoContext;
+        std::unique_ptr<tcp::acceptor>          m_Acceptor;
+        std::thread                             m_AcceptThread;
+        std::atomic<bool>                       m_bStop;
+
+        std::atomic<uint64_t>                   m_nConnects;
+        std::atomic<uint64_t>                   m_nPackets;
+        std::atomic<uint64_t>                   m_nSamples;
+        std::atomic<uint64_t>                   m_nBytes;
+        std::atomic<uint64_t>                   m_nCorrupted;
+        std::atomic<uint64_t>                   m_nDropped;
+};
+
+#endif
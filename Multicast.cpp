@@ -0,0 +1,640 @@
+#include "Multicast.h"
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <cerrno>
+#include <endian.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define RECEIVE_BATCH           32      // Datagrams per recvmmsg()
+#define RECEIVE_TIMEOUT_MS      100     // How often Run() checks for Stop()
+#define RECEIVE_SLOT_BYTES      65536   // Keeps every datagram float aligned
+
+//
+// Function used to turn a dotted address into an in_addr, INADDR_ANY if
+// empty
+//
+static bool ParseAddress(const std::string& s, struct in_addr *pAddr)
+{
+    if(s.empty()) {
+        pAddr->s_addr = htonl(INADDR_ANY);
+        return true;
+    }
+
+    if(::inet_pton(AF_INET, s.c_str(), pAddr) == 1) return true;
+
+    std::cerr << "Bad address " << s << std::endl;
+    return false;
+}
+
+//
+// Constructor
+//
+MulticastPublisher::MulticastPublisher(const MulticastConfig& Config)
+    : m_Config(Config)
+    , m_nSocket(-1)
+    , m_nSession(0)
+    , m_nSequence(0)
+    , m_nFill(sizeof(MulticastDatagramHeader))
+    , m_nRecords(0)
+    , m_bExit(false)
+    , m_nDatagrams(0)
+    , m_nRecordsSent(0)
+    , m_nBytes(0)
+    , m_nSnapshots(0)
+    , m_nSendErrors(0)
+{
+    const size_t    nMin = sizeof(MulticastDatagramHeader) +
+        sizeof(MulticastRecordHeader) + 64 * sizeof(float);
+
+    if(m_Config.nMaxDatagramBytes == 0) m_Config.nMaxDatagramBytes = 1472;
+    m_Config.nMaxDatagramBytes = std::min<size_t>(MULTICAST_MAX_DATAGRAM,
+        std::max(m_Config.nMaxDatagramBytes, nMin));
+    if(m_Config.nFlushIntervalUs == 0) m_Config.nFlushIntervalUs = 1000;
+    if(m_Config.nSnapshotIntervalMs == 0) m_Config.nSnapshotIntervalMs = 1000;
+
+    m_vDatagram.resize(m_Config.nMaxDatagramBytes);
+
+    struct sockaddr_in  sa;
+    ::memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(m_Config.nPort);
+
+    struct in_addr  ifAddr;
+    if(!ParseAddress(m_Config.sGroup, &sa.sin_addr) ||
+        !ParseAddress(m_Config.sInterface, &ifAddr)) return;
+
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if(fd < 0) {
+        std::cerr << "Unable to create multicast socket: " <<
+            ::strerror(errno) << std::endl;
+        return;
+    }
+
+    unsigned char   nTtl = static_cast<unsigned char>(
+        std::max(1, std::min(m_Config.nTtl, 255)));
+    unsigned char   bLoop = m_Config.bLoopback ? 1 : 0;
+
+    if(::setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &nTtl,
+        sizeof(nTtl)) < 0 ||
+        ::setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &bLoop,
+        sizeof(bLoop)) < 0 ||
+        (!m_Config.sInterface.empty() && ::setsockopt(fd, IPPROTO_IP,
+        IP_MULTICAST_IF, &ifAddr, sizeof(ifAddr)) < 0) ||
+        ::connect(fd, reinterpret_cast<struct sockaddr *>(&sa),
+        sizeof(sa)) < 0) {
+        std::cerr << "Unable to set up multicast to " << m_Config.sGroup <<
+            ":" << m_Config.nPort << ": " << ::strerror(errno) << std::endl;
+        ::close(fd);
+        return;
+    }
+
+    m_nSocket = fd;
+    m_nSession = std::random_device()();
+    m_tLastSnapshot = std::chrono::steady_clock::now();
+
+    m_FlushThread = std::thread([this]() { FlushThread(); });
+}
+
+//
+// Destructor
+//
+MulticastPublisher::~MulticastPublisher()
+{
+    if(m_FlushThread.joinable()) {
+        {
+            std::unique_lock<std::mutex>    lk(m_Lock);
+            m_bExit = true;
+            m_Signal.notify_one();
+        }
+        m_FlushThread.join();
+    }
+
+    if(m_nSocket >= 0) {
+        Flush();
+        ::close(m_nSocket);
+    }
+}
+
+//
+// Function used to get the publisher counters
+//
+MulticastPublisherStats MulticastPublisher::Stats(void) const
+{
+    MulticastPublisherStats s;
+
+    s.nDatagrams = m_nDatagrams.load(std::memory_order_relaxed);
+    s.nRecords = m_nRecordsSent.load(std::memory_order_relaxed);
+    s.nBytes = m_nBytes.load(std::memory_order_relaxed);
+    s.nSnapshots = m_nSnapshots.load(std::memory_order_relaxed);
+    s.nSendErrors = m_nSendErrors.load(std::memory_order_relaxed);
+
+    return s;
+}
+
+//
+// Function used to stamp and send a datagram.  Called with the lock held.
+//
+bool MulticastPublisher::Send(uint8_t *pDatagram, size_t nBytes,
+    uint16_t nRecords)
+{
+    MulticastDatagramHeader *h =
+        reinterpret_cast<MulticastDatagramHeader *>(pDatagram);
+
+    ::memcpy(h->szMagic, MULTICAST_MAGIC, sizeof(h->szMagic));
+    h->nVersion = htons(MULTICAST_VERSION);
+    h->nRecords = htons(nRecords);
+    h->nSession = htonl(m_nSession);
+    h->nReserved = 0;
+    h->nSequence = htobe64(m_nSequence++);
+
+    if(::send(m_nSocket, pDatagram, nBytes, 0) < 0) {
+        m_nSendErrors.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    m_nDatagrams.fetch_add(1, std::memory_order_relaxed);
+    m_nRecordsSent.fetch_add(nRecords, std::memory_order_relaxed);
+    m_nBytes.fetch_add(nBytes, std::memory_order_relaxed);
+
+    return true;
+}
+
+//
+// Function used to send the records gathered so far.  Called with the lock
+// held.
+//
+void MulticastPublisher::Flush(void)
+{
+    if(!m_nRecords) return;
+
+    Send(m_vDatagram.data(), m_nFill, m_nRecords);
+
+    m_nFill = sizeof(MulticastDatagramHeader);
+    m_nRecords = 0;
+}
+
+//
+// Function used to add a record to the datagram being gathered, sending it
+// first if the record will not fit.  Called with the lock held.
+//
+void MulticastPublisher::Append(uint32_t nId, uint64_t nFirstSample,
+    const void *p, size_t nBytes)
+{
+    const size_t    nRecord = sizeof(MulticastRecordHeader) + nBytes;
+
+    if(m_nFill + nRecord > m_vDatagram.size() || m_nRecords == UINT16_MAX)
+        Flush();
+
+    if(!m_nRecords) m_tFirstRecord = std::chrono::steady_clock::now();
+
+    MulticastRecordHeader   *r =
+        reinterpret_cast<MulticastRecordHeader *>(&m_vDatagram[m_nFill]);
+    r->id = htonl(nId);
+    r->length = htonl(static_cast<uint32_t>(nRecord));
+    r->nFirstSample = htobe64(nFirstSample);
+    ::memcpy(r + 1, p, nBytes);
+
+    m_nFill += nRecord;
+    m_nRecords++;
+
+    if(m_nFill + sizeof(MulticastRecordHeader) + sizeof(float) >
+        m_vDatagram.size()) Flush();
+}
+
+//
+// Function used to send the channel state in a datagram of its own.  Called
+// with the lock held.
+//
+void MulticastPublisher::SendSnapshot(void)
+{
+    std::string s(m_Tracker.Snapshot().dump());
+
+    const size_t    nBytes = sizeof(MulticastDatagramHeader) +
+        sizeof(MulticastRecordHeader) + s.size();
+    if(nBytes > MULTICAST_MAX_DATAGRAM) {
+        std::cerr << "Multicast snapshot needs " << nBytes << " bytes" <<
+            std::endl;
+        m_nSendErrors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    std::vector<uint8_t>    v(nBytes);
+    MulticastRecordHeader   *r = reinterpret_cast<MulticastRecordHeader *>(
+        &v[sizeof(MulticastDatagramHeader)]);
+    r->id = htonl(METADATA_ID);
+    r->length = htonl(static_cast<uint32_t>(sizeof(*r) + s.size()));
+    r->nFirstSample = 0;
+    ::memcpy(r + 1, s.data(), s.size());
+
+    Send(v.data(), v.size(), 1);
+
+    m_nSnapshots.fetch_add(1, std::memory_order_relaxed);
+    m_tLastSnapshot = std::chrono::steady_clock::now();
+}
+
+//
+// Thread used to send datagrams that are not filling up and to repeat the
+// snapshot
+//
+void MulticastPublisher::FlushThread(void)
+{
+    const auto  tFlush = std::chrono::microseconds(m_Config.nFlushIntervalUs);
+    const auto  tSnapshot =
+        std::chrono::milliseconds(m_Config.nSnapshotIntervalMs);
+
+    std::unique_lock<std::mutex>    lk(m_Lock);
+
+    while(!m_bExit) {
+        m_Signal.wait_for(lk, tFlush / 2);
+
+        auto    tNow = std::chrono::steady_clock::now();
+
+        if(m_nRecords && tNow - m_tFirstRecord >= tFlush) Flush();
+        if(tNow - m_tLastSnapshot >= tSnapshot) SendSnapshot();
+    }
+}
+
+//
+// Function used to process events from the LowLatencyDataClient
+//
+void MulticastPublisher::HandleEvent(EventType nType, const void *p, size_t n)
+{
+    if(m_nSocket < 0) return;
+
+    std::unique_lock<std::mutex>    lk(m_Lock);
+
+    m_Tracker.HandleEvent(nType, p, n);
+
+    if(nType == EVENT_TYPE_CHANNEL_DATA) {
+        const ChannelDataInfo   *cdi =
+            reinterpret_cast<const ChannelDataInfo *>(p);
+        uint64_t&               nSample = m_mSamples[cdi->nId];
+
+        const size_t    nMaxSamples = (m_vDatagram.size() -
+            sizeof(MulticastDatagramHeader) - sizeof(MulticastRecordHeader)) /
+            sizeof(float);
+
+        // Split what does not fit in one datagram
+        for(size_t i = 0; i < cdi->nSamples; ) {
+            size_t  nRoom = (m_vDatagram.size() - m_nFill) /
+                sizeof(float);
+            nRoom = nRoom > sizeof(MulticastRecordHeader) / sizeof(float) ?
+                nRoom - sizeof(MulticastRecordHeader) / sizeof(float) : 0;
+
+            // Only start a new datagram for what would not fit anyway
+            size_t  nTake = std::min(cdi->nSamples - i, nMaxSamples);
+            if(nTake > nRoom && nRoom >= 64) nTake = nRoom;
+
+            Append(static_cast<uint32_t>(cdi->nId), nSample + i,
+                cdi->pData + i, nTake * sizeof(float));
+            i += nTake;
+        }
+
+        nSample += cdi->nSamples;
+        return;
+    }
+
+    // Sample positions count from the first sample timestamp
+    if(nType == EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS)
+        m_mSamples[reinterpret_cast<const ChannelTimestampInfo *>(p)->nId] = 0;
+    else if(nType == EVENT_TYPE_CHANNEL_SUBSCRIBED)
+        m_mSamples[reinterpret_cast<const ChannelSubscribedInfo *>(p)->nId] = 0;
+    else if(nType == EVENT_TYPE_CHANNEL_UNSUBSCRIBED)
+        m_mSamples.erase(
+            reinterpret_cast<const ChannelUnsubscribedInfo *>(p)->nId);
+
+    // Data already gathered belongs before the change
+    Flush();
+    SendSnapshot();
+}
+
+//
+// Constructor
+//
+MulticastReceiver::MulticastReceiver(const MulticastReceiverConfig& Config,
+    EventHandler fCb)
+    : m_Config(Config)
+    , m_fEventHandler(fCb)
+    , m_nSocket(-1)
+    , m_bSession(false)
+    , m_nSession(0)
+    , m_nNextSequence(0)
+    , m_ReceiveThread(nullptr)
+    , m_bStop(false)
+    , m_nDatagrams(0)
+    , m_nRecords(0)
+    , m_nBytes(0)
+    , m_nLostDatagrams(0)
+    , m_nLateDatagrams(0)
+    , m_nBadDatagrams(0)
+    , m_nGaps(0)
+    , m_nSessions(0)
+{
+    struct ip_mreq  mreq;
+    if(!ParseAddress(m_Config.sGroup, &mreq.imr_multiaddr) ||
+        !ParseAddress(m_Config.sInterface, &mreq.imr_interface)) return;
+
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if(fd < 0) {
+        std::cerr << "Unable to create multicast socket: " <<
+            ::strerror(errno) << std::endl;
+        return;
+    }
+
+    // Any number of receivers on one host, each only hearing the group
+    struct sockaddr_in  sa;
+    ::memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(m_Config.nPort);
+    sa.sin_addr = mreq.imr_multiaddr;
+
+    int             nOn = 1;
+    int             nBuffer = static_cast<int>(std::min<size_t>(
+        m_Config.nReceiveBufferBytes, INT32_MAX));
+    struct timeval  tv = { 0, RECEIVE_TIMEOUT_MS * 1000 };
+
+    if(::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &nOn, sizeof(nOn)) < 0 ||
+        ::bind(fd, reinterpret_cast<struct sockaddr *>(&sa), sizeof(sa)) < 0 ||
+        ::setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq,
+        sizeof(mreq)) < 0 ||
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
+        std::cerr << "Unable to join multicast group " << m_Config.sGroup <<
+            ":" << m_Config.nPort << ": " << ::strerror(errno) << std::endl;
+        ::close(fd);
+        return;
+    }
+
+    // Only a hint, the kernel caps it at net.core.rmem_max
+    if(nBuffer > 0)
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &nBuffer, sizeof(nBuffer));
+
+    m_nSocket = fd;
+    m_vBuffer.resize(RECEIVE_BATCH * RECEIVE_SLOT_BYTES);
+}
+
+//
+// Destructor
+//
+MulticastReceiver::~MulticastReceiver()
+{
+    Stop();
+    Wait();
+
+    if(m_nSocket >= 0) ::close(m_nSocket);
+}
+
+//
+// Function used to get the receiver counters
+//
+MulticastReceiverStats MulticastReceiver::Stats(void) const
+{
+    MulticastReceiverStats  s;
+
+    s.nDatagrams = m_nDatagrams.load(std::memory_order_relaxed);
+    s.nRecords = m_nRecords.load(std::memory_order_relaxed);
+    s.nBytes = m_nBytes.load(std::memory_order_relaxed);
+    s.nLostDatagrams = m_nLostDatagrams.load(std::memory_order_relaxed);
+    s.nLateDatagrams = m_nLateDatagrams.load(std::memory_order_relaxed);
+    s.nBadDatagrams = m_nBadDatagrams.load(std::memory_order_relaxed);
+    s.nGaps = m_nGaps.load(std::memory_order_relaxed);
+    s.nSessions = m_nSessions.load(std::memory_order_relaxed);
+
+    return s;
+}
+
+//
+// Function used to bring our view of the channels in line with a snapshot.
+// Channels given a first sample timestamp count their samples from 0 again.
+// Only the parsing is guarded, what the event handler throws is the
+// application's.
+//
+void MulticastReceiver::ApplySnapshot(const char *p, size_t n)
+{
+    TrackerSnapshot ts;
+
+    try {
+        ts = ChannelTracker::ParseSnapshot(json::parse(p, p + n));
+    }
+    catch(...) {
+        std::cerr << "Failed to parse multicast snapshot" << std::endl;
+        return;
+    }
+
+    m_Tracker.ApplySnapshot(ts,
+        [this](EventType nType, const void *pEvent, size_t nSize) {
+            if(nType == EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS)
+                m_mNextSample.erase(reinterpret_cast<
+                    const ChannelTimestampInfo *>(pEvent)->nId);
+            else if(nType == EVENT_TYPE_CHANNEL_UNSUBSCRIBED)
+                m_mNextSample.erase(reinterpret_cast<
+                    const ChannelUnsubscribedInfo *>(pEvent)->nId);
+
+            m_fEventHandler(nType, pEvent, nSize);
+        });
+}
+
+//
+// Function used to deliver the samples of a data record, first restarting
+// the channel at the right time if samples went missing
+//
+void MulticastReceiver::ProcessData(uint32_t nId, uint64_t nFirstSample,
+    float *pData, size_t nSamples)
+{
+    const TrackedChannel    *tc = m_Tracker.Find(static_cast<int>(nId));
+    if(!tc) return;     // Not until the snapshot says what it is
+
+    auto    it = m_mNextSample.find(tc->nId);
+    bool    bKnown = it != m_mNextSample.end();
+
+    if(nFirstSample != (bKnown ? it->second : 0)) {
+        if(bKnown) m_nGaps.fetch_add(1, std::memory_order_relaxed);
+
+        // Our tracker keeps the real first sample timestamp, consumers are
+        // told where this sample falls
+        if(!std::isnan(tc->dFirstSampleTimestamp) &&
+            tc->dFirstSampleTimestamp != 0.0 &&
+            !std::isnan(tc->dEffectiveSamplePeriod)) {
+            ChannelTimestampInfo    ctsi;
+            ctsi.sName = tc->ci.sName;
+            ctsi.hChannel = tc->ci.hChannel;
+            ctsi.nId = tc->nId;
+            ctsi.dFirstSampleTimestamp = tc->dFirstSampleTimestamp +
+                static_cast<double>(nFirstSample) * tc->dEffectiveSamplePeriod;
+            m_fEventHandler(EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS, &ctsi,
+                sizeof(ctsi));
+        }
+    }
+
+    m_mNextSample[tc->nId] = nFirstSample + nSamples;
+
+    ChannelDataInfo cdi;
+    cdi.hChannel = tc->ci.hChannel;
+    cdi.nId = tc->nId;
+    cdi.pData = pData;
+    cdi.nSamples = nSamples;
+    m_fEventHandler(EVENT_TYPE_CHANNEL_DATA, &cdi, sizeof(cdi));
+}
+
+//
+// Function used to process one datagram
+//
+void MulticastReceiver::Process(uint8_t *p, size_t nBytes)
+{
+    const MulticastDatagramHeader   *h =
+        reinterpret_cast<const MulticastDatagramHeader *>(p);
+
+    if(nBytes < sizeof(*h) ||
+        ::memcmp(h->szMagic, MULTICAST_MAGIC, sizeof(h->szMagic)) ||
+        ntohs(h->nVersion) != MULTICAST_VERSION) {
+        m_nBadDatagrams.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    const uint32_t  nSession = ntohl(h->nSession);
+    const uint64_t  nSequence = be64toh(h->nSequence);
+
+    if(!m_bSession || nSession != m_nSession) {
+        // A restarted publisher numbers everything from 0 again
+        if(m_bSession) m_nSessions.fetch_add(1, std::memory_order_relaxed);
+        m_bSession = true;
+        m_nSession = nSession;
+        m_nNextSequence = nSequence;
+        m_mNextSample.clear();
+    }
+
+    if(nSequence < m_nNextSequence) {
+        m_nLateDatagrams.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if(nSequence > m_nNextSequence)
+        m_nLostDatagrams.fetch_add(nSequence - m_nNextSequence,
+            std::memory_order_relaxed);
+    m_nNextSequence = nSequence + 1;
+
+    m_nDatagrams.fetch_add(1, std::memory_order_relaxed);
+    m_nBytes.fetch_add(nBytes, std::memory_order_relaxed);
+
+    size_t      nOffset = sizeof(*h);
+    unsigned    nRecords = ntohs(h->nRecords);
+
+    for(unsigned i = 0; i < nRecords; i++) {
+        if(nBytes - nOffset < sizeof(MulticastRecordHeader)) break;
+
+        const MulticastRecordHeader *r =
+            reinterpret_cast<const MulticastRecordHeader *>(p + nOffset);
+        const uint32_t  nId = ntohl(r->id);
+        const uint32_t  nLength = ntohl(r->length);
+
+        if(nLength < sizeof(*r) || nLength > nBytes - nOffset) {
+            m_nBadDatagrams.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+
+        const size_t    nPayload = nLength - sizeof(*r);
+
+        if(nId == METADATA_ID)
+            ApplySnapshot(reinterpret_cast<const char *>(r + 1), nPayload);
+        else
+            ProcessData(nId, be64toh(r->nFirstSample),
+                reinterpret_cast<float *>(p + nOffset + sizeof(*r)),
+                nPayload / sizeof(float));
+
+        m_nRecords.fetch_add(1, std::memory_order_relaxed);
+        nOffset += nLength;
+    }
+}
+
+//
+// Function used to receive and process a batch of datagrams with one
+// system call.  Returns the number of datagrams.
+//
+size_t MulticastReceiver::Receive(int nFlags)
+{
+    struct mmsghdr  aMsgs[RECEIVE_BATCH];
+    struct iovec    aIov[RECEIVE_BATCH];
+
+    ::memset(aMsgs, 0, sizeof(aMsgs));
+    for(int i = 0; i < RECEIVE_BATCH; i++) {
+        aIov[i].iov_base = &m_vBuffer[i * RECEIVE_SLOT_BYTES];
+        aIov[i].iov_len = RECEIVE_SLOT_BYTES;
+        aMsgs[i].msg_hdr.msg_iov = &aIov[i];
+        aMsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int n = ::recvmmsg(m_nSocket, aMsgs, RECEIVE_BATCH, nFlags, nullptr);
+    if(n <= 0) return 0;
+
+    for(int i = 0; i < n; i++)
+        Process(static_cast<uint8_t *>(aIov[i].iov_base), aMsgs[i].msg_len);
+
+    return static_cast<size_t>(n);
+}
+
+//
+// Function used to process whatever datagrams are waiting without
+// blocking.  Returns the number of datagrams.
+//
+size_t MulticastReceiver::Poll(void)
+{
+    if(m_nSocket < 0) return 0;
+
+    size_t  nTotal = 0;
+    size_t  n;
+    while((n = Receive(MSG_DONTWAIT)) != 0) nTotal += n;
+
+    return nTotal;
+}
+
+//
+// Function used to receive on the calling thread until stopped
+//
+void MulticastReceiver::Run(void)
+{
+    if(m_nSocket < 0) return;
+
+    // Blocks for the first datagram of each batch, up to the socket timeout
+    while(!m_bStop.load(std::memory_order_relaxed))
+        Receive(MSG_WAITFORONE);
+}
+
+//
+// Function used to receive on a thread of its own
+//
+void MulticastReceiver::Start(void)
+{
+    if(m_ReceiveThread) return;
+
+    m_bStop = false;
+    m_ReceiveThread = new std::thread([this]() { Run(); });
+}
+
+//
+// Function used to stop receiving
+//
+void MulticastReceiver::Stop(void)
+{
+    m_bStop = true;
+}
+
+//
+// Function used to wait for a receiver started with Start() to finish
+//
+void MulticastReceiver::Wait(void)
+{
+    if(!m_ReceiveThread) return;
+
+    m_ReceiveThread->join();
+    delete m_ReceiveThread;
+    m_ReceiveThread = nullptr;
+}
+
+#endif
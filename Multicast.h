@@ -0,0 +1,233 @@
+#ifndef __MULTICAST_H__
+#define __MULTICAST_H__
+
+#if defined(__linux__)
+
+#include    <atomic>
+#include    <chrono>
+#include    <condition_variable>
+#include    <map>
+#include    <mutex>
+#include    <string>
+#include    <thread>
+#include    <vector>
+#include    "ChannelTracker.h"
+
+#define MULTICAST_MAGIC         "LLMC"
+#define MULTICAST_VERSION       1
+#define MULTICAST_MAX_DATAGRAM  65507       // Largest UDP payload over IPv4
+
+//
+// Definition of the header at the start of every datagram.
+//
+// NOTE:  All fields are in network byte order
+//
+typedef struct {
+    char        szMagic[4];     // MULTICAST_MAGIC, not terminated
+    uint16_t    nVersion;       // MULTICAST_VERSION
+    uint16_t    nRecords;       // Records that follow
+    uint32_t    nSession;       // Changes when the publisher restarts
+    uint32_t    nReserved;
+    uint64_t    nSequence;      // Datagram number within the session
+} MulticastDatagramHeader;
+
+//
+// Definition of the header of each record in a datagram.  The records are
+// packets as the server sends them, with the position of the first sample
+// added so a receiver can tell exactly what it missed:
+//
+//      id = channel id     float samples of a EVENT_TYPE_CHANNEL_DATA
+//      id = METADATA_ID    JSON snapshot of the channel state
+//
+// NOTE:  All fields are in network byte order, the samples as received
+//
+typedef struct {
+    uint32_t    id;
+    uint32_t    length;         // Of the record including this header
+    uint64_t    nFirstSample;   // Samples of the channel sent before this
+                                // record since its first sample timestamp
+} MulticastRecordHeader;
+
+//
+// Definition of the publisher settings
+//
+typedef struct {
+    std::string sGroup;                 // Group address, e.g. 239.255.76.76
+    uint16_t    nPort;
+    std::string sInterface;             // Local address to send from,
+                                        // "" = routing table's choice
+    int         nTtl;                   // 1 = stay on this subnet
+    bool        bLoopback;              // Deliver to receivers on this host
+    size_t      nMaxDatagramBytes;      // Path MTU less IP and UDP headers
+    unsigned    nFlushIntervalUs;       // Longest a record waits for others
+                                        // to fill its datagram
+    unsigned    nSnapshotIntervalMs;    // Channel state is repeated this
+                                        // often for late joiners
+} MulticastConfig;
+
+//
+// Definition of publisher counters
+//
+typedef struct {
+    uint64_t    nDatagrams;
+    uint64_t    nRecords;
+    uint64_t    nBytes;
+    uint64_t    nSnapshots;
+    uint64_t    nSendErrors;
+} MulticastPublisherStats;
+
+//
+// Definition of the multicast publisher.
+//
+// An event sink that republishes the data of every subscribed channel of
+// one connection as sequence numbered UDP multicast datagrams, packing as
+// many packets into each datagram as fit in nMaxDatagramBytes.  A packet
+// bigger than that is split.  Datagrams are sent when full, or by a
+// background thread once the oldest record has waited nFlushIntervalUs.
+//
+// Everything other than data is carried as a JSON snapshot of the channel
+// state (ChannelTracker::Snapshot()), sent at once when it changes and
+// again every nSnapshotIntervalMs, so a lost datagram or a receiver that
+// starts late costs nothing but the wait for the next one.  A snapshot too
+// big for the MTU relies on IP fragmentation.
+//
+class MulticastPublisher {
+    public:
+        explicit MulticastPublisher(const MulticastConfig&);
+        ~MulticastPublisher();
+
+        MulticastPublisher(const MulticastPublisher&) = delete;
+        MulticastPublisher& operator=(const MulticastPublisher&) = delete;
+
+        bool IsOpen(void) const { return m_nSocket >= 0; }
+
+        void HandleEvent(EventType, const void *, size_t);
+
+        MulticastPublisherStats Stats(void) const;
+
+    private:
+        void Append(uint32_t nId, uint64_t nFirstSample, const void *,
+            size_t);
+        void Flush(void);
+        void SendSnapshot(void);
+        bool Send(uint8_t *pDatagram, size_t nBytes, uint16_t nRecords);
+        void FlushThread(void);
+
+        MulticastConfig             m_Config;
+        ChannelTracker              m_Tracker;
+        std::map<int, uint64_t>     m_mSamples;     // Sent since the first
+                                                    // sample timestamp
+        int                         m_nSocket;
+        uint32_t                    m_nSession;
+        uint64_t                    m_nSequence;
+
+        std::vector<uint8_t>        m_vDatagram;
+        size_t                      m_nFill;
+        uint16_t                    m_nRecords;
+        std::chrono::steady_clock::time_point   m_tFirstRecord;
+        std::chrono::steady_clock::time_point   m_tLastSnapshot;
+
+        std::mutex                  m_Lock;
+        std::condition_variable     m_Signal;
+        bool                        m_bExit;
+        std::thread                 m_FlushThread;
+
+        std::atomic<uint64_t>       m_nDatagrams;
+        std::atomic<uint64_t>       m_nRecordsSent;
+        std::atomic<uint64_t>       m_nBytes;
+        std::atomic<uint64_t>       m_nSnapshots;
+        std::atomic<uint64_t>       m_nSendErrors;
+};
+
+//
+// Definition of the receiver settings
+//
+typedef struct {
+    std::string sGroup;                 // Group the publisher sends to
+    uint16_t    nPort;
+    std::string sInterface;             // Local address to join on,
+                                        // "" = any
+    size_t      nReceiveBufferBytes;    // SO_RCVBUF, rides out bursts
+} MulticastReceiverConfig;
+
+//
+// Definition of receiver counters
+//
+typedef struct {
+    uint64_t    nDatagrams;
+    uint64_t    nRecords;
+    uint64_t    nBytes;
+    uint64_t    nLostDatagrams;         // Sequence numbers never seen
+    uint64_t    nLateDatagrams;         // Out of order, dropped
+    uint64_t    nBadDatagrams;          // Not from a publisher
+    uint64_t    nGaps;                  // Channel data missing
+    uint64_t    nSessions;              // Publisher restarts seen
+} MulticastReceiverStats;
+
+//
+// Definition of the multicast receiver.
+//
+// Joins a MulticastPublisher's group and delivers the same EVENT_TYPE_*
+// sequence a LowLatencyDataClient would, starting from the first snapshot
+// it hears.  Data events point into the receive buffer and are only good
+// until the handler returns.
+//
+// Lost datagrams are counted from the sequence numbers.  When a channel's
+// data does not carry on from where it left off, the receiver delivers an
+// EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS with the timestamp of the first
+// sample that did arrive, so consumers restart the channel at the right
+// time rather than join the two sides of the gap.
+//
+class MulticastReceiver {
+    public:
+        MulticastReceiver(const MulticastReceiverConfig&, EventHandler);
+        ~MulticastReceiver();
+
+        MulticastReceiver(const MulticastReceiver&) = delete;
+        MulticastReceiver& operator=(const MulticastReceiver&) = delete;
+
+        bool IsOpen(void) const { return m_nSocket >= 0; }
+
+        size_t Poll(void);
+
+        void Run(void);
+        void Start(void);
+        void Stop(void);
+        void Wait(void);
+
+        MulticastReceiverStats Stats(void) const;
+
+    private:
+        size_t Receive(int nFlags);
+        void Process(uint8_t *, size_t);
+        void ProcessData(uint32_t nId, uint64_t nFirstSample, float *,
+            size_t nSamples);
+        void ApplySnapshot(const char *, size_t);
+
+        MulticastReceiverConfig     m_Config;
+        EventHandler                m_fEventHandler;
+        ChannelTracker              m_Tracker;      // As of the snapshots
+        std::map<int, uint64_t>     m_mNextSample;  // Expected next record
+
+        int                         m_nSocket;
+        std::vector<uint8_t>        m_vBuffer;
+        bool                        m_bSession;
+        uint32_t                    m_nSession;
+        uint64_t                    m_nNextSequence;
+
+        std::thread                 *m_ReceiveThread;
+        std::atomic<bool>           m_bStop;
+
+        std::atomic<uint64_t>       m_nDatagrams;
+        std::atomic<uint64_t>       m_nRecords;
+        std::atomic<uint64_t>       m_nBytes;
+        std::atomic<uint64_t>       m_nLostDatagrams;
+        std::atomic<uint64_t>       m_nLateDatagrams;
+        std::atomic<uint64_t>       m_nBadDatagrams;
+        std::atomic<uint64_t>       m_nGaps;
+        std::atomic<uint64_t>       m_nSessions;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,170 @@
+#include "PacketTiming.h"
+#include <algorithm>
+
+//
+// Constructor
+//
+LatencyHistogram::LatencyHistogram()
+    : m_nSumNs(0)
+    , m_vBaseline(BUCKETS, 0)
+    , m_nBaselineSumNs(0)
+{
+    for(auto& n : m_nCounts) n.store(0, std::memory_order_relaxed);
+}
+
+//
+// Function used to get the bucket a latency falls in
+//
+size_t LatencyHistogram::Bucket(uint64_t nNs)
+{
+    if(nNs >= (1ULL << MAX_BITS)) return BUCKETS - 1;
+    if(nNs < (1ULL << SUB_BUCKET_BITS)) return static_cast<size_t>(nNs);
+
+    int nTop = 63;
+    while(!(nNs & (1ULL << nTop))) nTop--;
+
+    // Ranges above the first are halved in resolution each time
+    int nShift = nTop - SUB_BUCKET_BITS;
+    return (static_cast<size_t>(nShift + 1) << SUB_BUCKET_BITS) +
+        static_cast<size_t>(nNs >> nShift) - (1ULL << SUB_BUCKET_BITS);
+}
+
+//
+// Function used to get the lowest latency that lands in a bucket
+//
+uint64_t LatencyHistogram::BucketLowest(size_t nBucket)
+{
+    if(nBucket < (2ULL << SUB_BUCKET_BITS)) return nBucket;
+
+    int nShift = static_cast<int>(nBucket >> SUB_BUCKET_BITS) - 1;
+    return ((nBucket & ((1ULL << SUB_BUCKET_BITS) - 1)) +
+        (1ULL << SUB_BUCKET_BITS)) << nShift;
+}
+
+//
+// Function used to get the highest latency that lands in a bucket
+//
+uint64_t LatencyHistogram::BucketHighest(size_t nBucket)
+{
+    if(nBucket + 1 >= BUCKETS) return UINT64_MAX;
+    return BucketLowest(nBucket + 1) - 1;
+}
+
+//
+// Function used to take the counts since the last reset
+//
+LatencySnapshot LatencyHistogram::Snapshot(bool bReset)
+{
+    LatencySnapshot s;
+    s.vCounts.resize(BUCKETS);
+    s.nCount = 0;
+
+    std::unique_lock<std::mutex>    lk(m_Lock);
+
+    uint64_t    nSumNs = m_nSumNs.load(std::memory_order_relaxed);
+    s.nSumNs = nSumNs - m_nBaselineSumNs;
+
+    for(size_t i = 0; i < BUCKETS; i++) {
+        uint64_t    n = m_nCounts[i].load(std::memory_order_relaxed);
+        s.vCounts[i] = n - m_vBaseline[i];
+        s.nCount += s.vCounts[i];
+        if(bReset) m_vBaseline[i] = n;
+    }
+    if(bReset) m_nBaselineSumNs = nSumNs;
+
+    return s;
+}
+
+//
+// Function used to get the latency a fraction of a snapshot's samples were
+// at or below, to within its bucket
+//
+uint64_t LatencyHistogram::Percentile(const LatencySnapshot& s,
+    double dFraction)
+{
+    if(!s.nCount) return 0;
+
+    uint64_t    nWanted = static_cast<uint64_t>(std::max(1.0,
+        dFraction * static_cast<double>(s.nCount) + 0.5));
+    uint64_t    nSeen = 0;
+
+    for(size_t i = 0; i < s.vCounts.size(); i++) {
+        nSeen += s.vCounts[i];
+        if(nSeen >= nWanted) return BucketHighest(i);
+    }
+
+    return Max(s);
+}
+
+//
+// Function used to get the largest latency in a snapshot, to within its
+// bucket
+//
+uint64_t LatencyHistogram::Max(const LatencySnapshot& s)
+{
+    for(size_t i = s.vCounts.size(); i > 0; i--)
+        if(s.vCounts[i - 1]) return BucketHighest(i - 1);
+
+    return 0;
+}
+
+//
+// Function used to get the mean latency of a snapshot
+//
+double LatencyHistogram::Mean(const LatencySnapshot& s)
+{
+    return s.nCount ? static_cast<double>(s.nSumNs) / s.nCount : 0.0;
+}
+
+//
+// Function used to make the histograms of a newly subscribed id, if it is
+// the highest yet.  Called from the socket read thread.
+//
+void PacketTiming::Subscribed(int nId)
+{
+    if(nId < 0) return;
+
+    std::unique_lock<std::mutex>    lk(m_Lock);
+    while(m_vChannels.size() <= static_cast<size_t>(nId))
+        m_vChannels.push_back(std::make_unique<ChannelHistograms>());
+}
+
+//
+// Function used to take the histograms of every channel that has been
+// timed since the last reset
+//
+std::vector<ChannelTimingSnapshot> PacketTiming::Snapshot(bool bReset)
+{
+    std::vector<ChannelTimingSnapshot>  v;
+    std::unique_lock<std::mutex>        lk(m_Lock);
+
+    for(size_t nId = 0; nId < m_vChannels.size(); nId++) {
+        ChannelTimingSnapshot   s;
+        uint64_t                nCount = 0;
+
+        s.nId = static_cast<int>(nId);
+        for(int nStage = 0; nStage < PACKET_STAGES; nStage++) {
+            s.Stages[nStage] = m_vChannels[nId]->Stages[nStage].Snapshot(
+                bReset);
+            nCount += s.Stages[nStage].nCount;
+        }
+
+        if(nCount) v.push_back(std::move(s));
+    }
+
+    return v;
+}
+
+//
+// Function used to get the name of a stage
+//
+const char *PacketTiming::StageName(PacketStage nStage)
+{
+    switch(nStage) {
+        case PACKET_STAGE_KERNEL_TO_HEADER:     return "kernel_to_header";
+        case PACKET_STAGE_HEADER_TO_COMPLETE:   return "header_to_complete";
+        case PACKET_STAGE_COMPLETE_TO_HANDLER:  return "complete_to_handler";
+        case PACKET_STAGE_HANDLER:              return "handler";
+        default:                                return "unknown";
+    }
+}
@@ -0,0 +1,154 @@
+#ifndef __PACKETTIMING_H__
+#define __PACKETTIMING_H__
+
+#include    <atomic>
+#include    <chrono>
+#include    <cstdint>
+#include    <memory>
+#include    <mutex>
+#include    <vector>
+
+//
+// Stages of the packet path timed by LowLatencyDataClient when built with
+// WITH_PACKET_TIMING.  Each is the gap between two points a data packet
+// passes:
+//
+//      kernel receive timestamp (SO_TIMESTAMPNS, Linux only)
+//          PACKET_STAGE_KERNEL_TO_HEADER
+//      header read
+//          PACKET_STAGE_HEADER_TO_COMPLETE
+//      whole packet read
+//          PACKET_STAGE_COMPLETE_TO_HANDLER
+//      event handler called
+//          PACKET_STAGE_HANDLER
+//      event handler returned
+//
+typedef enum {
+    PACKET_STAGE_KERNEL_TO_HEADER,
+    PACKET_STAGE_HEADER_TO_COMPLETE,
+    PACKET_STAGE_COMPLETE_TO_HANDLER,
+    PACKET_STAGE_HANDLER,
+    PACKET_STAGES,
+} PacketStage;
+
+//
+// Definition of a snapshot of a latency histogram
+//
+typedef struct {
+    uint64_t                nCount;
+    uint64_t                nSumNs;
+    std::vector<uint64_t>   vCounts;    // By LatencyHistogram bucket
+} LatencySnapshot;
+
+//
+// Definition of a log-linear (HDR style) histogram of nanosecond latencies.
+//
+// Each power of two range is split into 2^SUB_BUCKET_BITS equal buckets,
+// so any value is known to within about 3% from 1 ns to 2^MAX_BITS ns
+// (about 18 minutes); longer ones land in the last bucket.
+//
+// Record() is for one writer thread and costs a few relaxed loads and
+// stores, no locks or atomic read-modify-writes.  Snapshot() can be called
+// from any thread.  Resetting does not touch the writer's counts, it moves
+// the baseline later snapshots are taken against.
+//
+class LatencyHistogram {
+    public:
+        enum {
+            SUB_BUCKET_BITS = 5,
+            MAX_BITS = 40,
+            BUCKETS = (MAX_BITS - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS,
+        };
+
+        LatencyHistogram();
+
+        LatencyHistogram(const LatencyHistogram&) = delete;
+        LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+        void Record(uint64_t nNs)
+        {
+            std::atomic<uint64_t>&  n = m_nCounts[Bucket(nNs)];
+            n.store(n.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+            m_nSumNs.store(m_nSumNs.load(std::memory_order_relaxed) + nNs,
+                std::memory_order_relaxed);
+        }
+
+        LatencySnapshot Snapshot(bool bReset = false);
+
+        static size_t Bucket(uint64_t nNs);
+        static uint64_t BucketLowest(size_t nBucket);
+        static uint64_t BucketHighest(size_t nBucket);
+
+        static uint64_t Percentile(const LatencySnapshot&, double dFraction);
+        static uint64_t Max(const LatencySnapshot&);
+        static double Mean(const LatencySnapshot&);
+
+    private:
+        std::atomic<uint64_t>   m_nCounts[BUCKETS];
+        std::atomic<uint64_t>   m_nSumNs;
+
+        std::mutex              m_Lock;         // Snapshot takers only
+        std::vector<uint64_t>   m_vBaseline;
+        uint64_t                m_nBaselineSumNs;
+};
+
+//
+// Definition of the timing of one channel's data packets
+//
+typedef struct {
+    int             nId;
+    LatencySnapshot Stages[PACKET_STAGES];
+} ChannelTimingSnapshot;
+
+//
+// Definition of the per channel, per stage histograms.  Those of an id are
+// made when it is first subscribed, by the socket read thread with m_Lock
+// held, so it records without the lock while snapshots are taken with it.
+//
+class PacketTiming {
+    public:
+        PacketTiming() = default;
+
+        PacketTiming(const PacketTiming&) = delete;
+        PacketTiming& operator=(const PacketTiming&) = delete;
+
+        //
+        // Function used to get the time stamps are taken in, the clock
+        // SO_TIMESTAMPNS uses
+        //
+        static uint64_t Now(void)
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        //
+        // Function used to record the gap between two stamps, a zero stamp
+        // meaning it was not taken
+        //
+        void Record(int nId, PacketStage nStage, uint64_t nFromNs,
+            uint64_t nToNs)
+        {
+            if(nId < 0 || static_cast<size_t>(nId) >= m_vChannels.size() ||
+                !nFromNs) return;
+            m_vChannels[nId]->Stages[nStage].Record(nToNs > nFromNs ?
+                nToNs - nFromNs : 0);
+        }
+
+        void Subscribed(int nId);
+
+        std::vector<ChannelTimingSnapshot> Snapshot(bool bReset = false);
+
+        static const char *StageName(PacketStage);
+
+    private:
+        typedef struct {
+            LatencyHistogram    Stages[PACKET_STAGES];
+        } ChannelHistograms;
+
+        std::mutex                                      m_Lock;
+        std::vector<std::unique_ptr<ChannelHistograms>> m_vChannels;  // By id
+};
+
+#endif
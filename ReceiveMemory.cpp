@@ -0,0 +1,188 @@
+#include "ReceiveMemory.h"
+#include <new>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+//
+// Distance between the bytes touched to fault a block in, no bigger than
+// any page
+//
+static constexpr size_t nTouchStride = 4096;
+
+//
+// Constructor
+//
+ReceiveMemoryPool::ReceiveMemoryPool(const ReceiveMemoryConfig& config)
+    : m_Config(config)
+    , m_pSlab(nullptr)
+    , m_nSlabLeft(0)
+    , m_Stats()
+{
+    if(!m_Config.nMaxBytes) m_Config.nMaxBytes = 16 * 1024 * 1024;
+    if(!m_Config.nInitialBytes) m_Config.nInitialBytes = 64 * 1024;
+    if(m_Config.nInitialBytes > m_Config.nMaxBytes)
+        m_Config.nInitialBytes = m_Config.nMaxBytes;
+}
+
+//
+// Destructor, every block must have been given back
+//
+ReceiveMemoryPool::~ReceiveMemoryPool()
+{
+    for(auto& m : m_vMappings) {
+#if defined(__linux__)
+        ::munmap(m.p, m.nBytes);
+#else
+        delete [] m.p;
+#endif
+    }
+}
+
+//
+// Function used to map memory for blocks, a multiple of RECEIVE_SLAB_BYTES
+// aligned to RECEIVE_SLAB_BYTES so it can be on huge pages.  Called locked.
+//
+uint8_t *ReceiveMemoryPool::Map(size_t nBytes)
+{
+    Mapping m = { nullptr, nBytes, false };
+
+#if defined(__linux__)
+    const int   nProt = PROT_READ | PROT_WRITE;
+    const int   nFlags = MAP_PRIVATE | MAP_ANONYMOUS;
+    void        *p = MAP_FAILED;
+
+    // Reserved huge pages if there are any free
+    if(m_Config.bHugePages) {
+        p = ::mmap(nullptr, nBytes, nProt, nFlags | MAP_HUGETLB, -1, 0);
+        m.bHugeTlb = p != MAP_FAILED;
+    }
+
+    // Else ordinary pages, aligned so they can become transparent huge
+    // pages
+    if(p == MAP_FAILED) {
+        size_t  nMapped = nBytes + RECEIVE_SLAB_BYTES;
+        p = ::mmap(nullptr, nMapped, nProt, nFlags, -1, 0);
+        if(p == MAP_FAILED) return nullptr;
+
+        uint8_t     *pb = static_cast<uint8_t *>(p);
+        uintptr_t   n = reinterpret_cast<uintptr_t>(pb);
+        size_t      nHead = (RECEIVE_SLAB_BYTES - n % RECEIVE_SLAB_BYTES) %
+            RECEIVE_SLAB_BYTES;
+
+        if(nHead) ::munmap(pb, nHead);
+        if(nMapped - nHead > nBytes)
+            ::munmap(pb + nHead + nBytes, nMapped - nHead - nBytes);
+        p = pb + nHead;
+
+        if(m_Config.bHugePages) ::madvise(p, nBytes, MADV_HUGEPAGE);
+    }
+
+    m.p = static_cast<uint8_t *>(p);
+#else
+    m.p = new(std::nothrow) uint8_t[nBytes];
+    if(!m.p) return nullptr;
+#endif
+
+    m_vMappings.push_back(m);
+    m_Stats.nReservedBytes += nBytes;
+    if(m.bHugeTlb) m_Stats.nHugeTlbBytes += nBytes;
+
+    return m.p;
+}
+
+//
+// Function used to keep the rest of a slab as free blocks, biggest first.
+// Called locked.
+//
+void ReceiveMemoryPool::Keep(uint8_t *p, size_t nBytes)
+{
+    while(nBytes >= RECEIVE_MIN_BLOCK_BYTES) {
+        size_t  nBlock = RECEIVE_MIN_BLOCK_BYTES;
+        while(nBlock * 2 <= nBytes) nBlock *= 2;
+
+        m_mFree[nBlock].push_back(p);
+        p += nBlock;
+        nBytes -= nBlock;
+    }
+}
+
+//
+// Function used to get a block of at least nBytes, an empty one if that's
+// more than nMaxBytes or there's no memory for it
+//
+ReceiveBlock ReceiveMemoryPool::Get(size_t nBytes)
+{
+    ReceiveBlock    b = { nullptr, 0 };
+    if(nBytes > m_Config.nMaxBytes) return b;
+
+    size_t  nBlock = RECEIVE_MIN_BLOCK_BYTES;
+    while(nBlock < nBytes) nBlock *= 2;
+
+    bool    bNew = false;
+    {
+        std::unique_lock<std::mutex>    lk(m_Lock);
+
+        auto&   vFree = m_mFree[nBlock];
+        if(!vFree.empty()) {
+            b.p = vFree.back();
+            vFree.pop_back();
+
+        } else if(nBlock >= RECEIVE_SLAB_BYTES) {
+            b.p = Map(nBlock);
+            bNew = true;
+
+        } else {
+            if(m_nSlabLeft < nBlock) {
+                Keep(m_pSlab, m_nSlabLeft);
+                m_pSlab = Map(RECEIVE_SLAB_BYTES);
+                m_nSlabLeft = m_pSlab ? RECEIVE_SLAB_BYTES : 0;
+            }
+
+            if(m_pSlab) {
+                b.p = m_pSlab;
+                m_pSlab += nBlock;
+                m_nSlabLeft -= nBlock;
+                bNew = true;
+            }
+        }
+
+        if(!b.p) return b;
+
+        b.nBytes = nBlock;
+        m_Stats.nInUseBytes += nBlock;
+        m_Stats.nBlocksInUse++;
+    }
+
+    // Fault it in now rather than with the first packets
+    if(bNew && m_Config.bPrefault) {
+        for(size_t i = 0; i < b.nBytes; i += nTouchStride)
+            static_cast<volatile uint8_t *>(b.p)[i] = 0;
+    }
+
+    return b;
+}
+
+//
+// Function used to give a block back
+//
+void ReceiveMemoryPool::Put(const ReceiveBlock& b)
+{
+    if(!b.p) return;
+
+    std::unique_lock<std::mutex>    lk(m_Lock);
+
+    m_mFree[b.nBytes].push_back(b.p);
+    m_Stats.nInUseBytes -= b.nBytes;
+    m_Stats.nBlocksInUse--;
+}
+
+//
+// Function used to take the counters
+//
+ReceiveMemoryStats ReceiveMemoryPool::Stats(void)
+{
+    std::unique_lock<std::mutex>    lk(m_Lock);
+    return m_Stats;
+}
@@ -0,0 +1,92 @@
+#ifndef __RECEIVEMEMORY_H__
+#define __RECEIVEMEMORY_H__
+
+#include    <cstddef>
+#include    <cstdint>
+#include    <map>
+#include    <mutex>
+#include    <vector>
+
+#define RECEIVE_SLAB_BYTES      (2 * 1024 * 1024)   // A huge page
+#define RECEIVE_MIN_BLOCK_BYTES (64 * 1024)         // Smallest handed out
+
+//
+// Definition of the receive memory settings, 0s get the defaults
+//
+typedef struct {
+    size_t      nInitialBytes;          // Of each client's buffer (64 KB)
+    size_t      nMaxBytes;              // Largest packet taken (16 MB)
+    bool        bHugePages;             // Back with 2 MB pages if possible
+    bool        bPrefault;              // Touch blocks as they're handed out
+} ReceiveMemoryConfig;
+
+//
+// Definition of a block of receive memory
+//
+typedef struct {
+    uint8_t     *p;
+    size_t      nBytes;
+} ReceiveBlock;
+
+//
+// Definition of receive memory counters
+//
+typedef struct {
+    uint64_t    nReservedBytes;         // Mapped
+    uint64_t    nHugeTlbBytes;          // Of those, on reserved huge pages
+    uint64_t    nInUseBytes;            // Handed out
+    uint64_t    nBlocksInUse;
+} ReceiveMemoryStats;
+
+//
+// Definition of the memory LowLatencyDataClient reads packets into.
+//
+// Blocks are powers of two from RECEIVE_MIN_BLOCK_BYTES, carved out of
+// 2 MB slabs (bigger ones get a mapping of their own).  With bHugePages
+// the slabs are reserved huge pages when the system has them, else
+// transparent huge pages are asked for, so a client's buffer is one TLB
+// entry.  With bPrefault each block's pages are touched before it is
+// handed out, so the first packets don't fault them in.
+//
+// A client starts with an nInitialBytes block and swaps it for a bigger
+// one when a packet doesn't fit.  Blocks given back are kept for the next
+// Get() of their size, and the memory is only unmapped with the pool, so
+// clients sharing a pool share its slabs and reuse each other's blocks.
+// Get() and Put() lock, they're only called when a client starts, grows
+// or goes.
+//
+class ReceiveMemoryPool {
+    public:
+        explicit ReceiveMemoryPool(const ReceiveMemoryConfig&);
+        ~ReceiveMemoryPool();
+
+        ReceiveMemoryPool(const ReceiveMemoryPool&) = delete;
+        ReceiveMemoryPool& operator=(const ReceiveMemoryPool&) = delete;
+
+        ReceiveBlock Get(size_t nBytes);
+        void Put(const ReceiveBlock&);
+
+        const ReceiveMemoryConfig& Config(void) const { return m_Config; }
+        ReceiveMemoryStats Stats(void);
+
+    private:
+        typedef struct {
+            uint8_t     *p;
+            size_t      nBytes;
+            bool        bHugeTlb;
+        } Mapping;
+
+        uint8_t *Map(size_t nBytes);
+        void Keep(uint8_t *p, size_t nBytes);
+
+        ReceiveMemoryConfig                         m_Config;
+
+        std::mutex                                  m_Lock;
+        std::vector<Mapping>                        m_vMappings;
+        std::map<size_t, std::vector<uint8_t *>>    m_mFree;    // By size
+        uint8_t                                     *m_pSlab;   // Not yet
+        size_t                                      m_nSlabLeft;    // carved
+        ReceiveMemoryStats                          m_Stats;
+};
+
+#endif
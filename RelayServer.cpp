@@ -0,0 +1,751 @@
+#include "RelayServer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#if defined(__linux__)
+#include <arpa/inet.h>
+#endif
+
+#define MAX_COMMAND_LENGTH  (1024 * 1024)   // Largest JSON taken from a client
+#define MAX_WRITE_PACKETS   64              // Packets per scatter-gather write
+
+//
+// Definition of one downstream connection.  The reader thread hands the
+// client's commands to the relay; the writer thread drains the queue.
+//
+class RelayServer::Client {
+    public:
+        Client(RelayServer *pRelay, tcp::socket&& s, size_t nMaxQueueBytes)
+            : m_pRelay(pRelay)
+            , m_Socket(std::move(s))
+            , m_nMaxQueueBytes(nMaxQueueBytes)
+            , m_nQueuedBytes(0)
+            , m_bClosed(false)
+            , m_bFinished(false)
+        {
+        }
+
+        ~Client() { Close(); Join(); }
+
+        void Start(void)
+        {
+            m_WriteThread = std::thread([this]() { WriteThread(); });
+            m_ReadThread = std::thread([this]() { ReadThread(); });
+        }
+
+        //
+        // Function used to queue a packet.  Returns false if the client has
+        // fallen too far behind to take it.
+        //
+        bool Send(const RelayPacket& p)
+        {
+            std::unique_lock<std::mutex>    lk(m_QueueLock);
+
+            if(m_bClosed) return true;
+            if(m_nQueuedBytes + p->size() > m_nMaxQueueBytes) return false;
+
+            m_nQueuedBytes += p->size();
+            m_dQueue.push_back(p);
+            m_Signal.notify_one();
+
+            return true;
+        }
+
+        //
+        // Function used to shut the connection down.  Both threads see the
+        // socket fail and finish.
+        //
+        void Close(void)
+        {
+            {
+                std::unique_lock<std::mutex>    lk(m_QueueLock);
+                if(m_bClosed) return;
+                m_bClosed = true;
+                m_Signal.notify_one();
+            }
+
+            boost::system::error_code   ec;
+            m_Socket.shutdown(tcp::socket::shutdown_both, ec);
+        }
+
+        void Join(void)
+        {
+            if(m_ReadThread.joinable()) m_ReadThread.join();
+            if(m_WriteThread.joinable()) m_WriteThread.join();
+        }
+
+        bool IsFinished(void) const { return m_bFinished; }
+
+    private:
+        void ReadThread(void);
+        void WriteThread(void);
+
+        RelayServer                     *m_pRelay;
+        tcp::socket                     m_Socket;
+        size_t                          m_nMaxQueueBytes;
+
+        std::mutex                      m_QueueLock;
+        std::condition_variable         m_Signal;
+        std::deque<RelayPacket>         m_dQueue;
+        size_t                          m_nQueuedBytes;
+        bool                            m_bClosed;
+
+        std::thread                     m_ReadThread;
+        std::thread                     m_WriteThread;
+        std::atomic<bool>               m_bFinished;
+};
+
+//
+// Thread used to read commands from a downstream client
+//
+void RelayServer::Client::ReadThread(void)
+{
+    std::vector<char>   vCommand;
+
+    while(true) {
+        LowLatencyStreamPacketHeader    Header;
+        boost::system::error_code       ec;
+
+        boost::asio::read(m_Socket, boost::asio::buffer(&Header,
+            sizeof(Header)), ec);
+        if(ec) break;
+
+        uint32_t    nId = ::ntohl(Header.id);
+        uint32_t    nLength = ::ntohl(Header.length);
+
+        if(nId != METADATA_ID || nLength < sizeof(Header) ||
+            nLength > MAX_COMMAND_LENGTH) {
+            std::cerr << "Bad packet from relay client, id " << std::hex <<
+                nId << std::dec << " length " << nLength << std::endl;
+            break;
+        }
+
+        vCommand.resize(nLength - sizeof(Header));
+        boost::asio::read(m_Socket, boost::asio::buffer(vCommand), ec);
+        if(ec) break;
+
+        try {
+            json    j = json::parse(vCommand.begin(), vCommand.end());
+            m_pRelay->HandleCommand(this, j);
+        }
+        catch(...) {
+            std::cerr << "Bad command from relay client: " <<
+                std::string(vCommand.begin(), vCommand.end()) << std::endl;
+        }
+    }
+
+    Close();
+    m_pRelay->Remove(this);
+    m_bFinished = true;
+}
+
+//
+// Thread used to write queued packets to a downstream client
+//
+void RelayServer::Client::WriteThread(void)
+{
+    std::vector<RelayPacket>                vBatch;
+    std::vector<boost::asio::const_buffer>  vBuffers;
+
+    while(true) {
+        {
+            std::unique_lock<std::mutex>    lk(m_QueueLock);
+
+            m_Signal.wait(lk, [this]() {
+                return m_bClosed || !m_dQueue.empty();
+            });
+            if(m_bClosed) break;
+
+            while(!m_dQueue.empty() && vBatch.size() < MAX_WRITE_PACKETS) {
+                m_nQueuedBytes -= m_dQueue.front()->size();
+                vBatch.push_back(std::move(m_dQueue.front()));
+                m_dQueue.pop_front();
+            }
+        }
+
+        vBuffers.clear();
+        for(auto& p : vBatch)
+            vBuffers.push_back(boost::asio::buffer(p->data(), p->size()));
+
+        boost::system::error_code   ec;
+        boost::asio::write(m_Socket, vBuffers, ec);
+        vBatch.clear();
+
+        if(ec) {
+            Close();
+            break;
+        }
+    }
+}
+
+//
+// Constructor
+//
+RelayServer::RelayServer(const RelayServerConfig& config)
+    : m_Config(config)
+    , m_pUpstream(nullptr)
+    , m_bAcquisitionState(false)
+    , m_bStop(false)
+    , m_nConnects(0)
+    , m_nSlowClients(0)
+    , m_nPackets(0)
+    , m_nBytes(0)
+{
+    if(m_Config.nMaxQueueBytes < 1024 * 1024)
+        m_Config.nMaxQueueBytes = 1024 * 1024;
+}
+
+//
+// Destructor
+//
+RelayServer::~RelayServer()
+{
+    Stop();
+}
+
+//
+// Function used to start listening for clients of the given upstream
+// connection
+//
+bool RelayServer::Start(LowLatencyDataClient& upstream)
+{
+    m_pUpstream = &upstream;
+
+    try {
+        tcp::resolver   resolver(m_IoContext);
+        tcp::endpoint   ep = *resolver.resolve(m_Config.sAddress.empty() ?
+            "0.0.0.0" : m_Config.sAddress, m_Config.sPort).begin();
+
+        m_Acceptor = std::make_unique<tcp::acceptor>(m_IoContext);
+        m_Acceptor->open(ep.protocol());
+        m_Acceptor->set_option(tcp::acceptor::reuse_address(true));
+        m_Acceptor->bind(ep);
+        m_Acceptor->listen();
+    }
+    catch(std::exception& e) {
+        std::cerr << "Unable to listen on port " << m_Config.sPort << ": " <<
+            e.what() << std::endl;
+        m_Acceptor.reset();
+        return false;
+    }
+
+    m_bStop = false;
+    m_AcceptThread = std::thread([this]() { AcceptThread(); });
+
+    return true;
+}
+
+//
+// Function used to disconnect all of the clients and stop listening.  The
+// upstream subscriptions the clients held are released.
+//
+void RelayServer::Stop(void)
+{
+    if(m_AcceptThread.joinable()) {
+        m_bStop = true;
+
+        // Wake the blocking accept with a connection of our own
+        try {
+            tcp::endpoint   ep = m_Acceptor->local_endpoint();
+            if(ep.address().is_unspecified())
+                ep.address(boost::asio::ip::address_v4::loopback());
+
+            tcp::socket s(m_IoContext);
+            s.connect(ep);
+        }
+        catch(...) {
+        }
+
+        m_AcceptThread.join();
+        m_Acceptor.reset();
+    }
+
+    {
+        std::unique_lock<std::mutex>    lk(m_Lock);
+        for(auto& c : m_vClients) c->Close();
+    }
+
+    // The read threads take the lock to remove themselves
+    for(auto& c : m_vClients) c->Join();
+
+    std::unique_lock<std::mutex>    lk(m_Lock);
+    m_vClients.clear();
+}
+
+//
+// Thread used to accept downstream clients
+//
+void RelayServer::AcceptThread(void)
+{
+    while(!m_bStop) {
+        tcp::socket                 s(m_IoContext);
+        boost::system::error_code   ec;
+
+        m_Acceptor->accept(s, ec);
+        if(m_bStop) break;
+
+        if(ec) {
+            std::cerr << "Relay accept failed: " << ec.message() << std::endl;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+        s.set_option(tcp::no_delay(true), ec);
+
+        std::unique_lock<std::mutex>    lk(m_Lock);
+
+        Reap();
+
+        auto    c = std::make_unique<Client>(this, std::move(s),
+            m_Config.nMaxQueueBytes);
+
+        // Greet the client the way the server does, with everything that
+        // is available and the acquisition state
+        json    j;
+        for(auto& e : m_mChannels) {
+            const ChannelInfo&  ci = e.second.ci;
+            j["available"][ci.sName] = {
+                { "sample_period", ci.dSamplePeriod },
+                { "data_type", ci.sDataType },
+                { "scale", ci.dScale },
+                { "offset", ci.dOffset },
+            };
+        }
+        if(!j.empty()) c->Send(MakeMetadata(j));
+
+        j = { { "acquisition_state", m_bAcquisitionState ? "on" : "off" } };
+        if(m_bAcquisitionState && !m_sPreciseAcquisitionStartTime.empty())
+            j["precise_acquisition_start_time"] =
+                m_sPreciseAcquisitionStartTime;
+        c->Send(MakeMetadata(j));
+
+        c->Start();
+        m_vClients.push_back(std::move(c));
+        m_nConnects++;
+    }
+}
+
+//
+// Function used to free clients that have gone away.  Called with the lock
+// held.
+//
+void RelayServer::Reap(void)
+{
+    for(auto it = m_vClients.begin(); it != m_vClients.end(); ) {
+        if((*it)->IsFinished()) {
+            (*it)->Join();
+            it = m_vClients.erase(it);
+        }
+        else it++;
+    }
+}
+
+//
+// Function used to build a packet to go on the wire
+//
+RelayPacket RelayServer::MakePacket(uint32_t nId, const void *p,
+    size_t nBytes)
+{
+    auto    v = std::make_shared<std::vector<uint8_t>>(
+        sizeof(LowLatencyStreamPacketHeader) + nBytes);
+
+    LowLatencyStreamPacketHeader    *pHeader =
+        reinterpret_cast<LowLatencyStreamPacketHeader *>(v->data());
+    pHeader->id = ::htonl(nId);
+    pHeader->length = ::htonl(static_cast<uint32_t>(v->size()));
+
+    if(nBytes) ::memcpy(pHeader + 1, p, nBytes);
+
+    return v;
+}
+
+//
+// Function used to build a metadata packet
+//
+RelayPacket RelayServer::MakeMetadata(const json& j)
+{
+    std::string str(j.dump());
+    return MakePacket(METADATA_ID, str.data(), str.size());
+}
+
+//
+// Function used to send metadata to every client.  Called with the lock
+// held.
+//
+void RelayServer::Broadcast(const json& j)
+{
+    RelayPacket p = MakeMetadata(j);
+
+    for(auto& c : m_vClients) {
+        if(!c->Send(p)) {
+            m_nSlowClients++;
+            c->Close();
+        }
+    }
+}
+
+//
+// Function used to handle a command from a downstream client
+//
+void RelayServer::HandleCommand(Client *pClient, const json& j)
+{
+    std::unique_lock<std::mutex>    lk(m_Lock);
+
+    if(!m_pUpstream) return;
+
+    if(j.contains("subscribe")) {
+        for(auto& e : j["subscribe"].items()) {
+            int nDecimationFactor = e.value();
+            Subscribe(pClient, e.key(), static_cast<uint32_t>(
+                std::max(nDecimationFactor, 1)));
+        }
+
+    } else if(j.contains("unsubscribe")) {
+        json    jReply;
+
+        for(auto& e : j["unsubscribe"]) {
+            int     nId = e;
+            auto    it = m_mIds.find(nId);
+            if(it == m_mIds.end()) continue;
+
+            Channel&    ch = m_mChannels[it->second];
+            auto        sit = std::find_if(ch.vSubscribers.begin(),
+                ch.vSubscribers.end(), [pClient](const Subscriber& s) {
+                    return s.pClient == pClient;
+                });
+            if(sit == ch.vSubscribers.end()) continue;
+
+            ch.vSubscribers.erase(sit);
+            jReply["unsubscribed"].push_back(ch.ci.sName);
+
+            if(ch.vSubscribers.empty()) Release(ch);
+        }
+
+        if(!jReply.empty()) pClient->Send(MakeMetadata(jReply));
+
+    } else if(j.contains("acquire")) {
+        bool    bAcquire = j["acquire"];
+
+        // The upstream client toggles
+        if(bAcquire != m_bAcquisitionState) m_pUpstream->Acquire();
+
+    } else {
+        std::cerr << "Unknown relay client command " << j.dump() << std::endl;
+    }
+}
+
+//
+// Function used to subscribe a client to a channel.  Called with the lock
+// held.
+//
+void RelayServer::Subscribe(Client *pClient, const std::string& sName,
+    uint32_t nDecimationFactor)
+{
+    auto    it = m_mChannels.find(sName);
+    if(it == m_mChannels.end()) return;
+
+    Channel&    ch = it->second;
+
+    auto    fHas = [pClient](const std::vector<Subscriber>& v) {
+        return std::any_of(v.begin(), v.end(), [pClient](const Subscriber& s) {
+            return s.pClient == pClient;
+        });
+    };
+    if(fHas(ch.vSubscribers) || fHas(ch.vWaiting)) return;
+
+    if(ch.nId < 0 && !ch.bPending) {
+        // First taker, subscribe upstream at its decimation
+        std::string sUpstreamName(sName);
+
+        ch.nDecimationFactor = nDecimationFactor;
+        ch.bPending = true;
+        ch.vWaiting.push_back({ pClient, 1 });
+
+        m_pUpstream->SubscribeChannel(sUpstreamName, nDecimationFactor);
+        return;
+    }
+
+    if(nDecimationFactor % ch.nDecimationFactor) {
+        json    j = { { "status", "relay: " + sName + " is subscribed with "
+            "decimation " + std::to_string(ch.nDecimationFactor) +
+            ", ask for a multiple of it" } };
+        pClient->Send(MakeMetadata(j));
+        return;
+    }
+
+    Subscriber  s = { pClient, nDecimationFactor / ch.nDecimationFactor };
+
+    if(ch.bPending) ch.vWaiting.push_back(s);
+    else {
+        ch.vSubscribers.push_back(s);
+        SendSubscribed(ch, s);
+    }
+}
+
+//
+// Function used to tell a client it is subscribed.  The timestamp given is
+// that of the first sample it will be sent.  Called with the lock held.
+//
+void RelayServer::SendSubscribed(Channel& ch, const Subscriber& s)
+{
+    uint64_t    nFirst = (ch.nSamples + s.nStep - 1) / s.nStep * s.nStep;
+    double      dFSTS = ch.dFirstSampleTimestamp;
+
+    if(dFSTS != 0.0)
+        dFSTS += static_cast<double>(nFirst) * ch.ci.dSamplePeriod *
+            ch.nDecimationFactor;
+
+    json    j;
+    j["subscribed"].push_back({
+        { "name", ch.ci.sName },
+        { "id", ch.nId },
+        { "first_sample_timestamp_ns",
+            static_cast<uint64_t>(std::llround(dFSTS * 1000000000.0)) },
+    });
+
+    if(!s.pClient->Send(MakeMetadata(j))) {
+        m_nSlowClients++;
+        s.pClient->Close();
+    }
+}
+
+//
+// Function used to take a client that has gone away off every channel.
+//
+void RelayServer::Remove(Client *pClient)
+{
+    std::unique_lock<std::mutex>    lk(m_Lock);
+
+    for(auto& e : m_mChannels) {
+        Channel&    ch = e.second;
+
+        auto    fIs = [pClient](const Subscriber& s) {
+            return s.pClient == pClient;
+        };
+        ch.vSubscribers.erase(std::remove_if(ch.vSubscribers.begin(),
+            ch.vSubscribers.end(), fIs), ch.vSubscribers.end());
+        ch.vWaiting.erase(std::remove_if(ch.vWaiting.begin(),
+            ch.vWaiting.end(), fIs), ch.vWaiting.end());
+
+        if(ch.vSubscribers.empty() && ch.vWaiting.empty()) Release(ch);
+    }
+}
+
+//
+// Function used to drop the upstream subscription of a channel nobody is
+// taking any more.  One still pending is dropped when it completes.  Called
+// with the lock held.
+//
+void RelayServer::Release(Channel& ch)
+{
+    if(ch.nId < 0) return;
+
+    m_pUpstream->UnsubscribeChannel(ch.nId);
+    m_mIds.erase(ch.nId);
+    ch.nId = -1;
+}
+
+//
+// Function used to forward a block of data to the clients taking it.  Called
+// with the lock held.
+//
+void RelayServer::ForwardData(const ChannelDataInfo *cdi)
+{
+    auto    it = m_mIds.find(cdi->nId);
+    if(it == m_mIds.end()) return;
+
+    Channel&    ch = m_mChannels[it->second];
+
+    for(auto& s : ch.vSubscribers) {
+        RelayPacket p;
+
+        for(auto& e : m_vScratch)
+            if(e.first == s.nStep) p = e.second;
+
+        if(!p) {
+            if(s.nStep == 1) {
+                p = MakePacket(ch.nId, cdi->pData,
+                    cdi->nSamples * sizeof(float));
+            } else {
+                // Pick out the samples on this step's grid
+                std::vector<float>  v;
+                size_t  i = (s.nStep - ch.nSamples % s.nStep) % s.nStep;
+                for( ; i < cdi->nSamples; i += s.nStep)
+                    v.push_back(cdi->pData[i]);
+
+                p = MakePacket(ch.nId, v.data(), v.size() * sizeof(float));
+            }
+            m_vScratch.push_back({ s.nStep, p });
+        }
+
+        if(p->size() == sizeof(LowLatencyStreamPacketHeader)) continue;
+
+        if(s.pClient->Send(p)) {
+            m_nPackets++;
+            m_nBytes += p->size();
+        } else {
+            m_nSlowClients++;
+            s.pClient->Close();
+        }
+    }
+
+    m_vScratch.clear();
+    ch.nSamples += cdi->nSamples;
+}
+
+//
+// Function used to handle an event from the upstream connection
+//
+void RelayServer::HandleEvent(EventType nType, const void *p, size_t nSize)
+{
+    std::unique_lock<std::mutex>    lk(m_Lock);
+
+    switch(nType) {
+        case EVENT_TYPE_CHANNEL_DATA:
+            ForwardData(reinterpret_cast<const ChannelDataInfo *>(p));
+            break;
+
+        case EVENT_TYPE_AVAILABLE_CHANNEL: {
+            const ChannelInfo   *ci = reinterpret_cast<const ChannelInfo *>(p);
+
+            Channel&    ch = m_mChannels[ci->sName];
+            ch.ci = *ci;
+            ch.nId = -1;
+            ch.bPending = false;
+            ch.nDecimationFactor = 1;
+            ch.dFirstSampleTimestamp = 0.0;
+            ch.nSamples = 0;
+
+            json    j;
+            j["available"][ci->sName] = {
+                { "sample_period", ci->dSamplePeriod },
+                { "data_type", ci->sDataType },
+                { "scale", ci->dScale },
+                { "offset", ci->dOffset },
+            };
+            Broadcast(j);
+            break;
+        }
+
+        case EVENT_TYPE_UNAVAILABLE_CHANNEL: {
+            const std::string&  sName =
+                reinterpret_cast<const ChannelUnavailableInfo *>(p)->sName;
+
+            // The upstream client drops its subscription itself, as will
+            // the clients
+            auto    it = m_mChannels.find(sName);
+            if(it != m_mChannels.end()) {
+                if(it->second.nId >= 0) m_mIds.erase(it->second.nId);
+                m_mChannels.erase(it);
+            }
+
+            json    j;
+            j["unavailable"].push_back(sName);
+            Broadcast(j);
+            break;
+        }
+
+        case EVENT_TYPE_CHANNEL_SUBSCRIBED: {
+            const ChannelSubscribedInfo *csi =
+                reinterpret_cast<const ChannelSubscribedInfo *>(p);
+
+            auto    it = m_mChannels.find(csi->sName);
+            if(it == m_mChannels.end() || !it->second.bPending) break;
+
+            Channel&    ch = it->second;
+            ch.bPending = false;
+            ch.nId = csi->nId;
+            ch.nSamples = 0;
+            m_mIds[ch.nId] = ch.ci.sName;
+
+            // Everyone gave up while it was pending
+            if(ch.vWaiting.empty()) Release(ch);
+            break;
+        }
+
+        case EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS: {
+            const ChannelTimestampInfo  *ctsi =
+                reinterpret_cast<const ChannelTimestampInfo *>(p);
+
+            auto    it = m_mChannels.find(ctsi->sName);
+            if(it == m_mChannels.end() || it->second.nId != ctsi->nId) break;
+
+            Channel&    ch = it->second;
+            ch.dFirstSampleTimestamp = ctsi->dFirstSampleTimestamp;
+            ch.nSamples = 0;
+
+            // Answer the clients waiting on the upstream subscribe
+            for(auto& s : ch.vWaiting) {
+                ch.vSubscribers.push_back(s);
+                SendSubscribed(ch, s);
+            }
+            ch.vWaiting.clear();
+            break;
+        }
+
+        case EVENT_TYPE_CHANNEL_UNSUBSCRIBED: {
+            const ChannelUnsubscribedInfo   *cui =
+                reinterpret_cast<const ChannelUnsubscribedInfo *>(p);
+
+            // Only ids still in use here were not asked for by the relay
+            auto    it = m_mIds.find(cui->nId);
+            if(it == m_mIds.end()) break;
+
+            Channel&    ch = m_mChannels[it->second];
+            json        j;
+            j["unsubscribed"].push_back(ch.ci.sName);
+
+            RelayPacket pkt = MakeMetadata(j);
+            for(auto& s : ch.vSubscribers) s.pClient->Send(pkt);
+
+            ch.vSubscribers.clear();
+            ch.nId = -1;
+            m_mIds.erase(it);
+            break;
+        }
+
+        case EVENT_TYPE_ACQUIRE: {
+            m_bAcquisitionState = *reinterpret_cast<const bool *>(p);
+            m_sPreciseAcquisitionStartTime.clear();
+            if(m_bAcquisitionState && m_pUpstream)
+                m_sPreciseAcquisitionStartTime =
+                    m_pUpstream->PreciseAcquisitionStartTime();
+
+            for(auto& e : m_mChannels) e.second.nSamples = 0;
+
+            json    j = { { "acquisition_state",
+                m_bAcquisitionState ? "on" : "off" } };
+            if(!m_sPreciseAcquisitionStartTime.empty())
+                j["precise_acquisition_start_time"] =
+                    m_sPreciseAcquisitionStartTime;
+            Broadcast(j);
+            break;
+        }
+
+        // Not in the protocol, the lag steps the same for downstream clients
+        // so they see the gap for themselves
+        case EVENT_TYPE_CHANNEL_GAP:
+            break;
+    }
+}
+
+//
+// Function used to get the relay counters
+//
+RelayServerStats RelayServer::Stats(void) const
+{
+    RelayServerStats    s;
+
+    std::unique_lock<std::mutex>    lk(m_Lock);
+
+    s.nClients = 0;
+    for(auto& c : m_vClients) if(!c->IsFinished()) s.nClients++;
+
+    s.nConnects = m_nConnects;
+    s.nSlowClients = m_nSlowClients;
+    s.nPackets = m_nPackets;
+    s.nBytes = m_nBytes;
+    s.nUpstreamSubscriptions = m_mIds.size();
+
+    return s;
+}
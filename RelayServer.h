@@ -0,0 +1,138 @@
+#ifndef __RELAYSERVER_H__
+#define __RELAYSERVER_H__
+
+#include    <atomic>
+#include    <condition_variable>
+#include    <deque>
+#include    <map>
+#include    <memory>
+#include    <mutex>
+#include    <string>
+#include    <thread>
+#include    <vector>
+#include    "LowLatencyDataClient.h"
+
+//
+// Definition of the relay settings
+//
+typedef struct {
+    std::string sAddress;               // Address to listen on
+    std::string sPort;                  // Port to listen on
+    size_t      nMaxQueueBytes;         // A client further behind than this
+                                        // is disconnected
+} RelayServerConfig;
+
+//
+// Definition of relay counters
+//
+typedef struct {
+    uint64_t    nClients;               // Connected now
+    uint64_t    nConnects;
+    uint64_t    nSlowClients;           // Disconnected for falling behind
+    uint64_t    nPackets;               // Data packets queued to clients
+    uint64_t    nBytes;
+    uint64_t    nUpstreamSubscriptions;
+} RelayServerStats;
+
+//
+// A packet exactly as it goes on the wire, header in network byte order.
+// Data packets are built once and shared by every client they go to.
+//
+typedef std::shared_ptr<const std::vector<uint8_t>> RelayPacket;
+
+//
+// Definition of the relay server.
+//
+// Serves the low latency protocol (LowLatencyStreamPacketHeader + JSON
+// metadata or float samples) to any number of downstream clients from the
+// one upstream LowLatencyDataClient it is fed by, so the DAQ only ever sees
+// one connection.
+//
+// Subscriptions are merged:  the first client to ask for a channel
+// subscribes it upstream with its decimation and later clients share it.
+// A later client asking for a multiple of that decimation gets every Nth
+// sample picked out by the relay; any other decimation is refused with a
+// "status" message until the channel is free again.  A client joining a
+// running channel is given the timestamp of the first sample it will
+// actually receive.
+//
+// The sample bytes are forwarded as they arrived, copied once into a packet
+// that all the clients taking it share.  Each client has a queue drained by
+// its own writer thread with scatter-gather writes of many packets at a
+// time, so one slow client never holds up the upstream socket or the
+// others; one more than nMaxQueueBytes behind is disconnected.
+//
+class RelayServer {
+    public:
+        explicit RelayServer(const RelayServerConfig&);
+        ~RelayServer();
+
+        RelayServer(const RelayServer&) = delete;
+        RelayServer& operator=(const RelayServer&) = delete;
+
+        void HandleEvent(EventType, const void *, size_t);
+
+        bool Start(LowLatencyDataClient&);
+        void Stop(void);
+
+        RelayServerStats Stats(void) const;
+
+    private:
+        class Client;
+
+        typedef struct {
+            Client      *pClient;
+            uint32_t    nStep;                  // Forward every nStep'th
+                                                // upstream sample
+        } Subscriber;
+
+        typedef struct {
+            ChannelInfo             ci;
+            int                     nId;        // Upstream id, -1 = none
+            bool                    bPending;   // Upstream subscribe sent
+            uint32_t                nDecimationFactor;  // Upstream
+            double                  dFirstSampleTimestamp;
+            uint64_t                nSamples;   // Since the first sample
+            std::vector<Subscriber> vSubscribers;
+            std::vector<Subscriber> vWaiting;   // For the upstream subscribe
+        } Channel;
+
+        void AcceptThread(void);
+        void Reap(void);
+
+        void HandleCommand(Client *, const json&);
+        void Subscribe(Client *, const std::string&, uint32_t);
+        void Unsubscribe(Client *, int nId);
+        void Remove(Client *);
+        void Release(Channel&);
+        void SendSubscribed(Channel&, const Subscriber&);
+        void ForwardData(const ChannelDataInfo *);
+
+        static RelayPacket MakePacket(uint32_t nId, const void *, size_t);
+        static RelayPacket MakeMetadata(const json&);
+        void Broadcast(const json&);
+
+        RelayServerConfig                   m_Config;
+        LowLatencyDataClient                *m_pUpstream;
+
+        mutable std::mutex                  m_Lock;
+        std::map<std::string, Channel>      m_mChannels;
+        std::map<int, std::string>          m_mIds;     // Upstream id -> name
+        bool                                m_bAcquisitionState;
+        std::string                         m_sPreciseAcquisitionStartTime;
+        std::vector<std::unique_ptr<Client>> m_vClients;
+        std::vector<std::pair<uint32_t, RelayPacket>>   m_vScratch;
+                                                        // Packet per step
+
+        boost::asio::io_context             m_IoContext;
+        std::unique_ptr<tcp::acceptor>      m_Acceptor;
+        std::thread                         m_AcceptThread;
+        std::atomic<bool>                   m_bStop;
+
+        std::atomic<uint64_t>               m_nConnects;
+        std::atomic<uint64_t>               m_nSlowClients;
+        std::atomic<uint64_t>               m_nPackets;
+        std::atomic<uint64_t>               m_nBytes;
+};
+
+#endif
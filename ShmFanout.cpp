@@ -0,0 +1,780 @@
+#include "ShmFanout.h"
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static_assert(sizeof(ShmFanoutHeader) <= 4096, "Header too big");
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+    "Shared memory needs lock free 64 bit atomics");
+
+//
+// Function used to round up to a multiple of 8, the record alignment
+//
+static inline size_t RecordSize(size_t n)
+{
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+//
+// Function used to get the size of the shared header, a whole page
+//
+static size_t HeaderSize(void)
+{
+    return std::max<size_t>(4096, ::sysconf(_SC_PAGESIZE));
+}
+
+//
+// Function used to check whether a reader's process is still there
+//
+static bool ProcessExists(uint32_t nPid)
+{
+    return ::kill(static_cast<pid_t>(nPid), 0) == 0 || errno != ESRCH;
+}
+
+//
+// Function used to turn an event other than data into a JSON record
+//
+static json EventToJson(EventType nType, const void *p, size_t nSize)
+{
+    json    j;
+
+    switch(nType) {
+        case EVENT_TYPE_AVAILABLE_CHANNEL: {
+            const ChannelInfo *ci = reinterpret_cast<const ChannelInfo *>(p);
+            j["event"] = "available";
+            j["name"] = ci->sName;
+            j["data_type"] = ci->sDataType;
+            j["scale"] = ci->dScale;
+            j["offset"] = ci->dOffset;
+            j["sample_period"] = ci->dSamplePeriod;
+            break;
+        }
+
+        case EVENT_TYPE_UNAVAILABLE_CHANNEL:
+            j["event"] = "unavailable";
+            j["name"] =
+                reinterpret_cast<const ChannelUnavailableInfo *>(p)->sName;
+            break;
+
+        case EVENT_TYPE_CHANNEL_SUBSCRIBED: {
+            const ChannelSubscribedInfo *csi =
+                reinterpret_cast<const ChannelSubscribedInfo *>(p);
+            j["event"] = "subscribed";
+            j["name"] = csi->sName;
+            j["id"] = csi->nId;
+            j["decimation"] = csi->nDecimationFactor;
+            break;
+        }
+
+        case EVENT_TYPE_CHANNEL_UNSUBSCRIBED: {
+            const ChannelUnsubscribedInfo *cui =
+                reinterpret_cast<const ChannelUnsubscribedInfo *>(p);
+            j["event"] = "unsubscribed";
+            j["id"] = cui->nId;
+            break;
+        }
+
+        case EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS: {
+            const ChannelTimestampInfo *ctsi =
+                reinterpret_cast<const ChannelTimestampInfo *>(p);
+            j["event"] = "first_sample_ts";
+            j["name"] = ctsi->sName;
+            j["id"] = ctsi->nId;
+            j["first_sample_timestamp"] = ctsi->dFirstSampleTimestamp;
+            break;
+        }
+
+        case EVENT_TYPE_ACQUIRE:
+            j["event"] = "acquisition_state";
+            j["on"] = *reinterpret_cast<const bool *>(p);
+            break;
+
+        default:
+            break;
+    }
+
+    return j;
+}
+
+//
+// Constructor
+//
+ShmFanoutPublisher::ShmFanoutPublisher(const ShmFanoutConfig& Config)
+    : m_Config(Config)
+    , m_pHeader(nullptr)
+    , m_pSnapshot(nullptr)
+    , m_pRing(nullptr)
+    , m_nMapSize(0)
+    , m_nPosition(0)
+    , m_nEnd(0)
+    , m_nRecords(0)
+    , m_nBytes(0)
+    , m_nDroppedRecords(0)
+{
+    if(m_Config.sName.empty()) m_Config.sName.assign("/ll-fanout");
+    if(m_Config.nRingBytes < 1024 * 1024) m_Config.nRingBytes = 64 << 20;
+    size_t  n = 1024 * 1024;
+    while(n < m_Config.nRingBytes) n <<= 1;
+    m_Config.nRingBytes = n;
+
+    const size_t    nHeaderSize = HeaderSize();
+    if(m_Config.nSnapshotBytes < 64 * 1024)
+        m_Config.nSnapshotBytes = 1024 * 1024;
+    m_Config.nSnapshotBytes = (m_Config.nSnapshotBytes + nHeaderSize - 1) /
+        nHeaderSize * nHeaderSize;
+
+    // A publisher that died leaves its name behind
+    ::shm_unlink(m_Config.sName.c_str());
+
+    int fd = ::shm_open(m_Config.sName.c_str(), O_CREAT | O_EXCL | O_RDWR,
+        0644);
+    if(fd < 0) {
+        std::cerr << "Unable to create shared memory " << m_Config.sName <<
+            ": " << ::strerror(errno) << std::endl;
+        return;
+    }
+
+    m_nMapSize = nHeaderSize + m_Config.nSnapshotBytes + m_Config.nRingBytes;
+    if(::ftruncate(fd, m_nMapSize) < 0) {
+        std::cerr << "Unable to size shared memory " << m_Config.sName <<
+            ": " << ::strerror(errno) << std::endl;
+        ::close(fd);
+        ::shm_unlink(m_Config.sName.c_str());
+        return;
+    }
+
+    void    *p = ::mmap(nullptr, m_nMapSize, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, 0);
+    ::close(fd);
+
+    if(p == MAP_FAILED) {
+        std::cerr << "Unable to map shared memory " << m_Config.sName <<
+            std::endl;
+        ::shm_unlink(m_Config.sName.c_str());
+        return;
+    }
+
+    // The new memory is all zeros, fill in the rest of the header and
+    // write the magic last so readers never see half of it
+    ShmFanoutHeader *h = static_cast<ShmFanoutHeader *>(p);
+    h->nVersion = SHM_FANOUT_VERSION;
+    h->nHeaderSize = static_cast<uint32_t>(nHeaderSize);
+    h->nSnapshotSize = m_Config.nSnapshotBytes;
+    h->nRingBytes = m_Config.nRingBytes;
+    h->nPublisherPid = static_cast<uint32_t>(::getpid());
+
+    m_pHeader = h;
+    m_pSnapshot = static_cast<uint8_t *>(p) + nHeaderSize;
+    m_pRing = m_pSnapshot + m_Config.nSnapshotBytes;
+
+    WriteSnapshot();
+
+    std::atomic_thread_fence(std::memory_order_release);
+    ::memcpy(h->szMagic, SHM_FANOUT_MAGIC, sizeof(h->szMagic));
+}
+
+//
+// Destructor
+//
+ShmFanoutPublisher::~ShmFanoutPublisher()
+{
+    if(!m_pHeader) return;
+
+    // Readers keep their mapping, they only need to know no more is coming
+    m_pHeader->bClosed.store(1, std::memory_order_release);
+
+    ::munmap(m_pHeader, m_nMapSize);
+    ::shm_unlink(m_Config.sName.c_str());
+}
+
+//
+// Function used to get the publisher counters
+//
+ShmFanoutPublisherStats ShmFanoutPublisher::Stats(void) const
+{
+    ShmFanoutPublisherStats s;
+
+    s.nRecords = m_nRecords.load(std::memory_order_relaxed);
+    s.nBytes = m_nBytes.load(std::memory_order_relaxed);
+    s.nDroppedRecords = m_nDroppedRecords.load(std::memory_order_relaxed);
+
+    return s;
+}
+
+//
+// Function used to look at the attached readers.  Slots left behind by
+// readers that died are skipped.
+//
+std::vector<ShmFanoutReaderInfo> ShmFanoutPublisher::Readers(void) const
+{
+    std::vector<ShmFanoutReaderInfo>    vReaders;
+
+    if(!m_pHeader) return vReaders;
+
+    uint64_t    nWrite =
+        m_pHeader->nWritePosition.load(std::memory_order_acquire);
+
+    for(auto& e : m_pHeader->aReaders) {
+        uint32_t    nPid = e.nPid.load(std::memory_order_relaxed);
+        if(!nPid || !ProcessExists(nPid)) continue;
+
+        uint64_t    nPosition = e.nPosition.load(std::memory_order_relaxed);
+
+        ShmFanoutReaderInfo ri;
+        ri.nPid = nPid;
+        ri.nLagBytes = nWrite > nPosition ? nWrite - nPosition : 0;
+        ri.nOverruns = e.nOverruns.load(std::memory_order_relaxed);
+        ri.bSlow = ri.nLagBytes > m_Config.nRingBytes / 2;
+        vReaders.push_back(ri);
+    }
+
+    return vReaders;
+}
+
+//
+// Function used to start a record.  Returns where the payload goes or
+// nullptr if the record can never fit.
+//
+uint8_t *ShmFanoutPublisher::Reserve(uint32_t nId, size_t nPayload)
+{
+    const size_t    nLength = sizeof(LowLatencyStreamPacketHeader) + nPayload;
+    const size_t    nRecord = RecordSize(nLength);
+
+    if(nRecord > m_Config.nRingBytes / 2) {
+        m_nDroppedRecords.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    // Records never wrap, pad out the end of the ring if need be
+    const uint64_t  nMask = m_Config.nRingBytes - 1;
+    uint64_t        nStart = m_nPosition;
+    const size_t    nLeft = m_Config.nRingBytes - (nStart & nMask);
+    if(nLeft < nRecord) nStart += nLeft;
+    m_nEnd = nStart + nRecord;
+
+    // Tell readers these bytes are about to change before changing them
+    m_pHeader->nWriteLimit.store(m_nEnd, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    LowLatencyStreamPacketHeader    *h;
+    if(nStart != m_nPosition) {
+        h = reinterpret_cast<LowLatencyStreamPacketHeader *>(
+            m_pRing + (m_nPosition & nMask));
+        h->id = SHM_FANOUT_PAD_ID;
+        h->length = static_cast<uint32_t>(nLeft);
+    }
+
+    h = reinterpret_cast<LowLatencyStreamPacketHeader *>(
+        m_pRing + (nStart & nMask));
+    h->id = nId;
+    h->length = static_cast<uint32_t>(nLength);
+
+    return reinterpret_cast<uint8_t *>(h + 1);
+}
+
+//
+// Function used to make the reserved record visible to readers
+//
+void ShmFanoutPublisher::Commit(void)
+{
+    m_nBytes.fetch_add(m_nEnd - m_nPosition, std::memory_order_relaxed);
+    m_nRecords.fetch_add(1, std::memory_order_relaxed);
+
+    m_nPosition = m_nEnd;
+    m_pHeader->nWritePosition.store(m_nPosition, std::memory_order_release);
+}
+
+//
+// Function used to write an event other than data into the ring
+//
+void ShmFanoutPublisher::WriteMetadata(EventType nType, const void *p,
+    size_t nSize)
+{
+    std::string s(EventToJson(nType, p, nSize).dump());
+
+    uint8_t *pPayload = Reserve(METADATA_ID, s.size());
+    if(!pPayload) return;
+
+    ::memcpy(pPayload, s.data(), s.size());
+    Commit();
+}
+
+//
+// Function used to rewrite the snapshot of the channel state
+//
+void ShmFanoutPublisher::WriteSnapshot(void)
+{
+    std::string s(m_Tracker.Snapshot().dump());
+    if(s.size() > m_Config.nSnapshotBytes) {
+        std::cerr << "Shared memory snapshot needs " << s.size() <<
+            " bytes" << std::endl;
+        m_nDroppedRecords.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    ::memcpy(m_pSnapshot, s.data(), s.size());
+    m_pHeader->nSnapshotLength.store(s.size(), std::memory_order_relaxed);
+}
+
+//
+// Function used to process events from the LowLatencyDataClient
+//
+void ShmFanoutPublisher::HandleEvent(EventType nType, const void *p, size_t n)
+{
+    m_Tracker.HandleEvent(nType, p, n);
+
+    if(!m_pHeader) return;
+
+    if(nType == EVENT_TYPE_CHANNEL_DATA) {
+        const ChannelDataInfo   *cdi =
+            reinterpret_cast<const ChannelDataInfo *>(p);
+        const size_t            nBytes = cdi->nSamples * sizeof(float);
+
+        uint8_t *pPayload = Reserve(static_cast<uint32_t>(cdi->nId), nBytes);
+        if(!pPayload) return;
+
+        ::memcpy(pPayload, cdi->pData, nBytes);
+        Commit();
+        return;
+    }
+
+    // Readers attaching meanwhile retry until both the record and the
+    // snapshot are written
+    uint64_t    nSeq =
+        m_pHeader->nSnapshotSeq.load(std::memory_order_relaxed);
+    m_pHeader->nSnapshotSeq.store(nSeq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    WriteMetadata(nType, p, n);
+    WriteSnapshot();
+
+    m_pHeader->nSnapshotSeq.store(nSeq + 2, std::memory_order_release);
+}
+
+//
+// Constructor
+//
+ShmFanoutReader::ShmFanoutReader(const ShmFanoutReaderConfig& Config,
+    EventHandler fCb)
+    : m_Config(Config)
+    , m_fEventHandler(fCb)
+    , m_pHeader(nullptr)
+    , m_pSnapshot(nullptr)
+    , m_pRing(nullptr)
+    , m_nDataMapSize(0)
+    , m_pSlot(nullptr)
+    , m_nPosition(UINT64_MAX)
+    , m_ReaderThread(nullptr)
+    , m_bStop(false)
+    , m_nRecords(0)
+    , m_nBytes(0)
+    , m_nOverruns(0)
+{
+    if(m_Config.sName.empty()) m_Config.sName.assign("/ll-fanout");
+
+    int fd = ::shm_open(m_Config.sName.c_str(), O_RDWR, 0);
+    if(fd < 0) {
+        std::cerr << "Unable to open shared memory " << m_Config.sName <<
+            ": " << ::strerror(errno) << std::endl;
+        return;
+    }
+
+    const size_t    nHeaderSize = HeaderSize();
+    struct stat     st;
+    if(::fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < nHeaderSize) {
+        std::cerr << m_Config.sName << " is not a fan-out ring" << std::endl;
+        ::close(fd);
+        return;
+    }
+
+    // Only the header is writable, for the reader slots
+    void    *p = ::mmap(nullptr, nHeaderSize, PROT_READ | PROT_WRITE,
+        MAP_SHARED, fd, 0);
+    if(p == MAP_FAILED) {
+        std::cerr << "Unable to map shared memory " << m_Config.sName <<
+            std::endl;
+        ::close(fd);
+        return;
+    }
+
+    ShmFanoutHeader *h = static_cast<ShmFanoutHeader *>(p);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(::strncmp(h->szMagic, SHM_FANOUT_MAGIC, sizeof(h->szMagic)) ||
+        h->nVersion != SHM_FANOUT_VERSION || h->nHeaderSize != nHeaderSize ||
+        static_cast<size_t>(st.st_size) <
+            nHeaderSize + h->nSnapshotSize + h->nRingBytes) {
+        std::cerr << m_Config.sName << " is not a fan-out ring" << std::endl;
+        ::munmap(p, nHeaderSize);
+        ::close(fd);
+        return;
+    }
+
+    m_nDataMapSize = h->nSnapshotSize + h->nRingBytes;
+    void    *pData = ::mmap(nullptr, m_nDataMapSize, PROT_READ, MAP_SHARED, fd,
+        nHeaderSize);
+    ::close(fd);
+
+    if(pData == MAP_FAILED) {
+        std::cerr << "Unable to map shared memory " << m_Config.sName <<
+            std::endl;
+        ::munmap(p, nHeaderSize);
+        return;
+    }
+
+    m_pHeader = h;
+    m_pSnapshot = static_cast<const uint8_t *>(pData);
+    m_pRing = m_pSnapshot + h->nSnapshotSize;
+
+    // Take a free slot, or one left behind by a reader that died
+    const uint32_t  nPid = static_cast<uint32_t>(::getpid());
+    for(int nPass = 0; nPass < 2 && !m_pSlot; nPass++) {
+        for(auto& e : h->aReaders) {
+            uint32_t    nOld = e.nPid.load(std::memory_order_relaxed);
+            if(nPass == 0 ? nOld != 0 : ProcessExists(nOld)) continue;
+
+            if(e.nPid.compare_exchange_strong(nOld, nPid)) {
+                e.nOverruns.store(0, std::memory_order_relaxed);
+                e.nPosition.store(h->nWritePosition.load(
+                    std::memory_order_acquire), std::memory_order_relaxed);
+                m_pSlot = &e;
+                break;
+            }
+        }
+    }
+}
+
+//
+// Destructor
+//
+ShmFanoutReader::~ShmFanoutReader()
+{
+    Stop();
+    Wait();
+
+    if(!m_pHeader) return;
+
+    if(m_pSlot) m_pSlot->nPid.store(0, std::memory_order_release);
+
+    ::munmap(const_cast<uint8_t *>(m_pSnapshot), m_nDataMapSize);
+    ::munmap(m_pHeader, m_pHeader->nHeaderSize);
+}
+
+//
+// Function used to check whether the publisher has gone away
+//
+bool ShmFanoutReader::IsClosed(void) const
+{
+    return !m_pHeader || m_pHeader->bClosed.load(std::memory_order_acquire);
+}
+
+//
+// Function used to get the reader counters
+//
+ShmFanoutReaderStats ShmFanoutReader::Stats(void) const
+{
+    ShmFanoutReaderStats    s;
+
+    s.nRecords = m_nRecords.load(std::memory_order_relaxed);
+    s.nBytes = m_nBytes.load(std::memory_order_relaxed);
+    s.nOverruns = m_nOverruns.load(std::memory_order_relaxed);
+
+    return s;
+}
+
+//
+// Function used to pass an event on, keeping our view of the channels
+//
+void ShmFanoutReader::Deliver(EventType nType, const void *p, size_t n)
+{
+    m_Tracker.HandleEvent(nType, p, n);
+    m_fEventHandler(nType, p, n);
+}
+
+//
+// Function used to check whether the publisher has started writing over
+// the record at nPosition
+//
+bool ShmFanoutReader::Overwritten(uint64_t nPosition) const
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return m_pHeader->nWriteLimit.load(std::memory_order_relaxed) >
+        nPosition + m_pHeader->nRingBytes;
+}
+
+//
+// Function used to (re)start reading from the newest data.  The snapshot
+// and the position are only used if no metadata was written meanwhile.
+//
+void ShmFanoutReader::Resync(void)
+{
+    std::string s;
+    uint64_t    nPosition;
+
+    while(true) {
+        uint64_t    nSeq =
+            m_pHeader->nSnapshotSeq.load(std::memory_order_acquire);
+        if(nSeq & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        size_t  nLength =
+            m_pHeader->nSnapshotLength.load(std::memory_order_relaxed);
+        if(nLength > m_pHeader->nSnapshotSize) continue;
+
+        s.assign(reinterpret_cast<const char *>(m_pSnapshot), nLength);
+        nPosition = m_pHeader->nWritePosition.load(std::memory_order_acquire);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(m_pHeader->nSnapshotSeq.load(std::memory_order_relaxed) == nSeq)
+            break;
+    }
+
+    m_nPosition = nPosition;
+    ApplySnapshot(s);
+}
+
+//
+// Function used to deliver whatever events bring our view of the channels
+// in line with a snapshot.  Only the parsing is guarded, what the event
+// handler throws is the application's.
+//
+void ShmFanoutReader::ApplySnapshot(const std::string& s)
+{
+    TrackerSnapshot ts;
+
+    try {
+        ts = ChannelTracker::ParseSnapshot(json::parse(s));
+    }
+    catch(...) {
+        std::cerr << "Failed to parse shared memory snapshot" << std::endl;
+        return;
+    }
+
+    m_Tracker.ApplySnapshot(ts, m_fEventHandler);
+}
+
+//
+// Function used to turn a metadata record back into its event, which is
+// delivered once it has been parsed
+//
+void ShmFanoutReader::ApplyMetadata(const std::string& s)
+{
+    ChannelInfo             ci;
+    ChannelUnavailableInfo  cuai;
+    ChannelSubscribedInfo   csi;
+    ChannelUnsubscribedInfo cui;
+    ChannelTimestampInfo    ctsi;
+    bool                    bState = false;
+
+    EventType               nType = EVENT_TYPE_ACQUIRE;
+    const void              *pEvent = nullptr;
+    size_t                  nSize = 0;
+
+    try {
+        json        j = json::parse(s);
+        std::string sEvent(j["event"]);
+
+        if(sEvent == "available") {
+            ci.sName = j["name"];
+            ci.hChannel = ChannelNames::Intern(ci.sName);
+            ci.sDataType = j["data_type"];
+            ci.dScale = j["scale"];
+            ci.dOffset = j["offset"];
+            ci.dSamplePeriod = j["sample_period"];
+            ci.nDecimationFactor = 1;
+            nType = EVENT_TYPE_AVAILABLE_CHANNEL;
+            pEvent = &ci;
+            nSize = sizeof(ci);
+
+        } else if(sEvent == "unavailable") {
+            cuai.sName = j["name"];
+            cuai.hChannel = ChannelNames::Intern(cuai.sName);
+            nType = EVENT_TYPE_UNAVAILABLE_CHANNEL;
+            pEvent = &cuai;
+            nSize = sizeof(cuai);
+
+        } else if(sEvent == "subscribed") {
+            csi.sName = j["name"];
+            csi.hChannel = ChannelNames::Intern(csi.sName);
+            csi.nId = j["id"];
+            csi.nDecimationFactor = j["decimation"];
+            nType = EVENT_TYPE_CHANNEL_SUBSCRIBED;
+            pEvent = &csi;
+            nSize = sizeof(csi);
+
+        } else if(sEvent == "unsubscribed") {
+            const TrackedChannel    *tc;
+
+            cui.nId = j["id"];
+            tc = m_Tracker.Find(cui.nId);
+            cui.hChannel = tc ? tc->ci.hChannel : NO_CHANNEL_HANDLE;
+            nType = EVENT_TYPE_CHANNEL_UNSUBSCRIBED;
+            pEvent = &cui;
+            nSize = sizeof(cui);
+
+        } else if(sEvent == "first_sample_ts") {
+            ctsi.sName = j["name"];
+            ctsi.hChannel = ChannelNames::Intern(ctsi.sName);
+            ctsi.nId = j["id"];
+            ctsi.dFirstSampleTimestamp = j["first_sample_timestamp"];
+            nType = EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS;
+            pEvent = &ctsi;
+            nSize = sizeof(ctsi);
+
+        } else if(sEvent == "acquisition_state") {
+            bState = j["on"];
+            nType = EVENT_TYPE_ACQUIRE;
+            pEvent = &bState;
+            nSize = sizeof(bState);
+        }
+    }
+    catch(...) {
+        std::cerr << "Failed to parse shared memory record" << std::endl;
+        return;
+    }
+
+    if(pEvent) Deliver(nType, pEvent, nSize);
+}
+
+//
+// Function used to deliver up to nMaxRecords of what the publisher has
+// written.  Returns the number of records read.
+//
+size_t ShmFanoutReader::Poll(size_t nMaxRecords)
+{
+    if(!m_pHeader) return 0;
+
+    if(m_nPosition == UINT64_MAX) Resync();
+
+    const uint64_t  nRing = m_pHeader->nRingBytes;
+    const uint64_t  nMask = nRing - 1;
+    uint64_t        nWrite =
+        m_pHeader->nWritePosition.load(std::memory_order_acquire);
+    size_t          nRecords = 0;
+    uint64_t        nBytes = 0;
+
+    while(m_nPosition < nWrite && nRecords < nMaxRecords) {
+        const LowLatencyStreamPacketHeader  *h =
+            reinterpret_cast<const LowLatencyStreamPacketHeader *>(
+                m_pRing + (m_nPosition & nMask));
+        const uint32_t  nId = h->id;
+        const uint32_t  nLength = h->length;
+        const size_t    nRecord = nId == SHM_FANOUT_PAD_ID ?
+            nLength : RecordSize(nLength);
+
+        bool    bLapped = Overwritten(m_nPosition) ||
+            nLength < sizeof(*h) || nRecord > nRing - (m_nPosition & nMask);
+
+        if(!bLapped && nId == METADATA_ID) {
+            std::string s(reinterpret_cast<const char *>(h + 1),
+                nLength - sizeof(*h));
+            bLapped = Overwritten(m_nPosition);
+            if(!bLapped) ApplyMetadata(s);
+
+        } else if(!bLapped && nId != SHM_FANOUT_PAD_ID) {
+            const TrackedChannel    *tc =
+                m_Tracker.Find(static_cast<int>(nId));
+
+            ChannelDataInfo cdi;
+            cdi.hChannel = tc ? tc->ci.hChannel : NO_CHANNEL_HANDLE;
+            cdi.nId = static_cast<int>(nId);
+            cdi.pData = const_cast<float *>(
+                reinterpret_cast<const float *>(h + 1));
+            cdi.nSamples = (nLength - sizeof(*h)) / sizeof(float);
+
+            if(tc) Deliver(EVENT_TYPE_CHANNEL_DATA, &cdi, sizeof(cdi));
+
+            // The handler took so long the data changed under it
+            bLapped = Overwritten(m_nPosition);
+        }
+
+        if(bLapped) {
+            m_nOverruns.fetch_add(1, std::memory_order_relaxed);
+            if(m_pSlot)
+                m_pSlot->nOverruns.fetch_add(1, std::memory_order_relaxed);
+            Resync();
+            nWrite = m_pHeader->nWritePosition.load(std::memory_order_acquire);
+            continue;
+        }
+
+        m_nPosition += nRecord;
+        nBytes += nRecord;
+        if(nId != SHM_FANOUT_PAD_ID) nRecords++;
+    }
+
+    if(m_pSlot) m_pSlot->nPosition.store(m_nPosition, std::memory_order_relaxed);
+
+    m_nRecords.fetch_add(nRecords, std::memory_order_relaxed);
+    m_nBytes.fetch_add(nBytes, std::memory_order_relaxed);
+
+    return nRecords;
+}
+
+//
+// Function used to read on the calling thread until stopped or the
+// publisher goes away
+//
+void ShmFanoutReader::Run(void)
+{
+    if(!m_pHeader) return;
+
+    while(!m_bStop.load(std::memory_order_relaxed)) {
+        if(Poll()) continue;
+
+        // Nothing new, done if nothing more is coming
+        if(IsClosed() && m_nPosition >=
+            m_pHeader->nWritePosition.load(std::memory_order_acquire))
+            break;
+
+        if(m_Config.nIdleSleepUs)
+            std::this_thread::sleep_for(
+                std::chrono::microseconds(m_Config.nIdleSleepUs));
+        else
+            std::this_thread::yield();
+    }
+}
+
+//
+// Function used to read on a thread of its own
+//
+void ShmFanoutReader::Start(void)
+{
+    if(m_ReaderThread) return;
+
+    m_bStop = false;
+    m_ReaderThread = new std::thread([this]() { Run(); });
+}
+
+//
+// Function used to stop reading
+//
+void ShmFanoutReader::Stop(void)
+{
+    m_bStop = true;
+}
+
+//
+// Function used to wait for a reader started with Start() to finish
+//
+void ShmFanoutReader::Wait(void)
+{
+    if(!m_ReaderThread) return;
+
+    m_ReaderThread->join();
+    delete m_ReaderThread;
+    m_ReaderThread = nullptr;
+}
+
+#endif
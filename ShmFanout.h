@@ -0,0 +1,221 @@
+#ifndef __SHMFANOUT_H__
+#define __SHMFANOUT_H__
+
+#if defined(__linux__)
+
+#include    <atomic>
+#include    <string>
+#include    <thread>
+#include    <vector>
+#include    "ChannelTracker.h"
+
+#define SHM_FANOUT_MAGIC        "LLSHM01"
+#define SHM_FANOUT_VERSION      1
+#define SHM_FANOUT_MAX_READERS  32
+#define SHM_FANOUT_PAD_ID       0xffffffff  // Rest of the ring is unused
+
+//
+// Definition of a reader's slot in the shared header.  Readers publish how
+// far they have read so the publisher can see who is falling behind.
+//
+typedef struct alignas(64) {
+    std::atomic<uint32_t>   nPid;           // 0 = free
+    std::atomic<uint64_t>   nPosition;      // Ring position read up to
+    std::atomic<uint64_t>   nOverruns;      // Times lapped by the publisher
+} ShmFanoutReaderSlot;
+
+//
+// Definition of the header at the start of the shared memory.
+//
+// The header is followed by the metadata snapshot area and then the ring.
+// The ring holds records laid out exactly like stream packets, a
+// LowLatencyStreamPacketHeader (in host byte order) padded to 8 bytes:
+//
+//      id = channel id         float samples of a EVENT_TYPE_CHANNEL_DATA
+//      id = METADATA_ID        JSON describing any other event
+//      id = SHM_FANOUT_PAD_ID  skip to the start of the ring
+//
+// Positions are byte counts since the ring was created and never wrap;
+// the offset in the ring is position % nRingBytes.  The publisher raises
+// nWriteLimit before it writes a record and nWritePosition once it is
+// complete, so a reader knows bytes it is looking at are still good while
+// nWriteLimit <= its position + nRingBytes.
+//
+typedef struct {
+    char                    szMagic[8];     // SHM_FANOUT_MAGIC
+    uint32_t                nVersion;       // SHM_FANOUT_VERSION
+    uint32_t                nHeaderSize;    // Offset of the snapshot area
+    uint64_t                nSnapshotSize;  // Size of the snapshot area
+    uint64_t                nRingBytes;     // Size of the ring, power of 2
+    uint32_t                nPublisherPid;
+    std::atomic<uint32_t>   bClosed;        // Publisher has gone away
+
+    alignas(64) std::atomic<uint64_t>   nWritePosition;
+    std::atomic<uint64_t>               nWriteLimit;
+
+    // Seqlock over the snapshot, odd while it (or a metadata record) is
+    // being written
+    alignas(64) std::atomic<uint64_t>   nSnapshotSeq;
+    std::atomic<uint64_t>               nSnapshotLength;
+
+    ShmFanoutReaderSlot     aReaders[SHM_FANOUT_MAX_READERS];
+} ShmFanoutHeader;
+
+//
+// Definition of the publisher settings
+//
+typedef struct {
+    std::string sName;                  // shm_open() name, e.g. "/ll-fanout"
+    size_t      nRingBytes;             // Rounded up to a power of 2
+    size_t      nSnapshotBytes;         // Room for the metadata snapshot
+} ShmFanoutConfig;
+
+//
+// Definition of publisher counters
+//
+typedef struct {
+    uint64_t    nRecords;
+    uint64_t    nBytes;
+    uint64_t    nDroppedRecords;        // Too big for the ring/snapshot
+} ShmFanoutPublisherStats;
+
+//
+// Definition of what the publisher can see of a reader
+//
+typedef struct {
+    uint32_t    nPid;
+    uint64_t    nLagBytes;              // How far behind the publisher
+    uint64_t    nOverruns;
+    bool        bSlow;                  // More than half the ring behind
+} ShmFanoutReaderInfo;
+
+//
+// Definition of the shared memory publisher.
+//
+// An event sink that copies every event of one LowLatencyDataClient into a
+// POSIX shared memory ring so any number of local processes can share the
+// one connection.  Data is written as it arrived; everything else is
+// written as a small JSON record and also kept as a snapshot of the
+// current channel state so readers can attach at any time.
+//
+// The publisher never waits for readers.  A reader that falls a whole ring
+// behind is lapped; it notices, counts an overrun and picks up again from
+// the newest data and the snapshot.
+//
+class ShmFanoutPublisher {
+    public:
+        explicit ShmFanoutPublisher(const ShmFanoutConfig&);
+        ~ShmFanoutPublisher();
+
+        ShmFanoutPublisher(const ShmFanoutPublisher&) = delete;
+        ShmFanoutPublisher& operator=(const ShmFanoutPublisher&) = delete;
+
+        bool IsOpen(void) const { return m_pHeader != nullptr; }
+
+        void HandleEvent(EventType, const void *, size_t);
+
+        ShmFanoutPublisherStats Stats(void) const;
+        std::vector<ShmFanoutReaderInfo> Readers(void) const;
+
+    private:
+        uint8_t *Reserve(uint32_t nId, size_t nPayload);
+        void Commit(void);
+        void WriteMetadata(EventType, const void *, size_t);
+        void WriteSnapshot(void);
+
+        ShmFanoutConfig         m_Config;
+        ChannelTracker          m_Tracker;
+
+        ShmFanoutHeader         *m_pHeader;
+        uint8_t                 *m_pSnapshot;
+        uint8_t                 *m_pRing;
+        size_t                  m_nMapSize;
+
+        uint64_t                m_nPosition;    // Next record goes here
+        uint64_t                m_nEnd;         // End of the reserved record
+
+        std::atomic<uint64_t>   m_nRecords;
+        std::atomic<uint64_t>   m_nBytes;
+        std::atomic<uint64_t>   m_nDroppedRecords;
+};
+
+//
+// Definition of the reader settings
+//
+typedef struct {
+    std::string sName;                  // Name the publisher was given
+    unsigned    nIdleSleepUs;           // Sleep when idle in Run(),
+                                        // 0 = spin
+} ShmFanoutReaderConfig;
+
+//
+// Definition of reader counters
+//
+typedef struct {
+    uint64_t    nRecords;
+    uint64_t    nBytes;
+    uint64_t    nOverruns;
+} ShmFanoutReaderStats;
+
+//
+// Definition of the shared memory reader.
+//
+// Attaches to a ShmFanoutPublisher and delivers the same EVENT_TYPE_*
+// sequence a LowLatencyDataClient would, starting with the current channel
+// state.  Poll() makes no system calls:  data events point straight into
+// the (read only) shared ring and are only good until the handler returns.
+//
+// If the publisher laps the reader (the handler was too slow) the reader
+// counts an overrun, skips to the newest data and brings its channel state
+// up to date from the snapshot, delivering whatever events that takes.
+//
+class ShmFanoutReader {
+    public:
+        ShmFanoutReader(const ShmFanoutReaderConfig&, EventHandler);
+        ~ShmFanoutReader();
+
+        ShmFanoutReader(const ShmFanoutReader&) = delete;
+        ShmFanoutReader& operator=(const ShmFanoutReader&) = delete;
+
+        bool IsOpen(void) const { return m_pHeader != nullptr; }
+        bool IsClosed(void) const;
+
+        size_t Poll(size_t nMaxRecords = SIZE_MAX);
+
+        void Run(void);
+        void Start(void);
+        void Stop(void);
+        void Wait(void);
+
+        ShmFanoutReaderStats Stats(void) const;
+
+    private:
+        void Deliver(EventType, const void *, size_t);
+        void Resync(void);
+        void ApplySnapshot(const std::string&);
+        void ApplyMetadata(const std::string&);
+        bool Overwritten(uint64_t nPosition) const;
+
+        ShmFanoutReaderConfig   m_Config;
+        EventHandler            m_fEventHandler;
+        ChannelTracker          m_Tracker;
+
+        ShmFanoutHeader         *m_pHeader;
+        const uint8_t           *m_pSnapshot;
+        const uint8_t           *m_pRing;
+        size_t                  m_nDataMapSize;
+        ShmFanoutReaderSlot     *m_pSlot;
+
+        uint64_t                m_nPosition;    // Next record to read
+
+        std::thread             *m_ReaderThread;
+        std::atomic<bool>       m_bStop;
+
+        std::atomic<uint64_t>   m_nRecords;
+        std::atomic<uint64_t>   m_nBytes;
+        std::atomic<uint64_t>   m_nOverruns;
+};
+
+#endif
+
+#endif
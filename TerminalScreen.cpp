@@ -0,0 +1,245 @@
+#include "TerminalScreen.h"
+#include <algorithm>
+#include <charconv>
+
+#define MAX_SKIP_CELLS  4               // Unchanged cells rewritten rather
+                                        // than moved over, about what a
+                                        // cursor move costs
+
+//
+// Constructor
+//
+TerminalScreen::TerminalScreen(int nRows, int nColumns)
+    : m_nRows(nRows)
+    , m_nColumns(nColumns)
+    , m_vCells(static_cast<size_t>(nRows * nColumns),
+        { U' ', SCREEN_ATTRIBUTE_NORMAL })
+    , m_vShown(m_vCells)
+    , m_bInvalid(true)
+    , m_nShownRow(-1)
+    , m_nShownColumn(-1)
+    , m_nRow(0)
+    , m_nColumn(0)
+    , m_nAttribute(SCREEN_ATTRIBUTE_NORMAL)
+{
+}
+
+//
+// Function used to move the pen
+//
+void TerminalScreen::Move(int nRow, int nColumn)
+{
+    m_nRow = std::max(nRow, 1) - 1;
+    m_nColumn = std::max(nColumn, 1) - 1;
+}
+
+//
+// Function used to draw a character at the pen
+//
+void TerminalScreen::Put(char32_t ch)
+{
+    if(m_nRow < m_nRows && m_nColumn < m_nColumns) {
+        Cell&   c = m_vCells[m_nRow * m_nColumns + m_nColumn];
+        c.ch = ch;
+        c.nAttribute = static_cast<uint8_t>(m_nAttribute);
+    }
+    m_nColumn++;
+}
+
+//
+// Function used to draw UTF-8 text at the pen
+//
+void TerminalScreen::Text(const char *p, size_t n)
+{
+    const uint8_t   *pb = reinterpret_cast<const uint8_t *>(p);
+    const uint8_t   *pEnd = pb + n;
+
+    while(pb < pEnd) {
+        char32_t    ch = *pb++;
+        int         nMore = 0;
+
+        if(ch >= 0xf0) { ch &= 0x07; nMore = 3; }
+        else if(ch >= 0xe0) { ch &= 0x0f; nMore = 2; }
+        else if(ch >= 0xc0) { ch &= 0x1f; nMore = 1; }
+
+        for(; nMore && pb < pEnd; nMore--) ch = (ch << 6) | (*pb++ & 0x3f);
+
+        Put(ch);
+    }
+}
+
+//
+// Function used to draw text right aligned in a field at the pen
+//
+void TerminalScreen::RightAligned(const char *p, size_t n, int nWidth)
+{
+    for(int i = static_cast<int>(n); i < nWidth; i++) Put(U' ');
+    Text(p, n);
+}
+
+//
+// Function used to draw a number with a fixed number of decimal places,
+// right aligned in a field at the pen
+//
+void TerminalScreen::Fixed(double d, int nWidth, int nPrecision)
+{
+    char    sz[64];
+    auto    r = std::to_chars(sz, sz + sizeof(sz), d, std::chars_format::fixed,
+        nPrecision);
+
+    if(r.ec != std::errc()) RightAligned("?", 1, nWidth);
+    else RightAligned(sz, r.ptr - sz, nWidth);
+}
+
+//
+// Function used to draw a count right aligned in a field at the pen
+//
+void TerminalScreen::Unsigned(uint64_t n, int nWidth)
+{
+    char    sz[24];
+    auto    r = std::to_chars(sz, sz + sizeof(sz), n);
+
+    RightAligned(sz, r.ptr - sz, nWidth);
+}
+
+//
+// Function used to blank from the pen to the end of its row
+//
+void TerminalScreen::ClearToEndOfLine(void)
+{
+    if(m_nRow >= m_nRows) return;
+
+    for(int nColumn = m_nColumn; nColumn < m_nColumns; nColumn++)
+        m_vCells[m_nRow * m_nColumns + nColumn] =
+            { U' ', SCREEN_ATTRIBUTE_NORMAL };
+}
+
+//
+// Function used to blank from the pen to the end of the screen
+//
+void TerminalScreen::ClearToEndOfScreen(void)
+{
+    if(m_nRow >= m_nRows) return;
+
+    ClearToEndOfLine();
+    std::fill(m_vCells.begin() + (m_nRow + 1) * m_nColumns, m_vCells.end(),
+        Cell{ U' ', SCREEN_ATTRIBUTE_NORMAL });
+}
+
+//
+// Function used to blank the whole screen
+//
+void TerminalScreen::Clear(void)
+{
+    std::fill(m_vCells.begin(), m_vCells.end(),
+        Cell{ U' ', SCREEN_ATTRIBUTE_NORMAL });
+}
+
+//
+// Function used to append a code point as UTF-8
+//
+static void AppendUtf8(std::string& s, char32_t ch)
+{
+    if(ch < 0x80) s.push_back(static_cast<char>(ch));
+    else if(ch < 0x800) {
+        s.push_back(static_cast<char>(0xc0 | (ch >> 6)));
+        s.push_back(static_cast<char>(0x80 | (ch & 0x3f)));
+    } else if(ch < 0x10000) {
+        s.push_back(static_cast<char>(0xe0 | (ch >> 12)));
+        s.push_back(static_cast<char>(0x80 | ((ch >> 6) & 0x3f)));
+        s.push_back(static_cast<char>(0x80 | (ch & 0x3f)));
+    } else {
+        s.push_back(static_cast<char>(0xf0 | (ch >> 18)));
+        s.push_back(static_cast<char>(0x80 | ((ch >> 12) & 0x3f)));
+        s.push_back(static_cast<char>(0x80 | ((ch >> 6) & 0x3f)));
+        s.push_back(static_cast<char>(0x80 | (ch & 0x3f)));
+    }
+}
+
+//
+// Function used to append a cursor move, 0 based
+//
+static void AppendMove(std::string& s, int nRow, int nColumn)
+{
+    char    sz[16];
+
+    s.append("\x1b[");
+    s.append(sz, std::to_chars(sz, sz + sizeof(sz), nRow + 1).ptr);
+    s.push_back(';');
+    s.append(sz, std::to_chars(sz, sz + sizeof(sz), nColumn + 1).ptr);
+    s.push_back('H');
+}
+
+//
+// Function used to append an attribute change
+//
+static void AppendAttribute(std::string& s, uint8_t nAttribute)
+{
+    if(nAttribute == SCREEN_ATTRIBUTE_BLINK) s.append("\x1b[0;5m");
+    else s.append("\x1b[m");
+}
+
+//
+// Function used to append what takes the terminal from the last frame to
+// this one, leaving its cursor at the pen
+//
+void TerminalScreen::Render(std::string& sOut)
+{
+    // Where the terminal cursor is, -1 if not known
+    int     nRow = m_nShownRow;
+    int     nColumn = m_nShownColumn;
+    uint8_t nAttribute = SCREEN_ATTRIBUTE_NORMAL;
+
+    if(m_bInvalid) {
+        sOut.append("\x1b[m\x1b[2J");
+        std::fill(m_vShown.begin(), m_vShown.end(),
+            Cell{ U' ', SCREEN_ATTRIBUTE_NORMAL });
+        m_bInvalid = false;
+        nRow = nColumn = -1;
+    }
+
+    for(int r = 0; r < m_nRows; r++) {
+        const Cell  *pCells = &m_vCells[r * m_nColumns];
+        Cell        *pShown = &m_vShown[r * m_nColumns];
+
+        for(int c = 0; c < m_nColumns; c++) {
+            if(Same(pCells[c], pShown[c])) continue;
+
+            // Get there, over a few unchanged cells if they're drawn the
+            // same, else with a move
+            bool    bOver = r == nRow && c > nColumn &&
+                c - nColumn <= MAX_SKIP_CELLS;
+            for(int i = nColumn; bOver && i < c; i++)
+                bOver = pShown[i].nAttribute == nAttribute;
+
+            if(bOver) {
+                for(int i = nColumn; i < c; i++) AppendUtf8(sOut, pShown[i].ch);
+            } else if(r != nRow || c != nColumn) AppendMove(sOut, r, c);
+
+            if(pCells[c].nAttribute != nAttribute) {
+                nAttribute = pCells[c].nAttribute;
+                AppendAttribute(sOut, nAttribute);
+            }
+
+            AppendUtf8(sOut, pCells[c].ch);
+            pShown[c] = pCells[c];
+
+            // After the last column the cursor stays put or wraps depending
+            // on the terminal
+            nRow = r;
+            nColumn = c + 1 < m_nColumns ? c + 1 : -1;
+            if(nColumn < 0) nRow = -1;
+        }
+    }
+
+    if(nAttribute != SCREEN_ATTRIBUTE_NORMAL)
+        AppendAttribute(sOut, SCREEN_ATTRIBUTE_NORMAL);
+
+    int nPenRow = std::min(m_nRow, m_nRows - 1);
+    int nPenColumn = std::min(m_nColumn, m_nColumns - 1);
+    if(nPenRow != nRow || nPenColumn != nColumn)
+        AppendMove(sOut, nPenRow, nPenColumn);
+
+    m_nShownRow = nPenRow;
+    m_nShownColumn = nPenColumn;
+}
@@ -0,0 +1,80 @@
+#ifndef __TERMINALSCREEN_H__
+#define __TERMINALSCREEN_H__
+
+#include    <cstddef>
+#include    <cstdint>
+#include    <string>
+#include    <vector>
+
+//
+// Attributes a cell can be drawn with
+//
+typedef enum {
+    SCREEN_ATTRIBUTE_NORMAL,
+    SCREEN_ATTRIBUTE_BLINK,
+} ScreenAttribute;
+
+//
+// Definition of an off-screen model of an ANSI terminal.
+//
+// Drawing only changes cells in memory, at a pen position set by Move()
+// and advanced by what is drawn.  Render() compares the cells with those
+// of the last frame and gives the fewest escape sequences and characters
+// that take the terminal from one to the other, to be sent with a single
+// write.  Cells hold one code point each, so UTF-8 text is fine as long
+// as its characters are one column wide.  Positions are 1 based, like the
+// escape sequences; anything drawn off the screen is dropped.
+//
+// Not thread safe, the caller locks.
+//
+class TerminalScreen {
+    public:
+        TerminalScreen(int nRows, int nColumns);
+
+        void Move(int nRow, int nColumn);
+        void Attribute(ScreenAttribute n) { m_nAttribute = n; }
+
+        void Text(const char *p, size_t n);
+        void Text(const std::string& s) { Text(s.data(), s.size()); }
+        void Fixed(double d, int nWidth, int nPrecision);
+        void Unsigned(uint64_t n, int nWidth);
+
+        void ClearToEndOfLine(void);
+        void ClearToEndOfScreen(void);
+        void Clear(void);
+
+        void Render(std::string& sOut);
+        void Invalidate(void) { m_bInvalid = true; }
+
+        int Rows(void) const { return m_nRows; }
+        int Columns(void) const { return m_nColumns; }
+
+    private:
+        typedef struct {
+            char32_t    ch;
+            uint8_t     nAttribute;
+        } Cell;
+
+        static bool Same(const Cell& a, const Cell& b)
+        {
+            return a.ch == b.ch && a.nAttribute == b.nAttribute;
+        }
+
+        void Put(char32_t ch);
+        void RightAligned(const char *p, size_t n, int nWidth);
+
+        int                 m_nRows;
+        int                 m_nColumns;
+
+        std::vector<Cell>   m_vCells;           // Being drawn
+        std::vector<Cell>   m_vShown;           // As of the last Render()
+        bool                m_bInvalid;         // Terminal contents unknown
+        int                 m_nShownRow;        // Terminal cursor, 0 based,
+        int                 m_nShownColumn;     // -1 if not known
+
+        int                 m_nRow;             // Pen, 0 based
+        int                 m_nColumn;
+        ScreenAttribute     m_nAttribute;
+};
+
+#endif
@@ -0,0 +1,138 @@
+//
+// codec-bench.cpp - Ratio and speed of the FloatCodec on synthetic signals
+//
+//
+// Copyright (c) 2023 by Hi-Techniques Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the “Software”),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+#include    <chrono>
+#include    <cmath>
+#include    <cstring>
+#include    <functional>
+#include    <iostream>
+#include    <random>
+#include    <string>
+#include    <vector>
+#include    "FloatCodec.h"
+
+//
+// Number of samples in each test signal and in each encoded block
+//
+static constexpr size_t nSignalSamples = 4 * 1024 * 1024;
+static constexpr size_t nBlockSamples = 4096;
+
+//
+// Definition of a synthetic test signal
+//
+typedef struct {
+    std::string                 sName;
+    std::function<float(size_t)> fGenerate;
+} TestSignal;
+
+//
+// Function used to time a function, returns seconds for the best of a few
+// runs
+//
+static double Time(std::function<void(void)> f)
+{
+    double  dBest = 1e30;
+
+    for(int i = 0; i < 3; i++) {
+        auto    t0 = std::chrono::steady_clock::now();
+        f();
+        double  d = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - t0).count();
+        if(d < dBest) dBest = d;
+    }
+
+    return dBest;
+}
+
+//
+// Entry point of the application.  Prints one line of key=value pairs per
+// signal so runs can be compared by a script.
+//
+int main(int argc, char *argv[])
+{
+    std::mt19937                    rng(1234);
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    const double                    dPi = 3.14159265358979323846;
+    double                          dWalk = 0.0;
+
+    std::vector<TestSignal> vSignals = {
+        { "constant", [](size_t) { return 1234.0f; } },
+        { "adc_sine_counts", [&](size_t i) {
+            // 16 bit ADC counts of a slow sine with a little noise
+            return std::round(8000.0f * static_cast<float>(
+                std::sin(2.0 * dPi * i / 50000.0)) + 2.0f * noise(rng));
+        } },
+        { "adc_random_walk_counts", [&](size_t) {
+            dWalk += noise(rng);
+            return std::round(static_cast<float>(dWalk));
+        } },
+        { "slow_sine_float", [&](size_t i) {
+            return static_cast<float>(
+                1.0 + 0.01 * std::sin(2.0 * dPi * i / 50000.0));
+        } },
+        { "white_noise_float", [&](size_t) { return noise(rng); } },
+    };
+
+    std::vector<float>      vIn(nSignalSamples);
+    std::vector<float>      vOut(nSignalSamples);
+    std::vector<uint8_t>    vEncoded;
+
+    for(auto& s : vSignals) {
+        for(size_t i = 0; i < nSignalSamples; i++) vIn[i] = s.fGenerate(i);
+
+        double  dEncode = Time([&]() {
+            vEncoded.clear();
+            for(size_t i = 0; i < nSignalSamples; i += nBlockSamples)
+                FloatCodec::EncodeBlock(&vIn[i], nBlockSamples, vEncoded);
+        });
+
+        double  dDecode = Time([&]() {
+            size_t  nOffset = 0;
+            for(size_t i = 0; i < nSignalSamples; i += nBlockSamples) {
+                size_t  nUsed = 0;
+                FloatCodec::DecodeBlock(vEncoded.data() + nOffset,
+                    vEncoded.size() - nOffset, &vOut[i], nBlockSamples,
+                    &nUsed);
+                nOffset += nUsed;
+            }
+        });
+
+        bool    bExact = ::memcmp(vIn.data(), vOut.data(),
+            nSignalSamples * sizeof(float)) == 0;
+        double  dRawMB = nSignalSamples * sizeof(float) / 1e6;
+
+        std::cout << "signal=" << s.sName <<
+            " samples=" << nSignalSamples <<
+            " ratio=" << dRawMB * 1e6 / static_cast<double>(vEncoded.size()) <<
+            " bits_per_sample=" <<
+                vEncoded.size() * 8.0 / static_cast<double>(nSignalSamples) <<
+            " encode_MBps=" << dRawMB / dEncode <<
+            " decode_MBps=" << dRawMB / dDecode <<
+            " exact=" << (bExact ? 1 : 0) << std::endl;
+
+        if(!bExact) return 1;
+    }
+
+    return 0;
+}
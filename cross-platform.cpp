@@ -27,9 +27,37 @@
 #include    "ll-client.h"
 
 #if defined(__linux__)
+#include    <cerrno>
+#include    <poll.h>
+#include    <sys/eventfd.h>
+
+//
+// Function used to get the descriptor WakeKeyPressMonitor() signals, made
+// on first use so wakeups before the monitor starts aren't lost
+//
+static int WakeFd(void)
+{
+    static int  fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return fd;
+}
+
+//
+// Function used to have keyPressMonitor() call its callback with a 0 key,
+// from any thread
+//
+void WakeKeyPressMonitor(void)
+{
+    uint64_t    n = 1;
+    int         fd = WakeFd();
+
+    // Only fails if the count would overflow, it's signalled then anyway
+    if(fd < 0 || ::write(fd, &n, sizeof(n)) != sizeof(n)) return;
+}
+
 //
 // Function used to monitor for keypresses and call a callback function when
-// a key is pressed
+// a key is pressed.  The callback gets a 0 key when woken and, if a timeout
+// is given, when that long has passed without either.
 //
 void keyPressMonitor(uint32_t uTimeoutMS, std::function<void(char)> cb)
 {
@@ -42,27 +70,32 @@ void keyPressMonitor(uint32_t uTimeoutMS, std::function<void(char)> cb)
 
     std::thread t([uTimeoutMS, cb, oldSettings](void) {
         while(true) {
-            fd_set          set;
-            struct timeval  tv;
+            struct pollfd   fds[2];
 
-            tv.tv_sec = 0;
-            tv.tv_usec = uTimeoutMS * 1000;
+            fds[0].fd = ::fileno(stdin);
+            fds[0].events = POLLIN;
+            fds[1].fd = WakeFd();
+            fds[1].events = POLLIN;
 
-            FD_ZERO(&set);
-            FD_SET(::fileno(stdin), &set);
+            int r = ::poll(fds, 2, uTimeoutMS ? uTimeoutMS : -1);
+            if(r < 0 && errno == EINTR) continue;
 
-            int r = ::select(fileno(stdin)+1, &set, nullptr, nullptr, &tv);
-            if(r > 0) {
+            if(r > 0 && (fds[0].revents & POLLIN)) {
                 char    c;
-                if(::read(fileno(stdin), &c, 1)) {
-                    if(c == 'q') break;
-                    else cb(c);
-                }
+                if(::read(fileno(stdin), &c, 1) <= 0) break;
+                if(c == 'q') break;
+                else cb(c);
+
+            } else if(r > 0 && (fds[0].revents & (POLLHUP | POLLERR))) {
+                break;
 
             } else if(r < 0) {
                 break;
 
             } else {
+                // Woken or timed out, clear the wakeup count either way
+                uint64_t    n;
+                if(::read(WakeFd(), &n, sizeof(n)) < 0 && r > 0) continue;
                 cb(0);
             }
         }
@@ -103,9 +136,29 @@ static void ShowError(std::string sFuncName)
     ::LocalFree(messageBuffer);
 }
 
+//
+// Function used to get the event WakeKeyPressMonitor() signals, made on
+// first use so wakeups before the monitor starts aren't lost
+//
+static HANDLE WakeEvent(void)
+{
+    static HANDLE   hEvent = ::CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    return hEvent;
+}
+
+//
+// Function used to have keyPressMonitor() call its callback with a 0 key,
+// from any thread
+//
+void WakeKeyPressMonitor(void)
+{
+    if(WakeEvent()) ::SetEvent(WakeEvent());
+}
+
 //
 // Function used to monitor for keypresses and call a callback function when
-// a key is pressed
+// a key is pressed.  The callback gets a 0 key when woken and, if a timeout
+// is given, when that long has passed without either.
 //
 void keyPressMonitor(uint32_t uTimeoutMS, std::function<void(char)> cb)
 {
@@ -139,6 +192,21 @@ void keyPressMonitor(uint32_t uTimeoutMS, std::function<void(char)> cb)
         bool            bExit = false;
 
         while(!bExit) {
+            HANDLE  aHandles[2] = { hStdin, WakeEvent() };
+            DWORD   dwWait = ::WaitForMultipleObjects(aHandles[1] ? 2 : 1,
+                aHandles, FALSE, uTimeoutMS ? uTimeoutMS : INFINITE);
+
+            if(dwWait != WAIT_OBJECT_0) {
+                if(dwWait == WAIT_FAILED) {
+                    ShowError("WaitForMultipleObjects");
+                    cb('q');
+                    break;
+                }
+
+                cb(0);
+                continue;
+            }
+
             if(!::ReadConsoleInput(hStdin, irInBuf,
                 sizeof(irInBuf)/sizeof(irInBuf[0]), &cNumRead)) {
                 ShowError("ReadConsoleInput");
@@ -25,23 +25,103 @@
 // IN THE SOFTWARE.
 //
 #include    "ll-client.h"
-#if ! defined(__linux__)
+#include    <algorithm>
+#include    <cctype>
+#include    <chrono>
+#include    <condition_variable>
+#include    <cstdio>
+#include    <limits>
+#include    "TerminalScreen.h"
+#if defined(__SSE2__) || defined(_M_X64)
+#include    <emmintrin.h>
+#endif
+#if defined(__linux__)
+#include    <cerrno>
+#include    <unistd.h>
+#else
 #include    "Windows.h"
 #endif
 
 extern int                  currentChannelRow;
 extern std::recursive_mutex g_lChannelInformationLock;
 
-extern std::map<std::string, ChannelInformationEntry>   g_mChannelInformation;
+extern std::vector<ChannelInformationEntry>    g_vChannelInformation;
 
 static std::recursive_mutex l_PrintLock;
 
+//
+// What the screen is to show, sent to the terminal a frame at a time
+//
+static TerminalScreen       l_Screen(LAST_ROW, SCREEN_COLUMNS);
+static std::string          l_sFrame;
+
+//
+// Keys shown on the last row, short enough not to wrap
+//
+static const char           *l_pszKeys = "'q'=quit 'u'=up 'd'=down "
+    "'a'=acq on/off <space>=sub/unsub 's'=suball/unsuball";
+
+//
+// Latest data of each channel id and the thread drawing it.  An id's is
+// made when it is first subscribed, by the socket read thread with
+// l_LiveDataLock held, so it finds them without and the renderer holds it.
+// They never move once made.
+//
+static std::mutex                                   l_LiveDataLock;
+static std::vector<std::unique_ptr<ChannelLiveData>>    l_vLiveData;
+
+//
+// What each channel id showed at the last screen update, only used by the
+// renderer (under l_PrintLock), grown to match l_vLiveData
+//
+typedef struct {
+    ChannelStats    Stats;                      // Last update with samples
+    float           afHistory[SPARK_POINTS];    // Means of the updates,
+    int             nHistory;                   // oldest first
+    uint32_t        nRestarts;                  // As last read
+    uint64_t        nPublished;                 // As last read
+    uint64_t        nFrame;                     // Of afHistory's newest
+} ChannelShown;
+
+static std::vector<ChannelShown>    l_vShown;
+static bool                     l_bStatsView = false;
+
+//
+// Screen updates started, the statistics of each channel are added up from
+// the packets of one frame
+//
+static std::atomic<uint64_t>    l_nFrame(0);
+
+//
+// What each channel row showed at the last screen update, so that rows
+// with nothing new are left as they are.  Only used by the renderer.
+//
+typedef struct {
+    ChannelHandle                   hChannel;   // NO_CHANNEL_HANDLE =
+                                                // empty row
+    int                             nChannelId;
+    double                          dFirstSampleTimestamp;
+    bool                            bHighlight;
+    uint64_t                        ullPackets;
+    uint64_t                        ullTotalSamples;
+    uint64_t                        nPublished; // Of the statistics shown
+} ChannelRowShown;
+
+static ChannelRowShown          l_aRowShown[CHANNEL_ROWS];
+static std::atomic<bool>        l_bRedrawRows(true);    // All of them
+
+static std::thread              l_RenderThread;
+static std::mutex               l_RenderLock;
+static std::condition_variable  l_RenderStop;
+static bool                     l_bRenderStop = false;
+
 //
 // Clear the screen
 //
 void clear_screen(void) {
     std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
-    std::cout << "[2J" << std::flush;
+    l_Screen.Clear();
+    l_bRedrawRows = true;
 }
 
 //
@@ -49,7 +129,7 @@ void clear_screen(void) {
 //
 void clear_eos(void) {
     std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
-    std::cout << "[J" << std::flush;
+    l_Screen.ClearToEndOfScreen();
 }
 
 //
@@ -57,7 +137,7 @@ void clear_eos(void) {
 //
 void clear_eol(void) {
     std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
-    std::cout << "[0K" << std::flush;
+    l_Screen.ClearToEndOfLine();
 }
 
 //
@@ -65,18 +145,18 @@ void clear_eol(void) {
 //
 void screen_position(int row, int col) {
     std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
-    std::cout << "[" << row << ";" << col << "H" << std::flush;
+    l_Screen.Move(row, col);
 }
 
 //
 // Center the string on the indicated line
 //
 void center_string(int row, std::string& s) {
-    int c = (80 - s.size()) / 2;
+    int c = (SCREEN_COLUMNS - s.size()) / 2;
 
     std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
     screen_position(row, c);
-    std::cout << s << std::flush;
+    l_Screen.Text(s);
 }
 
 //
@@ -88,33 +168,41 @@ void center_string(int row, char *cs) {
     center_string(row, s);
 }
 
+//
+// Rows of the channel table: the handles of the channels whose names match
+// the filter, in name order.  Kept in order as channels are added and
+// removed, and only found again from the whole table when the filter
+// changes or UpdateChannels() is called.  Only the rows from l_nTopRow on
+// that fit are drawn.  Guarded by g_lChannelInformationLock.
+//
+static std::vector<ChannelHandle>               l_vRows;
+static bool                                     l_bRowsDirty = true;
+static std::string                              l_sCursorName;
+static int                                      l_nTopRow = 0;
+static std::string                              l_sFilter;
+static bool                                     l_bEditingFilter = false;
+
 //
 // Function used to print the channel name
 //
-static void PrintChannelName(int row, std::string sName,
-    bool bHighlight = false)
+static void PrintChannelName(int row, const ChannelInformationEntry& cie,
+    bool bHighlight)
 {
     std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
     screen_position(row, NAME_COLUMN);
 
-    if(bHighlight && row - CHANNEL_START_ROW == currentChannelRow)
-        std::cout << "[5m" << std::flush;
-    else
-        std::cout << "[m" << std::flush;
+    if(bHighlight) l_Screen.Attribute(SCREEN_ATTRIBUTE_BLINK);
+    else l_Screen.Attribute(SCREEN_ATTRIBUTE_NORMAL);
 
-    std::cout << sName << std::flush;
+    l_Screen.Text(cie.sChannelInfo.sName);
 
-    if(g_mChannelInformation.find(sName) !=
-        g_mChannelInformation.end()) {
-        if(g_mChannelInformation[sName].nChannelId >= 0)
-            std::cout << " (id=" <<
-                g_mChannelInformation[sName].nChannelId << ")" << std::flush;
+    if(cie.nChannelId >= 0) {
+        l_Screen.Text(" (id=");
+        l_Screen.Unsigned(cie.nChannelId, 0);
+        l_Screen.Text(")");
     }
 
-    if(bHighlight && row - CHANNEL_START_ROW == currentChannelRow)
-        std::cout << "[m" << std::flush;
-
-    screen_position(currentChannelRow + CHANNEL_START_ROW, NAME_COLUMN);
+    l_Screen.Attribute(SCREEN_ATTRIBUTE_NORMAL);
 }
 
 #if defined(WITH_EXTRA_CHANNEL_INFO)
@@ -125,8 +213,7 @@ static void PrintChannelDataType(int row, std::string sDataType)
 {
     std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
     screen_position(row, DATATYPE_COLUMN);
-    std::cout << ci.sDataType << std::flush;
-    screen_position(currentChannelRow + CHANNEL_START_ROW, NAME_COLUMN);
+    l_Screen.Text(sDataType);
 }
 
 //
@@ -136,9 +223,7 @@ static void PrintChannelScale(int row, double dScale)
 {
     std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
     screen_position(row, SCALE_COLUMN);
-    std::cout << std::setw(8) << std::setprecision(2) << std::fixed <<
-        std::right << dScale << std::flush;
-    screen_position(currentChannelRow + CHANNEL_START_ROW, NAME_COLUMN);
+    l_Screen.Fixed(dScale, 8, 2);
 }
 
 //
@@ -148,9 +233,7 @@ static void PrintChannelOffset(int row, double dOffset)
 {
     std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
     screen_position(row, OFFSET_COLUMN);
-    std::cout << std::setw(8) << std::setprecision(2) << std::fixed <<
-        std::right << dOffset << std::flush;
-    screen_position(currentChannelRow + CHANNEL_START_ROW, NAME_COLUMN);
+    l_Screen.Fixed(dOffset, 8, 2);
 }
 
 //
@@ -160,8 +243,7 @@ static void PrintChannelDecimationFactor(int row, int nDFactor)
 {
     std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
     screen_position(row, DFACTOR_COLUMN);
-    std::cout << std::setw(6) << std::right << nDFactor << std::flush;
-    screen_position(currentChannelRow + CHANNEL_START_ROW, NAME_COLUMN);
+    l_Screen.Unsigned(nDFactor, 6);
 }
 #endif
 
@@ -172,11 +254,10 @@ static void PrintChannelSampleRate(int row, double dSampleRate)
 {
     std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
     screen_position(row, SAMPLE_RATE_COLUMN);
-    std::cout << std::setw(10) << std::setprecision(2) << std::fixed <<
-        std::right << dSampleRate << std::flush;
-    screen_position(currentChannelRow + CHANNEL_START_ROW, NAME_COLUMN);
+    l_Screen.Fixed(dSampleRate, 10, 2);
 }
 
+#if ! defined(WITH_EXTRA_CHANNEL_INFO)
 //
 // Function used to print the first sample timestamp for the channel
 //
@@ -184,40 +265,117 @@ static void PrintChannelTotalSamples(int row, uint64_t ullTotalSamples)
 {
     std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
     screen_position(row, TOTAL_SAMPLES_COLUMN);
-    std::cout << std::setw(12) << std::right << ullTotalSamples  << std::flush;
-    screen_position(currentChannelRow + CHANNEL_START_ROW, NAME_COLUMN);
+    l_Screen.Unsigned(ullTotalSamples, 12);
 }
+#endif
 
 //
 // Function used to print the first sample timestamp
 //
-void PrintChannelFSTS(int row, double dFSTS)
+static void PrintChannelFSTS(int row, double dFSTS)
 {
     std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
     screen_position(row, FSTS_COLUMN);
-    if(!std::isnan(dFSTS))
-        std::cout << std::setw(12) << std::setprecision(6) << std::fixed <<
-            std::right << dFSTS << std::flush;
-    else
-        std::cout << std::setw(12) << std::setprecision(6) << std::fixed <<
-            std::right << "N/A" << std::flush;
+    if(!std::isnan(dFSTS)) l_Screen.Fixed(dFSTS, 12, 6);
+    else l_Screen.Text("         N/A");
+}
+
+#if ! defined(WITH_EXTRA_CHANNEL_INFO)
+//
+// Function used to print a sparkline of the means of the last screen
+// updates, lowest to highest of them
+//
+static void PrintChannelSparkline(int row, const ChannelShown& cs,
+    const ChannelInfo& ci)
+{
+    if(!cs.nHistory) return;
+
+    float   afPoints[SPARK_POINTS];
+    for(int i = 0; i < cs.nHistory; i++)
+        afPoints[i] = (cs.afHistory[i] * ci.dScale) + ci.dOffset;
+
+    auto    mm = std::minmax_element(afPoints, afPoints + cs.nHistory);
+    float   fLow = *mm.first;
+    float   fRange = *mm.second - fLow;
 
-    screen_position(currentChannelRow + CHANNEL_START_ROW, NAME_COLUMN);
+    // U+2581 to U+2588, lower one eighth block to full block
+    std::string str;
+    for(int i = 0; i < cs.nHistory; i++) {
+        int n = fRange > 0.0f ?
+            static_cast<int>((afPoints[i] - fLow) / fRange * 7.0f + 0.5f) : 3;
+        str.append("\xe2\x96");
+        str.push_back(static_cast<char>(0x81 + std::max(0, std::min(n, 7))));
+    }
+
+    std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
+    screen_position(row, SPARK_COLUMN);
+    l_Screen.Text(str);
 }
 
 //
-// Print an entire channel row of data items
+// Function used to print the minimum, maximum, mean and RMS of the samples
+// of a channel since the screen update before, and its sparkline
 //
-void PrintChannelRow(int row, const ChannelInfo& ci)
+static void PrintChannelStats(int row, const ChannelShown& cs,
+    const ChannelInfo& ci)
 {
+    const ChannelStats& st = cs.Stats;
+    if(!st.ullSamples) return;
+
+    double  a = ci.dScale;
+    double  b = ci.dOffset;
+    double  dMean = st.dSum / st.ullSamples;
+    double  dMin = (st.fMin * a) + b;
+    double  dMax = (st.fMax * a) + b;
+    if(a < 0.0) std::swap(dMin, dMax);
+
+    // Mean square of a * x + b from those of x
+    double  dMeanSquare = (a * a * st.dSumSquares / st.ullSamples) +
+        (2.0 * a * b * dMean) + (b * b);
+
     std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
-    // Adjust row to start of channel area
-    row += CHANNEL_START_ROW;
+    screen_position(row, MIN_COLUMN);
+    l_Screen.Fixed(dMin, 9, 3);
+    screen_position(row, MAX_COLUMN);
+    l_Screen.Fixed(dMax, 9, 3);
+    screen_position(row, MEAN_COLUMN);
+    l_Screen.Fixed((dMean * a) + b, 9, 3);
+    screen_position(row, RMS_COLUMN);
+    l_Screen.Fixed(std::sqrt(std::max(dMeanSquare, 0.0)), 9, 3);
+
+    PrintChannelSparkline(row, cs, ci);
+}
+#endif
+
+//
+// Function used to get the latest data of a channel id, nullptr if it has
+// none.  For the renderer.
+//
+static const ChannelLiveData *LiveData(int nId)
+{
+    std::unique_lock<std::mutex>    lk(l_LiveDataLock);
+
+    return nId >= 0 && static_cast<size_t>(nId) < l_vLiveData.size() ?
+        l_vLiveData[nId].get() : nullptr;
+}
+
+//
+// Print an entire channel row of data items, with the latest data if the
+// channel is subscribed:  the last sample of the latest packet and the
+// total samples, or in the statistics view the minimum, maximum, mean and
+// RMS of the samples since the screen update before and a sparkline of
+// the means of the last updates.
+//
+static void PrintChannelRow(int row, const ChannelInformationEntry& cie,
+    bool bHighlight)
+{
+    std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
+    const ChannelInfo&                      ci = cie.sChannelInfo;
 
     // Channel name is first
     screen_position(row, NAME_COLUMN);
     clear_eol();
-    PrintChannelName(row, ci.sName, true);
+    PrintChannelName(row, cie, bHighlight);
 
 #if defined(WITH_EXTRA_CHANNEL_INFO)
     PrintChannelDataType(row, ci.sDataType);
@@ -227,175 +385,802 @@ void PrintChannelRow(int row, const ChannelInfo& ci)
     PrintChannelDecimationFactor(row, ci.nDecimationFactor);
 #else
     PrintChannelSampleRate(row, 1.0 / ci.dSamplePeriod);
-    PrintChannelTotalSamples(row,
-        g_mChannelInformation[ci.sName].ullTotalSamples);
 #endif
 
-    if(g_mChannelInformation.find(ci.sName) != g_mChannelInformation.end())
-        PrintChannelFSTS(row,
-            g_mChannelInformation[ci.sName].dFirstSampleTimestamp);
-    else
-        PrintChannelFSTS(row, NAN);
+    if(!l_bStatsView) PrintChannelFSTS(row, cie.dFirstSampleTimestamp);
+
+#if ! defined(WITH_EXTRA_CHANNEL_INFO)
+    int                     nId = cie.nChannelId;
+    const ChannelLiveData   *pld = LiveData(nId);
+    if(!pld) return;
+
+    if(l_bStatsView) {
+        if(static_cast<size_t>(nId) < l_vShown.size())
+            PrintChannelStats(row, l_vShown[nId], ci);
+        return;
+    }
 
-    screen_position(currentChannelRow + CHANNEL_START_ROW, NAME_COLUMN);
+    const ChannelLiveData&  ld = *pld;
+
+    if(ld.ullPackets.load(std::memory_order_acquire)) {
+        screen_position(row, SAMPLE_COLUMN);
+        l_Screen.Fixed((ld.fLastSample.load() * ci.dScale) + ci.dOffset,
+            10, 6);
+    }
+
+    PrintChannelTotalSamples(row, ld.ullTotalSamples.load());
+#endif
 }
 
 //
-// Function used to print a data value for a channel.  Note:  only the last
-// sample from the buffer is printed.
+// Function used to get the statistics of a block of samples.  The samples
+// are taken STATS_LANES at a time into as many independent minimums,
+// maximums and sums, with SSE2 where there is it (the compiler won't
+// vectorize float minimums and maximums itself), and the lanes combined
+// at the end.  Sums are kept as floats within a block and as doubles
+// across blocks.
 //
-void PrintChannelData(const ChannelDataInfo *cdi)
+#define STATS_LANES     8
+
+void ChannelBlockStats(const float *pData, size_t nSamples, ChannelStats& s)
 {
-    std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
-    // Find the channel information for the channel id
-    for(auto it = g_mChannelInformation.begin();
-        it != g_mChannelInformation.end(); it++) {
-
-        if((*it).second.nChannelId == cdi->nId) {
-            // Channel information found, set screen position and print the
-            // value
-            int row = std::distance(g_mChannelInformation.begin(), it);
-            screen_position(CHANNEL_START_ROW + row, SAMPLE_COLUMN);
-
-            double dScale = (*it).second.sChannelInfo.dScale;
-            double dOffset = (*it).second.sChannelInfo.dOffset;
-            (*it).second.ullTotalSamples += cdi->nSamples;
-
-            std::cout << std::setw(10) << std::setprecision(6) << std::fixed <<
-                std::right <<
-                ((cdi->pData[cdi->nSamples - 1] * dScale) + dOffset) <<
-                std::flush;
-
-            PrintChannelTotalSamples(row + CHANNEL_START_ROW,
-                (*it).second.ullTotalSamples);
-
-            screen_position(currentChannelRow + CHANNEL_START_ROW, NAME_COLUMN);
-            return;
+    const float fInfinity = std::numeric_limits<float>::infinity();
+    size_t      nLanes = nSamples & ~static_cast<size_t>(STATS_LANES - 1);
+    float       afMin[STATS_LANES];
+    float       afMax[STATS_LANES];
+    float       afSum[STATS_LANES];
+    float       afSumSquares[STATS_LANES];
+
+#if defined(__SSE2__) || defined(_M_X64)
+    __m128  vMin0 = _mm_set1_ps(fInfinity), vMin1 = vMin0;
+    __m128  vMax0 = _mm_set1_ps(-fInfinity), vMax1 = vMax0;
+    __m128  vSum0 = _mm_setzero_ps(), vSum1 = vSum0;
+    __m128  vSumSquares0 = vSum0, vSumSquares1 = vSum0;
+
+    for(size_t i = 0; i < nLanes; i += STATS_LANES) {
+        __m128  v0 = _mm_loadu_ps(pData + i);
+        __m128  v1 = _mm_loadu_ps(pData + i + 4);
+
+        // The sample second, so a NaN leaves the lane as it was
+        vMin0 = _mm_min_ps(v0, vMin0);
+        vMin1 = _mm_min_ps(v1, vMin1);
+        vMax0 = _mm_max_ps(v0, vMax0);
+        vMax1 = _mm_max_ps(v1, vMax1);
+        vSum0 = _mm_add_ps(vSum0, v0);
+        vSum1 = _mm_add_ps(vSum1, v1);
+        vSumSquares0 = _mm_add_ps(vSumSquares0, _mm_mul_ps(v0, v0));
+        vSumSquares1 = _mm_add_ps(vSumSquares1, _mm_mul_ps(v1, v1));
+    }
+
+    _mm_storeu_ps(afMin, vMin0);
+    _mm_storeu_ps(afMin + 4, vMin1);
+    _mm_storeu_ps(afMax, vMax0);
+    _mm_storeu_ps(afMax + 4, vMax1);
+    _mm_storeu_ps(afSum, vSum0);
+    _mm_storeu_ps(afSum + 4, vSum1);
+    _mm_storeu_ps(afSumSquares, vSumSquares0);
+    _mm_storeu_ps(afSumSquares + 4, vSumSquares1);
+#else
+    for(int j = 0; j < STATS_LANES; j++) {
+        afMin[j] = fInfinity;
+        afMax[j] = -fInfinity;
+        afSum[j] = 0.0f;
+        afSumSquares[j] = 0.0f;
+    }
+
+    for(size_t i = 0; i < nLanes; i += STATS_LANES) {
+        for(int j = 0; j < STATS_LANES; j++) {
+            float   f = pData[i + j];
+            afMin[j] = f < afMin[j] ? f : afMin[j];
+            afMax[j] = f > afMax[j] ? f : afMax[j];
+            afSum[j] += f;
+            afSumSquares[j] += f * f;
         }
     }
+#endif
+
+    s.fMin = fInfinity;
+    s.fMax = -fInfinity;
+    s.dSum = 0.0;
+    s.dSumSquares = 0.0;
+    for(int j = 0; j < STATS_LANES; j++) {
+        s.fMin = std::min(s.fMin, afMin[j]);
+        s.fMax = std::max(s.fMax, afMax[j]);
+        s.dSum += afSum[j];
+        s.dSumSquares += afSumSquares[j];
+    }
+
+    for(size_t i = nLanes; i < nSamples; i++) {
+        float   f = pData[i];
+        s.fMin = f < s.fMin ? f : s.fMin;
+        s.fMax = f > s.fMax ? f : s.fMax;
+        s.dSum += f;
+        s.dSumSquares += f * f;
+    }
+    s.ullSamples = nSamples;
 }
 
 //
-// Function used to draw all of the fixed text on the screen
+// Function used to add statistics to those of the samples before
 //
-void DrawLabels(char *appName)
+static void MergeStats(ChannelStats& s, const ChannelStats& b)
 {
-#if ! defined(__linux__)
-    // This makes ANSI escape sequences work on Windows
-    HANDLE  hOut = GetStdHandle(STD_OUTPUT_HANDLE);
-    if(hOut != INVALID_HANDLE_VALUE) {
-        DWORD   dwOriginalOutMode = 0;
-        if(GetConsoleMode(hOut, &dwOriginalOutMode)) {
-            DWORD   dwRequestedOutModes = ENABLE_VIRTUAL_TERMINAL_PROCESSING;
-            DWORD   dwOutMode = dwOriginalOutMode | dwRequestedOutModes;
-            if(SetConsoleMode(hOut, dwOutMode)) {
-                ::system(" ");
-            } else {
-                ::printf("\n\nWindows 10 sucks Unable to set console mode\n");
-                exit(0);
-            }
-        } else {
-            ::printf("\n\nWindows 10 sucks Unable to get console mode\n");
-            exit(0);
+    if(!s.ullSamples) {
+        s = b;
+        return;
+    }
+
+    s.fMin = std::min(s.fMin, b.fMin);
+    s.fMax = std::max(s.fMax, b.fMax);
+    s.dSum += b.dSum;
+    s.dSumSquares += b.dSumSquares;
+    s.ullSamples += b.ullSamples;
+}
+
+//
+// Function used to hand a channel's statistics to the renderer.  Only
+// called from the socket read thread, the one writer.
+//
+static void PublishStats(ChannelLiveData& ld, const ChannelStats& s,
+    uint64_t nFrame, bool bRestart)
+{
+    const auto  r = std::memory_order_relaxed;
+    uint32_t    nSeq = ld.nSeq.load(r);
+
+    ld.nSeq.store(nSeq + 1, r);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if(bRestart) ld.nRestarts.store(ld.nRestarts.load(r) + 1, r);
+    ld.nPublished.store(ld.nPublished.load(r) + 1, r);
+    ld.nFrame.store(nFrame, r);
+    ld.fMin.store(s.fMin, r);
+    ld.fMax.store(s.fMax, r);
+    ld.dSum.store(s.dSum, r);
+    ld.dSumSquares.store(s.dSumSquares, r);
+    ld.ullSamples.store(s.ullSamples, r);
+
+    ld.nSeq.store(nSeq + 2, std::memory_order_release);
+}
+
+//
+// Function used to read what PublishStats() last handed over, trying again
+// if it was being written at the time
+//
+static void ReadStats(const ChannelLiveData& ld, ChannelStats& s,
+    uint32_t& nRestarts, uint64_t& nPublished, uint64_t& nFrame)
+{
+    const auto  r = std::memory_order_relaxed;
+
+    while(true) {
+        uint32_t    nSeq = ld.nSeq.load(std::memory_order_acquire);
+        if(nSeq & 1) {
+            std::this_thread::yield();
+            continue;
         }
-    } else {
-        ::printf("\n\nWindows 10 sucks Unable to get stdout handle\n");
-        exit(0);
+
+        nRestarts = ld.nRestarts.load(r);
+        nPublished = ld.nPublished.load(r);
+        nFrame = ld.nFrame.load(r);
+        s.fMin = ld.fMin.load(r);
+        s.fMax = ld.fMax.load(r);
+        s.dSum = ld.dSum.load(r);
+        s.dSumSquares = ld.dSumSquares.load(r);
+        s.ullSamples = ld.ullSamples.load(r);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(ld.nSeq.load(r) == nSeq) return;
     }
-#endif
+}
 
-    // Clear the screen
-    clear_screen();
+//
+// Function used to note the latest data of a channel.  Called by the socket
+// read thread for every data packet, so it only reduces the block, adds it
+// to the channel's statistics and leaves the drawing to the renderer.
+//
+void UpdateChannelData(const ChannelDataInfo *cdi)
+{
+    if(cdi->nId < 0 || static_cast<size_t>(cdi->nId) >= l_vLiveData.size() ||
+        !cdi->nSamples) return;
 
-    // Show version, build date, and build number
-    std::string str(appName);
-    center_string(APP_ROW, str);
+    ChannelLiveData&    ld = *l_vLiveData[cdi->nId];
+    const auto          r = std::memory_order_relaxed;
 
-    std::string heading("Available Channels");
-    center_string(TITLE_ROW, heading);
+    ChannelStats    s;
+    ChannelBlockStats(cdi->pData, cdi->nSamples, s);
+
+    // A new frame has started, add up its packets from scratch
+    uint64_t    nFrame = l_nFrame.load(std::memory_order_acquire);
+    if(nFrame != ld.nIntervalFrame) {
+        ld.Interval.ullSamples = 0;
+        ld.nIntervalFrame = nFrame;
+    }
+    MergeStats(ld.Interval, s);
+    PublishStats(ld, ld.Interval, nFrame, false);
+
+    ld.fLastSample.store(cdi->pData[cdi->nSamples - 1], r);
+    ld.ullTotalSamples.store(ld.ullTotalSamples.load(r) + cdi->nSamples, r);
+    ld.ullPackets.store(ld.ullPackets.load(r) + 1, std::memory_order_release);
+}
+
+//
+// Function used to start the data of a newly subscribed channel id over,
+// making it if the id is the highest yet.  Called from the socket read
+// thread, like UpdateChannelData().
+//
+void ResetChannelData(int nId)
+{
+    if(nId < 0) return;
+
+    if(static_cast<size_t>(nId) >= l_vLiveData.size()) {
+        std::unique_lock<std::mutex>    lk(l_LiveDataLock);
+        while(l_vLiveData.size() <= static_cast<size_t>(nId))
+            l_vLiveData.push_back(std::make_unique<ChannelLiveData>());
+    }
+
+    ChannelLiveData&    ld = *l_vLiveData[nId];
+
+    ld.fLastSample.store(0.0f);
+    ld.ullTotalSamples.store(0);
+    ld.ullPackets.store(0);
+
+    ChannelStats    s = {};
+    ld.Interval.ullSamples = 0;
+    ld.nIntervalFrame = l_nFrame.load(std::memory_order_acquire);
+    PublishStats(ld, s, ld.nIntervalFrame, true);
+}
+
+//
+// Function used to take the statistics of every channel id handed over
+// since the last screen update, then start a new frame.  The mean of a
+// frame not seen before is added to the sparkline, one seen before (some
+// of its packets came after the last update) replaces its last point.
+//
+static void TakeChannelStats(void)
+{
+    std::unique_lock<std::mutex>    lk(l_LiveDataLock);
+
+    if(l_vShown.size() < l_vLiveData.size())
+        l_vShown.resize(l_vLiveData.size(), ChannelShown());
+
+    for(size_t nId = 0; nId < l_vLiveData.size(); nId++) {
+        const ChannelLiveData&  ld = *l_vLiveData[nId];
+        ChannelShown&           cs = l_vShown[nId];
+        ChannelStats        s;
+        uint32_t            nRestarts;
+        uint64_t            nPublished;
+        uint64_t            nFrame;
+
+        ReadStats(ld, s, nRestarts, nPublished, nFrame);
+
+        if(nRestarts != cs.nRestarts) {
+            cs.nRestarts = nRestarts;
+            cs.Stats.ullSamples = 0;
+            cs.nHistory = 0;
+        }
+
+        if(nPublished == cs.nPublished) continue;
+        cs.nPublished = nPublished;
+        if(!s.ullSamples) continue;
+
+        cs.Stats = s;
+        if(cs.nHistory && nFrame == cs.nFrame) {
+            cs.afHistory[cs.nHistory - 1] =
+                static_cast<float>(s.dSum / s.ullSamples);
+            continue;
+        }
+        cs.nFrame = nFrame;
+
+        if(cs.nHistory == SPARK_POINTS) {
+            std::copy(cs.afHistory + 1, cs.afHistory + SPARK_POINTS,
+                cs.afHistory);
+            cs.nHistory--;
+        }
+        cs.afHistory[cs.nHistory++] = static_cast<float>(s.dSum / s.ullSamples);
+    }
+
+    l_nFrame.fetch_add(1, std::memory_order_release);
+}
+
+//
+// Function used to switch the data columns between the latest value and
+// the statistics of each screen update
+//
+void ToggleChannelView(void)
+{
+    std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
+    l_bStatsView = !l_bStatsView;
+    l_bRedrawRows = true;
+}
+
+//
+// Function used to clear the sample counts of every channel, when
+// acquisition stops
+//
+void ResetChannelTotals(void)
+{
+    std::unique_lock<std::mutex>    lk(l_LiveDataLock);
+    for(auto& pld : l_vLiveData) pld->ullTotalSamples.store(0);
+}
+
+//
+// Function used to note that any number of channels have been added or
+// removed, so the rows of the channel table are found again before they're
+// next used.  Called with g_lChannelInformationLock held.
+//
+void UpdateChannels(void)
+{
+    std::unique_lock<std::recursive_mutex>  lk(g_lChannelInformationLock);
+    l_bRowsDirty = true;
+}
+
+//
+// Function used to get the name of the channel on a row
+//
+static const std::string& RowName(ChannelHandle h)
+{
+    return g_vChannelInformation[h].sChannelInfo.sName;
+}
+
+//
+// Function used to find where a channel's row is, or would go, in the
+// rows of the channel table
+//
+static std::vector<ChannelHandle>::iterator FindRow(const std::string& sName)
+{
+    return std::lower_bound(l_vRows.begin(), l_vRows.end(), sName,
+        [](ChannelHandle h, const std::string& s) { return RowName(h) < s; });
+}
+
+//
+// Function used to tell whether a channel name matches the filter, any
+// part of it ignoring case
+//
+static bool MatchesFilter(const std::string& sName)
+{
+    auto    it = std::search(sName.begin(), sName.end(),
+        l_sFilter.begin(), l_sFilter.end(), [](char a, char b) {
+            return std::tolower(static_cast<unsigned char>(a)) ==
+                std::tolower(static_cast<unsigned char>(b));
+        });
+
+    return it != sName.end() || l_sFilter.empty();
+}
+
+//
+// Function used to give a channel just added to the table its row, if its
+// name matches the filter, keeping the cursor on the channel it's on.
+// Called with g_lChannelInformationLock held.
+//
+void AddChannelRow(ChannelHandle h)
+{
+    std::unique_lock<std::recursive_mutex>  lk(g_lChannelInformationLock);
+
+    if(l_bRowsDirty || !MatchesFilter(RowName(h))) return;
+
+    auto    it = FindRow(RowName(h));
+    if(it != l_vRows.end() && *it == h) return;
+
+    int row = static_cast<int>(it - l_vRows.begin());
+    l_vRows.insert(it, h);
+    if(l_vRows.size() > 1 && row <= currentChannelRow) currentChannelRow++;
+    l_bRedrawRows = true;
+}
+
+//
+// Function used to take away the row of a channel about to be removed from
+// the table, keeping the cursor on the channel it's on.  Called with
+// g_lChannelInformationLock held.
+//
+void RemoveChannelRow(ChannelHandle h)
+{
+    std::unique_lock<std::recursive_mutex>  lk(g_lChannelInformationLock);
+
+    if(l_bRowsDirty) return;
+
+    auto    it = FindRow(RowName(h));
+    if(it == l_vRows.end() || *it != h) return;
+
+    int row = static_cast<int>(it - l_vRows.begin());
+    l_vRows.erase(it);
+    if(row < currentChannelRow) currentChannelRow--;
+    l_bRedrawRows = true;
+}
+
+//
+// Function used to bring the rows of the channel table up to date, and
+// keep the cursor and the rows shown in range.  The cursor stays on the
+// channel it was on if that's still a row.
+//
+static void FindRows(void)
+{
+    if(l_bRowsDirty) {
+        l_bRowsDirty = false;
+        l_bRedrawRows = true;
+        l_vRows.clear();
+
+        for(size_t h = 0; h < g_vChannelInformation.size(); h++) {
+            const ChannelInfo&  ci = g_vChannelInformation[h].sChannelInfo;
+            if(ci.hChannel != h || !MatchesFilter(ci.sName)) continue;
+            l_vRows.push_back(ci.hChannel);
+        }
+
+        // The table is by handle, the rows are by name
+        std::sort(l_vRows.begin(), l_vRows.end(),
+            [](ChannelHandle a, ChannelHandle b) {
+                return RowName(a) < RowName(b);
+            });
+
+        auto    it = FindRow(l_sCursorName);
+        if(it != l_vRows.end() && RowName(*it) == l_sCursorName)
+            currentChannelRow = static_cast<int>(it - l_vRows.begin());
+    }
+
+    int nRows = static_cast<int>(l_vRows.size());
+
+    currentChannelRow = std::max(0, std::min(currentChannelRow, nRows - 1));
+
+    if(l_nTopRow > currentChannelRow) l_nTopRow = currentChannelRow;
+    if(l_nTopRow <= currentChannelRow - CHANNEL_ROWS)
+        l_nTopRow = currentChannelRow - CHANNEL_ROWS + 1;
+    l_nTopRow = std::max(0, std::min(l_nTopRow, nRows - CHANNEL_ROWS));
+
+    if(nRows) l_sCursorName = RowName(l_vRows[currentChannelRow]);
+    else l_sCursorName.clear();
+}
+
+//
+// Function used to move the cursor up (< 0) or down (> 0) rows of the
+// channel table, going round from one end to the other
+//
+void MoveChannelCursor(int nRows)
+{
+    std::unique_lock<std::recursive_mutex>  lk(g_lChannelInformationLock);
+
+    FindRows();
+    if(l_vRows.empty()) return;
+
+    int n = static_cast<int>(l_vRows.size());
+    currentChannelRow = ((currentChannelRow + nRows) % n + n) % n;
+    FindRows();
+}
+
+//
+// Function used to scroll the channel table back (< 0) or on (> 0) pages,
+// keeping the cursor where it is on the screen
+//
+void PageChannels(int nPages)
+{
+    std::unique_lock<std::recursive_mutex>  lk(g_lChannelInformationLock);
+
+    FindRows();
+
+    int nRows = static_cast<int>(l_vRows.size());
+    int nTopRow = std::max(0,
+        std::min(l_nTopRow + nPages * CHANNEL_ROWS, nRows - CHANNEL_ROWS));
+
+    currentChannelRow += nTopRow - l_nTopRow;
+    l_nTopRow = nTopRow;
+    FindRows();
+}
+
+//
+// Function used to show only the channels whose names contain sFilter,
+// ignoring case, all of them if it's empty.  bEditing shows it's being
+// typed.
+//
+void SetChannelFilter(const std::string& sFilter, bool bEditing)
+{
+    std::unique_lock<std::recursive_mutex>  lk(g_lChannelInformationLock);
+
+    if(sFilter != l_sFilter) {
+        l_sFilter = sFilter;
+        l_bRowsDirty = true;
+    }
+    l_bEditingFilter = bEditing;
+}
+
+//
+// Function used to get the channel on the cursor row, nullptr if there
+// are no rows.  Only good while g_lChannelInformationLock is held.
+//
+ChannelInformationEntry *ChannelAtCursor(void)
+{
+    std::unique_lock<std::recursive_mutex>  lk(g_lChannelInformationLock);
+
+    FindRows();
+    if(l_vRows.empty()) return nullptr;
+
+    return &g_vChannelInformation[l_vRows[currentChannelRow]];
+}
+
+//
+// Function used to draw the column headings of the channel table
+//
+static void PrintColumnHeadings(void)
+{
+    std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
+    screen_position(COLUMN_HEADINGS_ROW, 1);
+    clear_eol();
 
     screen_position(COLUMN_HEADINGS_ROW, NAME_HEADING_COLUMN);
-    std::cout << "NAME" << std::flush;
+    l_Screen.Text("NAME");
 #if defined(WITH_EXTRA_CHANNEL_INFO)
     screen_position(COLUMN_HEADINGS_ROW, DT_HEADING_COLUMN);
-    std::cout << "DATATYPE" << std::flush;
+    l_Screen.Text("DATATYPE");
     screen_position(COLUMN_HEADINGS_ROW, SCALE_HEADING_COLUMN);
-    std::cout << "SCALE" << std::flush;
+    l_Screen.Text("SCALE");
     screen_position(COLUMN_HEADINGS_ROW, OFFSET_HEADING_COLUMN);
-    std::cout << "OFFSET" << std::flush;
+    l_Screen.Text("OFFSET");
     screen_position(COLUMN_HEADINGS_ROW, SR_HEADING_COLUMN);
-    std::cout << "RATE" << std::flush;
+    l_Screen.Text("RATE");
     screen_position(COLUMN_HEADINGS_ROW, DF_HEADING_COLUMN);
-    std::cout << "DFACTOR" << std::flush;
+    l_Screen.Text("DFACTOR");
     screen_position(COLUMN_HEADINGS_ROW, FSTS_HEADING_COLUMN);
-    std::cout << "FSTS (s)" << std::flush;
+    l_Screen.Text("FSTS (s)");
 #else
     screen_position(COLUMN_HEADINGS_ROW, SR_HEADING_COLUMN);
-    std::cout << "RATE" << std::flush;
+    l_Screen.Text("RATE");
+
+    if(l_bStatsView) {
+        screen_position(COLUMN_HEADINGS_ROW, MIN_HEADING_COLUMN);
+        l_Screen.Text("MIN");
+        screen_position(COLUMN_HEADINGS_ROW, MAX_HEADING_COLUMN);
+        l_Screen.Text("MAX");
+        screen_position(COLUMN_HEADINGS_ROW, MEAN_HEADING_COLUMN);
+        l_Screen.Text("MEAN");
+        screen_position(COLUMN_HEADINGS_ROW, RMS_HEADING_COLUMN);
+        l_Screen.Text("RMS");
+        screen_position(COLUMN_HEADINGS_ROW, SPARK_HEADING_COLUMN);
+        l_Screen.Text("MEANS");
+        return;
+    }
+
     screen_position(COLUMN_HEADINGS_ROW, FSTS_HEADING_COLUMN);
-    std::cout << "FSTS (s)" << std::flush;
+    l_Screen.Text("FSTS (s)");
     screen_position(COLUMN_HEADINGS_ROW, TOTAL_SAMPLES_HEADING_COLUMN);
-    std::cout << "NUM SAMPLES" << std::flush;
+    l_Screen.Text("NUM SAMPLES");
     screen_position(COLUMN_HEADINGS_ROW, SAMPLE_HEADING_COLUMN);
-    std::cout << "VALUE" << std::flush;
+    l_Screen.Text("VALUE");
 #endif
+}
 
-    screen_position(LAST_ROW, 1);
-    std::cout <<
-        "'q'=quit, 'u'=up, 'd'=down, 'a'=acq on/off, <space>=sub/unsub, " <<
-        "'s'=suball/unsuball" <<
-        std::flush;
+//
+// Function used to draw the filter and where the rows shown are in the
+// channel table
+//
+static void PrintChannelFilter(void)
+{
+    std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
+    int                                     nRows = l_vRows.size();
+
+    screen_position(FILTER_ROW, 1);
+    clear_eol();
+    l_Screen.Text("Filter: ");
+    l_Screen.Text(l_sFilter);
+    if(l_bEditingFilter) l_Screen.Text("_");
 
-    screen_position(currentChannelRow + CHANNEL_START_ROW, NAME_COLUMN);
+    screen_position(FILTER_ROW, SCREEN_COLUMNS - 42);
+    l_Screen.Text(" '/'=filter 'n'/'p'=page 'v'=view ");
+    l_Screen.Unsigned(nRows ? l_nTopRow + 1 : 0, 0);
+    l_Screen.Text("-");
+    l_Screen.Unsigned(std::min(l_nTopRow + CHANNEL_ROWS, nRows), 0);
+    l_Screen.Text("/");
+    l_Screen.Unsigned(nRows, 0);
 }
 
 //
-// Function used to redraw all of the channel rows.
+// Function used to get what a channel row shows
 //
-void UpdateChannels(void)
+static ChannelRowShown RowShown(const ChannelInformationEntry& cie,
+    bool bHighlight)
 {
-    std::unique_lock<std::recursive_mutex>  lk(g_lChannelInformationLock);
+    ChannelRowShown rs = {};
 
+    rs.hChannel = cie.sChannelInfo.hChannel;
+    rs.nChannelId = cie.nChannelId;
+    rs.dFirstSampleTimestamp = cie.dFirstSampleTimestamp;
+    rs.bHighlight = bHighlight;
+
+    const ChannelLiveData   *pld = LiveData(cie.nChannelId);
+    if(pld) {
+        rs.ullPackets = pld->ullPackets.load(std::memory_order_acquire);
+        rs.ullTotalSamples = pld->ullTotalSamples.load();
+        if(static_cast<size_t>(cie.nChannelId) < l_vShown.size())
+            rs.nPublished = l_vShown[cie.nChannelId].nPublished;
+    }
+
+    return rs;
+}
+
+//
+// Function used to tell whether two channel rows show the same
+//
+static bool SameRow(const ChannelRowShown& a, const ChannelRowShown& b)
+{
+    return a.hChannel == b.hChannel && a.nChannelId == b.nChannelId &&
+        (a.dFirstSampleTimestamp == b.dFirstSampleTimestamp ||
+        (std::isnan(a.dFirstSampleTimestamp) &&
+        std::isnan(b.dFirstSampleTimestamp))) &&
+        a.bHighlight == b.bHighlight && a.ullPackets == b.ullPackets &&
+        a.ullTotalSamples == b.ullTotalSamples &&
+        a.nPublished == b.nPublished;
+}
+
+//
+// Function used to draw the rows of the channel table that fit on the
+// screen, with the latest data of those subscribed.  Only rows that show
+// something new are drawn again.
+//
+void RenderChannels(void)
+{
+    std::unique_lock<std::recursive_mutex>  lk(g_lChannelInformationLock);
     std::unique_lock<std::recursive_mutex>  plk(l_PrintLock);
-    currentChannelRow = 0;
-    screen_position(CHANNEL_START_ROW, 1);
-    clear_eos();
 
-    for(auto it = g_mChannelInformation.begin();
-        it != g_mChannelInformation.end(); it++) {
+    FindRows();
+    TakeChannelStats();
+    PrintChannelFilter();
+    PrintColumnHeadings();
+
+    bool    bRedraw = l_bRedrawRows.exchange(false);
+    int     nRows = static_cast<int>(l_vRows.size());
 
-        ChannelInformationEntry cie = (*it).second;
-        int row = std::distance(g_mChannelInformation.begin(), it);
+    for(int i = 0; i < CHANNEL_ROWS; i++) {
+        int                 row = l_nTopRow + i;
+        ChannelRowShown&    rsWas = l_aRowShown[i];
 
-        PrintChannelRow(row, cie.sChannelInfo);
+        if(row < nRows) {
+            const ChannelInformationEntry&  cie =
+                g_vChannelInformation[l_vRows[row]];
+            ChannelRowShown rs = RowShown(cie, row == currentChannelRow);
+
+            if(bRedraw || !SameRow(rs, rsWas)) {
+                PrintChannelRow(CHANNEL_START_ROW + i, cie, rs.bHighlight);
+                rsWas = rs;
+            }
+        } else if(bRedraw || rsWas.hChannel != NO_CHANNEL_HANDLE) {
+            screen_position(CHANNEL_START_ROW + i, NAME_COLUMN);
+            clear_eol();
+            rsWas.hChannel = NO_CHANNEL_HANDLE;
+        }
     }
 
-    screen_position(LAST_ROW, 1);
-    std::cout <<
-        "'q'=quit, 'u'=up, 'd'=down, 'a'=acq on/off, <space>=sub/unsub, " <<
-        "'s'=suball/unsuball" <<
-        std::flush;
+    screen_position(CHANNEL_START_ROW + currentChannelRow - l_nTopRow,
+        NAME_COLUMN);
+}
+
+//
+// Function used to get what takes the terminal to the current screen
+//
+void RenderScreen(std::string& sFrame)
+{
+    std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
+    l_Screen.Render(sFrame);
+}
+
+//
+// Function used to bring the terminal up to date with the screen in one
+// write
+//
+void FlushScreen(void)
+{
+    std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
+
+    l_sFrame.clear();
+    l_Screen.Render(l_sFrame);
+
+    const char  *p = l_sFrame.data();
+    size_t      n = l_sFrame.size();
+#if defined(__linux__)
+    while(n) {
+        ssize_t nWritten = ::write(STDOUT_FILENO, p, n);
+        if(nWritten < 0 && errno == EINTR) continue;
+        if(nWritten <= 0) break;
+        p += nWritten;
+        n -= nWritten;
+    }
+#else
+    std::fwrite(p, 1, n, stdout);
+    std::fflush(stdout);
+#endif
+}
+
+//
+// Thread used to redraw the channel data at a steady rate, however fast
+// it's coming in
+//
+static void RenderThread(std::chrono::nanoseconds nPeriod)
+{
+    auto    tNext = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex>    lk(l_RenderLock);
+    while(!l_bRenderStop) {
+        tNext += nPeriod;
+        if(l_RenderStop.wait_until(lk, tNext, []() { return l_bRenderStop; }))
+            break;
+
+        RenderChannels();
+        FlushScreen();
+
+        // Don't try to catch up on frames missed
+        auto    tNow = std::chrono::steady_clock::now();
+        if(tNext < tNow) tNext = tNow;
+    }
+}
 
-    screen_position(currentChannelRow + CHANNEL_START_ROW, NAME_COLUMN);
+//
+// Function used to start redrawing the channel data dRate times a second
+//
+void StartRenderer(double dRate)
+{
+    if(l_RenderThread.joinable() || !(dRate > 0.0)) return;
+
+    l_bRenderStop = false;
+    l_RenderThread = std::thread(RenderThread,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::duration<double>(1.0 / dRate)));
 }
 
 //
-// Function used to update the channel name when moving the cursor
+// Function used to stop the renderer
 //
-void UpdateChannelName(bool bHighlight)
+void StopRenderer(void)
 {
-    for(auto it = g_mChannelInformation.begin();
-        it != g_mChannelInformation.end(); it++) {
+    if(!l_RenderThread.joinable()) return;
 
-        if(std::distance(g_mChannelInformation.begin(), it) ==
-            currentChannelRow) {
+    {
+        std::unique_lock<std::mutex>    lk(l_RenderLock);
+        l_bRenderStop = true;
+    }
+    l_RenderStop.notify_all();
 
-            PrintChannelName(currentChannelRow + CHANNEL_START_ROW,
-                (*it).second.sChannelInfo.sName, bHighlight);
+    l_RenderThread.join();
+}
 
-            return;
+//
+// Function used to draw all of the fixed text on the screen
+//
+void DrawLabels(char *appName)
+{
+#if ! defined(__linux__)
+    // This makes ANSI escape sequences work on Windows
+    HANDLE  hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    if(hOut != INVALID_HANDLE_VALUE) {
+        DWORD   dwOriginalOutMode = 0;
+        if(GetConsoleMode(hOut, &dwOriginalOutMode)) {
+            DWORD   dwRequestedOutModes = ENABLE_VIRTUAL_TERMINAL_PROCESSING;
+            DWORD   dwOutMode = dwOriginalOutMode | dwRequestedOutModes;
+            if(SetConsoleMode(hOut, dwOutMode)) {
+                ::system(" ");
+            } else {
+                ::printf("\n\nWindows 10 sucks Unable to set console mode\n");
+                exit(0);
+            }
+        } else {
+            ::printf("\n\nWindows 10 sucks Unable to get console mode\n");
+            exit(0);
         }
+    } else {
+        ::printf("\n\nWindows 10 sucks Unable to get stdout handle\n");
+        exit(0);
     }
+#endif
+
+    // Clear the screen
+    clear_screen();
+
+    // Show version, build date, and build number
+    std::string str(appName);
+    center_string(APP_ROW, str);
+
+    std::string heading("Available Channels");
+    center_string(TITLE_ROW, heading);
+
+    PrintColumnHeadings();
+
+    screen_position(LAST_ROW, 1);
+    l_Screen.Text(l_pszKeys);
+
+    screen_position(CHANNEL_START_ROW, NAME_COLUMN);
 }
 
 void PrintAcquisitionStartTime(const std::string& sTimeString)
@@ -403,6 +1188,6 @@ void PrintAcquisitionStartTime(const std::string& sTimeString)
     std::unique_lock<std::recursive_mutex>  lk(l_PrintLock);
     screen_position(ACQ_TIME_ROW, 0);
     clear_eol();
-    std::cout << "Precise Acquisition Start TIme: " << sTimeString <<
-        std::flush;
+    l_Screen.Text("Precise Acquisition Start TIme: ");
+    l_Screen.Text(sTimeString);
 }
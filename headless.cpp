@@ -0,0 +1,573 @@
+//
+// headless.cpp - Headless run mode of the low latency streaming client
+//
+//
+// Written by:  Michael J. Lynch  (mlynch@hi-techiques.com)
+//
+// Copyright (c) 2023 by Hi-Techniques Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the “Software”),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+#include    <algorithm>
+#include    <chrono>
+#include    <condition_variable>
+#include    <csignal>
+#include    <cstdlib>
+#include    <limits>
+#include    <set>
+#include    "ll-client.h"
+#include    "ChannelRecorder.h"
+#include    "MetricsServer.h"
+#include    "PacketTiming.h"
+
+static volatile std::sig_atomic_t   g_bQuit = 0;
+
+//
+// Where the data of the subscribed channels goes
+//
+typedef enum {
+    HEADLESS_SINK_NULL,                 // Only counted
+    HEADLESS_SINK_STATS,                // Statistics of each channel
+    HEADLESS_SINK_RECORD,               // ChannelRecorder files
+} HeadlessSink;
+
+//
+// Definition of a channel name pattern to subscribe to, * and ? wildcards
+//
+typedef struct {
+    std::string sPattern;
+    int         nDecimationFactor;
+} HeadlessPattern;
+
+//
+// Definition of the headless run settings
+//
+typedef struct {
+    std::string                     sHost;
+    std::string                     sPort;
+    std::vector<HeadlessPattern>    vPatterns;      // Empty = all channels
+    double                          dSeconds;       // 0 = until signalled
+    uint64_t                        ullSamples;     // Of each channel, 0 =
+                                                    // no limit
+    HeadlessSink                    nSink;
+    std::string                     sDirectory;     // Record sink only
+    bool                            bAcquire;       // Start acquisition
+    std::string                     sMetricsPort;
+} HeadlessConfig;
+
+//
+// Definition of a subscribed channel, kept by the socket read thread
+//
+typedef struct {
+    std::string     sName;
+    ChannelHandle   hChannel;               // Of sName
+    double          dScale;
+    double          dOffset;
+    double          dPeriod;                // Between samples received
+    double          dFirstSampleTimestamp;
+    uint64_t        ullSamples;             // Since the FSTS
+    uint64_t        ullTotalSamples;        // Since subscribed
+    ChannelStats    Stats;                  // Unscaled, stats sink only
+} HeadlessChannel;
+
+//
+// Definition of the state of a headless run.  All but the members under
+// Lock and the atomics belong to the socket read thread until the client
+// is gone.
+//
+typedef struct {
+    const HeadlessConfig                *pConfig;
+    ChannelRecorder                     *pRecorder;
+
+    std::map<std::string, ChannelInfo>  mAvailable;
+    std::map<int, HeadlessChannel>      mChannels;
+    std::map<int, HeadlessChannel>      mFinished;  // Unsubscribed
+
+    uint64_t                            ullPackets;
+    uint64_t                            ullSamples;
+    uint64_t                            ullBytes;
+    std::chrono::steady_clock::time_point   tFirstData;
+    std::chrono::steady_clock::time_point   tLastData;
+    LatencyHistogram                    Latency;
+
+    std::mutex                          Lock;
+    std::condition_variable             Signal;
+    std::vector<int>                    vIds;           // Subscribed
+    std::set<ChannelHandle>             sDone;          // Of those, with
+                                                        // enough samples
+
+    std::atomic<int>                    nAcquiring;     // -1 = not known
+} Headless;
+
+//
+// Function used to forget a channel that was subscribed, so it is neither
+// waited on nor counted as done.  Called with Lock held.
+//
+static void DropChannel(Headless& h, int nId, ChannelHandle hChannel)
+{
+    h.vIds.erase(std::remove(h.vIds.begin(), h.vIds.end(), nId),
+        h.vIds.end());
+    h.sDone.erase(hChannel);
+    h.Signal.notify_one();
+}
+
+//
+// Function used to note that the user wants to quit
+//
+static void onSignal(int)
+{
+    g_bQuit = 1;
+}
+
+//
+// Function used to show help on how to use the headless mode
+//
+static void usage(void)
+{
+    std::vector<std::string>    vUsageStrings = {
+        "",
+        "USAGE: ll-client -H [-c <pattern>[:<decimation>]]... [-t <seconds>]",
+        "                 [-n <samples>] [-o null|stats|record] [-d <dir>]",
+        "                 [-a] [-m <metrics port>] <host> [port]",
+        "",
+        "   host    IP address of host to connect to",
+        "   port    Port number of host to connect to (def=10006)",
+        "   -c      Subscribe to the channels whose names match, * and ?",
+        "           wildcards, as they become available (def=all of them)",
+        "   -t      Stop after this many seconds",
+        "   -n      Stop once every channel has had this many samples",
+        "   -o      What to do with the data: count it (null, the default),",
+        "           show the statistics of each channel (stats) or record",
+        "           it (record)",
+        "   -d      Directory to record into (def=.)",
+        "   -a      Start acquisition if it isn't running",
+        "   -m      Serve the client counters to Prometheus at",
+        "           http://127.0.0.1:<metrics port>/metrics",
+        "",
+        "Runs until stopped by -t, -n or a signal, then prints a summary.",
+        "Latency is measured from the first sample timestamps the server",
+        "gives as channels are subscribed, so not for channels subscribed",
+        "before acquisition starts.  Exits with 1 if the connection is lost.",
+        "",
+    };
+
+    for(auto& e : vUsageStrings) std::cout << e << std::endl;
+}
+
+//
+// Function used to pick off the options, returns false if they're wrong
+//
+static bool ParseOptions(int argc, char *argv[], HeadlessConfig& config)
+{
+    int nArg = 1;
+    for(; nArg < argc && argv[nArg][0] == '-'; nArg++) {
+        std::string s(argv[nArg]);
+        const char  *pszValue = nArg + 1 < argc ? argv[nArg + 1] : nullptr;
+
+        if(s == "-a") {
+            config.bAcquire = true;
+            continue;
+        }
+
+        if(s.size() != 2 || !pszValue) return false;
+        nArg++;
+
+        std::string sValue(pszValue);
+        switch(s[1]) {
+            case 'c': {
+                HeadlessPattern hp = { sValue, 1 };
+                size_t          n = sValue.rfind(':');
+                if(n != std::string::npos) {
+                    hp.sPattern.assign(sValue, 0, n);
+                    hp.nDecimationFactor = std::atoi(sValue.c_str() + n + 1);
+                    if(hp.nDecimationFactor < 1) return false;
+                }
+                config.vPatterns.push_back(hp);
+                break;
+            }
+
+            case 't': config.dSeconds = std::atof(pszValue); break;
+            case 'n': config.ullSamples = std::strtoull(pszValue, 0, 10); break;
+            case 'd': config.sDirectory = sValue; break;
+            case 'm': config.sMetricsPort = sValue; break;
+
+            case 'o':
+                if(sValue == "null") config.nSink = HEADLESS_SINK_NULL;
+                else if(sValue == "stats") config.nSink = HEADLESS_SINK_STATS;
+                else if(sValue == "record")
+                    config.nSink = HEADLESS_SINK_RECORD;
+                else return false;
+                break;
+
+            default:
+                return false;
+        }
+    }
+
+    if(nArg >= argc || argc - nArg > 2 || config.dSeconds < 0.0) return false;
+
+    config.sHost.assign(argv[nArg]);
+    if(nArg + 1 < argc) config.sPort.assign(argv[nArg + 1]);
+
+    return true;
+}
+
+//
+// Function used to handle the events of the headless client.  Called from
+// the socket read thread.
+//
+static void HeadlessEvent(Headless& h, EventType nType, const void *p,
+    size_t nSize)
+{
+#if defined(__linux__)
+    if(h.pRecorder) h.pRecorder->HandleEvent(nType, p, nSize);
+#endif
+
+    switch(nType) {
+        case EVENT_TYPE_AVAILABLE_CHANNEL: {
+            auto    ci = static_cast<const ChannelInfo *>(p);
+            h.mAvailable[ci->sName] = *ci;
+            break;
+        }
+
+        case EVENT_TYPE_UNAVAILABLE_CHANNEL: {
+            auto            cuai =
+                static_cast<const ChannelUnavailableInfo *>(p);
+            ChannelHandle   hChannel = cuai->hChannel;
+            h.mAvailable.erase(cuai->sName);
+
+            // No more data will come for it if it was subscribed
+            std::unique_lock<std::mutex>    lk(h.Lock);
+            for(auto& c : h.mChannels)
+                if(c.second.hChannel == hChannel)
+                    DropChannel(h, c.first, hChannel);
+            break;
+        }
+
+        case EVENT_TYPE_CHANNEL_SUBSCRIBED: {
+            auto    csi = static_cast<const ChannelSubscribedInfo *>(p);
+            auto    it = h.mAvailable.find(csi->sName);
+
+            HeadlessChannel c = {};
+            c.sName = csi->sName;
+            c.hChannel = csi->hChannel;
+            c.dScale = 1.0;
+            c.dPeriod = NAN;
+            c.dFirstSampleTimestamp = NAN;
+            if(it != h.mAvailable.end()) {
+                c.dScale = (*it).second.dScale;
+                c.dOffset = (*it).second.dOffset;
+                c.dPeriod = (*it).second.dSamplePeriod *
+                    std::max<uint32_t>(csi->nDecimationFactor, 1);
+            }
+            h.mChannels[csi->nId] = c;
+
+            std::unique_lock<std::mutex>    lk(h.Lock);
+            h.vIds.push_back(csi->nId);
+            h.Signal.notify_one();
+            break;
+        }
+
+        case EVENT_TYPE_CHANNEL_UNSUBSCRIBED: {
+            int     nId = static_cast<const ChannelUnsubscribedInfo *>(p)->nId;
+            auto    it = h.mChannels.find(nId);
+            if(it == h.mChannels.end()) break;
+
+            // Keep what it had for the summary
+            ChannelHandle   hChannel = (*it).second.hChannel;
+            if((*it).second.ullTotalSamples)
+                h.mFinished[nId] = (*it).second;
+            h.mChannels.erase(it);
+
+            std::unique_lock<std::mutex>    lk(h.Lock);
+            DropChannel(h, nId, hChannel);
+            break;
+        }
+
+        case EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS: {
+            auto    ctsi = static_cast<const ChannelTimestampInfo *>(p);
+            auto    it = h.mChannels.find(ctsi->nId);
+            if(it == h.mChannels.end()) break;
+
+            (*it).second.dFirstSampleTimestamp = ctsi->dFirstSampleTimestamp;
+            (*it).second.ullSamples = 0;
+            break;
+        }
+
+        case EVENT_TYPE_ACQUIRE:
+            h.nAcquiring = *static_cast<const bool *>(p) ? 1 : 0;
+            break;
+
+        case EVENT_TYPE_CHANNEL_DATA: {
+            auto    cdi = static_cast<const ChannelDataInfo *>(p);
+            auto    it = h.mChannels.find(cdi->nId);
+            if(it == h.mChannels.end()) break;
+
+            HeadlessChannel&    c = (*it).second;
+            double              dNow = std::chrono::duration<double>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+
+            // From when the server could first have sent it, the time of
+            // its last sample plus one sample period, like ll-bench
+            c.ullSamples += cdi->nSamples;
+            double  dDue = c.dFirstSampleTimestamp +
+                static_cast<double>(c.ullSamples) * c.dPeriod;
+            if(std::isfinite(dDue) && c.dFirstSampleTimestamp > 0.0)
+                h.Latency.Record(static_cast<uint64_t>(
+                    std::max(0.0, dNow - dDue) * 1e9));
+
+            if(h.pConfig->nSink == HEADLESS_SINK_STATS && cdi->nSamples) {
+                ChannelStats    s;
+                ChannelBlockStats(cdi->pData, cdi->nSamples, s);
+
+                if(!c.Stats.ullSamples) c.Stats = s;
+                else {
+                    c.Stats.fMin = std::min(c.Stats.fMin, s.fMin);
+                    c.Stats.fMax = std::max(c.Stats.fMax, s.fMax);
+                    c.Stats.dSum += s.dSum;
+                    c.Stats.dSumSquares += s.dSumSquares;
+                    c.Stats.ullSamples += s.ullSamples;
+                }
+            }
+
+            uint64_t    ullLimit = h.pConfig->ullSamples;
+            if(ullLimit && c.ullTotalSamples < ullLimit &&
+                c.ullTotalSamples + cdi->nSamples >= ullLimit) {
+                std::unique_lock<std::mutex>    lk(h.Lock);
+                h.sDone.insert(c.hChannel);
+                h.Signal.notify_one();
+            }
+            c.ullTotalSamples += cdi->nSamples;
+
+            auto    tNow = std::chrono::steady_clock::now();
+            if(!h.ullPackets) h.tFirstData = tNow;
+            h.tLastData = tNow;
+            h.ullPackets++;
+            h.ullSamples += cdi->nSamples;
+            h.ullBytes += sizeof(LowLatencyStreamPacketHeader) +
+                cdi->nSamples * sizeof(float);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+//
+// Function used to print the statistics of a channel
+//
+static void PrintChannelSummary(int nId, const HeadlessChannel& c)
+{
+    std::cout << "channel name=" << c.sName << " id=" << nId <<
+        " samples=" << c.ullTotalSamples;
+
+    const ChannelStats& s = c.Stats;
+    if(s.ullSamples) {
+        double  a = c.dScale;
+        double  b = c.dOffset;
+        double  dMean = s.dSum / s.ullSamples;
+        double  dMin = (s.fMin * a) + b;
+        double  dMax = (s.fMax * a) + b;
+        if(a < 0.0) std::swap(dMin, dMax);
+
+        double  dMeanSquare = (a * a * s.dSumSquares / s.ullSamples) +
+            (2.0 * a * b * dMean) + (b * b);
+
+        std::cout << " min=" << dMin << " max=" << dMax << " mean=" <<
+            (dMean * a) + b << " rms=" << std::sqrt(std::max(dMeanSquare, 0.0));
+    }
+
+    std::cout << std::endl;
+}
+
+//
+// Function used to print the summary of a run
+//
+static void PrintSummary(Headless& h, const ClientMetricsSnapshot& m)
+{
+    double  d = h.ullPackets < 2 ? 0.0 : std::chrono::duration<double>(
+        h.tLastData - h.tFirstData).count();
+    auto    Rate = [d](double n) { return d > 0.0 ? n / d : 0.0; };
+
+    LatencySnapshot s = h.Latency.Snapshot();
+
+    std::cout << "summary seconds=" << d <<
+        " channels=" << h.mChannels.size() + h.mFinished.size() <<
+        " packets=" << h.ullPackets <<
+        " samples=" << h.ullSamples <<
+        " packets_per_s=" << Rate(h.ullPackets) <<
+        " samples_per_s=" << Rate(h.ullSamples) <<
+        " MBps=" << Rate(h.ullBytes) / (1024 * 1024);
+
+    // Nothing to go on without a first sample timestamp
+    if(s.nCount) {
+        std::cout <<
+            " p50_us=" << LatencyHistogram::Percentile(s, 0.5) / 1e3 <<
+            " p99_us=" << LatencyHistogram::Percentile(s, 0.99) / 1e3 <<
+            " p999_us=" << LatencyHistogram::Percentile(s, 0.999) / 1e3 <<
+            " max_us=" << LatencyHistogram::Max(s) / 1e3;
+    } else std::cout << " latency=not_measured";
+
+    std::cout << " missing_samples=" << m.nMissingSamples <<
+        " repeated_samples=" << m.nRepeatedSamples << std::endl;
+
+    if(h.pConfig->nSink == HEADLESS_SINK_STATS) {
+        std::map<int, HeadlessChannel>  mAll(h.mFinished);
+        for(auto& e : h.mChannels) mAll[e.first] = e.second;
+
+        for(auto& e : mAll) PrintChannelSummary(e.first, e.second);
+    }
+
+#if defined(__linux__)
+    if(h.pRecorder) {
+        h.pRecorder->Flush();
+
+        ChannelRecorderStats    rs = h.pRecorder->Stats();
+        std::cout << "record bytes=" << rs.nBytesWritten <<
+            " chunks=" << rs.nChunksWritten <<
+            " dropped_samples=" << rs.nDroppedSamples <<
+            " write_errors=" << rs.nWriteErrors << std::endl;
+    }
+#endif
+}
+
+//
+// Function used to run without a terminal: subscribe to the channels asked
+// for as they become available, hand their data to the sink until told to
+// stop, then unsubscribe and print a summary.  Returns the exit status.
+//
+int RunHeadless(int argc, char *argv[])
+{
+    HeadlessConfig  config;
+    config.sPort.assign("10006");
+    config.dSeconds = 0.0;
+    config.ullSamples = 0;
+    config.nSink = HEADLESS_SINK_NULL;
+    config.sDirectory.assign(".");
+    config.bAcquire = false;
+
+    if(!ParseOptions(argc, argv, config)) {
+        usage();
+        return 1;
+    }
+
+    Headless    h;
+    h.pConfig = &config;
+    h.pRecorder = nullptr;
+    h.ullPackets = h.ullSamples = h.ullBytes = 0;
+    h.nAcquiring = -1;
+
+#if defined(__linux__)
+    std::unique_ptr<ChannelRecorder>    pRecorder;
+#endif
+    if(config.nSink == HEADLESS_SINK_RECORD) {
+#if defined(__linux__)
+        ChannelRecorderConfig   rc = {};
+        rc.sDirectory = config.sDirectory;
+        rc.nChunkBytes = 1024 * 1024;
+        rc.nChunks = 64;
+        rc.nPreallocateBytes = 64 * 1024 * 1024;
+        pRecorder = std::make_unique<ChannelRecorder>(rc);
+        h.pRecorder = pRecorder.get();
+#else
+        std::cerr << "Recording is only supported on Linux" << std::endl;
+        return 1;
+#endif
+    }
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    boost::asio::io_context io_context;
+    ClientMetricsSnapshot   m;
+    bool                    bLost = false;
+
+    try {
+        LowLatencyDataClient    llc(io_context, config.sHost, config.sPort,
+            [&h](EventType nType, const void *p, size_t nSize) {
+                HeadlessEvent(h, nType, p, nSize);
+            });
+
+        auto    metrics = StartMetrics(llc, config.sMetricsPort);
+
+        // The client subscribes to the channels as they become available
+        for(auto& hp : config.vPatterns)
+            llc.SubscribeMatching(hp.sPattern, hp.nDecimationFactor);
+        if(config.vPatterns.empty()) llc.SubscribeMatching("*");
+
+        auto    tStart = std::chrono::steady_clock::now();
+        bool    bAcquireSent = false;
+
+        std::unique_lock<std::mutex>    lk(h.Lock);
+        while(!g_bQuit) {
+            h.Signal.wait_for(lk, std::chrono::milliseconds(100));
+
+            if(!llc.Connected()) {
+                bLost = true;
+                break;
+            }
+
+            size_t  nSubscribed = h.vIds.size();
+            size_t  nDone = h.sDone.size();
+
+            lk.unlock();
+            if(config.bAcquire && !bAcquireSent && h.nAcquiring == 0) {
+                llc.Acquire();
+                bAcquireSent = true;
+            }
+            lk.lock();
+
+            if(config.dSeconds > 0.0 && std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - tStart).count() >=
+                config.dSeconds) break;
+
+            if(config.ullSamples && nSubscribed && nDone >= nSubscribed)
+                break;
+        }
+
+        // Unsubscribe everything, waiting a while for it to be done
+        std::vector<int>    vIds(h.vIds);
+        lk.unlock();
+        if(!bLost && !vIds.empty()) {
+            llc.UnsubscribeChannels(vIds);
+
+            lk.lock();
+            h.Signal.wait_for(lk, std::chrono::seconds(1),
+                [&h]() { return h.vIds.empty(); });
+            lk.unlock();
+        }
+
+        m = llc.Metrics();
+    }
+    catch(std::exception& e) {
+        std::cerr << "Headless run failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    // The client is gone, so is its read thread
+    PrintSummary(h, m);
+
+    if(bLost) {
+        std::cerr << "Lost the connection to the server" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,670 @@
+//
+// ll-bench.cpp - Benchmarks of the client ingest, parse, dispatch and display
+//
+//
+// Copyright (c) 2023 by Hi-Techniques Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the “Software”),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+#include    <algorithm>
+#include    <atomic>
+#include    <chrono>
+#include    <condition_variable>
+#include    <cstdlib>
+#include    <cstring>
+#include    <functional>
+#include    <iostream>
+#include    <string>
+#include    <vector>
+#include    "ll-client.h"
+#include    "MockServer.h"
+#if defined(__linux__)
+#include    <arpa/inet.h>
+#endif
+
+//
+// What the display functions and the client expect the application to have
+//
+int nDebug = 0;
+std::vector<ChannelInformationEntry>    g_vChannelInformation;
+std::recursive_mutex    g_lChannelInformationLock;
+int currentChannelRow = 0;
+
+static boost::asio::io_context  io_context;
+
+//
+// Sizes of the micro benchmarks
+//
+static constexpr int    nBenchChannels = 8;     // Data ids subscribed
+static constexpr size_t nFramingBytes = 8 * 1024 * 1024;
+static constexpr size_t nDispatchPackets = 4 * 1024 * 1024;
+static constexpr size_t nUpdateCalls = 16 * 1024 * 1024;
+static constexpr size_t nRenderFrames = 16 * 1024;
+
+//
+// Data events seen by the loopback client, and the count that wakes the
+// benchmark waiting for them
+//
+static std::atomic<uint64_t>    g_nDataEvents(0);
+static std::atomic<uint64_t>    g_nDataTarget(0);
+static std::mutex               g_DataLock;
+static std::condition_variable  g_DataDone;
+
+//
+// Definition of the way in to the client's packet processing
+//
+class LowLatencyDataClientBench {
+    public:
+        static void Subscribe(LowLatencyDataClient& c, int nId,
+            const ChannelInfo& ci)
+        {
+            typedef LowLatencyDataClient::SubscribedChannels    Table;
+
+            auto    p = std::make_shared<Table>(*c.m_pSubscribedChannels);
+            (*p)[nId] = ci;
+            c.PublishSubscribedChannels(std::move(p));
+            c.m_nMaxSubscribedId = std::max<int64_t>(c.m_nMaxSubscribedId,
+                nId);
+            c.m_Metrics.Subscribed(nId, ci.sName);
+#if defined(WITH_PACKET_TIMING)
+            c.m_Timing.Subscribed(nId);
+#endif
+        }
+
+        static void ForgetAvailable(LowLatencyDataClient& c)
+        {
+            c.PublishAvailableChannels(
+                std::make_shared<LowLatencyDataClient::AvailableChannels>());
+        }
+
+        static void ProcessMetadataPacket(LowLatencyDataClient& c,
+            LowLatencyStreamPacketHeader *pHeader)
+        {
+            c.ProcessMetadataPacket(pHeader);
+        }
+
+        static void ProcessDataPacket(LowLatencyDataClient& c,
+            LowLatencyStreamPacketHeader *pHeader)
+        {
+            c.ProcessDataPacket(pHeader);
+        }
+};
+
+//
+// Function used to time a function, returns seconds for the best of a few
+// runs
+//
+static double Time(std::function<void(void)> f)
+{
+    double  dBest = 1e30;
+
+    for(int i = 0; i < 3; i++) {
+        auto    t0 = std::chrono::steady_clock::now();
+        f();
+        double  d = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - t0).count();
+        if(d < dBest) dBest = d;
+    }
+
+    return dBest;
+}
+
+//
+// Function used to add a packet to a buffer, with the header in network
+// order as it comes off the wire or in host order as the read loop leaves
+// it
+//
+static void AppendPacket(std::vector<uint8_t>& v, uint32_t nId,
+    const void *p, size_t nBytes, bool bNetworkOrder)
+{
+    LowLatencyStreamPacketHeader    Header;
+
+    Header.id = bNetworkOrder ? ::htonl(nId) : nId;
+    Header.length = static_cast<uint32_t>(sizeof(Header) + nBytes);
+    if(bNetworkOrder) Header.length = ::htonl(Header.length);
+
+    const uint8_t   *pHeader = reinterpret_cast<const uint8_t *>(&Header);
+    v.insert(v.end(), pHeader, pHeader + sizeof(Header));
+    v.insert(v.end(), static_cast<const uint8_t *>(p),
+        static_cast<const uint8_t *>(p) + nBytes);
+}
+
+//
+// Function used to handle the events of the loopback client
+//
+static void LoopbackEvent(EventType nType, const void *, size_t)
+{
+    if(nType != EVENT_TYPE_CHANNEL_DATA) return;
+
+    if(++g_nDataEvents == g_nDataTarget) {
+        std::unique_lock<std::mutex>    lk(g_DataLock);
+        g_DataDone.notify_one();
+    }
+}
+
+//
+// Function used to time the read loop taking apart a stream of data
+// packets of various sizes, written as fast as loopback takes them
+//
+static void BenchFraming(tcp::socket& s)
+{
+    for(size_t nSamples : { 1, 16, 256, 4096 }) {
+        std::vector<float>      vSamples(nSamples, 1.0f);
+        std::vector<uint8_t>    vStream;
+        size_t  nPacketBytes = sizeof(LowLatencyStreamPacketHeader) +
+            nSamples * sizeof(float);
+        size_t  nPackets = nFramingBytes / nPacketBytes;
+
+        vStream.reserve(nPackets * nPacketBytes);
+        for(size_t i = 0; i < nPackets; i++)
+            AppendPacket(vStream, i % nBenchChannels, vSamples.data(),
+                nSamples * sizeof(float), true);
+
+        double  d = Time([&]() {
+            g_nDataEvents = 0;
+            g_nDataTarget = nPackets;
+
+            boost::asio::write(s, boost::asio::buffer(vStream));
+
+            std::unique_lock<std::mutex>    lk(g_DataLock);
+            g_DataDone.wait(lk, [nPackets]() {
+                return g_nDataEvents >= nPackets;
+            });
+        });
+
+        std::cout << "bench=framing samples_per_packet=" << nSamples <<
+            " packets=" << nPackets <<
+            " packets_per_s=" << nPackets / d <<
+            " samples_per_s=" << nPackets * nSamples / d <<
+            " MBps=" << vStream.size() / d / 1e6 << std::endl;
+    }
+}
+
+//
+// Function used to time parsing "available" messages for many channels
+//
+static void BenchAvailable(LowLatencyDataClient& client)
+{
+    for(int nChannels : { 100, 1000, 10000 }) {
+        json    j;
+        for(int i = 0; i < nChannels; i++) {
+            j["available"]["chassis1/slot" + std::to_string(i / 64) +
+                "/ai" + std::to_string(i % 64)] = {
+                { "sample_period", 1e-6 },
+                { "data_type", "int16" },
+                { "scale", 0.000305175781 },
+                { "offset", 0.0 },
+            };
+        }
+
+        std::string             str(j.dump());
+        std::vector<uint8_t>    vPacket;
+        AppendPacket(vPacket, METADATA_ID, str.data(), str.size(), false);
+
+        const int   nMessages = std::max(1, 20000 / nChannels);
+        double      dBest = 1e30;
+
+        for(int nRun = 0; nRun < 3; nRun++) {
+            double  d = 0.0;
+
+            for(int i = 0; i < nMessages; i++) {
+                // Each message has to bring the channels in again
+                LowLatencyDataClientBench::ForgetAvailable(client);
+
+                auto    t0 = std::chrono::steady_clock::now();
+                LowLatencyDataClientBench::ProcessMetadataPacket(client,
+                    reinterpret_cast<LowLatencyStreamPacketHeader *>(
+                    vPacket.data()));
+                d += std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - t0).count();
+            }
+
+            dBest = std::min(dBest, d);
+        }
+        LowLatencyDataClientBench::ForgetAvailable(client);
+
+        std::cout << "bench=available channels=" << nChannels <<
+            " message_bytes=" << str.size() <<
+            " us_per_message=" << dBest / nMessages * 1e6 <<
+            " channels_per_s=" << nChannels * nMessages / dBest <<
+            " MBps=" << str.size() * nMessages / dBest / 1e6 << std::endl;
+    }
+}
+
+//
+// Function used to time handing data packets to the event handler
+//
+static void BenchDispatch(LowLatencyDataClient& client)
+{
+    const size_t            nSamples = 100;
+    std::vector<float>      vSamples(nSamples, 1.0f);
+    std::vector<uint8_t>    vPackets;
+
+    for(int i = 0; i < nBenchChannels; i++)
+        AppendPacket(vPackets, i, vSamples.data(), nSamples * sizeof(float),
+            false);
+
+    const size_t    nPacketBytes = vPackets.size() / nBenchChannels;
+    g_nDataTarget = 0;
+
+    double  d = Time([&]() {
+        for(size_t i = 0; i < nDispatchPackets; i++) {
+            LowLatencyDataClientBench::ProcessDataPacket(client,
+                reinterpret_cast<LowLatencyStreamPacketHeader *>(
+                vPackets.data() + (i % nBenchChannels) * nPacketBytes));
+        }
+    });
+
+    std::cout << "bench=dispatch channels=" << nBenchChannels <<
+        " packets=" << nDispatchPackets <<
+        " ns_per_packet=" << d / nDispatchPackets * 1e9 <<
+        " packets_per_s=" << nDispatchPackets / d << std::endl;
+}
+
+//
+// Function used to time noting the latest data of a channel, what the
+// socket read thread does for each packet, and drawing a frame of it
+//
+static void BenchChannelData(void)
+{
+    std::vector<ChannelHandle>  vHandles;
+
+    for(int i = 0; i < nBenchChannels; i++) {
+        ChannelInformationEntry e = {};
+        e.sChannelInfo.sName = "ai" + std::to_string(i);
+        e.sChannelInfo.hChannel = ChannelNames::Intern(e.sChannelInfo.sName);
+        vHandles.push_back(e.sChannelInfo.hChannel);
+        e.sChannelInfo.dScale = 1.0;
+        e.nChannelId = i;
+        if(g_vChannelInformation.size() <= e.sChannelInfo.hChannel) {
+            ChannelInformationEntry eNone = {};
+            eNone.sChannelInfo.hChannel = NO_CHANNEL_HANDLE;
+            g_vChannelInformation.resize(e.sChannelInfo.hChannel + 1, eNone);
+        }
+        g_vChannelInformation[e.sChannelInfo.hChannel] = e;
+        ResetChannelData(i);
+    }
+    UpdateChannels();
+
+    std::vector<float>  vSamples(100, 1.25f);
+    ChannelDataInfo     cdi;
+    cdi.pData = vSamples.data();
+    cdi.nSamples = vSamples.size();
+
+    double  d = Time([&]() {
+        for(size_t i = 0; i < nUpdateCalls; i++) {
+            cdi.nId = static_cast<int>(i % nBenchChannels);
+            cdi.hChannel = vHandles[cdi.nId];
+            UpdateChannelData(&cdi);
+        }
+    });
+
+    std::cout << "bench=update_channel_data channels=" << nBenchChannels <<
+        " calls=" << nUpdateCalls <<
+        " ns_per_call=" << d / nUpdateCalls * 1e9 <<
+        " ns_per_sample=" << d / nUpdateCalls / cdi.nSamples * 1e9 <<
+        " calls_per_s=" << nUpdateCalls / d << std::endl;
+
+    // Every channel has a new value for every frame, the first frame
+    // draws the whole screen
+    std::string sFrame;
+    size_t      nBytes = 0;
+
+    RenderChannels();
+    RenderScreen(sFrame);
+
+    d = Time([&]() {
+        for(size_t i = 0; i < nRenderFrames; i++) {
+            vSamples.back() = static_cast<float>(i);
+            for(cdi.nId = 0; cdi.nId < nBenchChannels; cdi.nId++)
+                UpdateChannelData(&cdi);
+
+            sFrame.clear();
+            RenderChannels();
+            RenderScreen(sFrame);
+            nBytes += sFrame.size();
+        }
+    });
+
+    g_vChannelInformation.clear();
+    UpdateChannels();
+
+    std::cout << "bench=render_channels channels=" << nBenchChannels <<
+        " frames=" << nRenderFrames <<
+        " us_per_frame=" << d / nRenderFrames * 1e6 <<
+        " bytes_per_frame=" << nBytes / nRenderFrames << std::endl;
+}
+
+//
+// Function used to run the micro benchmarks against a client connected to
+// a socket of our own
+//
+static bool RunMicroBenchmarks(void)
+{
+    tcp::acceptor   acceptor(io_context, tcp::endpoint(
+        boost::asio::ip::address_v4::loopback(), 0));
+    std::string     sHost("127.0.0.1");
+    std::string     sPort(std::to_string(acceptor.local_endpoint().port()));
+    tcp::socket     s(io_context);
+
+    try {
+        LowLatencyDataClient    client(io_context, sHost, sPort,
+            LoopbackEvent);
+        acceptor.accept(s);
+
+        for(int i = 0; i < nBenchChannels; i++) {
+            ChannelInfo ci = {};
+            ci.sName = "ai" + std::to_string(i);
+            ci.hChannel = ChannelNames::Intern(ci.sName);
+            ci.sDataType = "float";
+            ci.dScale = 1.0;
+            ci.dSamplePeriod = 1e-6;
+            ci.nDecimationFactor = 1;
+            LowLatencyDataClientBench::Subscribe(client, i, ci);
+        }
+
+        BenchFraming(s);
+        BenchAvailable(client);
+        BenchDispatch(client);
+        BenchChannelData();
+    }
+    catch(std::exception& e) {
+        std::cerr << "Micro benchmarks failed: " << e.what() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+//
+// Definition of what the end to end benchmark gathers on the client's read
+// thread
+//
+typedef struct {
+    std::atomic<int>        nAvailable;
+    std::atomic<bool>       bMeasuring;
+    std::map<int, double>   mFirstSampleTimestamp;  // By id, seconds
+    std::map<int, uint64_t> mSamples;               // By id, since then
+    double                  dSamplePeriod;
+    uint64_t                nPackets;
+    uint64_t                nSamples;
+    uint64_t                nBytes;
+    std::vector<uint32_t>   vLatencyNs;
+} EndToEnd;
+
+//
+// Function used to handle the events of the end to end client.  A packet's
+// latency is from when the server could first have sent it, the time of
+// its last sample plus one sample period, to when the handler gets it.
+//
+static void EndToEndEvent(EndToEnd& e, EventType nType, const void *pData)
+{
+    switch(nType) {
+        case EVENT_TYPE_AVAILABLE_CHANNEL:
+            e.nAvailable++;
+            break;
+
+        case EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS: {
+            auto    p = static_cast<const ChannelTimestampInfo *>(pData);
+            e.mFirstSampleTimestamp[p->nId] = p->dFirstSampleTimestamp;
+            e.mSamples[p->nId] = 0;
+            break;
+        }
+
+        case EVENT_TYPE_CHANNEL_DATA: {
+            auto    p = static_cast<const ChannelDataInfo *>(pData);
+            double  dNow = std::chrono::duration<double>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+
+            uint64_t&   nSamples = e.mSamples[p->nId];
+            nSamples += p->nSamples;
+            if(!e.bMeasuring) break;
+
+            double  dDue = e.mFirstSampleTimestamp[p->nId] +
+                static_cast<double>(nSamples) * e.dSamplePeriod;
+            double  dLatency = std::max(0.0, dNow - dDue);
+
+            e.nPackets++;
+            e.nSamples += p->nSamples;
+            e.nBytes += sizeof(LowLatencyStreamPacketHeader) +
+                p->nSamples * sizeof(float);
+            e.vLatencyNs.push_back(static_cast<uint32_t>(
+                std::min(dLatency * 1e9, 4e9)));
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+#if defined(WITH_PACKET_TIMING)
+//
+// Function used to print where the time went on the client's packet path,
+// all channels together
+//
+static void PrintPacketTiming(const std::vector<ChannelTimingSnapshot>& v)
+{
+    for(int nStage = 0; nStage < PACKET_STAGES; nStage++) {
+        LatencySnapshot s = {};
+        s.vCounts.resize(LatencyHistogram::BUCKETS);
+
+        for(auto& c : v) {
+            const LatencySnapshot&  cs = c.Stages[nStage];
+            s.nCount += cs.nCount;
+            s.nSumNs += cs.nSumNs;
+            for(size_t i = 0; i < cs.vCounts.size(); i++)
+                s.vCounts[i] += cs.vCounts[i];
+        }
+
+        std::cout << "bench=packet_stage stage=" <<
+            PacketTiming::StageName(static_cast<PacketStage>(nStage)) <<
+            " count=" << s.nCount <<
+            " mean_ns=" << LatencyHistogram::Mean(s) <<
+            " p50_ns=" << LatencyHistogram::Percentile(s, 0.5) <<
+            " p99_ns=" << LatencyHistogram::Percentile(s, 0.99) <<
+            " p999_ns=" << LatencyHistogram::Percentile(s, 0.999) <<
+            " max_ns=" << LatencyHistogram::Max(s) << std::endl;
+    }
+}
+#endif
+
+//
+// Function used to stream from a MockServer over loopback and measure the
+// throughput and latency the client gets
+//
+static bool RunEndToEnd(int nChannels, double dRate, size_t nBlock,
+    double dSeconds)
+{
+    MockServerConfig    config = {};
+    config.sAddress.assign("127.0.0.1");
+    config.sPort.assign("0");
+    config.nBlockSamples = nBlock;
+    config.bAcquire = true;
+    config.nSeed = 1;
+
+    for(int i = 0; i < nChannels; i++) {
+        MockChannelConfig   c = {};
+        c.sName = "ai" + std::to_string(i);
+        c.sDataType.assign("float");
+        c.dSampleRate = dRate;
+        c.dScale = 1.0;
+        c.nSignal = MOCK_SIGNAL_COUNTER;
+        config.vChannels.push_back(c);
+    }
+
+    MockServer  server(config);
+    if(!server.Start()) return false;
+
+    EndToEnd    e;
+    e.nAvailable = 0;
+    e.bMeasuring = false;
+    e.dSamplePeriod = 1.0 / dRate;
+    e.nPackets = e.nSamples = e.nBytes = 0;
+    e.vLatencyNs.reserve(static_cast<size_t>(
+        nChannels * dRate / nBlock * dSeconds * 1.5) + 1024);
+
+    std::string sHost("127.0.0.1");
+    std::string sPort(std::to_string(server.Port()));
+    double      dElapsed = 0.0;
+    uint64_t    nMissingSamples = 0;
+    uint64_t    nRepeatedSamples = 0;
+
+    try {
+        LowLatencyDataClient    client(io_context, sHost, sPort,
+            [&e](EventType nType, const void *p, size_t) {
+                EndToEndEvent(e, nType, p);
+            });
+
+        for(int i = 0; i < 500 && e.nAvailable < nChannels; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if(e.nAvailable < nChannels) {
+            std::cerr << "Mock server channels never became available" <<
+                std::endl;
+            return false;
+        }
+
+        for(int i = 0; i < nChannels; i++) {
+            std::string sName("ai" + std::to_string(i));
+            client.SubscribeChannel(sName, 1);
+        }
+
+        // Let the connection settle before measuring
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+        auto    t0 = std::chrono::steady_clock::now();
+#if defined(WITH_PACKET_TIMING)
+        client.TimingSnapshot(true);
+#endif
+        e.bMeasuring = true;
+        std::this_thread::sleep_for(std::chrono::duration<double>(dSeconds));
+        e.bMeasuring = false;
+        dElapsed = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - t0).count();
+
+        // Whether the rate was sustained, see ChannelContinuity
+        ClientMetricsSnapshot   m = client.Metrics();
+        nMissingSamples = m.nMissingSamples;
+        nRepeatedSamples = m.nRepeatedSamples;
+
+#if defined(WITH_PACKET_TIMING)
+        PrintPacketTiming(client.TimingSnapshot());
+#endif
+    }
+    catch(std::exception& ex) {
+        std::cerr << "End to end benchmark failed: " << ex.what() << std::endl;
+        return false;
+    }
+
+    server.Stop();
+
+    std::vector<uint32_t>&  v = e.vLatencyNs;
+    std::sort(v.begin(), v.end());
+    auto    Percentile = [&v](double d) {
+        return v.empty() ? 0.0 : v[std::min(v.size() - 1,
+            static_cast<size_t>(d * v.size()))] / 1e3;
+    };
+
+    std::cout << "bench=end_to_end channels=" << nChannels <<
+        " rate=" << dRate << " block=" << nBlock <<
+        " seconds=" << dElapsed <<
+        " packets=" << e.nPackets <<
+        " packets_per_s=" << e.nPackets / dElapsed <<
+        " samples_per_s=" << e.nSamples / dElapsed <<
+        " MBps=" << e.nBytes / dElapsed / 1e6 <<
+        " p50_us=" << Percentile(0.5) <<
+        " p99_us=" << Percentile(0.99) <<
+        " p999_us=" << Percentile(0.999) <<
+        " max_us=" << (v.empty() ? 0.0 : v.back() / 1e3) <<
+        " missing_samples=" << nMissingSamples <<
+        " repeated_samples=" << nRepeatedSamples << std::endl;
+
+    return e.nPackets > 0;
+}
+
+//
+// Function used to print the usage
+//
+static void usage(const char *pszName)
+{
+    std::cerr << "Usage: " << pszName << " [-m | -e] [-c channels] "
+        "[-r rate] [-b block] [-s seconds]" << std::endl;
+    std::cerr << "    -m    Micro benchmarks only" << std::endl;
+    std::cerr << "    -e    End to end benchmark only" << std::endl;
+    std::cerr << "    -c    End to end channels, 1 to " << nBenchChannels <<
+        " (" << nBenchChannels << ")" << std::endl;
+    std::cerr << "    -r    End to end sample rate in Hz (100000)" <<
+        std::endl;
+    std::cerr << "    -b    End to end samples per packet (100)" << std::endl;
+    std::cerr << "    -s    End to end seconds measured (5)" << std::endl;
+}
+
+//
+// Entry point of the application.  Prints one line of key=value pairs per
+// benchmark so runs can be compared by a script.
+//
+int main(int argc, char *argv[])
+{
+    bool    bMicro = true;
+    bool    bEndToEnd = true;
+    int     nChannels = nBenchChannels;
+    double  dRate = 100000.0;
+    size_t  nBlock = 100;
+    double  dSeconds = 5.0;
+
+    for(int nArg = 1; nArg < argc; nArg++) {
+        std::string s(argv[nArg]);
+
+        if(s == "-m") {
+            bEndToEnd = false;
+            continue;
+        } else if(s == "-e") {
+            bMicro = false;
+            continue;
+        }
+
+        if(nArg + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+
+        const char  *pszValue = argv[++nArg];
+        if(s == "-c") nChannels = std::atoi(pszValue);
+        else if(s == "-r") dRate = std::atof(pszValue);
+        else if(s == "-b") nBlock = std::atoi(pszValue);
+        else if(s == "-s") dSeconds = std::atof(pszValue);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(!(bMicro || bEndToEnd) || nChannels < 1 ||
+        nChannels > nBenchChannels || !(dRate > 0.0) || nBlock < 1 ||
+        !(dSeconds > 0.0)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if(bMicro && !RunMicroBenchmarks()) return 1;
+    if(bEndToEnd && !RunEndToEnd(nChannels, dRate, nBlock, dSeconds))
+        return 1;
+
+    return 0;
+}
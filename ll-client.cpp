@@ -24,16 +24,21 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 //
+#include    <cctype>
+#include    <cstdlib>
 #include    "ll-client.h"
+#include    "RelayServer.h"
+#include    "MetricsServer.h"
 
 //
 // Global debug flag
 int nDebug = 0;
 
 //
-// Map of channel information
+// Channel information by handle, sChannelInfo.hChannel is NO_CHANNEL_HANDLE
+// for the channels not available
 //
-std::map<std::string, ChannelInformationEntry>  g_mChannelInformation;
+std::vector<ChannelInformationEntry>    g_vChannelInformation;
 
 //
 // Resource lock for channel information list above
@@ -41,15 +46,61 @@ std::map<std::string, ChannelInformationEntry>  g_mChannelInformation;
 std::recursive_mutex    g_lChannelInformationLock;
 
 //
-// Current channel row the cursor is on
+// Row of the channel table the cursor is on
 //
 int currentChannelRow = 0;
 
+//
+// Handles of the subscribed channels by id, for the events that only give
+// the id.  Guarded by g_lChannelInformationLock.
+//
+static std::vector<ChannelHandle>   l_vChannelById;
+
+//
+// Signalled when the server confirms a channel is unsubscribed, waited on
+// with g_lChannelInformationLock
+//
+static std::condition_variable_any  l_Unsubscribed;
+
+//
+// Function used to get the available channel with a handle, nullptr if
+// none.  Only good while g_lChannelInformationLock is held.
+//
+static ChannelInformationEntry *ChannelByHandle(ChannelHandle h)
+{
+    if(h >= g_vChannelInformation.size() ||
+        g_vChannelInformation[h].sChannelInfo.hChannel != h) return nullptr;
+
+    return &g_vChannelInformation[h];
+}
+
+//
+// Function used to get the subscribed channel with an id, nullptr if none.
+// Only good while g_lChannelInformationLock is held.
+//
+static ChannelInformationEntry *ChannelById(int nId)
+{
+    if(nId < 0 || static_cast<size_t>(nId) >= l_vChannelById.size())
+        return nullptr;
+
+    return ChannelByHandle(l_vChannelById[nId]);
+}
+
 //
 // IO Context for Boost
 //
 static boost::asio::io_context io_context;
 
+//
+// Port to serve the client metrics on, none if empty
+//
+static std::string metricsPort;
+
+//
+// Screen updates per second
+//
+static double renderRate = RENDER_RATE;
+
 //
 // Function used to show help on how to use this application
 //
@@ -57,10 +108,18 @@ static void usage(void)
 {
     std::vector<std::string>    vUsageStrings = {
         "",
-        "USAGE: ll-client <host> [port]",
+        "USAGE: ll-client [-r <relay port>] [-m <metrics port>] [-f <fps>]",
+        "                 <host> [port]",
+        "       ll-client -H [<headless options>] <host> [port]",
         "",
         "   host    IP address of host to connect to",
         "   port    Port number of host to connect to (def=10006)",
+        "   -r      Run as a relay, serving the connection to clients",
+        "           connecting on <relay port> ('q' to quit)",
+        "   -m      Serve the client counters to Prometheus at",
+        "           http://127.0.0.1:<metrics port>/metrics",
+        "   -f      Screen updates per second (def=20)",
+        "   -H      Run without a terminal, 'll-client -H' for its options",
         ""
     };
 
@@ -70,13 +129,20 @@ static void usage(void)
 //
 // Funtion used to remove an available channel
 //
-static void RemoveAvailableChannel(const std::string& sName)
+static void RemoveAvailableChannel(ChannelHandle hChannel)
 {
     std::unique_lock<std::recursive_mutex>  lk(g_lChannelInformationLock);
 
-    if(g_mChannelInformation.find(sName) !=
-        g_mChannelInformation.end()) {
-        g_mChannelInformation.erase(sName);
+    ChannelInformationEntry *pcie = ChannelByHandle(hChannel);
+    if(pcie) {
+        // No longer subscribed either, for anyone waiting on that
+        if(ChannelById(pcie->nChannelId) == pcie) {
+            l_vChannelById[pcie->nChannelId] = NO_CHANNEL_HANDLE;
+            l_Unsubscribed.notify_all();
+        }
+
+        RemoveChannelRow(pcie->sChannelInfo.hChannel);
+        pcie->sChannelInfo.hChannel = NO_CHANNEL_HANDLE;
     }
 }
 
@@ -90,13 +156,16 @@ static void HandleAvailableChannelEvent(const void *p)
     cie.sChannelInfo = *ci;
     cie.nChannelId = -1;
     cie.dFirstSampleTimestamp = NAN;
-    cie.ullTotalSamples = 0ULL;
-    PrintChannelRow(g_mChannelInformation.size(), cie.sChannelInfo);
 
     std::unique_lock<std::recursive_mutex> lk(g_lChannelInformationLock);
 
-    g_mChannelInformation[ci->sName] = cie;
-    UpdateChannels();
+    if(g_vChannelInformation.size() <= ci->hChannel) {
+        ChannelInformationEntry ciNone = {};
+        ciNone.sChannelInfo.hChannel = NO_CHANNEL_HANDLE;
+        g_vChannelInformation.resize(ci->hChannel + 1, ciNone);
+    }
+    g_vChannelInformation[ci->hChannel] = cie;
+    AddChannelRow(ci->hChannel);
 }
 
 //
@@ -104,9 +173,9 @@ static void HandleAvailableChannelEvent(const void *p)
 //
 static void HandleUnavailableChannelEvent(const void *p)
 {
-    std::string sName(reinterpret_cast<char *>(const_cast<void *>(p)));
-    RemoveAvailableChannel(sName);
-    UpdateChannels();
+    const ChannelUnavailableInfo   *cuai =
+        reinterpret_cast<const ChannelUnavailableInfo *>(p);
+    RemoveAvailableChannel(cuai->hChannel);
 }
 
 //
@@ -118,17 +187,17 @@ static void HandleChannelSubscribedEvent(const void *p)
         reinterpret_cast<const ChannelSubscribedInfo *>(p);
     std::unique_lock<std::recursive_mutex>  lk(g_lChannelInformationLock);
 
-    if(g_mChannelInformation.find(csi->sName) !=
-        g_mChannelInformation.end()) {
-        g_mChannelInformation[csi->sName].nChannelId = csi->nId;
-
-        int row = std::distance(g_mChannelInformation.begin(),
-            g_mChannelInformation.find(csi->sName));
+    ResetChannelData(csi->nId);
 
-        g_mChannelInformation[csi->sName].ullTotalSamples = 0ULL;
+    ChannelInformationEntry *pcie = ChannelByHandle(csi->hChannel);
+    if(pcie) {
+        pcie->nChannelId = csi->nId;
 
-        PrintChannelRow(row,
-            g_mChannelInformation[csi->sName].sChannelInfo);
+        if(csi->nId >= 0) {
+            if(static_cast<size_t>(csi->nId) >= l_vChannelById.size())
+                l_vChannelById.resize(csi->nId + 1, NO_CHANNEL_HANDLE);
+            l_vChannelById[csi->nId] = csi->hChannel;
+        }
     }
 }
 
@@ -142,36 +211,27 @@ static void HandleChannelUnsubscribedEvent(const void *p)
     std::unique_lock<std::recursive_mutex>
         lk(g_lChannelInformationLock);
 
-    for(auto it = g_mChannelInformation.begin();
-        it != g_mChannelInformation.end(); it++) {
-        if((*it).second.nChannelId == cui->nId) {
-            (*it).second.nChannelId = -1;
-            (*it).second.dFirstSampleTimestamp = NAN;
-
-            int row = std::distance(g_mChannelInformation.begin(), it);
-            PrintChannelRow(row, (*it).second.sChannelInfo);
-        }
+    ChannelInformationEntry *pcie = ChannelByHandle(cui->hChannel);
+    if(pcie && pcie->nChannelId == cui->nId) {
+        pcie->nChannelId = -1;
+        pcie->dFirstSampleTimestamp = NAN;
+        l_vChannelById[cui->nId] = NO_CHANNEL_HANDLE;
     }
+    l_Unsubscribed.notify_all();
 }
 
 //
-// Function used to subscribe/unsubscribe channels
+// Function used to subscribe/unsubscribe the channel on the cursor row
 //
-static void ToggleSubscribeState(int nChannelRow, LowLatencyDataClient& llc)
+static void ToggleSubscribeState(LowLatencyDataClient& llc)
 {
-    if(static_cast<size_t>(nChannelRow) > g_mChannelInformation.size()) return;
-
-    for(auto it = g_mChannelInformation.begin();
-        it != g_mChannelInformation.end(); it++) {
-        if(std::distance(g_mChannelInformation.begin(), it) == nChannelRow) {
+    std::unique_lock<std::recursive_mutex>  lk(g_lChannelInformationLock);
 
-            ChannelInformationEntry& ci = (*it).second;
-            std::string sName = (*it).first;
+    ChannelInformationEntry *pcie = ChannelAtCursor();
+    if(!pcie) return;
 
-            if(ci.nChannelId < 0) llc.SubscribeChannel(sName);
-            else llc.UnsubscribeChannel(ci.nChannelId);
-        }
-    }
+    if(pcie->nChannelId < 0) llc.SubscribeChannel(pcie->sChannelInfo.hChannel);
+    else llc.UnsubscribeChannel(pcie->nChannelId);
 }
 
 //
@@ -180,13 +240,18 @@ static void ToggleSubscribeState(int nChannelRow, LowLatencyDataClient& llc)
 static void ToggleSubscribeAll(LowLatencyDataClient& llc)
 {
     std::vector<ChannelInfo>    vChannelsList;
-    for(auto it = g_mChannelInformation.begin();
-        it != g_mChannelInformation.end(); it++) {
-        ChannelInfo ci;
-        std::string sName = (*it).first;
-        ci.sName.assign(sName);
-        ci.nDecimationFactor = 1;
-        vChannelsList.push_back(ci);
+    {
+        std::unique_lock<std::recursive_mutex>  lk(g_lChannelInformationLock);
+
+        for(auto& cie : g_vChannelInformation) {
+            if(cie.sChannelInfo.hChannel == NO_CHANNEL_HANDLE) continue;
+
+            ChannelInfo ci;
+            ci.sName.assign(cie.sChannelInfo.sName);
+            ci.hChannel = cie.sChannelInfo.hChannel;
+            ci.nDecimationFactor = 1;
+            vChannelsList.push_back(ci);
+        }
     }
     llc.SubscribeChannels(vChannelsList);
 }
@@ -200,23 +265,27 @@ static void ToggleAcquisitionState(LowLatencyDataClient& llc)
 }
 
 //
-// Function used to unsubscribe from ALL subscribed channels
+// Function used to unsubscribe from ALL subscribed channels, with one
+// request, waiting a while for the server to confirm it
 //
 static void UnsubscribeAll(LowLatencyDataClient& llc)
 {
-    for(auto it = g_mChannelInformation.begin();
-        it != g_mChannelInformation.end(); it++) {
-        if((*it).second.nChannelId != -1) {
-
-            int row = std::distance(g_mChannelInformation.begin(), it);
-            ToggleSubscribeState(row, llc);
+    std::vector<int>    vIds;
+    {
+        std::unique_lock<std::recursive_mutex>  lk(g_lChannelInformationLock);
+        for(size_t nId = 0; nId < l_vChannelById.size(); nId++)
+            if(ChannelById(nId)) vIds.push_back(nId);
+    }
 
-            while((*it).second.nChannelId != -1)
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if(vIds.empty()) return;
+    llc.UnsubscribeChannels(vIds);
 
-            PrintChannelRow(row, (*it).second.sChannelInfo);
-        }
-    }
+    std::unique_lock<std::recursive_mutex>  lk(g_lChannelInformationLock);
+    l_Unsubscribed.wait_for(lk,
+        std::chrono::milliseconds(UNSUBSCRIBE_TIMEOUT_MS), [&vIds]() {
+            for(int nId : vIds) if(ChannelById(nId)) return false;
+            return true;
+        });
 }
 
 //
@@ -230,20 +299,9 @@ static void HandleChannelFirstSampleTimestampEvent(const void *p)
     std::unique_lock<std::recursive_mutex>
         lk(g_lChannelInformationLock);
 
-    if(g_mChannelInformation.find(ctsi->sName) !=
-        g_mChannelInformation.end()) {
-        if(g_mChannelInformation[ctsi->sName].nChannelId ==
-            ctsi->nId) {
-            g_mChannelInformation[ctsi->sName].dFirstSampleTimestamp =
-                ctsi->dFirstSampleTimestamp;
-
-            int row = std::distance(g_mChannelInformation.begin(),
-                g_mChannelInformation.find(ctsi->sName));
-
-            PrintChannelFSTS(CHANNEL_START_ROW + row,
-                ctsi->dFirstSampleTimestamp);
-        }
-    }
+    ChannelInformationEntry *pcie = ChannelById(ctsi->nId);
+    if(pcie && pcie->sChannelInfo.hChannel == ctsi->hChannel)
+        pcie->dFirstSampleTimestamp = ctsi->dFirstSampleTimestamp;
 }
 
 //
@@ -253,7 +311,7 @@ static void HandleChannelDataEvent(const void *p)
 {
     const ChannelDataInfo   *cdi =
         reinterpret_cast<const ChannelDataInfo *>(p);
-    PrintChannelData(cdi);
+    UpdateChannelData(cdi);
 }
 
 //
@@ -265,8 +323,19 @@ static void HandleAcquireEvent(const void *p)
 
     if(!bState) {
         // If acquisition is stopping, clear the sample counts
-        for(auto& e : g_mChannelInformation) e.second.ullTotalSamples = 0ULL;
+        ResetChannelTotals();
     }
+
+    // Have the key press loop show the new acquisition start time
+    WakeKeyPressMonitor();
+}
+
+//
+// Event handler to handle samples found missing or repeated, they're
+// counted in the client metrics so there's nothing more to do here
+//
+static void HandleChannelGapEvent(const void *)
+{
 }
 
 //
@@ -302,6 +371,10 @@ static std::map<EventType, std::function<void(const void *)>>
             EVENT_TYPE_CHANNEL_DATA,
             HandleChannelDataEvent
         },
+        {
+            EVENT_TYPE_CHANNEL_GAP,
+            HandleChannelGapEvent
+        },
 };
 
 //
@@ -316,11 +389,93 @@ static void HandleEvents(EventType nType, const void *p, size_t nSize)
     g_mEventHandlers[nType](p);
 }
 
+//
+// Function used to serve the counters of a client, if asked to
+//
+std::unique_ptr<MetricsServer> StartMetrics(LowLatencyDataClient& llc,
+    const std::string& sPort)
+{
+    if(sPort.empty()) return nullptr;
+
+    MetricsServerConfig config;
+    config.sPort = sPort;
+
+    auto    p = std::make_unique<MetricsServer>(config, [&llc]() {
+        std::string str;
+        ClientMetrics::Prometheus(llc.Metrics(), str);
+        return str;
+    });
+
+    if(!p->Start()) return nullptr;
+    return p;
+}
+
+//
+// Function used to run as a relay.  The one connection to the server is
+// shared by every client that connects to the relay port.
+//
+static int RunRelay(std::string& host, std::string& port,
+    const std::string& relayPort)
+{
+    RelayServerConfig   config;
+    config.sPort = relayPort;
+    config.nMaxQueueBytes = 64 * 1024 * 1024;
+
+    RelayServer relay(config);
+
+    LowLatencyDataClient    llc(io_context, host, port,
+        [&relay](EventType nType, const void *p, size_t nSize) {
+            relay.HandleEvent(nType, p, nSize);
+        });
+
+    if(!relay.Start(llc)) return 1;
+
+    auto    metrics = StartMetrics(llc, metricsPort);
+
+    std::cout << "Relaying " << host << ":" << port << " on port " <<
+        relayPort << ", 'q' to quit" << std::endl;
+
+    // Show the counters once a second
+    keyPressMonitor(1000, [&relay](char) {
+        RelayServerStats    s = relay.Stats();
+        std::cout << "\rclients " << s.nClients << "  channels " <<
+            s.nUpstreamSubscriptions << "  packets " << s.nPackets <<
+            "  MB " << s.nBytes / (1024 * 1024) << "  slow " <<
+            s.nSlowClients << "   " << std::flush;
+    });
+    std::cout << std::endl;
+
+    relay.Stop();
+
+    return 0;
+}
+
 //
 // Entry point of the application
 //
 int main(int argc, char *argv[])
 {
+    // Headless has options of its own
+    if(argc > 1 && std::string(argv[1]) == "-H")
+        return RunHeadless(argc - 1, argv + 1);
+
+    // Pick off the relay, metrics and screen update options
+    char        *appName = argv[0];
+    std::string relayPort;
+    while(argc > 2 && (std::string(argv[1]) == "-r" ||
+        std::string(argv[1]) == "-m" || std::string(argv[1]) == "-f")) {
+        if(argv[1][1] == 'r') relayPort.assign(argv[2]);
+        else if(argv[1][1] == 'm') metricsPort.assign(argv[2]);
+        else renderRate = std::atof(argv[2]);
+        argc -= 2;
+        argv += 2;
+    }
+
+    if(!(renderRate > 0.0)) {
+        usage();
+        return 0;
+    }
+
     // Make sure the correct number of arguments has been given
     if(argc < 2 || argc > 3) {
         usage();
@@ -332,37 +487,67 @@ int main(int argc, char *argv[])
     std::string port("10006");
     if(argc > 2) port.assign(argv[2]);
 
+    if(!relayPort.empty()) return RunRelay(host, port, relayPort);
+
     // Draw all of the static text on the screen
-    DrawLabels(argv[0]);
+    DrawLabels(appName);
 
     // Instatiate the connection to the low latency data server
     LowLatencyDataClient    llc(io_context, host, port, HandleEvents);
 
-    // Monitor for keypresses
-    keyPressMonitor(100, [&llc](char key) mutable {
-        if(key == 'u') {
+    auto    metrics = StartMetrics(llc, metricsPort);
+
+    // Draw the channel data as it comes in
+    StartRenderer(renderRate);
+
+    // Monitor for keypresses, after '/' they're the channel filter until
+    // enter or escape (which clears it).  Woken with a 0 key when the
+    // acquisition state changes.
+    bool        bFilter = false;
+    std::string sFilter;
+    keyPressMonitor(0, [&llc, &bFilter, &sFilter](char key) mutable {
+        if(bFilter) {
+            if(key == '\n' || key == '\r') bFilter = false;
+            else if(key == 0x1b) {
+                sFilter.clear();
+                bFilter = false;
+            } else if(key == 0x7f || key == '\b') {
+                if(!sFilter.empty()) sFilter.pop_back();
+            } else if(std::isprint(static_cast<unsigned char>(key)))
+                sFilter.push_back(key);
+
+            SetChannelFilter(sFilter, bFilter);
+
+        } else if(key == '/') {
+            bFilter = true;
+            SetChannelFilter(sFilter, bFilter);
+
+        } else if(key == 'u') {
             // Move channel row up 1
-            UpdateChannelName(false);
-            currentChannelRow--;
-            if(currentChannelRow < 0)
-                currentChannelRow = g_mChannelInformation.size() - 1;
-            UpdateChannelName(true);
+            MoveChannelCursor(-1);
 
         } else if(key == 'd') {
             // Move channel row down 1
-            UpdateChannelName(false);
-            currentChannelRow++;
-            if(static_cast<size_t>(currentChannelRow) >=
-                g_mChannelInformation.size())
-                currentChannelRow = 0;
-            UpdateChannelName(true);
+            MoveChannelCursor(1);
+
+        } else if(key == 'p') {
+            // Previous page of channels
+            PageChannels(-1);
+
+        } else if(key == 'n') {
+            // Next page of channels
+            PageChannels(1);
+
+        } else if(key == 'v') {
+            // Latest value or statistics of each screen update
+            ToggleChannelView();
 
         } else if(key == 'D') {
             nDebug ^= 1;
 
         } else if(key == ' ') {
             // Subscribe/Unsubscribe channel on current channel row
-            ToggleSubscribeState(currentChannelRow, llc);
+            ToggleSubscribeState(llc);
 
         } else if(key == 's') {
             ToggleSubscribeAll(llc);
@@ -380,9 +565,12 @@ int main(int argc, char *argv[])
     // Unsubscribe from all of the subscribed channels before leaving
     UnsubscribeAll(llc);
 
+    StopRenderer();
+
     // Leaving, posistion curson on last row and clear the line
     screen_position(LAST_ROW, 1);
     clear_eol();
+    FlushScreen();
 
     // Return success
     return 0;
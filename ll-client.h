@@ -32,17 +32,22 @@
 #else
 //#include    "Windows.h"
 #endif
+#include    <atomic>
 #include    <iostream>
 #include    <iomanip>
 #include    <string>
 #include    <map>
+#include    <memory>
 #include    <vector>
 #include    <mutex>
+#include    <condition_variable>
 #include    <thread>
 #include    <functional>
 #include    <cmath>
 #include    "LowLatencyDataClient.h"
 
+class MetricsServer;
+
 
 // Row and column definitions for various items
 
@@ -75,6 +80,19 @@
 #define SR_HEADING_COLUMN       (NAME_HEADING_COLUMN + 23)
 #define FSTS_HEADING_COLUMN     (SR_HEADING_COLUMN + 18)
 #define TOTAL_SAMPLES_HEADING_COLUMN    (FSTS_HEADING_COLUMN + 14)
+
+// Columns of the statistics view, in place of FSTS onwards
+#define MIN_COLUMN              (SAMPLE_RATE_COLUMN + 11)
+#define MAX_COLUMN              (MIN_COLUMN + 10)
+#define MEAN_COLUMN             (MAX_COLUMN + 10)
+#define RMS_COLUMN              (MEAN_COLUMN + 10)
+#define SPARK_COLUMN            (RMS_COLUMN + 11)
+
+#define MIN_HEADING_COLUMN      (MIN_COLUMN + 6)
+#define MAX_HEADING_COLUMN      (MAX_COLUMN + 6)
+#define MEAN_HEADING_COLUMN     (MEAN_COLUMN + 5)
+#define RMS_HEADING_COLUMN      (RMS_COLUMN + 6)
+#define SPARK_HEADING_COLUMN    SPARK_COLUMN
 #endif
 
 #define SAMPLE_COLUMN           (80 - 9)
@@ -84,8 +102,15 @@
 #define TITLE_ROW           (APP_ROW + 2)
 #define ACQ_TIME_ROW        (TITLE_ROW + 2)
 #define COLUMN_HEADINGS_ROW (ACQ_TIME_ROW + 2)
+#define FILTER_ROW          (ACQ_TIME_ROW + 1)
 #define CHANNEL_START_ROW   (COLUMN_HEADINGS_ROW + 1)
 #define LAST_ROW            25
+#define CHANNEL_ROWS        (LAST_ROW - CHANNEL_START_ROW - 1)
+#define SCREEN_COLUMNS      80
+
+#define RENDER_RATE         20          // Default screen updates per second
+#define SPARK_POINTS        10          // Screen updates in a sparkline
+#define UNSUBSCRIBE_TIMEOUT_MS  2000    // Wait for unsubscribes at exit
 
 //
 // Definiton of per channel information maintained in this application
@@ -94,9 +119,50 @@ typedef struct {
     ChannelInfo sChannelInfo;           // Info from LowLatencyDataClient object
     int         nChannelId;             // >= 0 = subscribed
     double      dFirstSampleTimestamp;  // Timestamp of first sample
-    uint64_t    ullTotalSamples;        // Total number of samples
 } ChannelInformationEntry;
 
+//
+// Definition of the statistics of a run of samples
+//
+typedef struct {
+    float       fMin;
+    float       fMax;
+    double      dSum;
+    double      dSumSquares;
+    uint64_t    ullSamples;             // 0 = none, the rest is undefined
+} ChannelStats;
+
+//
+// Definition of the latest data of a subscribed channel.  The socket read
+// thread stores to these for every data packet and the renderer draws from
+// them at its own rate, without either taking a lock.
+//
+// The statistics are added up by the socket read thread alone, a frame at a
+// time.  Every packet publishes those of its frame so far under a seqlock
+// (nSeq odd while it's being written), which the renderer reads.  So the
+// last frame before the data stops is shown as well.
+//
+typedef struct {
+    std::atomic<float>      fLastSample;        // Unscaled
+    std::atomic<uint64_t>   ullTotalSamples;
+    std::atomic<uint64_t>   ullPackets;         // Changes with new data
+
+    // Socket read thread only
+    ChannelStats            Interval;           // Unscaled, being added up
+    uint64_t                nIntervalFrame;     // Frame Interval began in
+
+    // Published for the renderer
+    std::atomic<uint32_t>   nSeq;
+    std::atomic<uint32_t>   nRestarts;          // Data started over
+    std::atomic<uint64_t>   nPublished;         // Changes with each publish
+    std::atomic<uint64_t>   nFrame;             // Frame of the publish
+    std::atomic<float>      fMin;
+    std::atomic<float>      fMax;
+    std::atomic<double>     dSum;
+    std::atomic<double>     dSumSquares;
+    std::atomic<uint64_t>   ullSamples;
+} ChannelLiveData;
+
 //
 // Function prototypes
 //
@@ -109,13 +175,30 @@ void center_string(int, char *);
 
 void DrawLabels(char *appName);
 
-void PrintChannelFSTS(int row, double dFSTS);
 void UpdateChannels(void);
-void PrintChannelRow(int row, const ChannelInfo& ci);
-void UpdateChannelName(bool);
-void PrintChannelData(const ChannelDataInfo *);
+void AddChannelRow(ChannelHandle);
+void RemoveChannelRow(ChannelHandle);
+void MoveChannelCursor(int nRows);
+void PageChannels(int nPages);
+void ToggleChannelView(void);
+void SetChannelFilter(const std::string& sFilter, bool bEditing);
+ChannelInformationEntry *ChannelAtCursor(void);
+void ChannelBlockStats(const float *pData, size_t nSamples, ChannelStats&);
+void UpdateChannelData(const ChannelDataInfo *);
+void ResetChannelData(int nId);
+void ResetChannelTotals(void);
+void RenderChannels(void);
+void StartRenderer(double dRate);
+void StopRenderer(void);
+void RenderScreen(std::string&);
+void FlushScreen(void);
 void PrintAcquisitionStartTime(const std::string&);
 
 void keyPressMonitor(uint32_t, std::function<void(char)>);
+void WakeKeyPressMonitor(void);
+
+std::unique_ptr<MetricsServer> StartMetrics(LowLatencyDataClient&,
+    const std::string& sPort);
+int RunHeadless(int argc, char *argv[]);
 
 #endif
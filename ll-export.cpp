@@ -0,0 +1,99 @@
+//
+// ll-export.cpp - Export a ChannelRecorder capture as CSV or TSV
+//
+//
+// Copyright (c) 2023 by Hi-Techniques Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the “Software”),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+#include    <chrono>
+#include    <cstring>
+#include    <iostream>
+#include    <string>
+#include    "CaptureReplay.h"
+#include    "ChannelExporter.h"
+
+//
+// Function used to print the usage
+//
+static void usage(const char *pszName)
+{
+    std::cerr << "Usage: " << pszName << " [-t] <capture> <output | ->" <<
+        std::endl;
+    std::cerr << "    -t    Tab separated instead of comma separated" <<
+        std::endl;
+}
+
+//
+// Entry point of the application.  Plays the capture through the exporter
+// as fast as the exporter can take it.
+//
+int main(int argc, char *argv[])
+{
+    char    cSeparator = ',';
+    int     nArg = 1;
+
+    if(argc > nArg && !::strcmp(argv[nArg], "-t")) {
+        cSeparator = '\t';
+        nArg++;
+    }
+
+    if(argc - nArg != 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    ChannelExporterConfig   ec;
+    ec.sPath.assign(argv[nArg + 1]);
+    ec.cSeparator = cSeparator;
+    ec.nTimeDecimals = 9;
+    ec.nValueDigits = 0;
+    ec.nBufferBytes = 8 * 1024 * 1024;
+    ec.nMaxQueuedSamples = 0;
+    ec.nMaxPendingSamples = 0;
+    ec.bBlockWhenFull = true;
+
+    ChannelExporter exporter(ec);
+    if(!exporter.IsOpen()) return 1;
+
+    CaptureReplayConfig rc;
+    rc.dSpeed = 0.0;
+    rc.nBlockSamples = 64 * 1024;
+
+    CaptureReplay   replay(argv[nArg],
+        [&exporter](EventType nType, const void *p, size_t n) {
+            exporter.HandleEvent(nType, p, n);
+        }, rc);
+    if(!replay.Channels()) return 1;
+
+    auto    t0 = std::chrono::steady_clock::now();
+    replay.Run();
+    exporter.Finish();
+    double  dSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - t0).count();
+
+    ChannelExporterStats    s = exporter.Stats();
+    std::cerr << "rows=" << s.nRows << " samples=" << s.nSamples <<
+        " bytes=" << s.nBytes << " seconds=" << dSeconds <<
+        " MBps=" << s.nBytes / dSeconds / 1e6 <<
+        " ignored=" << s.nIgnoredSamples <<
+        " write_errors=" << s.nWriteErrors << std::endl;
+
+    return s.nWriteErrors ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+//
+// ll-sim.cpp - Simulated DAQ serving the low latency stream protocol
+//
+//
+// Copyright (c) 2023 by Hi-Techniques Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the “Software”),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+#include    <chrono>
+#include    <csignal>
+#include    <cstdlib>
+#include    <cstring>
+#include    <iostream>
+#include    <string>
+#include    <thread>
+#include    "MockServer.h"
+
+static volatile std::sig_atomic_t   g_bQuit = 0;
+
+//
+// Function used to note that the user wants to quit
+//
+static void onSignal(int)
+{
+    g_bQuit = 1;
+}
+
+//
+// Function used to print the usage
+//
+static void usage(const char *pszName)
+{
+    std::cerr << "Usage: " << pszName << " [options]" << std::endl;
+    std::cerr << "    -p <port>       Port to listen on (10006)" << std::endl;
+    std::cerr << "    -c <channels>   Channels, named ai0, ai1, ... (8)" <<
+        std::endl;
+    std::cerr << "    -r <rate>       Sample rate in Hz (10000)" << std::endl;
+    std::cerr << "    -b <samples>    Samples per data packet (100)" <<
+        std::endl;
+    std::cerr << "    -t <type>       float, int16 or int32 (float)" <<
+        std::endl;
+    std::cerr << "    -s <signal>     sine, square, ramp, noise or counter "
+        "(sine)" << std::endl;
+    std::cerr << "    -a              Acquire from the start" << std::endl;
+    std::cerr << "    -f <bytes>      Write in random pieces of at most this"
+        << std::endl;
+    std::cerr << "    -w <us>         Pause between the pieces" << std::endl;
+    std::cerr << "    -x <rate>       Fraction of packets corrupted" <<
+        std::endl;
+    std::cerr << "    -d <rate>       Fraction of packets dropped" <<
+        std::endl;
+    std::cerr << "    -F <ms>         Make the last channel come and go "
+        "this often" << std::endl;
+}
+
+//
+// Entry point of the application.  Serves until interrupted, printing the
+// counters once a second.
+//
+int main(int argc, char *argv[])
+{
+    MockServerConfig    config = {};
+    MockChannelConfig   channel = {};
+    int                 nChannels = 8;
+    unsigned            nFlapMs = 0;
+
+    config.sPort.assign("10006");
+    config.nBlockSamples = 100;
+    config.nSeed = 1;
+    channel.sDataType.assign("float");
+    channel.dSampleRate = 10000.0;
+    channel.dScale = 1.0;
+    channel.nSignal = MOCK_SIGNAL_SINE;
+    channel.dAmplitude = 10.0;
+    channel.dFrequency = 10.0;
+
+    for(int nArg = 1; nArg < argc; nArg++) {
+        std::string s(argv[nArg]);
+        const char  *pszValue = nArg + 1 < argc ? argv[nArg + 1] : nullptr;
+
+        if(s == "-a") {
+            config.bAcquire = true;
+            continue;
+        }
+
+        if(s.size() != 2 || s[0] != '-' || !pszValue) {
+            usage(argv[0]);
+            return 1;
+        }
+        nArg++;
+
+        switch(s[1]) {
+            case 'p': config.sPort.assign(pszValue); break;
+            case 'c': nChannels = std::atoi(pszValue); break;
+            case 'r': channel.dSampleRate = std::atof(pszValue); break;
+            case 'b': config.nBlockSamples = std::atoi(pszValue); break;
+            case 't': channel.sDataType.assign(pszValue); break;
+            case 'f': config.Faults.nFragmentBytes = std::atoi(pszValue); break;
+            case 'w': config.Faults.nSlowWriteUs = std::atoi(pszValue); break;
+            case 'x': config.Faults.dCorruptRate = std::atof(pszValue); break;
+            case 'd': config.Faults.dDropRate = std::atof(pszValue); break;
+            case 'F': nFlapMs = std::atoi(pszValue); break;
+            case 's':
+                if(MockServer::ParseSignal(pszValue, &channel.nSignal)) break;
+                // Fall through
+
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if(nChannels < 1 || !(channel.dSampleRate > 0.0) ||
+        config.nBlockSamples < 1 || (channel.sDataType != "float" &&
+        channel.sDataType != "int16" && channel.sDataType != "int32")) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Integer channels send counts of a +/-10 V range
+    if(channel.sDataType == "int16") channel.dScale = 10.0 / 32768.0;
+    else if(channel.sDataType == "int32") channel.dScale = 10.0 / 2147483648.0;
+
+    for(int n = 0; n < nChannels; n++) {
+        channel.sName = "ai" + std::to_string(n);
+        config.vChannels.push_back(channel);
+        channel.dFrequency *= 1.5;
+    }
+
+    MockServer  server(config);
+    if(!server.Start()) return 1;
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    std::cerr << "Serving " << nChannels << " channels at " <<
+        channel.dSampleRate << " Hz on port " << config.sPort << std::endl;
+
+    auto    tFlap = std::chrono::steady_clock::now();
+    bool    bAvailable = true;
+
+    while(!g_bQuit) {
+        for(int n = 0; n < 10 && !g_bQuit; n++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+            auto    tNow = std::chrono::steady_clock::now();
+            if(nFlapMs && tNow - tFlap >= std::chrono::milliseconds(nFlapMs)) {
+                bAvailable = !bAvailable;
+                server.SetAvailable(config.vChannels.back().sName, bAvailable);
+                tFlap = tNow;
+            }
+        }
+
+        MockServerStats s = server.Stats();
+        std::cerr << "clients=" << s.nClients << " connects=" <<
+            s.nConnects << " packets=" << s.nPackets << " samples=" <<
+            s.nSamples << " bytes=" << s.nBytes << " corrupted=" <<
+            s.nCorrupted << " dropped=" << s.nDropped << std::endl;
+    }
+
+    server.Stop();
+
+    return 0;
+}
@@ -0,0 +1,1086 @@
+//
+// ll-tap.cpp - Feed a connection's events to the in-memory channel stores
+//
+//
+// Copyright (c) 2023 by Hi-Techniques Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the “Software”),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+#include    <algorithm>
+#include    <atomic>
+#include    <chrono>
+#include    <cmath>
+#include    <csignal>
+#include    <cstdlib>
+#include    <cstring>
+#include    <functional>
+#include    <iostream>
+#include    <memory>
+#include    <string>
+#include    <thread>
+#include    <vector>
+#include    <unistd.h>
+#include    "CaptureReader.h"
+#include    "CaptureReplay.h"
+#include    "ChannelHistory.h"
+#include    "ChannelLodPyramid.h"
+#include    "ChannelRecorder.h"
+#include    "LowLatencyDataClient.h"
+#include    "MockServer.h"
+#include    "Multicast.h"
+#include    "ShmFanout.h"
+
+//
+// What the client expects the application to have
+//
+int nDebug = 0;
+
+static volatile std::sig_atomic_t   g_bQuit = 0;
+
+//
+// Highest channel id the stores keep
+//
+#define TAP_MAX_CHANNEL_ID  1023
+
+//
+// Definition of the tap settings
+//
+typedef struct {
+    std::string                 sHost;
+    std::string                 sPort;
+    std::vector<std::string>    vPatterns;      // Empty = all channels
+    bool                        bAcquire;       // Start acquisition
+    double                      dHistorySeconds;
+    ChannelLodConfig            Lod;
+    std::string                 sShmPublish;    // Also publish to this ring
+    std::string                 sShmRead;       // Read this ring instead
+    MulticastConfig             Multicast;      // Also publish, nPort != 0
+    MulticastReceiverConfig     MulticastRead;  // Receive instead, nPort != 0
+} TapConfig;
+
+//
+// Definition of the stores the events of one source are fed to, and where
+// they are passed on to.  Data events are counted per channel id so a self
+// check can compare what went in with what the stores hold.
+//
+typedef struct {
+    std::unique_ptr<ChannelHistory> pHistory;
+    std::unique_ptr<ChannelLodPyramid>  pLod;
+    std::unique_ptr<ShmFanoutPublisher> pShm;
+    std::unique_ptr<MulticastPublisher> pMulticast;
+    std::atomic<uint64_t>           aSamples[TAP_MAX_CHANNEL_ID + 1];
+    std::atomic<int>                nAcquiring;     // -1 = not known
+} Tap;
+
+//
+// Function used to note that the user wants to quit
+//
+static void onSignal(int)
+{
+    g_bQuit = 1;
+}
+
+//
+// Function used to print the usage
+//
+static void usage(const char *pszName)
+{
+    std::cerr << "Usage: " << pszName << " [options] <host> [port]" <<
+        std::endl;
+    std::cerr << "       " << pszName << " -T" << std::endl;
+    std::cerr << "    -c <pattern>    Subscribe to the channels whose names "
+        "match, * and ?" << std::endl;
+    std::cerr << "                    wildcards, may be repeated (all)" <<
+        std::endl;
+    std::cerr << "    -a              Start acquisition" << std::endl;
+    std::cerr << "    -h <seconds>    History kept per channel (10)" <<
+        std::endl;
+    std::cerr << "    -s <name>       Publish the events to a shared memory "
+        "ring" << std::endl;
+    std::cerr << "    -S <name>       Read the events from a shared memory "
+        "ring, no <host>" << std::endl;
+    std::cerr << "    -m <group:port> Publish the data to a multicast group" <<
+        std::endl;
+    std::cerr << "    -M <group:port> Receive the data from a multicast group, "
+        "no <host>" << std::endl;
+    std::cerr << "    -i <address>    Local address for -m and -M, e.g. "
+        "127.0.0.1 (any)" << std::endl;
+    std::cerr << "    -T              Check each store over loopback "
+        "against a MockServer," << std::endl;
+    std::cerr << "                    the client's counts of each channel "
+        "and seeks in and" << std::endl;
+    std::cerr << "                    replays of a recording" << std::endl;
+}
+
+//
+// Function used to make the stores, returns false if one could not be made
+//
+static bool OpenTap(Tap& t, const TapConfig& config)
+{
+    ChannelHistoryConfig    hc = {};
+    hc.dSeconds = config.dHistorySeconds;
+    hc.nMaxBytes = 64 * 1024 * 1024;
+    hc.nMaxChannelId = TAP_MAX_CHANNEL_ID;
+    t.pHistory = std::make_unique<ChannelHistory>(hc);
+
+    ChannelLodConfig    lc = config.Lod;
+    lc.nMaxChannelId = TAP_MAX_CHANNEL_ID;
+    t.pLod = std::make_unique<ChannelLodPyramid>(lc);
+
+    for(auto& n : t.aSamples) n = 0;
+    t.nAcquiring = -1;
+
+    if(!config.sShmPublish.empty()) {
+        ShmFanoutConfig sc = {};
+        sc.sName = config.sShmPublish;
+        sc.nRingBytes = 64 * 1024 * 1024;
+        sc.nSnapshotBytes = 1024 * 1024;
+        t.pShm = std::make_unique<ShmFanoutPublisher>(sc);
+        if(!t.pShm->IsOpen()) return false;
+    }
+
+    if(config.Multicast.nPort) {
+        t.pMulticast = std::make_unique<MulticastPublisher>(config.Multicast);
+        if(!t.pMulticast->IsOpen()) return false;
+    }
+
+    return true;
+}
+
+//
+// Function used to hand an event to the stores
+//
+static void TapEvent(Tap& t, EventType nType, const void *p, size_t nSize)
+{
+    if(nType == EVENT_TYPE_CHANNEL_DATA) {
+        auto    cdi = static_cast<const ChannelDataInfo *>(p);
+        if(cdi->nId >= 0 && cdi->nId <= TAP_MAX_CHANNEL_ID)
+            t.aSamples[cdi->nId] += cdi->nSamples;
+
+    } else if(nType == EVENT_TYPE_ACQUIRE)
+        t.nAcquiring = *static_cast<const bool *>(p) ? 1 : 0;
+
+    t.pHistory->HandleEvent(nType, p, nSize);
+    t.pLod->HandleEvent(nType, p, nSize);
+    if(t.pShm) t.pShm->HandleEvent(nType, p, nSize);
+    if(t.pMulticast) t.pMulticast->HandleEvent(nType, p, nSize);
+}
+
+//
+// Function used to print a line for each channel the stores hold
+//
+static void PrintTap(Tap& t)
+{
+    for(int nId = 0; nId <= TAP_MAX_CHANNEL_ID; nId++) {
+        ChannelHistoryInfo  Info;
+        if(!t.pHistory->Info(nId, Info) || !Info.bSubscribed) continue;
+
+        std::cout << "channel name=" << Info.szName << " id=" << nId <<
+            " samples=" << t.aSamples[nId] << " held=" <<
+            Info.nNextIndex - Info.nFirstIndex;
+
+        float   fNewest;
+        if(Info.nNextIndex && t.pHistory->Sample(nId, Info.nNextIndex - 1,
+            fNewest))
+            std::cout << " newest=" << fNewest * Info.dScale + Info.dOffset;
+
+        // The range of the last minute from the pyramid
+        LodBucket   b;
+        double      dEnd = ChannelHistory::TimeAtIndex(Info, Info.nNextIndex);
+        if(Info.nNextIndex && t.pLod->Query(nId, dEnd - 60.0, dEnd, &b, 1) &&
+            b.nSamples)
+            std::cout << " min=" << b.fMin << " max=" << b.fMax;
+
+        std::cout << std::endl;
+    }
+}
+
+//
+// Function used to tell whether samples of a counter signal follow on from
+// each other
+//
+static bool Consecutive(const std::vector<float>& v, size_t nSamples)
+{
+    for(size_t i = 1; i < nSamples; i++)
+        if(v[i] != v[i - 1] + 1.0f && v[i] != 0.0f) return false;
+
+    return nSamples > 0;
+}
+
+//
+// Function used to check the history held of each channel:  the newest
+// second is there, in order, and can be found by time as well as by index
+//
+static bool CheckHistory(Tap& t, int nChannels, double dRate)
+{
+    bool    bPass = true;
+    size_t  nWanted = static_cast<size_t>(dRate / 2);
+
+    for(int nId = 0; nId < nChannels; nId++) {
+        ChannelHistoryInfo  Info;
+        std::vector<float>  v(nWanted);
+
+        if(!t.pHistory->Info(nId, Info) || Info.nNextIndex < nWanted) {
+            bPass = false;
+            continue;
+        }
+
+        size_t  nRead = t.pHistory->Read(nId, Info.nNextIndex - nWanted,
+            v.data(), nWanted);
+        if(nRead != nWanted || !Consecutive(v, nRead)) bPass = false;
+
+        // The same samples again by their timestamps
+        uint64_t    nFirst;
+        double      dStart = ChannelHistory::TimeAtIndex(Info,
+            Info.nNextIndex - nWanted);
+        double      dEnd = ChannelHistory::TimeAtIndex(Info,
+            Info.nNextIndex - 1);
+        nRead = t.pHistory->ReadTimeRange(nId, dStart, dEnd, v.data(),
+            nWanted, &nFirst);
+        if(nRead != nWanted || nFirst != Info.nNextIndex - nWanted ||
+            !Consecutive(v, nRead)) bPass = false;
+    }
+
+    std::cout << "check=history result=" << (bPass ? "pass" : "fail") <<
+        std::endl;
+    return bPass;
+}
+
+//
+// Function used to check the pyramid of each channel:  a second of display
+// buckets at a zoom whose level has already dropped most of that second
+// must come from a coarser level, with every bucket filled and the counter
+// rising up to the newest sample
+//
+static bool CheckLod(Tap& t, int nChannels, double dRate)
+{
+    bool                    bPass = true;
+    const size_t            nBuckets = 1000;
+    std::vector<LodBucket>  v(nBuckets);
+
+    for(int nId = 0; nId < nChannels; nId++) {
+        ChannelHistoryInfo  Info;
+        float               fNewest;
+
+        if(!t.pHistory->Info(nId, Info) || Info.nNextIndex < dRate ||
+            !t.pHistory->Sample(nId, Info.nNextIndex - 1, fNewest)) {
+            bPass = false;
+            continue;
+        }
+
+        double  dEnd = ChannelHistory::TimeAtIndex(Info, Info.nNextIndex);
+        if(t.pLod->Query(nId, dEnd - 1.0, dEnd, v.data(), nBuckets) !=
+            nBuckets) {
+            bPass = false;
+            continue;
+        }
+
+        for(size_t i = 0; i < nBuckets; i++) {
+            const LodBucket&    b = v[i];
+            if(!b.nSamples || !(b.fMin <= b.fMean && b.fMean <= b.fMax) ||
+                (i && b.fMax < v[i - 1].fMax)) bPass = false;
+        }
+        if(v[nBuckets - 1].fMax != fNewest) bPass = false;
+    }
+
+    std::cout << "check=lod result=" << (bPass ? "pass" : "fail") <<
+        std::endl;
+    return bPass;
+}
+
+//
+// Function used to tell whether the stores fed from a publisher got every
+// sample the publishing ones did, ending with the same one
+//
+static bool SameSamples(Tap& t, Tap& rt, int nChannels)
+{
+    bool    bPass = true;
+
+    for(int nId = 0; nId < nChannels; nId++) {
+        ChannelHistoryInfo  Info, rInfo;
+        float               fNewest, frNewest;
+
+        if(!t.aSamples[nId] || rt.aSamples[nId] != t.aSamples[nId] ||
+            !t.pHistory->Info(nId, Info) || !rt.pHistory->Info(nId, rInfo) ||
+            !Info.nNextIndex || rInfo.nNextIndex != Info.nNextIndex ||
+            !t.pHistory->Sample(nId, Info.nNextIndex - 1, fNewest) ||
+            !rt.pHistory->Sample(nId, rInfo.nNextIndex - 1, frNewest) ||
+            frNewest != fNewest)
+            bPass = false;
+    }
+
+    return bPass;
+}
+
+//
+// Function used to check that a reader of the shared memory ring got every
+// sample published, once the publisher has gone and the reader has read
+// to the end
+//
+static bool CheckShm(Tap& t, Tap& rt, int nChannels)
+{
+    bool    bPass = SameSamples(t, rt, nChannels);
+
+    std::cout << "check=shm result=" << (bPass ? "pass" : "fail") <<
+        std::endl;
+    return bPass;
+}
+
+//
+// Function used to check that a multicast receiver on loopback got every
+// sample published, with no datagram lost
+//
+static bool CheckMulticast(Tap& t, Tap& mt, int nChannels,
+    const MulticastReceiverStats& s)
+{
+    bool    bPass = s.nDatagrams && !s.nLostDatagrams && !s.nGaps &&
+        SameSamples(t, mt, nChannels);
+
+    std::cout << "check=multicast result=" << (bPass ? "pass" : "fail") <<
+        " datagrams=" << s.nDatagrams << " lost=" << s.nLostDatagrams <<
+        std::endl;
+    return bPass;
+}
+
+//
+// Function used to hand a recorder a block of a counter signal, counting on
+// from *pnNext
+//
+static void RecordCounter(const EventHandler& fRecord, ChannelHandle hChannel,
+    int nId, size_t nSamples, uint64_t *pnNext)
+{
+    std::vector<float>  v(100);
+
+    while(nSamples) {
+        size_t  n = std::min(nSamples, v.size());
+        for(size_t i = 0; i < n; i++)
+            v[i] = static_cast<float>((*pnNext)++);
+
+        ChannelDataInfo cdi;
+        cdi.hChannel = hChannel;
+        cdi.nId = nId;
+        cdi.pData = v.data();
+        cdi.nSamples = n;
+        fRecord(EVENT_TYPE_CHANNEL_DATA, &cdi, sizeof(cdi));
+
+        nSamples -= n;
+    }
+}
+
+//
+// Function used to check a capture can be found by time:  a channel is
+// recorded at 10 kHz with epoch timestamps, acquisition is restarted and
+// the first sample timestamp of the new run comes a little after its first
+// samples, then the recording is read back with a CaptureReader.  Every
+// sample's timestamp must lead back to it, a 0.1 s range must hold 1000
+// samples and ranges and times across the restart must land on the right
+// segment.
+//
+static bool CheckCapture(void)
+{
+    const double    dPeriod = 1e-4;
+    const double    dStart = 1.7e9 + 0.123456789;
+    const double    dRestart = dStart + 10.0;
+    const uint64_t  nRun = 20000;
+    const uint64_t  nUntimed = 500;
+
+    char    szDirectory[] = "/tmp/ll-tap-check-XXXXXX";
+    if(!::mkdtemp(szDirectory)) return false;
+
+    std::string sName("cap0");
+    std::string sPath = std::string(szDirectory) + "/" +
+        ChannelRecorder::FileName(sName, "-0-0.llr");
+
+    {
+        ChannelRecorderConfig   rc = {};
+        rc.sDirectory.assign(szDirectory);
+        rc.nChunkBytes = 64 * 1024;
+        rc.nChunks = 8;
+        rc.nFlushMillis = 1000;
+        rc.nIndexInterval = 1024;
+        ChannelRecorder         r(rc);
+        EventHandler            fRecord = [&r](EventType nType,
+            const void *p, size_t nSize) { r.HandleEvent(nType, p, nSize); };
+
+        ChannelInfo ci;
+        ci.sName = sName;
+        ci.hChannel = ChannelNames::Intern(sName);
+        ci.sDataType.assign("float");
+        ci.dScale = 1.0;
+        ci.dOffset = 0.0;
+        ci.dSamplePeriod = dPeriod;
+        ci.nDecimationFactor = 1;
+        r.HandleEvent(EVENT_TYPE_AVAILABLE_CHANNEL, &ci, sizeof(ci));
+
+        ChannelSubscribedInfo   csi;
+        csi.sName = sName;
+        csi.hChannel = ci.hChannel;
+        csi.nId = 0;
+        csi.nDecimationFactor = 1;
+        r.HandleEvent(EVENT_TYPE_CHANNEL_SUBSCRIBED, &csi, sizeof(csi));
+
+        ChannelTimestampInfo    ctsi;
+        ctsi.sName = sName;
+        ctsi.hChannel = ci.hChannel;
+        ctsi.nId = 0;
+        ctsi.dFirstSampleTimestamp = dStart;
+        r.HandleEvent(EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS, &ctsi,
+            sizeof(ctsi));
+
+        uint64_t    nNext = 0;
+        RecordCounter(fRecord, ci.hChannel, 0, nRun, &nNext);
+
+        // Stopped, as the client tells it
+        bool    bAcquiring = false;
+        ctsi.dFirstSampleTimestamp = 0.0;
+        r.HandleEvent(EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS, &ctsi,
+            sizeof(ctsi));
+        r.HandleEvent(EVENT_TYPE_ACQUIRE, &bAcquiring, sizeof(bAcquiring));
+
+        // Restarted, the timestamp of the new run comes late
+        bAcquiring = true;
+        r.HandleEvent(EVENT_TYPE_ACQUIRE, &bAcquiring, sizeof(bAcquiring));
+        RecordCounter(fRecord, ci.hChannel, 0, nUntimed, &nNext);
+
+        ctsi.dFirstSampleTimestamp = dRestart;
+        r.HandleEvent(EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS, &ctsi,
+            sizeof(ctsi));
+        RecordCounter(fRecord, ci.hChannel, 0, nRun, &nNext);
+
+        ChannelUnsubscribedInfo cui;
+        cui.hChannel = ci.hChannel;
+        cui.nId = 0;
+        r.HandleEvent(EVENT_TYPE_CHANNEL_UNSUBSCRIBED, &cui, sizeof(cui));
+        r.Flush();
+    }
+
+    bool    bPass = false;
+    {
+        CaptureReader   reader(sPath);
+        const uint64_t  nSecond = nRun + nUntimed;
+        const auto&     vSegments = reader.Segments();
+
+        bPass = reader.IsOpen() && reader.Samples() == nSecond + nRun &&
+            vSegments.size() == 3 && vSegments[0].dStartTime == dStart &&
+            vSegments[1].nFirstSample == nRun &&
+            std::isnan(vSegments[1].dStartTime) &&
+            vSegments[2].nFirstSample == nSecond &&
+            vSegments[2].dStartTime == dRestart;
+
+        // Every timed sample from its own timestamp
+        uint64_t    nMissed = 0;
+        for(uint64_t n = 0; bPass && n < reader.Samples(); n++) {
+            if(n >= nRun && n < nSecond) continue;
+
+            uint64_t    nFound;
+            if(!reader.SampleAtTime(reader.TimeOfSample(n), &nFound) ||
+                nFound != n) nMissed++;
+        }
+        if(nMissed) bPass = false;
+
+        // A tenth of a second in the first run
+        const float *pData;
+        uint64_t    nFirst;
+        double      t = reader.TimeOfSample(5000);
+        if(bPass && (reader.ReadTimeRange(t, t + 0.1, &pData, &nFirst) !=
+            1000 || nFirst != 5000 || pData[0] != 5000.0f ||
+            pData[999] != 5999.0f)) bPass = false;
+
+        // From the end of the first run into the second, the untimed
+        // samples in between included
+        t = reader.TimeOfSample(nRun - 500);
+        if(bPass && (reader.ReadTimeRange(t, dRestart + 0.05, &pData,
+            &nFirst) != 1500 || nFirst != nRun - 500 ||
+            pData[1499] != static_cast<float>(nSecond + 499))) bPass = false;
+
+        // Between the runs is the start of the second
+        if(bPass && (!reader.SampleAtTime(dStart + 5.0, &nFirst) ||
+            nFirst != nSecond)) bPass = false;
+
+        std::cout << "check=capture result=" << (bPass ? "pass" : "fail") <<
+            " segments=" << vSegments.size() << " missed=" << nMissed <<
+            std::endl;
+    }
+
+    std::string sIndexPath = sPath.substr(0, sPath.size() - 4) + ".lli";
+    ::unlink(sPath.c_str());
+    ::unlink(sIndexPath.c_str());
+    ::rmdir(szDirectory);
+
+    return bPass;
+}
+
+//
+// Function used to note an event in the log of the channel it is for, every
+// channel's for acquisition, a run of data blocks noted once
+//
+static void LogEvent(std::vector<std::vector<std::string>>& vLogs,
+    EventType nType, const void *p)
+{
+    int         nId = -1;
+    std::string sEvent;
+
+    if(nType == EVENT_TYPE_CHANNEL_SUBSCRIBED) {
+        nId = reinterpret_cast<const ChannelSubscribedInfo *>(p)->nId;
+        sEvent = "subscribed";
+    } else if(nType == EVENT_TYPE_CHANNEL_UNSUBSCRIBED) {
+        nId = reinterpret_cast<const ChannelUnsubscribedInfo *>(p)->nId;
+        sEvent = "unsubscribed";
+    } else if(nType == EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS) {
+        const ChannelTimestampInfo  *ctsi =
+            reinterpret_cast<const ChannelTimestampInfo *>(p);
+        nId = ctsi->nId;
+        sEvent = "fsts=" + std::to_string(ctsi->dFirstSampleTimestamp);
+    } else if(nType == EVENT_TYPE_CHANNEL_DATA) {
+        nId = reinterpret_cast<const ChannelDataInfo *>(p)->nId;
+        sEvent = "data";
+    } else if(nType == EVENT_TYPE_ACQUIRE) {
+        sEvent = *reinterpret_cast<const bool *>(p) ? "acquire=1" :
+            "acquire=0";
+        for(auto& e : vLogs) e.push_back(sEvent);
+        return;
+    } else
+        return;
+
+    if(nId < 0 || nId >= static_cast<int>(vLogs.size())) return;
+
+    auto&   vLog = vLogs[nId];
+    if(sEvent == "data" && !vLog.empty() && vLog.back() == sEvent) return;
+    vLog.push_back(sEvent);
+}
+
+//
+// Function used to check a capture replays the way it was recorded:  two
+// channels are recorded through two acquisitions, the second with its
+// first sample timestamp late, then the capture is replayed with a
+// CaptureReplay.  Each channel must see the same subscribe, acquisition and
+// timestamp events around its data, and all of its samples in order.
+//
+static bool CheckReplay(void)
+{
+    const int       nChannels = 2;
+    const double    dPeriod = 1e-4;
+    const double    dStart = 1.7e9 + 0.123456789;
+    const double    dRestart = dStart + 10.0;
+    const uint64_t  nRun = 5000;
+    const uint64_t  nUntimed = 500;
+
+    char    szDirectory[] = "/tmp/ll-tap-check-XXXXXX";
+    if(!::mkdtemp(szDirectory)) return false;
+
+    std::vector<std::vector<std::string>>   vRecorded(nChannels);
+    std::vector<std::string>                vPaths;
+
+    {
+        ChannelRecorderConfig   rc = {};
+        rc.sDirectory.assign(szDirectory);
+        rc.nChunkBytes = 64 * 1024;
+        rc.nChunks = 8;
+        rc.nFlushMillis = 1000;
+        rc.nIndexInterval = 1024;
+        ChannelRecorder         r(rc);
+        EventHandler            fRecord = [&](EventType nType,
+            const void *p, size_t nSize) {
+            LogEvent(vRecorded, nType, p);
+            r.HandleEvent(nType, p, nSize);
+        };
+
+        std::vector<ChannelHandle>  vHandles;
+        for(int i = 0; i < nChannels; i++) {
+            ChannelInfo ci;
+            ci.sName = "rep" + std::to_string(i);
+            ci.hChannel = ChannelNames::Intern(ci.sName);
+            ci.sDataType.assign("float");
+            ci.dScale = 1.0;
+            ci.dOffset = 0.0;
+            ci.dSamplePeriod = dPeriod;
+            ci.nDecimationFactor = 1;
+            fRecord(EVENT_TYPE_AVAILABLE_CHANNEL, &ci, sizeof(ci));
+            vHandles.push_back(ci.hChannel);
+            vPaths.push_back(std::string(szDirectory) + "/" +
+                ChannelRecorder::FileName(ci.sName, "-") + std::to_string(i) +
+                "-0.llr");
+
+            ChannelSubscribedInfo   csi;
+            csi.sName = ci.sName;
+            csi.hChannel = ci.hChannel;
+            csi.nId = i;
+            csi.nDecimationFactor = 1;
+            fRecord(EVENT_TYPE_CHANNEL_SUBSCRIBED, &csi, sizeof(csi));
+        }
+
+        auto fTimestamp = [&](double dTime) {
+            for(int i = 0; i < nChannels; i++) {
+                ChannelTimestampInfo    ctsi;
+                ctsi.sName = "rep" + std::to_string(i);
+                ctsi.hChannel = vHandles[i];
+                ctsi.nId = i;
+                ctsi.dFirstSampleTimestamp = dTime;
+                fRecord(EVENT_TYPE_CHANNEL_FIRST_SAMPLE_TS, &ctsi,
+                    sizeof(ctsi));
+            }
+        };
+        auto fAcquire = [&](bool bAcquiring) {
+            fRecord(EVENT_TYPE_ACQUIRE, &bAcquiring, sizeof(bAcquiring));
+        };
+        std::vector<uint64_t>   vNext(nChannels, 0);
+        auto fData = [&](uint64_t nSamples) {
+            for(int i = 0; i < nChannels; i++)
+                RecordCounter(fRecord, vHandles[i], i, nSamples, &vNext[i]);
+        };
+
+        fTimestamp(dStart);
+        fAcquire(true);
+        fData(nRun);
+
+        // Stopped and restarted, the timestamp of the new run comes late
+        fTimestamp(0.0);
+        fAcquire(false);
+        fAcquire(true);
+        fData(nUntimed);
+        fTimestamp(dRestart);
+        fData(nRun);
+
+        fTimestamp(0.0);
+        fAcquire(false);
+        for(int i = 0; i < nChannels; i++) {
+            ChannelUnsubscribedInfo cui;
+            cui.hChannel = vHandles[i];
+            cui.nId = i;
+            fRecord(EVENT_TYPE_CHANNEL_UNSUBSCRIBED, &cui, sizeof(cui));
+        }
+        r.Flush();
+    }
+
+    std::vector<std::vector<std::string>>   vReplayed(nChannels);
+    std::vector<uint64_t>                   vNext(nChannels, 0);
+    uint64_t                                nOutOfOrder = 0;
+
+    CaptureReplayConfig config = {};
+    config.dSpeed = 0.0;
+    config.nBlockSamples = 256;
+    CaptureReplay   replay(szDirectory, [&](EventType nType, const void *p,
+        size_t) {
+        LogEvent(vReplayed, nType, p);
+        if(nType != EVENT_TYPE_CHANNEL_DATA) return;
+
+        const ChannelDataInfo   *cdi =
+            reinterpret_cast<const ChannelDataInfo *>(p);
+        if(cdi->nId < 0 || cdi->nId >= nChannels) return;
+        for(size_t i = 0; i < cdi->nSamples; i++) {
+            if(cdi->pData[i] != static_cast<float>(vNext[cdi->nId]))
+                nOutOfOrder++;
+            vNext[cdi->nId]++;
+        }
+    }, config);
+    replay.Run();
+
+    bool    bPass = replay.Channels() == nChannels && vReplayed == vRecorded &&
+        !nOutOfOrder;
+    for(auto& e : vNext)
+        if(e != 2 * nRun + nUntimed) bPass = false;
+
+    std::cout << "check=replay result=" << (bPass ? "pass" : "fail") <<
+        " channels=" << replay.Channels() << " events=" <<
+        vReplayed[0].size() << " out_of_order=" << nOutOfOrder << std::endl;
+
+    for(auto& e : vPaths) {
+        std::string sIndexPath = e.substr(0, e.size() - 4) + ".lli";
+        ::unlink(e.c_str());
+        ::unlink(sIndexPath.c_str());
+    }
+    ::rmdir(szDirectory);
+
+    return bPass;
+}
+
+//
+// Function used to check the client keeps count of every channel, however
+// high its id:  a MockServer drops some of the packets of more than eight
+// channels, and each must have its packets and samples counted and its
+// gaps found
+//
+static bool CheckChannels(void)
+{
+    const int       nChannels = 12;
+    const size_t    nBlockSamples = 100;
+
+    MockServerConfig    config = {};
+    config.sAddress.assign("127.0.0.1");
+    config.sPort.assign("0");
+    config.nBlockSamples = nBlockSamples;
+    config.bAcquire = true;
+    config.Faults.dDropRate = 0.05;
+    config.nSeed = 1;
+
+    for(int i = 0; i < nChannels; i++) {
+        MockChannelConfig   c = {};
+        c.sName = "ai" + std::to_string(i);
+        c.sDataType.assign("float");
+        c.dSampleRate = 10000.0;
+        c.dScale = 1.0;
+        c.nSignal = MOCK_SIGNAL_COUNTER;
+        config.vChannels.push_back(c);
+    }
+
+    MockServer  server(config);
+    if(!server.Start()) return false;
+
+    boost::asio::io_context io_context;
+    std::string             sHost("127.0.0.1");
+    std::string             sPort(std::to_string(server.Port()));
+    ClientMetricsSnapshot   s;
+
+    try {
+        LowLatencyDataClient    client(io_context, sHost, sPort,
+            [](EventType, const void *, size_t) {});
+        client.SubscribeMatching("*");
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+        s = client.Metrics();
+    }
+    catch(std::exception& e) {
+        std::cerr << "Channel check failed: " << e.what() << std::endl;
+        server.Stop();
+        return false;
+    }
+    server.Stop();
+
+    std::vector<bool>   vCounted(nChannels, false);
+    uint64_t            nGaps = 0;
+
+    for(auto& c : s.vChannels) {
+        if(c.nId < 0 || c.nId >= nChannels || !c.nPackets || !c.nGaps ||
+            c.nSamples != c.nPackets * nBlockSamples) continue;
+
+        vCounted[c.nId] = true;
+        nGaps += c.nGaps;
+    }
+
+    bool    bPass = std::count(vCounted.begin(), vCounted.end(), true) ==
+        nChannels;
+
+    std::cout << "check=channels result=" << (bPass ? "pass" : "fail") <<
+        " channels=" << s.vChannels.size() << " gaps=" << nGaps << std::endl;
+    return bPass;
+}
+
+//
+// Function used to run each store over loopback against a MockServer
+// sending a counter on each channel, returns false if any check fails
+//
+static bool SelfCheck(void)
+{
+    // More than eight, the ids once taken for a framing error
+    const int       nChannels = 12;
+    const double    dRate = 10000.0;
+
+    MockServerConfig    config = {};
+    config.sAddress.assign("127.0.0.1");
+    config.sPort.assign("0");
+    config.nBlockSamples = 100;
+    config.bAcquire = true;
+    config.nSeed = 1;
+
+    for(int i = 0; i < nChannels; i++) {
+        MockChannelConfig   c = {};
+        c.sName = "ai" + std::to_string(i);
+        c.sDataType.assign("float");
+        c.dSampleRate = dRate;
+        c.dScale = 1.0;
+        c.nSignal = MOCK_SIGNAL_COUNTER;
+        config.vChannels.push_back(c);
+    }
+
+    MockServer  server(config);
+    if(!server.Start()) return false;
+
+    // Level 0 only holds 1024 samples so a second's query needs level 4
+    TapConfig   tc = {};
+    tc.dHistorySeconds = 10.0;
+    tc.Lod.nBaseBucketSamples = 16;
+    tc.Lod.nLevels = 8;
+    tc.Lod.nBucketsPerLevel = 64;
+    tc.sShmPublish = "/ll-tap-check-" + std::to_string(::getpid());
+    tc.Multicast.sGroup.assign("239.255.76.77");
+    tc.Multicast.nPort = static_cast<uint16_t>(40000 + ::getpid() % 20000);
+    tc.Multicast.sInterface.assign("127.0.0.1");
+    tc.Multicast.nTtl = 0;
+    tc.Multicast.bLoopback = true;
+
+    // What readers of the ring and the group get goes into stores of their
+    // own
+    TapConfig   rtc = tc;
+    rtc.sShmPublish.clear();
+    rtc.Multicast.nPort = 0;
+
+    auto    pTap = std::make_unique<Tap>();
+    auto    pShmTap = std::make_unique<Tap>();
+    auto    pMulticastTap = std::make_unique<Tap>();
+    Tap&    t = *pTap;
+    Tap&    rt = *pShmTap;
+    Tap&    mt = *pMulticastTap;
+    if(!OpenTap(t, tc) || !OpenTap(rt, rtc) || !OpenTap(mt, rtc)) {
+        server.Stop();
+        return false;
+    }
+
+    ShmFanoutReaderConfig   src = {};
+    src.sName = tc.sShmPublish;
+    src.nIdleSleepUs = 100;
+    ShmFanoutReader         reader(src,
+        [&rt](EventType nType, const void *p, size_t nSize) {
+            TapEvent(rt, nType, p, nSize);
+        });
+    reader.Start();
+
+    MulticastReceiverConfig mrc = {};
+    mrc.sGroup = tc.Multicast.sGroup;
+    mrc.nPort = tc.Multicast.nPort;
+    mrc.sInterface = tc.Multicast.sInterface;
+    mrc.nReceiveBufferBytes = 4 * 1024 * 1024;
+    MulticastReceiver       receiver(mrc,
+        [&mt](EventType nType, const void *p, size_t nSize) {
+            TapEvent(mt, nType, p, nSize);
+        });
+    receiver.Start();
+
+    boost::asio::io_context io_context;
+    std::string             sHost("127.0.0.1");
+    std::string             sPort(std::to_string(server.Port()));
+    bool                    bPass = true;
+
+    try {
+        {
+            LowLatencyDataClient    client(io_context, sHost, sPort,
+                [&t](EventType nType, const void *p, size_t nSize) {
+                    TapEvent(t, nType, p, nSize);
+                });
+            client.SubscribeMatching("*");
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+
+            bPass = CheckHistory(t, nChannels, dRate) && bPass;
+            bPass = CheckLod(t, nChannels, dRate) && bPass;
+        }
+
+        // Nothing more is published once the client is gone, the reader
+        // stops when it has read the rest
+        t.pShm.reset();
+        reader.Wait();
+        bPass = CheckShm(t, rt, nChannels) && bPass;
+
+        // The publisher sends what it holds as it goes, then give the
+        // datagrams time to arrive
+        t.pMulticast.reset();
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        receiver.Stop();
+        receiver.Wait();
+        bPass = CheckMulticast(t, mt, nChannels, receiver.Stats()) && bPass;
+    }
+    catch(std::exception& e) {
+        std::cerr << "Self check failed: " << e.what() << std::endl;
+        bPass = false;
+    }
+
+    reader.Stop();
+    reader.Wait();
+    receiver.Stop();
+    receiver.Wait();
+    server.Stop();
+
+    bPass = CheckChannels() && bPass;
+    bPass = CheckCapture() && bPass;
+    bPass = CheckReplay() && bPass;
+
+    return bPass;
+}
+
+//
+// Function used to split a group:port argument, returns false if it is not
+// one
+//
+static bool ParseGroup(const char *psz, std::string& sGroup, uint16_t& nPort)
+{
+    const char  *pszColon = std::strrchr(psz, ':');
+    if(!pszColon || pszColon == psz) return false;
+
+    int n = std::atoi(pszColon + 1);
+    if(n <= 0 || n > 65535) return false;
+
+    sGroup.assign(psz, pszColon - psz);
+    nPort = static_cast<uint16_t>(n);
+    return true;
+}
+
+//
+// Function used to print what the stores hold once a second until the user
+// quits, calling fTick every 100 ms in between
+//
+static void PrintUntilQuit(Tap& t, const std::function<void(void)>& fTick)
+{
+    while(!g_bQuit) {
+        for(int n = 0; n < 10 && !g_bQuit; n++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            fTick();
+        }
+
+        PrintTap(t);
+    }
+}
+
+//
+// Function used to feed the stores from a reader of a publisher until the
+// user quits
+//
+template<typename Reader, typename Config>
+static int RunReader(Tap& t, const Config& rc)
+{
+    Reader  reader(rc, [&t](EventType nType, const void *p, size_t n) {
+        TapEvent(t, nType, p, n);
+    });
+    if(!reader.IsOpen()) return 1;
+
+    reader.Start();
+    PrintUntilQuit(t, []() {});
+    reader.Stop();
+    reader.Wait();
+    return 0;
+}
+
+//
+// Entry point of the application.  Taps the server until interrupted,
+// printing what the stores hold once a second.
+//
+int main(int argc, char *argv[])
+{
+    TapConfig   config = {};
+    std::string sInterface;
+    int         nArg = 1;
+
+    config.sPort.assign("10006");
+    config.dHistorySeconds = 10.0;
+    config.Lod.nBaseBucketSamples = 64;
+    config.Lod.nLevels = 16;
+    config.Lod.nBucketsPerLevel = 1024;
+
+    for(; nArg < argc && argv[nArg][0] == '-'; nArg++) {
+        std::string s(argv[nArg]);
+        const char  *pszValue = nArg + 1 < argc ? argv[nArg + 1] : nullptr;
+
+        if(s == "-T") return SelfCheck() ? 0 : 1;
+
+        if(s == "-a") {
+            config.bAcquire = true;
+            continue;
+        }
+
+        if(s.size() != 2 || !pszValue) {
+            usage(argv[0]);
+            return 1;
+        }
+        nArg++;
+
+        switch(s[1]) {
+            case 'c': config.vPatterns.push_back(pszValue); break;
+            case 'h': config.dHistorySeconds = std::atof(pszValue); break;
+            case 's': config.sShmPublish.assign(pszValue); break;
+            case 'S': config.sShmRead.assign(pszValue); break;
+            case 'i': sInterface.assign(pszValue); break;
+
+            case 'm':
+                if(ParseGroup(pszValue, config.Multicast.sGroup,
+                    config.Multicast.nPort)) break;
+                usage(argv[0]);
+                return 1;
+
+            case 'M':
+                if(ParseGroup(pszValue, config.MulticastRead.sGroup,
+                    config.MulticastRead.nPort)) break;
+                usage(argv[0]);
+                return 1;
+
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    config.Multicast.sInterface = sInterface;
+    config.Multicast.nTtl = 1;
+    config.Multicast.bLoopback = true;
+    config.MulticastRead.sInterface = sInterface;
+    config.MulticastRead.nReceiveBufferBytes = 4 * 1024 * 1024;
+
+    // A ring or group to read from takes the place of the host
+    bool    bConnect = config.sShmRead.empty() && !config.MulticastRead.nPort;
+    if((bConnect ? nArg >= argc || argc - nArg > 2 : nArg != argc) ||
+        !(config.dHistorySeconds > 0.0)) {
+        usage(argv[0]);
+        return 1;
+    }
+    if(bConnect) {
+        config.sHost.assign(argv[nArg]);
+        if(nArg + 1 < argc) config.sPort.assign(argv[nArg + 1]);
+    }
+
+    auto    pTap = std::make_unique<Tap>();
+    Tap&    t = *pTap;
+    if(!OpenTap(t, config)) return 1;
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    if(config.MulticastRead.nPort)
+        return RunReader<MulticastReceiver>(t, config.MulticastRead);
+
+    if(!bConnect) {
+        ShmFanoutReaderConfig   rc = {};
+        rc.sName = config.sShmRead;
+        rc.nIdleSleepUs = 100;
+        return RunReader<ShmFanoutReader>(t, rc);
+    }
+
+    boost::asio::io_context io_context;
+
+    try {
+        LowLatencyDataClient    client(io_context, config.sHost,
+            config.sPort, [&t](EventType nType, const void *p, size_t n) {
+                TapEvent(t, nType, p, n);
+            });
+
+        for(auto& s : config.vPatterns) client.SubscribeMatching(s);
+        if(config.vPatterns.empty()) client.SubscribeMatching("*");
+        bool    bAcquireSent = false;
+
+        PrintUntilQuit(t, [&]() {
+            // Only once the state is known, Acquire() toggles it
+            if(config.bAcquire && !bAcquireSent && t.nAcquiring == 0) {
+                client.Acquire();
+                bAcquireSent = true;
+            }
+        });
+    }
+    catch(std::exception& e) {
+        std::cerr << "Tap failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}